@@ -0,0 +1,800 @@
+#include "AABB.h"
+#include "Box.h"
+#include "Camera.h"
+#include "CompiledScene.h"
+#include "Hittable.h"
+#include "HittableList.h"
+#include "InstanceTranslation.h"
+#include "InstanceYRotation.h"
+#include "OrientedBox.h"
+#include "PerlinNoise.h"
+#include "Quad.h"
+#include "Renderer.h"
+#include "Scenes.h"
+#include "Sphere.h"
+#include "Util.h"
+#include "XYRectangle.h"
+#include "XZRectangle.h"
+#include "YZRectangle.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	//Every random stream in the benchmark is derived from this so runs are comparable
+	constexpr unsigned int BenchmarkSeed = 1337;
+
+	//Extra references the spatial split BVH may create, as a fraction of the primitive count
+	constexpr float SpatialSplitBudget = 0.3f;
+
+	//Primitives per cluster in the clustered run, 64 KiB of primitive records
+	constexpr size_t ClusterSize = 1024;
+
+	//Tile edge length for the breadth first tile renders
+	constexpr size_t TileSize = 32;
+
+	struct BenchmarkSettings
+	{
+		RenderSettings render;
+		std::vector<size_t> threadCounts;
+		size_t microbenchmarkCalls = 2000000;
+		std::string outputPath = "benchmark.json";
+	};
+
+	struct RenderResult
+	{
+		size_t threadCount = 0;
+		double poolStartupMilliseconds = 0.0;
+		double renderMilliseconds = 0.0;
+		double resolveMilliseconds = 0.0;
+		uint64_t primaryRays = 0;
+		uint64_t totalRays = 0;
+	};
+
+	struct CompiledResult
+	{
+		uint64_t bytes = 0;
+		uint64_t nodeBytes = 0; //BVH nodes alone, compared against primitiveCount to get the tree's cost per primitive
+		uint64_t primitiveCount = 0;
+		double compileMilliseconds = 0.0;
+		double loadMilliseconds = 0.0;
+		bool samplesLights = false; //Traced with next event estimation, which scenes built directly don't have
+		RenderResult render;
+	};
+
+	//Hit rates of the L1 data cache and the last level cache over a render, hardware counters aren't
+	//available everywhere so the rates are only meaningful when available is set
+	struct CacheResult
+	{
+		bool available = false;
+		double l1HitRate = 0.0;
+		double lastLevelHitRate = 0.0;
+	};
+
+	struct TileResult
+	{
+		RenderResult render;
+		CacheResult cache;
+	};
+
+	//Counts cache reads and misses across every thread created after Start, which has to be called before the
+	//thread pool is. Only implemented with Linux perf events, where L2 has no generic event so the L1 data
+	//cache and the last level cache bracket it.
+	class CacheCounters
+	{
+	public:
+		CacheCounters(const CacheCounters&) = delete;
+		CacheCounters& operator=(const CacheCounters&) = delete;
+
+		CacheCounters() = default;
+
+		~CacheCounters()
+		{
+#ifdef __linux__
+			for (int descriptor : descriptors)
+			{
+				if (descriptor >= 0)
+				{
+					close(descriptor);
+				}
+			}
+#endif
+		}
+
+		void Start()
+		{
+#ifdef __linux__
+			const uint64_t l1 = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8);
+			const uint64_t lastLevel = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8);
+			const uint64_t configs[CounterCount] = {
+				l1 | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16),
+				l1 | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+				lastLevel | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16),
+				lastLevel | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+			};
+
+			for (size_t i = 0; i < CounterCount; i++)
+			{
+				perf_event_attr attributes = {};
+				attributes.type = PERF_TYPE_HW_CACHE;
+				attributes.size = sizeof(attributes);
+				attributes.config = configs[i];
+				attributes.disabled = 1;
+				attributes.inherit = 1;
+				attributes.exclude_kernel = 1;
+				attributes.exclude_hv = 1;
+
+				descriptors[i] = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+				if (descriptors[i] >= 0)
+				{
+					ioctl(descriptors[i], PERF_EVENT_IOC_RESET, 0);
+					ioctl(descriptors[i], PERF_EVENT_IOC_ENABLE, 0);
+				}
+			}
+#endif
+		}
+
+		//Call once the threads being counted have exited, their counts are only folded in then
+		CacheResult Stop()
+		{
+			CacheResult result;
+#ifdef __linux__
+			uint64_t counts[CounterCount] = {};
+			for (size_t i = 0; i < CounterCount; i++)
+			{
+				if (descriptors[i] < 0)
+				{
+					return result;
+				}
+
+				ioctl(descriptors[i], PERF_EVENT_IOC_DISABLE, 0);
+				if (read(descriptors[i], &counts[i], sizeof(counts[i])) != sizeof(counts[i]))
+				{
+					return result;
+				}
+			}
+
+			if (counts[0] == 0 || counts[2] == 0)
+			{
+				return result;
+			}
+
+			result.available = true;
+			result.l1HitRate = 1.0 - static_cast<double>(counts[1]) / static_cast<double>(counts[0]);
+			result.lastLevelHitRate = 1.0 - static_cast<double>(counts[3]) / static_cast<double>(counts[2]);
+#endif
+			return result;
+		}
+
+	private:
+#ifdef __linux__
+		static constexpr size_t CounterCount = 4;
+		int descriptors[CounterCount] = { -1, -1, -1, -1 };
+#endif
+	};
+
+	struct SceneResult
+	{
+		std::string name;
+		size_t objectCount = 0;
+		double sceneBuildMilliseconds = 0.0;
+		double bvhBuildMilliseconds = 0.0;
+		std::vector<RenderResult> renders;
+
+		//The same scene written by SceneCompiler, mapped back in and rendered at the highest thread count,
+		//with the plain SAH BVH, with spatial splits, with quantized wide nodes and split into clusters
+		CompiledResult compiled;
+		CompiledResult spatialSplits;
+		CompiledResult wideNodes;
+		CompiledResult clustered;
+
+		//Tiles rendered breadth first at the highest thread count, tracing each bounce's rays in generation
+		//order and then sorted for coherence
+		TileResult batched;
+		TileResult sorted;
+	};
+
+	struct MicrobenchmarkResult
+	{
+		std::string name;
+		uint64_t calls = 0;
+		double nanosecondsPerCall = 0.0;
+		double checksum = 0.0;
+	};
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	double MegaPerSecond(uint64_t count, double milliseconds)
+	{
+		return milliseconds > 0.0 ? static_cast<double>(count) / (milliseconds * 1000.0) : 0.0;
+	}
+
+	std::vector<size_t> DefaultThreadCounts()
+	{
+		const size_t hardwareThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+		std::vector<size_t> counts;
+		for (size_t count = 1; count < hardwareThreads; count *= 2)
+		{
+			counts.push_back(count);
+		}
+		counts.push_back(hardwareThreads);
+
+		return counts;
+	}
+
+	//Parses "N" or "N,N,...", raising counts of 0 to 1. Returns false unless every item is a whole number.
+	bool ParseCounts(const char* value, std::vector<size_t>& counts)
+	{
+		counts.clear();
+		char* end = nullptr;
+		do
+		{
+			if (!std::isdigit(static_cast<unsigned char>(*value)))
+			{
+				return false;
+			}
+			counts.push_back(std::max<size_t>(1, static_cast<size_t>(std::strtoull(value, &end, 10))));
+			value = end + 1;
+		} while (*end == ',');
+
+		return *end == '\0';
+	}
+
+	void PrintUsage(const char* program)
+	{
+		std::cerr << "Usage: " << program << " [--quick] [--threads 1,2,4] [--spp N] [--output benchmark.json]\n";
+	}
+
+	RenderResult RenderScene(const Scene& scene, const RenderSettings& settings, size_t threadCount)
+	{
+		RenderResult result;
+		result.threadCount = threadCount;
+		result.primaryRays = static_cast<uint64_t>(settings.width) * settings.height * settings.samplesPerPixel;
+
+		const Camera camera = scene.CreateCamera(static_cast<float>(settings.width) / static_cast<float>(settings.height));
+		std::vector<Vector3> pixels(settings.width * settings.height);
+
+		Clock::time_point start = Clock::now();
+		ThreadPool threadPool(threadCount);
+		result.poolStartupMilliseconds = MillisecondsSince(start);
+
+		start = Clock::now();
+
+		std::vector<TaskFuture<uint64_t>> rows;
+		rows.reserve(settings.height);
+		for (size_t y = 0; y < settings.height; y++)
+		{
+			rows.push_back(threadPool.AddTask([&scene, &camera, &settings, &pixels, y]()
+				{
+					//Seed per scanline so the work done is identical for every thread count
+					Util::SeedRandom(BenchmarkSeed + static_cast<unsigned int>(y));
+					Renderer::TakeRayCount();
+
+					for (size_t x = 0; x < settings.width; x++)
+					{
+						pixels[y * settings.width + x] = Renderer::RenderPixel(x, y, scene, camera, settings);
+					}
+
+					return Renderer::TakeRayCount();
+				}));
+		}
+
+		for (TaskFuture<uint64_t>& row : rows)
+		{
+			result.totalRays += row.Get();
+		}
+
+		result.renderMilliseconds = MillisecondsSince(start);
+
+		//Resolve to 8 bit colour the same way ImageData does, minus the disk write
+		start = Clock::now();
+		std::vector<unsigned char> resolved(pixels.size() * 3);
+		const float inverseSampleCount = 1.0f / static_cast<float>(settings.samplesPerPixel);
+		for (size_t i = 0; i < pixels.size(); i++)
+		{
+			Vector3 colour = pixels[i] * inverseSampleCount;
+			resolved[i * 3 + 0] = static_cast<unsigned char>(std::min(255.99f * std::sqrt(colour.x), 255.0f));
+			resolved[i * 3 + 1] = static_cast<unsigned char>(std::min(255.99f * std::sqrt(colour.y), 255.0f));
+			resolved[i * 3 + 2] = static_cast<unsigned char>(std::min(255.99f * std::sqrt(colour.z), 255.0f));
+		}
+		result.resolveMilliseconds = MillisecondsSince(start);
+
+		return result;
+	}
+
+	TileResult RenderTiles(const Scene& scene, const RenderSettings& settings, size_t threadCount, bool sortRays)
+	{
+		TileResult result;
+		RenderResult& render = result.render;
+		render.threadCount = threadCount;
+		render.primaryRays = static_cast<uint64_t>(settings.width) * settings.height * settings.samplesPerPixel;
+
+		const Camera camera = scene.CreateCamera(static_cast<float>(settings.width) / static_cast<float>(settings.height));
+
+		CacheCounters counters;
+		counters.Start();
+
+		{
+			Clock::time_point start = Clock::now();
+			ThreadPool threadPool(threadCount);
+			render.poolStartupMilliseconds = MillisecondsSince(start);
+
+			start = Clock::now();
+
+			std::vector<TaskFuture<uint64_t>> tiles;
+			for (size_t y0 = 0; y0 < settings.height; y0 += TileSize)
+			{
+				for (size_t x0 = 0; x0 < settings.width; x0 += TileSize)
+				{
+					tiles.push_back(threadPool.AddTask([&scene, &camera, &settings, sortRays, x0, y0]()
+						{
+							//Seed per tile so the work done is identical for every thread count
+							Util::SeedRandom(Renderer::PixelSeed(BenchmarkSeed, x0, y0));
+							Renderer::TakeRayCount();
+
+							std::vector<Vector3> colours;
+							Renderer::RenderTile(x0, y0, std::min(x0 + TileSize, settings.width), std::min(y0 + TileSize, settings.height), scene, camera, settings, sortRays, colours);
+
+							return Renderer::TakeRayCount();
+						}));
+				}
+			}
+
+			for (TaskFuture<uint64_t>& tile : tiles)
+			{
+				render.totalRays += tile.Get();
+			}
+
+			render.renderMilliseconds = MillisecondsSince(start);
+		}
+
+		result.cache = counters.Stop();
+
+		return result;
+	}
+
+	CompiledResult BenchmarkCompiled(const Scene& scene, const std::string& name, const CompileOptions& options, const BenchmarkSettings& settings)
+	{
+		CompiledResult result;
+
+		const std::filesystem::path compiledPath = std::filesystem::temp_directory_path() / (name + ".rtscene");
+
+		Clock::time_point start = Clock::now();
+		const bool compiled = Scenes::Compile(scene, compiledPath, options);
+		result.compileMilliseconds = MillisecondsSince(start);
+
+		Scene compiledScene;
+		start = Clock::now();
+		if (compiled && Scenes::Load(compiledPath, compiledScene))
+		{
+			result.loadMilliseconds = MillisecondsSince(start);
+			result.bytes = std::filesystem::file_size(compiledPath);
+
+			const CompiledScene* compiledWorld = static_cast<const CompiledScene*>(compiledScene.world);
+			result.nodeBytes = compiledWorld->NodeBytes();
+			result.primitiveCount = compiledWorld->PrimitiveCount();
+			result.samplesLights = compiledScene.lights != nullptr;
+
+			result.render = RenderScene(compiledScene, settings.render, settings.threadCounts.back());
+			delete compiledScene.world;
+		}
+
+		std::error_code error;
+		std::filesystem::remove(compiledPath, error);
+
+		return result;
+	}
+
+	SceneResult BenchmarkScene(SceneId id, const BenchmarkSettings& settings)
+	{
+		SceneResult result;
+		result.name = Scenes::GetName(id);
+
+		Util::SeedRandom(BenchmarkSeed);
+		Clock::time_point start = Clock::now();
+		Scene scene = Scenes::CreateObjects(id);
+		result.sceneBuildMilliseconds = MillisecondsSince(start);
+		result.objectCount = scene.objects.size();
+
+		Util::SeedRandom(BenchmarkSeed);
+		start = Clock::now();
+		Scenes::BuildWorld(scene);
+		result.bvhBuildMilliseconds = MillisecondsSince(start);
+
+		for (size_t threadCount : settings.threadCounts)
+		{
+			result.renders.push_back(RenderScene(scene, settings.render, threadCount));
+		}
+
+		CompileOptions options;
+		result.compiled = BenchmarkCompiled(scene, result.name, options, settings);
+
+		options.duplicationBudget = SpatialSplitBudget;
+		result.spatialSplits = BenchmarkCompiled(scene, result.name, options, settings);
+
+		options = CompileOptions();
+		options.nodeLayout = SceneFormat::NodeLayout::Wide;
+		result.wideNodes = BenchmarkCompiled(scene, result.name, options, settings);
+
+		options = CompileOptions();
+		options.clusterSize = ClusterSize;
+		result.clustered = BenchmarkCompiled(scene, result.name, options, settings);
+
+		result.batched = RenderTiles(scene, settings.render, settings.threadCounts.back(), false);
+		result.sorted = RenderTiles(scene, settings.render, settings.threadCounts.back(), true);
+
+		return result;
+	}
+
+	//Rays start outside a unit sized target and aim at a slightly larger region so roughly half of them hit
+	std::vector<Ray> GenerateMicrobenchmarkRays(size_t count)
+	{
+		Util::SeedRandom(BenchmarkSeed);
+
+		std::vector<Ray> rays;
+		rays.reserve(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			Vector3 origin = 5.0f * GetNormalized(Util::RandomInUnitSphere());
+			Vector3 target = 1.5f * Util::RandomInUnitSphere();
+			rays.emplace_back(origin, target - origin, 0.0f);
+		}
+
+		return rays;
+	}
+
+	template<typename Function>
+	MicrobenchmarkResult RunMicrobenchmark(const std::string& name, uint64_t calls, Function&& function)
+	{
+		MicrobenchmarkResult result;
+		result.name = name;
+		result.calls = calls;
+
+		const Clock::time_point start = Clock::now();
+		for (uint64_t i = 0; i < calls; i++)
+		{
+			result.checksum += function(static_cast<size_t>(i));
+		}
+		result.nanosecondsPerCall = MillisecondsSince(start) * 1000000.0 / static_cast<double>(calls);
+
+		return result;
+	}
+
+	std::vector<MicrobenchmarkResult> RunMicrobenchmarks(const BenchmarkSettings& settings)
+	{
+		constexpr size_t RayCount = 4096;
+		const std::vector<Ray> rays = GenerateMicrobenchmarkRays(RayCount);
+		const uint64_t calls = settings.microbenchmarkCalls;
+
+		const Sphere sphere(Vector3(0.0f, 0.0f, 0.0f), 1.0f, nullptr);
+		const XYRectangle xyRectangle(-1.0f, 1.0f, -1.0f, 1.0f, 0.0f, nullptr);
+		const XZRectangle xzRectangle(-1.0f, 1.0f, -1.0f, 1.0f, 0.0f, nullptr);
+		const YZRectangle yzRectangle(-1.0f, 1.0f, -1.0f, 1.0f, 0.0f, nullptr);
+		const AABB box(Vector3(-1.0f, -1.0f, -1.0f), Vector3(1.0f, 1.0f, 1.0f));
+
+		auto hitTest = [&rays](const Hittable& hittable)
+		{
+			return [&rays, target = &hittable](size_t i)
+			{
+				HitRecord hitRecord;
+				return target->Hit(rays[i % RayCount], 0.001f, std::numeric_limits<float>::max(), hitRecord) ? static_cast<double>(hitRecord.t) : 0.0;
+			};
+		};
+
+		std::vector<MicrobenchmarkResult> results;
+		results.push_back(RunMicrobenchmark("Sphere::Hit", calls, hitTest(sphere)));
+		results.push_back(RunMicrobenchmark("XYRectangle::Hit", calls, hitTest(xyRectangle)));
+		results.push_back(RunMicrobenchmark("XZRectangle::Hit", calls, hitTest(xzRectangle)));
+		results.push_back(RunMicrobenchmark("YZRectangle::Hit", calls, hitTest(yzRectangle)));
+
+		//The box as the six rectangles it used to be built from, against the single slab test
+		Hittable* sides[] = {
+			new XYRectangle(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, nullptr), new XYRectangle(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, nullptr),
+			new XZRectangle(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, nullptr), new XZRectangle(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, nullptr),
+			new YZRectangle(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, nullptr), new YZRectangle(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, nullptr)
+		};
+		const HittableList rectangleBox(sides, 6);
+		const Box slabBox(Vector3(-1.0f, -1.0f, -1.0f), Vector3(1.0f, 1.0f, 1.0f), nullptr);
+
+		//A turned box the way the Cornell box used to place them, against one oriented box leaf
+		const InstanceTranslation instancedBox(new InstanceYRotation(new Box(Vector3(0.0f, 0.0f, 0.0f), Vector3(1.0f, 1.0f, 1.0f), nullptr), 15.0f), Vector3(-0.5f, -0.5f, -0.5f));
+		const std::unique_ptr<OrientedBox> orientedBox(OrientedBox::YRotated(Vector3(1.0f, 1.0f, 1.0f), 15.0f, Vector3(-0.5f, -0.5f, -0.5f), nullptr));
+		const Quad quad(Vector3(-1.0f, -1.0f, 0.0f), Vector3(2.0f, 0.0f, 0.0f), Vector3(0.0f, 2.0f, 0.0f), nullptr);
+
+		results.push_back(RunMicrobenchmark("Quad::Hit", calls, hitTest(quad)));
+		results.push_back(RunMicrobenchmark("Box as 6 rectangles", calls, hitTest(rectangleBox)));
+		results.push_back(RunMicrobenchmark("Box::Hit", calls, hitTest(slabBox)));
+		results.push_back(RunMicrobenchmark("Instanced rotated Box", calls, hitTest(instancedBox)));
+		results.push_back(RunMicrobenchmark("OrientedBox::Hit", calls, hitTest(*orientedBox)));
+		results.push_back(RunMicrobenchmark("AABB::RayIntersection", calls, [&rays, &box](size_t i)
+			{
+				return box.RayIntersection(rays[i % RayCount], 0.001f, std::numeric_limits<float>::max()) ? 1.0 : 0.0;
+			}));
+
+		Util::SeedRandom(BenchmarkSeed);
+		const PerlinNoise noise;
+		std::vector<Vector3> points(RayCount);
+		for (Vector3& point : points)
+		{
+			point = Vector3(10.0f * Util::RandomFloat(), 10.0f * Util::RandomFloat(), 10.0f * Util::RandomFloat());
+		}
+
+		//Turbulence is an order of magnitude slower than a hit test so it gets fewer calls
+		results.push_back(RunMicrobenchmark("PerlinNoise::Turbulence", std::max<uint64_t>(1, calls / 10), [&noise, &points](size_t i)
+			{
+				return static_cast<double>(noise.Turbulence(points[i % RayCount]));
+			}));
+
+		return results;
+	}
+
+	void PrintCompiled(const char* label, const CompiledResult& compiled)
+	{
+		const RenderResult& render = compiled.render;
+		std::cout << label << " " << compiled.bytes << " bytes"
+			<< "  nodes " << static_cast<double>(compiled.nodeBytes) / std::max<uint64_t>(1, compiled.primitiveCount) << " bytes/primitive"
+			<< "  compile " << compiled.compileMilliseconds << " ms"
+			<< "  load " << compiled.loadMilliseconds << " ms"
+			<< "  render " << render.renderMilliseconds << " ms"
+			<< "  total Mray/s " << MegaPerSecond(render.totalRays, render.renderMilliseconds) << " with " << render.threadCount << " threads"
+			<< (compiled.samplesLights ? "  samples lights" : "") << "\n";
+	}
+
+	void WriteCompiledJson(std::ofstream& file, const char* key, const CompiledResult& compiled)
+	{
+		const RenderResult& render = compiled.render;
+		file << "      \"" << key << "\": { \"bytes\": " << compiled.bytes
+			<< ", \"nodeBytes\": " << compiled.nodeBytes
+			<< ", \"primitives\": " << compiled.primitiveCount
+			<< ", \"compileMs\": " << compiled.compileMilliseconds
+			<< ", \"loadMs\": " << compiled.loadMilliseconds
+			<< ", \"samplesLights\": " << (compiled.samplesLights ? "true" : "false")
+			<< ", \"threads\": " << render.threadCount
+			<< ", \"renderMs\": " << render.renderMilliseconds
+			<< ", \"totalRays\": " << render.totalRays
+			<< ", \"totalMraysPerSecond\": " << MegaPerSecond(render.totalRays, render.renderMilliseconds)
+			<< " }";
+	}
+
+	void PrintTiles(const char* label, const TileResult& tiles)
+	{
+		const RenderResult& render = tiles.render;
+		std::cout << label << " render " << render.renderMilliseconds << " ms"
+			<< "  total Mray/s " << MegaPerSecond(render.totalRays, render.renderMilliseconds) << " with " << render.threadCount << " threads";
+
+		if (tiles.cache.available)
+		{
+			std::cout << "  L1D hit " << 100.0 * tiles.cache.l1HitRate << "%  LLC hit " << 100.0 * tiles.cache.lastLevelHitRate << "%\n";
+		}
+		else
+		{
+			std::cout << "  cache counters n/a\n";
+		}
+	}
+
+	void WriteTilesJson(std::ofstream& file, const char* key, const TileResult& tiles)
+	{
+		const RenderResult& render = tiles.render;
+		file << "      \"" << key << "\": { \"threads\": " << render.threadCount
+			<< ", \"renderMs\": " << render.renderMilliseconds
+			<< ", \"totalRays\": " << render.totalRays
+			<< ", \"totalMraysPerSecond\": " << MegaPerSecond(render.totalRays, render.renderMilliseconds);
+
+		if (tiles.cache.available)
+		{
+			file << ", \"l1HitRate\": " << tiles.cache.l1HitRate << ", \"lastLevelHitRate\": " << tiles.cache.lastLevelHitRate;
+		}
+		else
+		{
+			file << ", \"l1HitRate\": null, \"lastLevelHitRate\": null";
+		}
+
+		file << " }";
+	}
+
+	void PrintResults(const BenchmarkSettings& settings, const std::vector<SceneResult>& scenes, const std::vector<MicrobenchmarkResult>& microbenchmarks)
+	{
+		const RenderSettings& render = settings.render;
+		std::cout << "Resolution " << render.width << "x" << render.height << ", " << render.samplesPerPixel << " spp, "
+			<< render.maxBounces << " max bounces, seed " << BenchmarkSeed << "\n\n";
+
+		std::cout << std::fixed << std::setprecision(2);
+		for (const SceneResult& scene : scenes)
+		{
+			std::cout << scene.name << " (" << scene.objectCount << " objects)"
+				<< "  scene build " << scene.sceneBuildMilliseconds << " ms"
+				<< "  bvh build " << scene.bvhBuildMilliseconds << " ms\n";
+
+			std::cout << std::setw(10) << "threads" << std::setw(14) << "startup ms" << std::setw(14) << "render ms" << std::setw(14) << "resolve ms"
+				<< std::setw(16) << "primary Mray/s" << std::setw(14) << "total Mray/s" << "\n";
+
+			for (const RenderResult& run : scene.renders)
+			{
+				std::cout << std::setw(10) << run.threadCount
+					<< std::setw(14) << run.poolStartupMilliseconds
+					<< std::setw(14) << run.renderMilliseconds
+					<< std::setw(14) << run.resolveMilliseconds
+					<< std::setw(16) << MegaPerSecond(run.primaryRays, run.renderMilliseconds)
+					<< std::setw(14) << MegaPerSecond(run.totalRays, run.renderMilliseconds) << "\n";
+			}
+
+			PrintCompiled("compiled", scene.compiled);
+			PrintCompiled("sbvh", scene.spatialSplits);
+			PrintCompiled("wide", scene.wideNodes);
+			PrintCompiled("clustered", scene.clustered);
+			PrintTiles("batched", scene.batched);
+			PrintTiles("sorted", scene.sorted);
+			if (scene.compiled.samplesLights)
+			{
+				//Shadow rays add to the compiled renders' ray counts and change their images, so they aren't like for like
+				std::cout << "compiled renders sample lights directly, the others only find lights by bouncing into them\n";
+			}
+			std::cout << "\n";
+		}
+
+		std::cout << std::setw(26) << "microbenchmark" << std::setw(14) << "ns/call" << std::setw(14) << "Mcall/s" << "\n";
+		for (const MicrobenchmarkResult& micro : microbenchmarks)
+		{
+			std::cout << std::setw(26) << micro.name << std::setw(14) << micro.nanosecondsPerCall << std::setw(14) << 1000.0 / micro.nanosecondsPerCall << "\n";
+		}
+	}
+
+	void WriteJson(const BenchmarkSettings& settings, const std::vector<SceneResult>& scenes, const std::vector<MicrobenchmarkResult>& microbenchmarks)
+	{
+		std::ofstream file(settings.outputPath);
+		if (!file.is_open())
+		{
+			std::cerr << "Unable to open " << settings.outputPath << "\n";
+			return;
+		}
+
+		const RenderSettings& render = settings.render;
+		file << std::setprecision(6) << std::fixed;
+		file << "{\n";
+		file << "  \"seed\": " << BenchmarkSeed << ",\n";
+		file << "  \"width\": " << render.width << ",\n";
+		file << "  \"height\": " << render.height << ",\n";
+		file << "  \"samplesPerPixel\": " << render.samplesPerPixel << ",\n";
+		file << "  \"maxBounces\": " << render.maxBounces << ",\n";
+		file << "  \"hardwareThreads\": " << std::thread::hardware_concurrency() << ",\n";
+		file << "  \"scenes\": [\n";
+		for (size_t i = 0; i < scenes.size(); i++)
+		{
+			const SceneResult& scene = scenes[i];
+			file << "    {\n";
+			file << "      \"name\": \"" << scene.name << "\",\n";
+			file << "      \"objects\": " << scene.objectCount << ",\n";
+			file << "      \"sceneBuildMs\": " << scene.sceneBuildMilliseconds << ",\n";
+			file << "      \"bvhBuildMs\": " << scene.bvhBuildMilliseconds << ",\n";
+			file << "      \"renders\": [\n";
+			for (size_t j = 0; j < scene.renders.size(); j++)
+			{
+				const RenderResult& run = scene.renders[j];
+				file << "        { \"threads\": " << run.threadCount
+					<< ", \"poolStartupMs\": " << run.poolStartupMilliseconds
+					<< ", \"renderMs\": " << run.renderMilliseconds
+					<< ", \"resolveMs\": " << run.resolveMilliseconds
+					<< ", \"primaryRays\": " << run.primaryRays
+					<< ", \"totalRays\": " << run.totalRays
+					<< ", \"primaryMraysPerSecond\": " << MegaPerSecond(run.primaryRays, run.renderMilliseconds)
+					<< ", \"totalMraysPerSecond\": " << MegaPerSecond(run.totalRays, run.renderMilliseconds)
+					<< " }" << (j + 1 < scene.renders.size() ? "," : "") << "\n";
+			}
+			file << "      ],\n";
+
+			WriteCompiledJson(file, "compiled", scene.compiled);
+			file << ",\n";
+			WriteCompiledJson(file, "spatialSplits", scene.spatialSplits);
+			file << ",\n";
+			WriteCompiledJson(file, "wideNodes", scene.wideNodes);
+			file << ",\n";
+			WriteCompiledJson(file, "clustered", scene.clustered);
+			file << ",\n";
+			WriteTilesJson(file, "batched", scene.batched);
+			file << ",\n";
+			WriteTilesJson(file, "sorted", scene.sorted);
+			file << "\n";
+			file << "    }" << (i + 1 < scenes.size() ? "," : "") << "\n";
+		}
+		file << "  ],\n";
+		file << "  \"microbenchmarks\": [\n";
+		for (size_t i = 0; i < microbenchmarks.size(); i++)
+		{
+			const MicrobenchmarkResult& micro = microbenchmarks[i];
+			file << "    { \"name\": \"" << micro.name << "\", \"calls\": " << micro.calls
+				<< ", \"nsPerCall\": " << micro.nanosecondsPerCall
+				<< ", \"checksum\": " << micro.checksum << " }" << (i + 1 < microbenchmarks.size() ? "," : "") << "\n";
+		}
+		file << "  ]\n";
+		file << "}\n";
+	}
+}
+
+//Usage: "Ray Tracing Benchmark" [--quick] [--threads 1,2,4] [--spp N] [--output benchmark.json]
+int main(int argc, char** argv)
+{
+	BenchmarkSettings settings;
+	settings.render.width = 320;
+	settings.render.height = 180;
+	settings.render.samplesPerPixel = 8;
+	settings.render.maxBounces = 50;
+	settings.threadCounts = DefaultThreadCounts();
+
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string argument = argv[i];
+		if (argument == "--quick")
+		{
+			settings.render.width = 160;
+			settings.render.height = 90;
+			settings.render.samplesPerPixel = 2;
+			settings.microbenchmarkCalls = 200000;
+		}
+		else if (argument == "--threads" && i + 1 < argc)
+		{
+			if (!ParseCounts(argv[++i], settings.threadCounts))
+			{
+				std::cerr << "Invalid thread counts " << argv[i] << "\n";
+				PrintUsage(argv[0]);
+				return 1;
+			}
+		}
+		else if (argument == "--spp" && i + 1 < argc)
+		{
+			std::vector<size_t> samplesPerPixel;
+			if (!ParseCounts(argv[++i], samplesPerPixel) || samplesPerPixel.size() != 1)
+			{
+				std::cerr << "Invalid sample count " << argv[i] << "\n";
+				PrintUsage(argv[0]);
+				return 1;
+			}
+			settings.render.samplesPerPixel = samplesPerPixel[0];
+		}
+		else if (argument == "--output" && i + 1 < argc)
+		{
+			settings.outputPath = argv[++i];
+		}
+	}
+
+	std::vector<SceneResult> scenes;
+	for (SceneId id : Scenes::All)
+	{
+		scenes.push_back(BenchmarkScene(id, settings));
+	}
+
+	const std::vector<MicrobenchmarkResult> microbenchmarks = RunMicrobenchmarks(settings);
+
+	PrintResults(settings, scenes, microbenchmarks);
+	WriteJson(settings, scenes, microbenchmarks);
+
+	return 0;
+}
@@ -1,6 +1,7 @@
 #include "AABB.h"
 
 #include "Hittable.h"
+#include "Statistics.h"
 
 AABB::AABB(const Vector3& a, const Vector3& b)
 {
@@ -20,6 +21,21 @@ Vector3 AABB::Max() const
 
 bool AABB::RayIntersection(const Ray& ray, float tmin, float tmax) const
 {
+	RT_STATISTIC_INCREMENT(aabbTests);
+
+#if RAYTRACING_SIMD_VECTOR3
+	//All three slabs at once. Max and Min return their second operand when the first is NaN, so a slab giving
+	//0 * inf is ignored exactly like the scalar comparisons ignore it
+	const SIMD::Vector inverseDirection = SIMD::Vector(_mm_set1_ps(1.0f)) / ray.Direction().Simd();
+	const SIMD::Vector t0 = (min.Simd() - ray.Origin().Simd()) * inverseDirection;
+	const SIMD::Vector t1 = (max.Simd() - ray.Origin().Simd()) * inverseDirection;
+	const __m128 negative = _mm_cmplt_ps(inverseDirection.v, _mm_setzero_ps());
+
+	const SIMD::Vector tNear = SIMD::Vector::Max(_mm_or_ps(_mm_and_ps(negative, t1.v), _mm_andnot_ps(negative, t0.v)), _mm_set1_ps(tmin));
+	const SIMD::Vector tFar = SIMD::Vector::Min(_mm_or_ps(_mm_and_ps(negative, t0.v), _mm_andnot_ps(negative, t1.v)), _mm_set1_ps(tmax));
+
+	return std::min(std::min(tFar.x, tFar.y), tFar.z) > std::max(std::max(tNear.x, tNear.y), tNear.z);
+#else
 	for (int i = 0; i < 3; i++)
 	{
 		float invD = 1.0f / ray.Direction().v[i];
@@ -35,10 +51,14 @@ bool AABB::RayIntersection(const Ray& ray, float tmin, float tmax) const
 			return false;
 	}
 	return true;
+#endif
 }
 
 AABB AABB::SurroundingBox(AABB box0, AABB box1)
 {
+#if RAYTRACING_SIMD_VECTOR3
+	return AABB(Vector3(SIMD::Vector::Min(box0.min.Simd(), box1.min.Simd())), Vector3(SIMD::Vector::Max(box0.max.Simd(), box1.max.Simd())));
+#else
 	Vector3 min(std::min(box0.min.x, box1.min.x),
 		std::min(box0.min.y, box1.min.y),
 		std::min(box0.min.z, box1.min.z));
@@ -48,6 +68,7 @@ AABB AABB::SurroundingBox(AABB box0, AABB box1)
 		std::max(box0.max.z, box1.max.z));
 
 	return AABB(min, max);
+#endif
 }
 
 int AABB::AABBAxisXComparison(const Hittable* a, const Hittable* b)
@@ -58,10 +79,8 @@ int AABB::AABBAxisXComparison(const Hittable* a, const Hittable* b)
 	a->BoundingBox(0, 0, boxLeft);
 	b->BoundingBox(0, 0, boxRight);
 
-	if (boxLeft.Min().v[axis] - boxRight.Min().v[axis] < 0.0f)
-		return false;
-	else
-		return true;
+	//Must be a strict ordering, std::sort reads out of bounds otherwise
+	return boxLeft.Min().v[axis] < boxRight.Min().v[axis];
 }
 
 int AABB::AABBAxisYComparison(const Hittable* a, const Hittable* b)
@@ -72,10 +91,8 @@ int AABB::AABBAxisYComparison(const Hittable* a, const Hittable* b)
 	a->BoundingBox(0, 0, boxLeft);
 	b->BoundingBox(0, 0, boxRight);
 
-	if (boxLeft.Min().v[axis] - boxRight.Min().v[axis] < 0.0f)
-		return false;
-	else
-		return true;
+	//Must be a strict ordering, std::sort reads out of bounds otherwise
+	return boxLeft.Min().v[axis] < boxRight.Min().v[axis];
 }
 
 int AABB::AABBAxisZComparison(const Hittable* a, const Hittable* b)
@@ -86,8 +103,6 @@ int AABB::AABBAxisZComparison(const Hittable* a, const Hittable* b)
 	a->BoundingBox(0, 0, boxLeft);
 	b->BoundingBox(0, 0, boxRight);
 
-	if (boxLeft.Min().v[axis] - boxRight.Min().v[axis] < 0.0f)
-		return false;
-	else
-		return true;
+	//Must be a strict ordering, std::sort reads out of bounds otherwise
+	return boxLeft.Min().v[axis] < boxRight.Min().v[axis];
 }
@@ -0,0 +1,136 @@
+#include "AccumulationBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <system_error>
+
+AccumulationBuffer::AccumulationBuffer(size_t width, size_t height)
+	: width(width), height(height), pixels(width * height)
+{
+}
+
+void AccumulationBuffer::Pixel::Add(const Vector3& sample)
+{
+	const float luminance = Luminance(sample);
+	sum += sample;
+	luminanceSquaredSum += luminance * luminance;
+	samples++;
+}
+
+AccumulationBuffer::Pixel& AccumulationBuffer::Get(size_t x, size_t y)
+{
+	return pixels[y * width + x];
+}
+
+const AccumulationBuffer::Pixel& AccumulationBuffer::Get(size_t x, size_t y) const
+{
+	return pixels[y * width + x];
+}
+
+size_t AccumulationBuffer::Width() const
+{
+	return width;
+}
+
+size_t AccumulationBuffer::Height() const
+{
+	return height;
+}
+
+bool AccumulationBuffer::WriteImage(const std::filesystem::path& filepath) const
+{
+	std::filesystem::path temporaryPath = filepath;
+	temporaryPath += ".tmp";
+
+	{
+		std::ofstream file(temporaryPath);
+		if (!file.is_open())
+		{
+			std::cerr << "Failed to open " << temporaryPath.string() << "\n";
+			return false;
+		}
+
+		file << "P3\n" << width << " " << height << "\n255\n";
+
+		for (size_t row = 0; row < height; row++)
+		{
+			const size_t y = height - 1 - row;
+			for (size_t x = 0; x < width; x++)
+			{
+				//Fall back to coarser and coarser grid points until one has been sampled
+				const Pixel* pixel = &Get(x, y);
+				for (size_t mask = ~size_t(1); pixel->samples == 0 && mask != 0; mask <<= 1)
+				{
+					pixel = &Get(x & mask, y & mask);
+				}
+
+				Vector3 colour(0.0f, 0.0f, 0.0f);
+				if (pixel->samples > 0)
+				{
+					//Gamma correction
+					colour = pixel->sum / static_cast<float>(pixel->samples);
+					colour = Vector3(std::sqrt(colour.x), std::sqrt(colour.y), std::sqrt(colour.z));
+				}
+
+				int ir = static_cast<int>(255.99 * colour.x);
+				int ig = static_cast<int>(255.99 * colour.y);
+				int ib = static_cast<int>(255.99 * colour.z);
+
+				file << ir << " " << ig << " " << ib << "\n";
+			}
+		}
+
+		if (!file)
+		{
+			std::cerr << "Failed to write " << temporaryPath.string() << "\n";
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, filepath, error);
+	if (error)
+	{
+		std::cerr << "Failed to replace " << filepath.string() << ": " << error.message() << "\n";
+		return false;
+	}
+
+	return true;
+}
+
+float AccumulationBuffer::RelativeNoise() const
+{
+	double varianceOfMeans = 0.0;
+	double luminance = 0.0;
+
+	for (const Pixel& pixel : pixels)
+	{
+		if (pixel.samples < 2)
+		{
+			return std::numeric_limits<float>::infinity();
+		}
+
+		const double n = pixel.samples;
+		const double mean = Luminance(pixel.sum) / n;
+		const double variance = std::max(0.0, (pixel.luminanceSquaredSum - n * mean * mean) / (n - 1.0));
+
+		varianceOfMeans += variance / n;
+		luminance += mean;
+	}
+
+	if (luminance <= 0.0)
+	{
+		return std::numeric_limits<float>::infinity();
+	}
+
+	const double count = static_cast<double>(pixels.size());
+	return static_cast<float>(std::sqrt(varianceOfMeans / count) / (luminance / count));
+}
+
+float AccumulationBuffer::Luminance(const Vector3& colour)
+{
+	return 0.2126f * colour.x + 0.7152f * colour.y + 0.0722f * colour.z;
+}
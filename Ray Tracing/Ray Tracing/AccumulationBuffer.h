@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Vector3.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+//Running per pixel sums for renders that add samples over several passes. Each pixel keeps its own sample
+//count, so pixels can be refined unevenly and an image can be written at any point without losing work.
+class AccumulationBuffer
+{
+public:
+	struct Pixel
+	{
+		Vector3 sum = Vector3(0.0f, 0.0f, 0.0f);
+		float luminanceSquaredSum = 0.0f; //For the noise estimate
+		uint32_t samples = 0;
+
+		void Add(const Vector3& sample);
+	};
+
+	AccumulationBuffer(size_t width, size_t height);
+
+	//Not synchronised, a pixel must only be written by one thread at a time and not while an image is written
+	Pixel& Get(size_t x, size_t y);
+	const Pixel& Get(size_t x, size_t y) const;
+
+	size_t Width() const;
+	size_t Height() const;
+
+	//Pixels that have no samples yet show the nearest sampled pixel of the power of two grid above and to
+	//their left, so a frame traced at reduced resolution still fills the image. y runs from the bottom row.
+	//Writes to a temporary file and renames it over filepath so viewers never read a partial image.
+	bool WriteImage(const std::filesystem::path& filepath) const;
+
+	//Root mean square of the pixels' standard errors relative to the image's mean luminance, or infinity while
+	//any pixel has fewer than two samples
+	float RelativeNoise() const;
+
+	static float Luminance(const Vector3& colour);
+
+private:
+	size_t width;
+	size_t height;
+	std::vector<Pixel> pixels;
+};
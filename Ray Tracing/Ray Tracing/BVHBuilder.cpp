@@ -0,0 +1,489 @@
+#include "BVHBuilder.h"
+
+#include "TaskGroup.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace
+{
+	constexpr int BinCount = 16;
+
+	//Relative cost of visiting a node compared to intersecting one primitive
+	constexpr float TraversalCost = 1.0f;
+
+	//Spatial splits are only tried where the children of the best object split overlap by at least this
+	//fraction of the root's surface area, elsewhere they rarely pay for the extra references
+	constexpr float MinimumOverlap = 1e-5f;
+
+	//Subtrees over fewer primitives than this are built on the thread that reaches them, splitting them off isn't worth the copy
+	constexpr size_t MinimumParallelPrimitives = 4096;
+
+	AABB EmptyBox()
+	{
+		const float max = std::numeric_limits<float>::max();
+		return AABB(Vector3(max, max, max), Vector3(-max, -max, -max));
+	}
+
+	AABB Grow(const AABB& box, const Vector3& point)
+	{
+		return AABB::SurroundingBox(box, AABB(point, point));
+	}
+
+	AABB Intersection(const AABB& a, const AABB& b)
+	{
+		const Vector3 minimum(std::max(a.Min().x, b.Min().x), std::max(a.Min().y, b.Min().y), std::max(a.Min().z, b.Min().z));
+		const Vector3 maximum(std::min(a.Max().x, b.Max().x), std::min(a.Max().y, b.Max().y), std::min(a.Max().z, b.Max().z));
+		return AABB(minimum, maximum);
+	}
+
+	bool IsEmpty(const AABB& box)
+	{
+		return box.Min().x > box.Max().x || box.Min().y > box.Max().y || box.Min().z > box.Max().z;
+	}
+
+	//box with its extent along axis replaced by [minimum, maximum]
+	AABB Slab(const AABB& box, int axis, float minimum, float maximum)
+	{
+		Vector3 low = box.Min();
+		Vector3 high = box.Max();
+		low.v[axis] = minimum;
+		high.v[axis] = maximum;
+		return AABB(low, high);
+	}
+}
+
+BVHBuilder::BVHBuilder(size_t maxLeafSize)
+	: maxLeafSize(std::max<size_t>(1, maxLeafSize))
+{
+}
+
+void BVHBuilder::EnableSpatialSplits(float duplicationBudget, Clipper clipper)
+{
+	this->duplicationBudget = std::max(0.0f, duplicationBudget);
+	this->clipper = std::move(clipper);
+}
+
+void BVHBuilder::Build(const std::vector<AABB>& bounds, std::vector<Node>& nodes, std::vector<uint32_t>& primitiveOrder, ThreadPool* threadPool) const
+{
+	nodes.clear();
+	primitiveOrder.clear();
+
+	if (bounds.empty())
+	{
+		return;
+	}
+
+	AABB rootBounds = EmptyBox();
+	std::vector<BuildPrimitive> primitives(bounds.size());
+	for (size_t i = 0; i < bounds.size(); i++)
+	{
+		primitives[i].bounds = bounds[i];
+		primitives[i].centroid = 0.5f * (bounds[i].Min() + bounds[i].Max());
+		primitives[i].index = static_cast<uint32_t>(i);
+		rootBounds = AABB::SurroundingBox(rootBounds, bounds[i]);
+	}
+
+	BuildState state;
+	state.rootArea = SurfaceArea(rootBounds);
+	state.referenceCount = bounds.size();
+	state.referenceLimit = bounds.size() + static_cast<size_t>(duplicationBudget * static_cast<float>(bounds.size()));
+
+	nodes.reserve(2 * state.referenceLimit);
+	primitiveOrder.reserve(state.referenceLimit);
+	//Spatial splits draw on one budget of references in build order, so only plain builds can run out of order
+	BuildRecursive(primitives, 0, state, nodes, primitiveOrder, duplicationBudget > 0.0f ? nullptr : threadPool);
+}
+
+float BVHBuilder::SurfaceArea(const AABB& box)
+{
+	const Vector3 extent = box.Max() - box.Min();
+	if (extent.x < 0.0f || extent.y < 0.0f || extent.z < 0.0f)
+	{
+		return 0.0f;
+	}
+	return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+size_t BVHBuilder::BuildRecursive(std::vector<BuildPrimitive>& primitives, size_t depth, BuildState& state, std::vector<Node>& nodes, std::vector<uint32_t>& primitiveOrder, ThreadPool* threadPool) const
+{
+	AABB bounds = EmptyBox();
+	AABB centroidBounds = EmptyBox();
+	for (const BuildPrimitive& primitive : primitives)
+	{
+		bounds = AABB::SurroundingBox(bounds, primitive.bounds);
+		centroidBounds = Grow(centroidBounds, primitive.centroid);
+	}
+
+	const size_t nodeIndex = nodes.size();
+	nodes.emplace_back();
+	nodes[nodeIndex].bounds = bounds;
+
+	const size_t count = primitives.size();
+
+	//Leaves larger than the limit are never allowed so only compare against the leaf cost when one is possible
+	const float leafCost = count <= maxLeafSize ? static_cast<float>(count) : std::numeric_limits<float>::max();
+
+	//Median splits below this depth halve the count each level, which keeps the whole tree within MaxDepth
+	const bool allowSAH = count > 1 && depth < MaxDepth / 2;
+
+	Split objectSplit;
+	const bool foundObjectSplit = allowSAH && FindObjectSplit(primitives, bounds, centroidBounds, leafCost, objectSplit);
+
+	Split spatialSplit;
+	bool useSpatialSplit = false;
+	if (allowSAH && state.referenceCount < state.referenceLimit)
+	{
+		//Without an object split every centroid is in the same place, splitting space is the only option left
+		const float overlap = foundObjectSplit ? SurfaceArea(Intersection(objectSplit.leftBounds, objectSplit.rightBounds)) : SurfaceArea(bounds);
+		if (overlap > MinimumOverlap * state.rootArea)
+		{
+			useSpatialSplit = FindSpatialSplit(primitives, bounds, foundObjectSplit ? objectSplit.cost : leafCost, spatialSplit);
+		}
+	}
+
+	std::vector<BuildPrimitive> left;
+	std::vector<BuildPrimitive> right;
+	int axis = 0;
+
+	if (useSpatialSplit)
+	{
+		axis = spatialSplit.axis;
+		PerformSpatialSplit(primitives, spatialSplit, state, left, right);
+	}
+	else if (foundObjectSplit)
+	{
+		axis = objectSplit.axis;
+		for (const BuildPrimitive& primitive : primitives)
+		{
+			(primitive.centroid.v[axis] < objectSplit.position ? left : right).push_back(primitive);
+		}
+	}
+
+	if (left.empty() || right.empty())
+	{
+		if (count <= maxLeafSize)
+		{
+			nodes[nodeIndex].rightOrFirst = static_cast<uint32_t>(primitiveOrder.size());
+			nodes[nodeIndex].count = static_cast<uint32_t>(count);
+			for (const BuildPrimitive& primitive : primitives)
+			{
+				primitiveOrder.push_back(primitive.index);
+			}
+			return nodeIndex;
+		}
+
+		//No useful split but too many primitives for one leaf, fall back to the object median of the widest axis
+		const Vector3 extent = centroidBounds.Max() - centroidBounds.Min();
+		axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		const size_t middle = count / 2;
+		std::nth_element(primitives.begin(), primitives.begin() + middle, primitives.end(), [axis](const BuildPrimitive& a, const BuildPrimitive& b)
+			{
+				return a.centroid.v[axis] < b.centroid.v[axis];
+			});
+
+		left.assign(primitives.begin(), primitives.begin() + middle);
+		right.assign(primitives.begin() + middle, primitives.end());
+	}
+
+	nodes[nodeIndex].axis = static_cast<uint32_t>(axis);
+
+	//Children own their references from here on
+	primitives.clear();
+	primitives.shrink_to_fit();
+
+	size_t rightChild;
+	if (threadPool != nullptr && right.size() >= MinimumParallelPrimitives)
+	{
+		BuildChildrenInParallel(left, right, depth, state, nodes, primitiveOrder, *threadPool, rightChild);
+	}
+	else
+	{
+		BuildRecursive(left, depth + 1, state, nodes, primitiveOrder, threadPool);
+		rightChild = BuildRecursive(right, depth + 1, state, nodes, primitiveOrder, threadPool);
+	}
+	nodes[nodeIndex].rightOrFirst = static_cast<uint32_t>(rightChild);
+
+	return nodeIndex;
+}
+
+void BVHBuilder::BuildChildrenInParallel(std::vector<BuildPrimitive>& left, std::vector<BuildPrimitive>& right, size_t depth, BuildState& state, std::vector<Node>& nodes, std::vector<uint32_t>& primitiveOrder, ThreadPool& threadPool, size_t& rightChild) const
+{
+	std::vector<Node> rightNodes;
+	std::vector<uint32_t> rightOrder;
+
+	//Waiting runs other tasks, among them the subtrees the right side splits off in turn
+	TaskGroup group(threadPool);
+	group.Run([&]()
+		{
+			rightNodes.reserve(2 * right.size());
+			rightOrder.reserve(right.size());
+			BuildRecursive(right, depth + 1, state, rightNodes, rightOrder, &threadPool);
+		});
+	BuildRecursive(left, depth + 1, state, nodes, primitiveOrder, &threadPool);
+	group.Wait();
+
+	//The right subtree's indices start from zero, move them past everything the left subtree emitted
+	const uint32_t nodeBase = static_cast<uint32_t>(nodes.size());
+	const uint32_t orderBase = static_cast<uint32_t>(primitiveOrder.size());
+	for (Node node : rightNodes)
+	{
+		node.rightOrFirst += node.count > 0 ? orderBase : nodeBase;
+		nodes.push_back(node);
+	}
+	primitiveOrder.insert(primitiveOrder.end(), rightOrder.begin(), rightOrder.end());
+
+	rightChild = nodeBase;
+}
+
+bool BVHBuilder::FindObjectSplit(const std::vector<BuildPrimitive>& primitives, const AABB& bounds, const AABB& centroidBounds, float maxCost, Split& split) const
+{
+	const float parentArea = SurfaceArea(bounds);
+
+	float bestCost = maxCost;
+	bool found = false;
+
+	for (int candidateAxis = 0; candidateAxis < 3; candidateAxis++)
+	{
+		const float minimum = centroidBounds.Min().v[candidateAxis];
+		const float extent = centroidBounds.Max().v[candidateAxis] - minimum;
+		if (!(extent > 0.0f))
+		{
+			continue;
+		}
+
+		AABB binBounds[BinCount];
+		size_t binCounts[BinCount] = {};
+		std::fill(std::begin(binBounds), std::end(binBounds), EmptyBox());
+
+		const float scale = BinCount / extent;
+		for (const BuildPrimitive& primitive : primitives)
+		{
+			const int bin = std::min(BinCount - 1, static_cast<int>((primitive.centroid.v[candidateAxis] - minimum) * scale));
+			binBounds[bin] = AABB::SurroundingBox(binBounds[bin], primitive.bounds);
+			binCounts[bin]++;
+		}
+
+		//Sweep from the right to get the bounds and count of everything right of each plane
+		AABB rightBoxes[BinCount - 1];
+		size_t rightCounts[BinCount - 1];
+		AABB rightBox = EmptyBox();
+		size_t rightCount = 0;
+		for (int plane = BinCount - 1; plane > 0; plane--)
+		{
+			rightBox = AABB::SurroundingBox(rightBox, binBounds[plane]);
+			rightCount += binCounts[plane];
+			rightBoxes[plane - 1] = rightBox;
+			rightCounts[plane - 1] = rightCount;
+		}
+
+		AABB leftBox = EmptyBox();
+		size_t leftCount = 0;
+		for (int plane = 0; plane < BinCount - 1; plane++)
+		{
+			leftBox = AABB::SurroundingBox(leftBox, binBounds[plane]);
+			leftCount += binCounts[plane];
+
+			if (leftCount == 0 || rightCounts[plane] == 0)
+			{
+				continue;
+			}
+
+			const float cost = TraversalCost + (SurfaceArea(leftBox) * leftCount + SurfaceArea(rightBoxes[plane]) * rightCounts[plane]) / parentArea;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				split.axis = candidateAxis;
+				split.position = minimum + extent * static_cast<float>(plane + 1) / BinCount;
+				split.cost = cost;
+				split.leftBounds = leftBox;
+				split.rightBounds = rightBoxes[plane];
+				split.leftCount = leftCount;
+				split.rightCount = rightCounts[plane];
+				found = true;
+			}
+		}
+	}
+
+	return found;
+}
+
+bool BVHBuilder::FindSpatialSplit(const std::vector<BuildPrimitive>& primitives, const AABB& bounds, float maxCost, Split& split) const
+{
+	const float parentArea = SurfaceArea(bounds);
+
+	float bestCost = maxCost;
+	bool found = false;
+
+	for (int candidateAxis = 0; candidateAxis < 3; candidateAxis++)
+	{
+		const float minimum = bounds.Min().v[candidateAxis];
+		const float extent = bounds.Max().v[candidateAxis] - minimum;
+		if (!(extent > 0.0f))
+		{
+			continue;
+		}
+
+		//Bins are equal slices of the node, each reference adds its clipped bounds to every bin it passes
+		//through and is counted once where it enters and once where it exits
+		AABB binBounds[BinCount];
+		size_t entries[BinCount] = {};
+		size_t exits[BinCount] = {};
+		std::fill(std::begin(binBounds), std::end(binBounds), EmptyBox());
+
+		const float binWidth = extent / BinCount;
+		const float scale = BinCount / extent;
+		for (const BuildPrimitive& primitive : primitives)
+		{
+			const int first = std::clamp(static_cast<int>((primitive.bounds.Min().v[candidateAxis] - minimum) * scale), 0, BinCount - 1);
+			const int last = std::clamp(static_cast<int>((primitive.bounds.Max().v[candidateAxis] - minimum) * scale), first, BinCount - 1);
+
+			for (int bin = first; bin <= last; bin++)
+			{
+				const float binMinimum = minimum + binWidth * static_cast<float>(bin);
+				const float binMaximum = bin == BinCount - 1 ? bounds.Max().v[candidateAxis] : binMinimum + binWidth;
+				const AABB clipped = Clip(primitive, Slab(bounds, candidateAxis, binMinimum, binMaximum));
+				if (!IsEmpty(clipped))
+				{
+					binBounds[bin] = AABB::SurroundingBox(binBounds[bin], clipped);
+				}
+			}
+
+			entries[first]++;
+			exits[last]++;
+		}
+
+		AABB rightBoxes[BinCount - 1];
+		size_t rightCounts[BinCount - 1];
+		AABB rightBox = EmptyBox();
+		size_t rightCount = 0;
+		for (int plane = BinCount - 1; plane > 0; plane--)
+		{
+			rightBox = AABB::SurroundingBox(rightBox, binBounds[plane]);
+			rightCount += exits[plane];
+			rightBoxes[plane - 1] = rightBox;
+			rightCounts[plane - 1] = rightCount;
+		}
+
+		AABB leftBox = EmptyBox();
+		size_t leftCount = 0;
+		for (int plane = 0; plane < BinCount - 1; plane++)
+		{
+			leftBox = AABB::SurroundingBox(leftBox, binBounds[plane]);
+			leftCount += entries[plane];
+
+			if (leftCount == 0 || rightCounts[plane] == 0)
+			{
+				continue;
+			}
+
+			const float cost = TraversalCost + (SurfaceArea(leftBox) * leftCount + SurfaceArea(rightBoxes[plane]) * rightCounts[plane]) / parentArea;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				split.axis = candidateAxis;
+				split.position = minimum + binWidth * static_cast<float>(plane + 1);
+				split.cost = cost;
+				split.leftBounds = leftBox;
+				split.rightBounds = rightBoxes[plane];
+				split.leftCount = leftCount;
+				split.rightCount = rightCounts[plane];
+				found = true;
+			}
+		}
+	}
+
+	return found;
+}
+
+void BVHBuilder::PerformSpatialSplit(const std::vector<BuildPrimitive>& primitives, const Split& split, BuildState& state, std::vector<BuildPrimitive>& left, std::vector<BuildPrimitive>& right) const
+{
+	const int axis = split.axis;
+	const float position = split.position;
+
+	AABB leftBounds = split.leftBounds;
+	AABB rightBounds = split.rightBounds;
+	size_t leftCount = split.leftCount;
+	size_t rightCount = split.rightCount;
+
+	for (const BuildPrimitive& primitive : primitives)
+	{
+		if (primitive.bounds.Max().v[axis] <= position)
+		{
+			left.push_back(primitive);
+			continue;
+		}
+
+		if (primitive.bounds.Min().v[axis] >= position)
+		{
+			right.push_back(primitive);
+			continue;
+		}
+
+		//Reference unsplitting: keep a straddling primitive whole on one side when that is no more expensive
+		//than duplicating it, and always once the duplication budget is spent
+		const AABB leftGrown = AABB::SurroundingBox(leftBounds, primitive.bounds);
+		const AABB rightGrown = AABB::SurroundingBox(rightBounds, primitive.bounds);
+		const float lefts = static_cast<float>(leftCount);
+		const float rights = static_cast<float>(rightCount);
+		const float splitCost = SurfaceArea(leftBounds) * lefts + SurfaceArea(rightBounds) * rights;
+		const float leftCost = SurfaceArea(leftGrown) * lefts + SurfaceArea(rightBounds) * (rights - 1.0f);
+		const float rightCost = SurfaceArea(leftBounds) * (lefts - 1.0f) + SurfaceArea(rightGrown) * rights;
+		const bool canDuplicate = state.referenceCount < state.referenceLimit;
+
+		if (canDuplicate && splitCost < leftCost && splitCost < rightCost)
+		{
+			BuildPrimitive leftPart = primitive;
+			BuildPrimitive rightPart = primitive;
+			leftPart.bounds = Clip(primitive, Slab(primitive.bounds, axis, primitive.bounds.Min().v[axis], position));
+			rightPart.bounds = Clip(primitive, Slab(primitive.bounds, axis, position, primitive.bounds.Max().v[axis]));
+
+			leftPart.centroid = 0.5f * (leftPart.bounds.Min() + leftPart.bounds.Max());
+			rightPart.centroid = 0.5f * (rightPart.bounds.Min() + rightPart.bounds.Max());
+
+			//The exact clip can find the primitive on one side only, then there is nothing to duplicate
+			const bool leftEmpty = IsEmpty(leftPart.bounds);
+			const bool rightEmpty = IsEmpty(rightPart.bounds);
+			if (leftEmpty && rightEmpty)
+			{
+				left.push_back(primitive);
+			}
+			else if (leftEmpty || rightEmpty)
+			{
+				(leftEmpty ? right : left).push_back(leftEmpty ? rightPart : leftPart);
+			}
+			else
+			{
+				left.push_back(leftPart);
+				right.push_back(rightPart);
+				state.referenceCount++;
+			}
+			continue;
+		}
+
+		if (leftCost < rightCost)
+		{
+			left.push_back(primitive);
+			leftBounds = leftGrown;
+			rightCount--;
+		}
+		else
+		{
+			right.push_back(primitive);
+			rightBounds = rightGrown;
+			leftCount--;
+		}
+	}
+}
+
+AABB BVHBuilder::Clip(const BuildPrimitive& primitive, const AABB& box) const
+{
+	const AABB clipped = Intersection(primitive.bounds, box);
+	if (IsEmpty(clipped) || !clipper)
+	{
+		return clipped;
+	}
+
+	return Intersection(clipper(primitive.index, clipped), clipped);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "AABB.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class ThreadPool;
+
+//Builds a flat bounding volume hierarchy over primitive bounds using the binned surface area heuristic.
+//Nodes are emitted depth first so an interior node's left child directly follows it in the array.
+//With spatial splits enabled (SBVH) a primitive that straddles a split plane can be referenced from both
+//sides with its bounds clipped to each, which keeps large overlapping primitives from bloating every node.
+class BVHBuilder
+{
+public:
+	struct Node
+	{
+		AABB bounds;
+		uint32_t rightOrFirst = 0; //Right child of an interior node or the first entry of primitiveOrder for a leaf
+		uint32_t count = 0; //Zero for interior nodes
+		uint32_t axis = 0;
+	};
+
+	//Returns the bounds of the part of a primitive inside box, or an empty box if none of it is
+	using Clipper = std::function<AABB(uint32_t primitive, const AABB& box)>;
+
+	//Trees never get deeper than this so traversal can use a fixed size stack
+	static constexpr size_t MaxDepth = 64;
+
+	BVHBuilder(size_t maxLeafSize = 4);
+
+	//Allows up to duplicationBudget extra references per primitive, 0.3 lets the tree hold 30% more references
+	//than there are primitives. Without a clipper a reference's bounds are clipped as boxes, which is exact
+	//for axis aligned primitives and conservative for everything else.
+	void EnableSpatialSplits(float duplicationBudget, Clipper clipper = nullptr);
+
+	//primitiveOrder receives the primitive indices in leaf order, with spatial splits an index can appear more than once.
+	//Given a pool, large subtrees of a build without spatial splits are built in parallel, giving the same tree.
+	void Build(const std::vector<AABB>& bounds, std::vector<Node>& nodes, std::vector<uint32_t>& primitiveOrder, ThreadPool* threadPool = nullptr) const;
+
+	static float SurfaceArea(const AABB& box);
+
+private:
+	struct BuildPrimitive
+	{
+		AABB bounds;
+		Vector3 centroid;
+		uint32_t index;
+	};
+
+	struct Split
+	{
+		int axis = 0;
+		float position = 0.0f;
+		float cost = 0.0f;
+		AABB leftBounds;
+		AABB rightBounds;
+		size_t leftCount = 0;
+		size_t rightCount = 0;
+	};
+
+	struct BuildState
+	{
+		float rootArea = 0.0f;
+		size_t referenceCount = 0;
+		size_t referenceLimit = 0;
+	};
+
+	size_t BuildRecursive(std::vector<BuildPrimitive>& primitives, size_t depth, BuildState& state, std::vector<Node>& nodes, std::vector<uint32_t>& primitiveOrder, ThreadPool* threadPool) const;
+
+	//Builds right into separate arrays on the pool while left is built here, then appends them as a serial build would
+	void BuildChildrenInParallel(std::vector<BuildPrimitive>& left, std::vector<BuildPrimitive>& right, size_t depth, BuildState& state, std::vector<Node>& nodes, std::vector<uint32_t>& primitiveOrder, ThreadPool& threadPool, size_t& rightChild) const;
+
+	//Return false if a leaf is cheaper than any split, or maxCost is
+	bool FindObjectSplit(const std::vector<BuildPrimitive>& primitives, const AABB& bounds, const AABB& centroidBounds, float maxCost, Split& split) const;
+	bool FindSpatialSplit(const std::vector<BuildPrimitive>& primitives, const AABB& bounds, float maxCost, Split& split) const;
+
+	void PerformSpatialSplit(const std::vector<BuildPrimitive>& primitives, const Split& split, BuildState& state, std::vector<BuildPrimitive>& left, std::vector<BuildPrimitive>& right) const;
+
+	//Bounds of the part of primitive inside box
+	AABB Clip(const BuildPrimitive& primitive, const AABB& box) const;
+
+	size_t maxLeafSize;
+	float duplicationBudget = 0.0f;
+	Clipper clipper;
+};
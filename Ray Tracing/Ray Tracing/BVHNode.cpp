@@ -1,5 +1,7 @@
 #include "BVHNode.h"
 
+#include "Statistics.h"
+
 BVHNode::BVHNode(Hittable** l, size_t n, float time0, float time1)
 {
     int axis = int(3 * Util::RandomFloat());
@@ -46,6 +48,8 @@ BVHNode::BVHNode(Hittable** l, size_t n, float time0, float time1)
 
 bool BVHNode::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
 {
+    RT_STATISTIC_INCREMENT(bvhNodesVisited);
+
     if (box.RayIntersection(r, tMin, tMax))
     {
         HitRecord leftRec, rightRec;
@@ -84,4 +88,15 @@ bool BVHNode::BoundingBox(float t0, float t1, AABB& b) const
 {
     b = box;
     return true;
-}
\ No newline at end of file
+}
+
+bool BVHNode::Compile(SceneCompiler& compiler) const
+{
+    //The compiled scene builds its own hierarchy so only the leaves are kept
+    if (!left->Compile(compiler))
+    {
+        return false;
+    }
+
+    return right == left || right->Compile(compiler);
+}
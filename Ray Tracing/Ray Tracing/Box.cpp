@@ -1,27 +1,36 @@
 #include "Box.h"
 
+#include "SceneCompiler.h"
+#include "Statistics.h"
+
+#include <limits>
+
 Box::Box(Vector3 p0, Vector3 p1, Material* material)
-    : box_min(p0), box_max(p1)
+    : box_min(p0), box_max(p1), material(material)
 {
-    constexpr size_t SideCount = 6;
-    Hittable** temp_sides = new Hittable * [SideCount];
-    int i = 0;
+}
 
-    temp_sides[i++] = new XYRectangle(p0.x, p1.x, p0.y, p1.y, p1.z, material);
-    temp_sides[i++] = new XYRectangle(p0.x, p1.x, p0.y, p1.y, p0.z, material);
+bool Box::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
+{
+    RT_STATISTIC_INCREMENT(primitiveTests);
 
-    temp_sides[i++] = new XZRectangle(p0.x, p1.x, p0.z, p1.z, p1.y, material);
-    temp_sides[i++] = new XZRectangle(p0.x, p1.x, p0.z, p1.z, p0.y, material);
+    SlabHit slabs;
+    float t;
+    int face;
+    if (!Slabs(r.Origin(), r.Direction(), box_min, box_max, slabs) || !ClosestFace(slabs, tMin, tMax, t, face))
+    {
+        return false;
+    }
 
-    temp_sides[i++] = new YZRectangle(p0.y, p1.y, p0.z, p1.z, p1.x, material);
-    temp_sides[i++] = new YZRectangle(p0.y, p1.y, p0.z, p1.z, p0.x, material);
+    hitRecord.t = t;
+    hitRecord.p = r.PointAtTime(t);
+    hitRecord.materialPtr = material;
 
-    sides = new HittableList(temp_sides, SideCount);
-}
+    Vector3 outwardNormal;
+    FaceHit(hitRecord.p, box_min, box_max, face, outwardNormal, hitRecord.u, hitRecord.v);
+    hitRecord.SetFaceNormal(r, outwardNormal);
 
-bool Box::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
-{
-    return sides->Hit(r, tMin, tMax, hitRecord);
+    return true;
 }
 
 bool Box::BoundingBox(float t0, float t1, AABB& box) const
@@ -29,3 +38,74 @@ bool Box::BoundingBox(float t0, float t1, AABB& box) const
     box = AABB(box_min, box_max);
     return true;
 }
+
+bool Box::Compile(SceneCompiler& compiler) const
+{
+    SceneFormat::Primitive primitive = {};
+    primitive.type = SceneFormat::PrimitiveType::Box;
+    if (!compiler.AddMaterial(material, primitive.material))
+    {
+        return false;
+    }
+
+    box_min.Store(primitive.data);
+    box_max.Store(primitive.data + 3);
+
+    compiler.AddPrimitive(*this, primitive);
+    return true;
+}
+
+bool Box::Slabs(const Vector3& origin, const Vector3& direction, const Vector3& minimum, const Vector3& maximum, SlabHit& slabs)
+{
+    slabs.tNear = -std::numeric_limits<float>::max();
+    slabs.tFar = std::numeric_limits<float>::max();
+    slabs.nearFace = 0;
+    slabs.farFace = 1;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float inverse = 1.0f / direction[axis];
+        const float t0 = (minimum[axis] - origin[axis]) * inverse;
+        const float t1 = (maximum[axis] - origin[axis]) * inverse;
+
+        //A ray heading towards +axis enters through the minimum face and leaves through the maximum face.
+        //NaNs from rays lying in a face plane fail both comparisons and leave the interval alone.
+        const bool positive = inverse >= 0.0f;
+        const float entry = positive ? t0 : t1;
+        const float exit = positive ? t1 : t0;
+        const int entryFace = 2 * axis + (positive ? 0 : 1);
+
+        const bool later = entry > slabs.tNear;
+        slabs.nearFace = later ? entryFace : slabs.nearFace;
+        slabs.tNear = later ? entry : slabs.tNear;
+
+        const bool earlier = exit < slabs.tFar;
+        slabs.farFace = earlier ? (entryFace ^ 1) : slabs.farFace;
+        slabs.tFar = earlier ? exit : slabs.tFar;
+    }
+
+    return slabs.tNear <= slabs.tFar;
+}
+
+bool Box::ClosestFace(const SlabHit& slabs, float tMin, float tMax, float& t, int& face)
+{
+    //Rays starting inside the box hit the face they leave through
+    const bool inside = slabs.tNear < tMin;
+    t = inside ? slabs.tFar : slabs.tNear;
+    face = inside ? slabs.farFace : slabs.nearFace;
+
+    return t >= tMin && t <= tMax;
+}
+
+void Box::FaceHit(const Vector3& point, const Vector3& minimum, const Vector3& maximum, int face, Vector3& normal, float& u, float& v)
+{
+    const int normalAxis = face / 2;
+    const int firstAxis = normalAxis == 0 ? 1 : 0;
+    const int secondAxis = normalAxis == 2 ? 1 : 2;
+
+    normal = Vector3(0.0f, 0.0f, 0.0f);
+    normal[normalAxis] = (face & 1) ? 1.0f : -1.0f;
+
+    u = (point[firstAxis] - minimum[firstAxis]) / (maximum[firstAxis] - minimum[firstAxis]);
+    v = (point[secondAxis] - minimum[secondAxis]) / (maximum[secondAxis] - minimum[secondAxis]);
+}
@@ -1,11 +1,16 @@
 #pragma once
 
 #include "Hittable.h"
-#include "HittableList.h"
 
-#include "XYRectangle.h"
-#include "XZRectangle.h"
-#include "YZRectangle.h"
+//Entry and exit of a ray through an axis aligned box. Faces are numbered 2 * axis on the minimum side and
+//2 * axis + 1 on the maximum side.
+struct SlabHit
+{
+    float tNear;
+    float tFar;
+    int nearFace;
+    int farFace;
+};
 
 class Box : public Hittable
 {
@@ -15,10 +20,20 @@ public:
 
     bool Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const override;
     bool BoundingBox(float t0, float t1, AABB& box) const override;
+    bool Compile(SceneCompiler& compiler) const override;
+
+    //Intersects all three slabs of [minimum, maximum] with selects rather than branches, false if the ray's line misses
+    static bool Slabs(const Vector3& origin, const Vector3& direction, const Vector3& minimum, const Vector3& maximum, SlabHit& slabs);
+
+    //Picks the face of slabs a ray starting at tMin and ending at tMax hits first, false if there isn't one
+    static bool ClosestFace(const SlabHit& slabs, float tMin, float tMax, float& t, int& face);
+
+    //Outward normal and texture coordinates of point on face, using the same axes as the rectangles
+    static void FaceHit(const Vector3& point, const Vector3& minimum, const Vector3& maximum, int face, Vector3& normal, float& u, float& v);
 
 private:
     Vector3 box_min;
     Vector3 box_max;
 
-    HittableList* sides;
+    Material* material;
 };
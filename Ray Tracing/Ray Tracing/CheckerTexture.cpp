@@ -1,5 +1,7 @@
 #include "CheckerTexture.h"
 
+#include "SceneCompiler.h"
+
 CheckerTexture::CheckerTexture(Texture* t0, Texture* t1) : even(t0), odd(t1) {}
 
 Vector3 CheckerTexture::Value(float u, float v, const Vector3& p) const
@@ -11,3 +13,9 @@ Vector3 CheckerTexture::Value(float u, float v, const Vector3& p) const
 	else
 		return even->Value(u, v, p);
 }
+
+bool CheckerTexture::Compile(SceneCompiler& compiler, SceneFormat::Texture& record) const
+{
+	record.type = SceneFormat::TextureType::Checker;
+	return compiler.AddTexture(even, record.children[0]) && compiler.AddTexture(odd, record.children[1]);
+}
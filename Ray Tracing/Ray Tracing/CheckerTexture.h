@@ -12,6 +12,8 @@ public:
 
 	Vector3 Value(float u, float v, const Vector3& p) const override;
 
+	bool Compile(SceneCompiler& compiler, SceneFormat::Texture& record) const override;
+
 private:
 	Texture* odd;
 	Texture* even;
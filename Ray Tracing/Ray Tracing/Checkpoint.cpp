@@ -0,0 +1,237 @@
+#include "Checkpoint.h"
+
+#include "SceneFormat.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <system_error>
+
+namespace
+{
+	constexpr char Magic[8] = { 'R', 'T', 'C', 'H', 'E', 'C', 'K', '\0' };
+	constexpr uint32_t Version = 2;
+
+	struct TileRecord
+	{
+		uint32_t tile;
+		uint32_t passesDone;
+		uint32_t nextPixel;
+		uint32_t pixelCount;
+		uint32_t randomStateSize;
+		uint32_t padding;
+		uint64_t checksum; //FNV-1a of the record and its data with this field zeroed
+	};
+
+	//sum, luminanceSquaredSum and samples, written field by field so the layout doesn't depend on Vector3's
+	constexpr size_t PixelSize = 5 * sizeof(float);
+
+	size_t PixelCount(const TileProgress& tile)
+	{
+		return (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+	}
+
+	template<typename T>
+	void Append(std::vector<uint8_t>& bytes, const T& value)
+	{
+		const uint8_t* begin = reinterpret_cast<const uint8_t*>(&value);
+		bytes.insert(bytes.end(), begin, begin + sizeof(T));
+	}
+
+	bool WriteFile(const std::filesystem::path& path, const std::vector<uint8_t>& bytes, std::ios::openmode mode)
+	{
+		std::ofstream stream(path, std::ios::binary | mode);
+		if (!stream.is_open() || !stream.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())) || !stream.flush())
+		{
+			std::cerr << "Failed to write checkpoint " << path.string() << "\n";
+			return false;
+		}
+		return true;
+	}
+}
+
+Checkpoint::Checkpoint(const std::filesystem::path& path, const RenderOptions& options)
+	: path(path)
+{
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.width = static_cast<uint32_t>(options.settings.width);
+	header.height = static_cast<uint32_t>(options.settings.height);
+	header.tileSize = static_cast<uint32_t>(options.tileSize);
+	header.samplesPerPixel = static_cast<uint32_t>(options.settings.samplesPerPixel);
+	header.seed = options.seed;
+	header.maxBounces = options.settings.maxBounces;
+	header.legacyMaterials = options.settings.legacyMaterials;
+	header.scene = static_cast<uint32_t>(options.scene);
+	header.sceneFileHash = SceneFormat::Checksum(reinterpret_cast<const uint8_t*>(options.sceneFile.data()), options.sceneFile.size());
+}
+
+bool Checkpoint::Load(AccumulationBuffer& buffer, std::vector<TileProgress>& tiles)
+{
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream.is_open())
+	{
+		return true;
+	}
+
+	const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+	Header fileHeader;
+	if (bytes.size() < sizeof(fileHeader))
+	{
+		std::cerr << "Checkpoint " << path.string() << " is truncated\n";
+		return false;
+	}
+
+	std::memcpy(&fileHeader, bytes.data(), sizeof(fileHeader));
+	if (std::memcmp(&fileHeader, &header, sizeof(header)) != 0)
+	{
+		std::cerr << "Checkpoint " << path.string() << " is from a render with different settings, delete it or checkpoint elsewhere\n";
+		return false;
+	}
+
+	size_t offset = sizeof(fileHeader);
+	size_t loadedTiles = 0;
+	while (offset + sizeof(TileRecord) <= bytes.size())
+	{
+		TileRecord record;
+		std::memcpy(&record, bytes.data() + offset, sizeof(record));
+
+		//A crash can leave a partly written record at the end, stop there and keep what came before
+		const size_t dataSize = static_cast<size_t>(record.pixelCount) * PixelSize + record.randomStateSize;
+		if (record.tile >= tiles.size() || record.pixelCount != PixelCount(tiles[record.tile]) || dataSize > bytes.size() - offset - sizeof(record))
+		{
+			break;
+		}
+
+		const uint64_t expected = record.checksum;
+		record.checksum = 0;
+		uint64_t checksum = SceneFormat::Checksum(reinterpret_cast<const uint8_t*>(&record), sizeof(record));
+		checksum = SceneFormat::Checksum(bytes.data() + offset + sizeof(record), dataSize, checksum);
+		if (checksum != expected)
+		{
+			break;
+		}
+
+		TileProgress& tile = tiles[record.tile];
+		tile.passesDone = record.passesDone;
+		tile.nextPixel = record.nextPixel;
+
+		const uint8_t* data = bytes.data() + offset + sizeof(record);
+		for (size_t y = tile.y0; y < tile.y1; y++)
+		{
+			for (size_t x = tile.x0; x < tile.x1; x++)
+			{
+				float values[4];
+				AccumulationBuffer::Pixel& pixel = buffer.Get(x, y);
+				std::memcpy(values, data, sizeof(values));
+				std::memcpy(&pixel.samples, data + sizeof(values), sizeof(pixel.samples));
+				pixel.sum = Vector3(values[0], values[1], values[2]);
+				pixel.luminanceSquaredSum = values[3];
+				data += PixelSize;
+			}
+		}
+		tile.randomState.assign(reinterpret_cast<const char*>(data), record.randomStateSize);
+
+		offset += sizeof(record) + dataSize;
+		loadedTiles++;
+	}
+
+	//Anything after the last good record is garbage that appending would hide the next records behind
+	fileSize = offset;
+	snapshotDue = offset != bytes.size();
+
+	std::cout << "Resumed " << loadedTiles << " tile records from " << path.string() << "\n";
+	return true;
+}
+
+bool Checkpoint::Save(const AccumulationBuffer& buffer, const std::vector<TileProgress>& tiles, const std::vector<size_t>& changedTiles)
+{
+	if (snapshotDue)
+	{
+		return WriteSnapshot(buffer, tiles);
+	}
+
+	std::vector<uint8_t> bytes;
+	for (size_t tile : changedTiles)
+	{
+		AppendTile(bytes, buffer, tiles[tile], static_cast<uint32_t>(tile));
+	}
+
+	//Rewrite the file once the journal is bigger than a snapshot, so it doesn't grow without bound
+	const uint64_t snapshotSize = sizeof(Header) + tiles.size() * sizeof(TileRecord) + buffer.Width() * buffer.Height() * PixelSize;
+	if (fileSize + bytes.size() > 2 * snapshotSize)
+	{
+		return WriteSnapshot(buffer, tiles);
+	}
+
+	if (!WriteFile(path, bytes, std::ios::app))
+	{
+		snapshotDue = true;
+		return false;
+	}
+
+	fileSize += bytes.size();
+	return true;
+}
+
+void Checkpoint::AppendTile(std::vector<uint8_t>& bytes, const AccumulationBuffer& buffer, const TileProgress& tile, uint32_t tileIndex) const
+{
+	const size_t start = bytes.size();
+
+	TileRecord record = {};
+	record.tile = tileIndex;
+	record.passesDone = tile.passesDone;
+	record.nextPixel = tile.nextPixel;
+	record.pixelCount = static_cast<uint32_t>(PixelCount(tile));
+	record.randomStateSize = static_cast<uint32_t>(tile.randomState.size());
+	Append(bytes, record);
+
+	for (size_t y = tile.y0; y < tile.y1; y++)
+	{
+		for (size_t x = tile.x0; x < tile.x1; x++)
+		{
+			const AccumulationBuffer::Pixel& pixel = buffer.Get(x, y);
+			Append(bytes, pixel.sum.x);
+			Append(bytes, pixel.sum.y);
+			Append(bytes, pixel.sum.z);
+			Append(bytes, pixel.luminanceSquaredSum);
+			Append(bytes, pixel.samples);
+		}
+	}
+	bytes.insert(bytes.end(), tile.randomState.begin(), tile.randomState.end());
+
+	record.checksum = SceneFormat::Checksum(bytes.data() + start, bytes.size() - start);
+	std::memcpy(bytes.data() + start, &record, sizeof(record));
+}
+
+bool Checkpoint::WriteSnapshot(const AccumulationBuffer& buffer, const std::vector<TileProgress>& tiles)
+{
+	std::vector<uint8_t> bytes;
+	Append(bytes, header);
+	for (size_t tile = 0; tile < tiles.size(); tile++)
+	{
+		AppendTile(bytes, buffer, tiles[tile], static_cast<uint32_t>(tile));
+	}
+
+	std::filesystem::path temporaryPath = path;
+	temporaryPath += ".tmp";
+	if (!WriteFile(temporaryPath, bytes, std::ios::trunc))
+	{
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error)
+	{
+		std::cerr << "Failed to replace checkpoint " << path.string() << ": " << error.message() << "\n";
+		return false;
+	}
+
+	fileSize = bytes.size();
+	snapshotDue = false;
+	return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "AccumulationBuffer.h"
+#include "CommandLine.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+//How far a progressive render has got through one tile. Every pass seeds each tile afresh, so this is all that's
+//needed to carry on a tile's random number stream exactly.
+struct TileProgress
+{
+	size_t x0, y0, x1, y1;
+	uint32_t passesDone = 0;
+	uint32_t nextPixel = 0; //Pixels of pass passesDone already traced when the pass was cut short
+	std::string randomState; //Random engine state to continue from nextPixel with, empty if nextPixel is 0
+};
+
+//Saves the accumulation buffer and tile progress of a progressive render so it can be resumed after the process
+//is stopped or killed. The file is a snapshot followed by a journal of tiles changed since, each record with its
+//own checksum. Changed tiles are appended so a save only costs what was rendered since the last one, and a record
+//torn by a crash is ignored on loading, leaving that tile's previous record. Once the journal outgrows the
+//snapshot the file is rewritten to a temporary file and renamed over the original.
+class Checkpoint
+{
+public:
+	Checkpoint(const std::filesystem::path& path, const RenderOptions& options);
+
+	//Fills buffer and tiles from the file. A missing file is a fresh render and leaves them untouched, returns
+	//false if the file belongs to a render with different settings.
+	bool Load(AccumulationBuffer& buffer, std::vector<TileProgress>& tiles);
+
+	//Writes the tiles listed in changedTiles, or everything if a new snapshot is due. Tiles must not be written
+	//to while this runs.
+	bool Save(const AccumulationBuffer& buffer, const std::vector<TileProgress>& tiles, const std::vector<size_t>& changedTiles);
+
+private:
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t tileSize;
+		uint32_t samplesPerPixel;
+		uint32_t seed;
+		int32_t maxBounces;
+		uint32_t legacyMaterials;
+		uint32_t scene;
+		uint64_t sceneFileHash;
+	};
+
+	void AppendTile(std::vector<uint8_t>& bytes, const AccumulationBuffer& buffer, const TileProgress& tile, uint32_t tileIndex) const;
+	bool WriteSnapshot(const AccumulationBuffer& buffer, const std::vector<TileProgress>& tiles);
+
+	std::filesystem::path path;
+	Header header;
+	uint64_t fileSize = 0;
+	bool snapshotDue = true; //No valid file to append to yet
+};
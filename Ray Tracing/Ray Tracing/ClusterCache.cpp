@@ -0,0 +1,71 @@
+#include "ClusterCache.h"
+
+#include <algorithm>
+
+ClusterCache::ClusterCache(const MappedFile& file, uint64_t clusterDataOffset, const SceneFormat::Cluster* clusters, size_t clusterCount, uint64_t limitBytes)
+	: file(file), clusterDataOffset(clusterDataOffset), clusters(clusters), limitBytes(limitBytes),
+	lastUse(new std::atomic<uint64_t>[clusterCount]), resident(new std::atomic<bool>[clusterCount])
+{
+	for (size_t i = 0; i < clusterCount; i++)
+	{
+		lastUse[i].store(0, std::memory_order_relaxed);
+		resident[i].store(false, std::memory_order_relaxed);
+	}
+}
+
+void ClusterCache::Touch(uint32_t cluster)
+{
+	//Only write the stamp when it changes so threads sharing a hot cluster don't keep bouncing its cache line
+	const uint64_t now = clock.load(std::memory_order_relaxed);
+	if (lastUse[cluster].load(std::memory_order_relaxed) != now)
+	{
+		lastUse[cluster].store(now, std::memory_order_relaxed);
+	}
+
+	if (resident[cluster].load(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (resident[cluster].load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	const uint64_t size = clusters[cluster].size;
+	while (!residentClusters.empty() && residentBytes + size > limitBytes)
+	{
+		const auto oldest = std::min_element(residentClusters.begin(), residentClusters.end(), [this](uint32_t a, uint32_t b)
+			{
+				return lastUse[a].load(std::memory_order_relaxed) < lastUse[b].load(std::memory_order_relaxed);
+			});
+
+		const SceneFormat::Cluster& evicted = clusters[*oldest];
+		file.Release(static_cast<size_t>(clusterDataOffset + evicted.offset), static_cast<size_t>(evicted.size));
+		resident[*oldest].store(false, std::memory_order_relaxed);
+		residentBytes -= evicted.size;
+		evictions.fetch_add(1, std::memory_order_relaxed);
+
+		*oldest = residentClusters.back();
+		residentClusters.pop_back();
+	}
+
+	file.Prefetch(static_cast<size_t>(clusterDataOffset + clusters[cluster].offset), static_cast<size_t>(size));
+	residentClusters.push_back(cluster);
+	residentBytes += size;
+	loads.fetch_add(1, std::memory_order_relaxed);
+
+	lastUse[cluster].store(clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	resident[cluster].store(true, std::memory_order_release);
+}
+
+uint64_t ClusterCache::Loads() const
+{
+	return loads.load(std::memory_order_relaxed);
+}
+
+uint64_t ClusterCache::Evictions() const
+{
+	return evictions.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "SceneFormat.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//Explicit residency for the clusters of a compiled scene, on top of what the page cache does by itself.
+//A cluster is prefetched the first time a ray enters it and the least recently used clusters are released
+//once the resident ones go over the limit. Releasing only drops pages, so a ray still traversing a released
+//cluster just faults them back in and the cache never affects what is rendered.
+class ClusterCache
+{
+public:
+	ClusterCache(const MappedFile& file, uint64_t clusterDataOffset, const SceneFormat::Cluster* clusters, size_t clusterCount, uint64_t limitBytes);
+
+	//Called by every ray that enters cluster, only takes the lock when the cluster isn't resident
+	void Touch(uint32_t cluster);
+
+	uint64_t Loads() const;
+	uint64_t Evictions() const;
+
+private:
+	const MappedFile& file;
+	uint64_t clusterDataOffset;
+	const SceneFormat::Cluster* clusters;
+	uint64_t limitBytes;
+
+	//Advanced on every load, recently used clusters are stamped with the current value
+	std::atomic<uint64_t> clock{ 0 };
+	std::unique_ptr<std::atomic<uint64_t>[]> lastUse;
+	std::unique_ptr<std::atomic<bool>[]> resident;
+
+	std::mutex mutex;
+	std::vector<uint32_t> residentClusters;
+	uint64_t residentBytes = 0;
+	std::atomic<uint64_t> loads{ 0 };
+	std::atomic<uint64_t> evictions{ 0 };
+};
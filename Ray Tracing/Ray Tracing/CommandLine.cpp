@@ -0,0 +1,259 @@
+#include "CommandLine.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+	bool ParseScene(const std::string& name, SceneId& scene)
+	{
+		for (SceneId id : Scenes::All)
+		{
+			if (name == Scenes::GetName(id))
+			{
+				scene = id;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	size_t ToSize(const char* value)
+	{
+		return static_cast<size_t>(std::strtoull(value, nullptr, 10));
+	}
+
+	//Parses "X,Y,Z"
+	bool ParseVector(const char* value, Vector3& vector)
+	{
+		char* end = nullptr;
+		float components[3];
+		for (int i = 0; i < 3; i++)
+		{
+			components[i] = std::strtof(value, &end);
+			if (end == value || (i < 2 && *end != ','))
+			{
+				return false;
+			}
+			value = end + 1;
+		}
+
+		vector = Vector3(components[0], components[1], components[2]);
+		return *end == '\0';
+	}
+}
+
+bool CommandLine::Parse(int argc, char** argv, RenderOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string argument = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (argument == "--scene" && hasValue)
+		{
+			if (!ParseScene(argv[++i], options.scene))
+			{
+				std::cerr << "Unknown scene " << argv[i] << "\n";
+				PrintUsage(argv[0]);
+				return false;
+			}
+		}
+		else if (argument == "--width" && hasValue)
+		{
+			options.settings.width = std::max<size_t>(1, ToSize(argv[++i]));
+		}
+		else if (argument == "--height" && hasValue)
+		{
+			options.settings.height = std::max<size_t>(1, ToSize(argv[++i]));
+		}
+		else if (argument == "--spp" && hasValue)
+		{
+			options.settings.samplesPerPixel = std::max<size_t>(1, ToSize(argv[++i]));
+		}
+		else if (argument == "--bounces" && hasValue)
+		{
+			options.settings.maxBounces = std::atoi(argv[++i]);
+		}
+		else if (argument == "--legacy-materials")
+		{
+			options.settings.legacyMaterials = true;
+		}
+		else if (argument == "--seed" && hasValue)
+		{
+			options.seed = static_cast<unsigned int>(ToSize(argv[++i]));
+		}
+		else if (argument == "--threads" && hasValue)
+		{
+			options.threadCount = ToSize(argv[++i]);
+		}
+		else if (argument == "--pin-threads")
+		{
+			options.pinThreads = true;
+		}
+		else if (argument == "--output" && hasValue)
+		{
+			options.outputPath = argv[++i];
+		}
+		else if (argument == "--scene-file" && hasValue)
+		{
+			options.sceneFile = argv[++i];
+		}
+		else if (argument == "--compile" && hasValue)
+		{
+			options.mode = RenderMode::CompileScene;
+			options.compiledScenePath = argv[++i];
+		}
+		else if (argument == "--spatial-splits" && hasValue)
+		{
+			options.compileOptions.duplicationBudget = std::max(0.0f, static_cast<float>(std::atof(argv[++i])));
+		}
+		else if (argument == "--wide-nodes")
+		{
+			options.compileOptions.nodeLayout = SceneFormat::NodeLayout::Wide;
+		}
+		else if (argument == "--clusters" && hasValue)
+		{
+			options.compileOptions.clusterSize = ToSize(argv[++i]);
+		}
+		else if (argument == "--sort-rays")
+		{
+			options.sortRays = true;
+		}
+		else if (argument == "--cluster-cache" && hasValue)
+		{
+			options.clusterCacheMegabytes = ToSize(argv[++i]);
+		}
+		else if (argument == "--progressive")
+		{
+			options.progressive = true;
+		}
+		else if (argument == "--preview" && hasValue)
+		{
+			options.progressive = true;
+			options.previewPath = argv[++i];
+		}
+		else if (argument == "--time-budget" && hasValue)
+		{
+			options.progressive = true;
+			options.timeBudgetSeconds = std::max(0.0, std::atof(argv[++i]));
+		}
+		else if (argument == "--target-noise" && hasValue)
+		{
+			options.progressive = true;
+			options.targetNoise = std::max(0.0f, static_cast<float>(std::atof(argv[++i])));
+		}
+		else if (argument == "--checkpoint" && hasValue)
+		{
+			options.progressive = true;
+			options.checkpointPath = argv[++i];
+		}
+		else if (argument == "--checkpoint-interval" && hasValue)
+		{
+			options.checkpointIntervalSeconds = std::max(0.0, std::atof(argv[++i]));
+		}
+		else if ((argument == "--look-from" || argument == "--look-at") && hasValue)
+		{
+			Vector3 vector;
+			if (!ParseVector(argv[++i], vector))
+			{
+				std::cerr << "Expected X,Y,Z after " << argument << "\n";
+				PrintUsage(argv[0]);
+				return false;
+			}
+			(argument == "--look-from" ? options.lookFrom : options.lookAt) = vector;
+		}
+		else if (argument == "--fov" && hasValue)
+		{
+			options.verticalFov = static_cast<float>(std::atof(argv[++i]));
+		}
+		else if (argument == "--coordinator" && hasValue)
+		{
+			options.mode = RenderMode::Coordinator;
+			options.address = argv[++i];
+		}
+		else if (argument == "--worker" && hasValue)
+		{
+			options.mode = RenderMode::Worker;
+			options.address = argv[++i];
+		}
+		else if (argument == "--spawn-workers" && hasValue)
+		{
+			options.spawnWorkers = ToSize(argv[++i]);
+		}
+		else if (argument == "--tile-size" && hasValue)
+		{
+			options.tileSize = std::max<size_t>(1, ToSize(argv[++i]));
+		}
+		else if (argument == "--lease-timeout" && hasValue)
+		{
+			options.leaseTimeoutSeconds = std::atof(argv[++i]);
+		}
+		else if (argument == "--fail-after" && hasValue)
+		{
+			options.failAfterTiles = ToSize(argv[++i]);
+		}
+		else if (argument == "--daemon" && hasValue)
+		{
+			options.mode = RenderMode::Daemon;
+			options.address = argv[++i];
+		}
+		else if (argument == "--submit" && hasValue)
+		{
+			options.mode = RenderMode::Submit;
+			options.address = argv[++i];
+		}
+		else if (argument == "--scene-cache" && hasValue)
+		{
+			options.sceneCacheSize = std::max<size_t>(1, ToSize(argv[++i]));
+		}
+		else if (argument == "--scene-cache-dir" && hasValue)
+		{
+			options.sceneCacheDirectory = argv[++i];
+		}
+		else
+		{
+			std::cerr << "Unknown argument " << argument << "\n";
+			PrintUsage(argv[0]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void CommandLine::PrintUsage(const char* program)
+{
+	std::cerr << "Usage: " << program << " [options]\n"
+		<< "  --scene RandomScene|CornellBox|TwoPerlinSpheres|LargeRandomScene|ManyLights|GlossyCornellBox\n"
+		<< "  --scene-file FILE        render a scene compiled with --compile\n"
+		<< "  --compile FILE           compile --scene to FILE and exit\n"
+		<< "  --spatial-splits BUDGET  compile with a spatial split BVH, BUDGET is the fraction of extra references allowed\n"
+		<< "  --wide-nodes             compile the BVH as quantized 4 wide nodes, one per cache line\n"
+		<< "  --clusters N             compile the top level into page aligned clusters of up to N primitives\n"
+		<< "  --cluster-cache MB       keep at most MB of a clustered --scene-file resident, evicting least recently used\n"
+		<< "  --sort-rays              render --tile-size tiles breadth first, tracing each bounce's rays in coherent order\n"
+		<< "  --progressive            render in passes that refine resolution then samples, writing --preview after each\n"
+		<< "  --preview FILE           where progressive passes write their image, preview.ppm by default\n"
+		<< "  --time-budget SECONDS    stop progressive rendering at the next pixel once the budget runs out, keeping the pixels already traced\n"
+		<< "  --target-noise X         stop progressive rendering once the relative noise estimate is below X\n"
+		<< "  --checkpoint FILE        render progressively, resuming from FILE if it exists and saving progress to it\n"
+		<< "  --checkpoint-interval SECONDS  how often --checkpoint is saved, 60 by default\n"
+		<< "  --legacy-materials       render with the original material sampling instead of the BSDFs' own, light sampling diffuse surfaces only\n"
+		<< "  --look-from X,Y,Z --look-at X,Y,Z --fov DEGREES  override the scene's camera\n"
+		<< "  --width N --height N --spp N --bounces N --seed N --threads N --output file.ppm\n"
+		<< "  --pin-threads            pin render threads to cores, one per physical core and NUMA node by NUMA node first\n"
+		<< "  --coordinator ADDRESS    split the frame into tiles and lease them to workers\n"
+		<< "  --worker ADDRESS         render tiles leased by a coordinator\n"
+		<< "  --spawn-workers N        coordinator starts N local worker processes\n"
+		<< "  --tile-size N            tile edge length in pixels\n"
+		<< "  --lease-timeout SECONDS  reissue a tile if its lease is not returned in time\n"
+		<< "  --fail-after N           worker exits after N tiles, with --spawn-workers only the first spawned worker (testing)\n"
+		<< "  --daemon ADDRESS         serve render jobs, keeping the thread pool and compiled scenes between them\n"
+		<< "  --submit ADDRESS         send the job described by the other options to a daemon\n"
+		<< "  --scene-cache N          compiled scenes a daemon keeps mapped, 4 by default\n"
+		<< "  --scene-cache-dir DIR    where a daemon compiles built in scenes to, scene-cache by default\n"
+		<< "ADDRESS is tcp:HOST:PORT or unix:PATH\n";
+}
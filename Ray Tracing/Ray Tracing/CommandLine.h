@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Renderer.h"
+#include "Scenes.h"
+
+#include <optional>
+#include <string>
+
+enum class RenderMode
+{
+	Local,
+	Coordinator,
+	Worker,
+	CompileScene,
+	Daemon,
+	Submit
+};
+
+struct RenderOptions
+{
+	RenderMode mode = RenderMode::Local;
+	SceneId scene = SceneId::RandomScene;
+	RenderSettings settings;
+	unsigned int seed = 0;
+	size_t threadCount = 0; //0 uses every hardware thread
+	bool pinThreads = false; //Pin the pool's workers to cores, filling one NUMA node's cores before the next
+	std::string outputPath = "render.ppm";
+	std::string sceneFile; //Compiled scene to render instead of building scene
+	std::string compiledScenePath; //Where CompileScene mode writes scene
+	CompileOptions compileOptions; //BVH layout CompileScene writes
+	bool sortRays = false; //Local renders trace tiles breadth first with their secondary rays sorted for coherence
+	size_t clusterCacheMegabytes = 0; //Resident cluster limit when rendering a clustered scene file, 0 leaves it to the page cache
+
+	//Replace the scene's own camera settings when set
+	std::optional<Vector3> lookFrom;
+	std::optional<Vector3> lookAt;
+	std::optional<float> verticalFov;
+
+	//Progressive rendering
+	bool progressive = false;
+	std::string previewPath = "preview.ppm"; //Rewritten after every pass
+	double timeBudgetSeconds = 0.0; //0 renders every pass
+	float targetNoise = 0.0f; //Relative noise to stop at, 0 renders every pass
+	std::string checkpointPath; //Resumed from if it exists and saved periodically, empty disables checkpoints
+	double checkpointIntervalSeconds = 60.0;
+
+	//Distributed rendering
+	std::string address = "tcp:127.0.0.1:5555";
+	size_t spawnWorkers = 0;
+	size_t tileSize = 32;
+	double leaseTimeoutSeconds = 60.0;
+	size_t failAfterTiles = 0; //Worker exits without returning its next lease after this many tiles, for testing reissue
+
+	//Render daemon
+	std::string sceneCacheDirectory = "scene-cache"; //Where built in scenes are compiled to for the daemon
+	size_t sceneCacheSize = 4; //Compiled scenes the daemon keeps mapped
+};
+
+namespace CommandLine
+{
+	//Returns false and prints usage if the arguments can't be parsed
+	bool Parse(int argc, char** argv, RenderOptions& options);
+
+	void PrintUsage(const char* program);
+}
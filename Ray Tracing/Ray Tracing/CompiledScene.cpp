@@ -0,0 +1,711 @@
+#include "CompiledScene.h"
+
+#include "BVHBuilder.h"
+#include "Box.h"
+#include "CheckerTexture.h"
+#include "Dialectric.h"
+#include "DiffuseLight.h"
+#include "ImageTexture.h"
+#include "InstanceTranslation.h"
+#include "InstanceYRotation.h"
+#include "Lambertian.h"
+#include "Metal.h"
+#include "MovingSphere.h"
+#include "NoiseTexture.h"
+#include "OrientedBox.h"
+#include "Quad.h"
+#include "Sphere.h"
+#include "Statistics.h"
+#include "XYRectangle.h"
+#include "XZRectangle.h"
+#include "YZRectangle.h"
+
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace
+{
+	bool SectionFits(const SceneFormat::SectionRange& range, size_t recordSize, uint64_t fileSize)
+	{
+		if (range.offset % SceneFormat::SectionAlignment != 0 || range.offset > fileSize)
+		{
+			return false;
+		}
+		return range.count <= (fileSize - range.offset) / recordSize;
+	}
+
+	bool Validate(const MappedFile& file, const std::filesystem::path& path)
+	{
+		SceneFormat::Header header;
+		if (file.Size() < sizeof(header))
+		{
+			std::cerr << path << " is too small to be a compiled scene\n";
+			return false;
+		}
+
+		std::memcpy(&header, file.Data(), sizeof(header));
+
+		if (std::memcmp(header.magic, SceneFormat::Magic, sizeof(header.magic)) != 0)
+		{
+			std::cerr << path << " is not a compiled scene\n";
+			return false;
+		}
+
+		if (header.version != SceneFormat::Version || header.headerSize != sizeof(header))
+		{
+			std::cerr << path << " is compiled scene version " << header.version << ", expected " << SceneFormat::Version << "\n";
+			return false;
+		}
+
+		if (header.fileSize != file.Size())
+		{
+			std::cerr << path << " is truncated\n";
+			return false;
+		}
+
+		const size_t recordSizes[] = { sizeof(SceneFormat::Node), sizeof(SceneFormat::Primitive), sizeof(SceneFormat::Material), sizeof(SceneFormat::Texture), 1, sizeof(SceneFormat::LightNode), sizeof(SceneFormat::Light), sizeof(SceneFormat::WideNode),
+			sizeof(SceneFormat::Cluster), 1 };
+		for (size_t i = 0; i < static_cast<size_t>(SceneFormat::Section::Count); i++)
+		{
+			if (!SectionFits(header.sections[i], recordSizes[i], header.fileSize))
+			{
+				std::cerr << path << " has a section outside the file\n";
+				return false;
+			}
+		}
+
+		if (header.nodeLayout != SceneFormat::NodeLayout::Binary && header.nodeLayout != SceneFormat::NodeLayout::Wide)
+		{
+			std::cerr << path << " has an unknown node layout\n";
+			return false;
+		}
+
+		const SceneFormat::Section nodeSection = header.nodeLayout == SceneFormat::NodeLayout::Wide ? SceneFormat::Section::WideNodes : SceneFormat::Section::Nodes;
+		if (header.rootNode >= header.sections[static_cast<uint32_t>(nodeSection)].count)
+		{
+			std::cerr << path << " has no root node\n";
+			return false;
+		}
+
+		const SceneFormat::SectionRange& clusters = header.sections[static_cast<uint32_t>(SceneFormat::Section::Clusters)];
+		const SceneFormat::SectionRange& clusterData = header.sections[static_cast<uint32_t>(SceneFormat::Section::ClusterData)];
+		if (clusterData.offset % SceneFormat::ClusterAlignment != 0)
+		{
+			std::cerr << path << " has misaligned clusters\n";
+			return false;
+		}
+
+		const size_t nodeSize = header.nodeLayout == SceneFormat::NodeLayout::Wide ? sizeof(SceneFormat::WideNode) : sizeof(SceneFormat::Node);
+		for (uint64_t i = 0; i < clusters.count; i++)
+		{
+			SceneFormat::Cluster cluster;
+			std::memcpy(&cluster, file.Data() + clusters.offset + i * sizeof(cluster), sizeof(cluster));
+
+			const bool fits = cluster.offset % SceneFormat::ClusterAlignment == 0 && cluster.size <= clusterData.count && cluster.offset <= clusterData.count - cluster.size
+				&& cluster.primitiveOffset % SceneFormat::SectionAlignment == 0 && cluster.nodeCount <= cluster.primitiveOffset / nodeSize
+				&& cluster.primitiveOffset <= cluster.size && cluster.primitiveCount <= (cluster.size - cluster.primitiveOffset) / sizeof(SceneFormat::Primitive)
+				&& cluster.root < cluster.nodeCount;
+			if (!fits)
+			{
+				std::cerr << path << " has a cluster outside its section\n";
+				return false;
+			}
+		}
+
+		const uint64_t expected = header.checksum;
+		header.checksum = 0;
+		uint64_t checksum = SceneFormat::Checksum(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+		checksum = SceneFormat::Checksum(file.Data() + sizeof(header), file.Size() - sizeof(header), checksum);
+
+		if (checksum != expected)
+		{
+			std::cerr << path << " failed its checksum\n";
+			return false;
+		}
+
+		return true;
+	}
+
+	AABB WideChildBounds(const SceneFormat::WideNode& node, size_t child)
+	{
+		Vector3 minimum;
+		Vector3 maximum;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float step = SceneFormat::QuantizationStep(node.exponent[axis]);
+			minimum.v[axis] = SceneFormat::Dequantize(node.origin[axis], node.lower[axis][child], step);
+			maximum.v[axis] = SceneFormat::Dequantize(node.origin[axis], node.upper[axis][child], step);
+		}
+		return AABB(minimum, maximum);
+	}
+}
+
+CompiledMaterial::CompiledMaterial(const CompiledScene* scene, uint32_t index)
+	: scene(scene), index(index)
+{
+}
+
+bool CompiledMaterial::Scatter(const Ray& r_in, const HitRecord& hitRecord, Vector3& attenuation, Ray& scattered) const
+{
+	return scene->Scatter(index, r_in, hitRecord, attenuation, scattered);
+}
+
+Vector3 CompiledMaterial::Emitted(float u, float v, const Vector3& p) const
+{
+	return scene->Emitted(index, u, v, p);
+}
+
+bool CompiledMaterial::Sample(const Ray& r_in, const HitRecord& hitRecord, BsdfSample& sample) const
+{
+	return scene->Sample(index, r_in, hitRecord, sample);
+}
+
+Vector3 CompiledMaterial::Eval(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const
+{
+	return scene->Eval(index, r_in, hitRecord, direction);
+}
+
+float CompiledMaterial::Pdf(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const
+{
+	return scene->Pdf(index, r_in, hitRecord, direction);
+}
+
+bool CompiledMaterial::IsDiffuse() const
+{
+	return scene->IsDiffuse(index);
+}
+
+bool CompiledMaterial::SamplesLights() const
+{
+	return scene->SamplesLights(index);
+}
+
+CompiledTexture::CompiledTexture(const CompiledScene* scene, uint32_t index)
+	: scene(scene), index(index)
+{
+}
+
+Vector3 CompiledTexture::Value(float u, float v, const Vector3& p) const
+{
+	return scene->TextureValue(index, u, v, p);
+}
+
+CompiledSubtree::CompiledSubtree(const CompiledScene* scene, uint32_t root)
+	: scene(scene), root(root)
+{
+}
+
+bool CompiledSubtree::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
+{
+	return scene->HitSubtree(root, r, tMin, tMax, hitRecord);
+}
+
+bool CompiledSubtree::BoundingBox(float t0, float t1, AABB& box) const
+{
+	box = scene->NodeBounds(root);
+	return true;
+}
+
+CompiledCluster::CompiledCluster(const CompiledScene* scene, uint32_t cluster)
+	: scene(scene), cluster(cluster)
+{
+}
+
+bool CompiledCluster::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
+{
+	return scene->HitCluster(cluster, r, tMin, tMax, hitRecord);
+}
+
+bool CompiledCluster::BoundingBox(float t0, float t1, AABB& box) const
+{
+	box = scene->ClusterBounds(cluster);
+	return true;
+}
+
+CompiledScene* CompiledScene::Load(const std::filesystem::path& path)
+{
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		std::cerr << "Unable to open " << path << "\n";
+		return nullptr;
+	}
+
+	if (!Validate(file, path))
+	{
+		return nullptr;
+	}
+
+	CompiledScene* scene = new CompiledScene();
+	scene->file = std::move(file);
+	scene->header = reinterpret_cast<const SceneFormat::Header*>(scene->file.Data());
+	scene->nodes = scene->SectionData<SceneFormat::Node>(SceneFormat::Section::Nodes);
+	scene->primitives = scene->SectionData<SceneFormat::Primitive>(SceneFormat::Section::Primitives);
+	scene->materials = scene->SectionData<SceneFormat::Material>(SceneFormat::Section::Materials);
+	scene->textures = scene->SectionData<SceneFormat::Texture>(SceneFormat::Section::Textures);
+	scene->data = scene->SectionData<uint8_t>(SceneFormat::Section::Data);
+	scene->wideNodes = scene->SectionData<SceneFormat::WideNode>(SceneFormat::Section::WideNodes);
+	scene->clusters = scene->SectionData<SceneFormat::Cluster>(SceneFormat::Section::Clusters);
+	scene->clusterData = scene->SectionData<uint8_t>(SceneFormat::Section::ClusterData);
+
+	const SceneFormat::SectionRange& lightNodes = scene->header->sections[static_cast<uint32_t>(SceneFormat::Section::LightNodes)];
+	const SceneFormat::SectionRange& lights = scene->header->sections[static_cast<uint32_t>(SceneFormat::Section::Lights)];
+	scene->lights = LightBVH(scene,
+		scene->SectionData<SceneFormat::LightNode>(SceneFormat::Section::LightNodes), static_cast<size_t>(lightNodes.count),
+		scene->SectionData<SceneFormat::Light>(SceneFormat::Section::Lights), static_cast<size_t>(lights.count));
+
+	const size_t materialCount = static_cast<size_t>(scene->header->sections[static_cast<uint32_t>(SceneFormat::Section::Materials)].count);
+	scene->materialViews.reset(new CompiledMaterial[materialCount]);
+	for (size_t i = 0; i < materialCount; i++)
+	{
+		scene->materialViews[i] = CompiledMaterial(scene, static_cast<uint32_t>(i));
+	}
+
+	return scene;
+}
+
+bool CompiledScene::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
+{
+	return HitSubtree(header->rootNode, r, tMin, tMax, hitRecord);
+}
+
+bool CompiledScene::BoundingBox(float t0, float t1, AABB& box) const
+{
+	box = NodeBounds(header->rootNode);
+	return true;
+}
+
+const SceneFormat::Header& CompiledScene::GetHeader() const
+{
+	return *header;
+}
+
+uint64_t CompiledScene::NodeBytes() const
+{
+	const size_t nodeSize = header->nodeLayout == SceneFormat::NodeLayout::Wide ? sizeof(SceneFormat::WideNode) : sizeof(SceneFormat::Node);
+	const SceneFormat::Section nodeSection = header->nodeLayout == SceneFormat::NodeLayout::Wide ? SceneFormat::Section::WideNodes : SceneFormat::Section::Nodes;
+
+	uint64_t nodeCount = header->sections[static_cast<uint32_t>(nodeSection)].count;
+	for (uint64_t i = 0; i < header->sections[static_cast<uint32_t>(SceneFormat::Section::Clusters)].count; i++)
+	{
+		nodeCount += clusters[i].nodeCount;
+	}
+	return nodeCount * nodeSize;
+}
+
+uint64_t CompiledScene::PrimitiveCount() const
+{
+	uint64_t primitiveCount = header->sections[static_cast<uint32_t>(SceneFormat::Section::Primitives)].count;
+	for (uint64_t i = 0; i < header->sections[static_cast<uint32_t>(SceneFormat::Section::Clusters)].count; i++)
+	{
+		primitiveCount += clusters[i].primitiveCount;
+	}
+	return primitiveCount;
+}
+
+bool CompiledScene::HitSubtree(uint32_t root, const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
+{
+	return HitTree({ nodes, wideNodes, primitives }, root, r, tMin, tMax, hitRecord);
+}
+
+bool CompiledScene::HitCluster(uint32_t cluster, const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
+{
+	if (clusterCache)
+	{
+		clusterCache->Touch(cluster);
+	}
+
+	//Nodes of either layout start the cluster, its primitives follow them
+	const SceneFormat::Cluster& record = clusters[cluster];
+	const uint8_t* base = clusterData + record.offset;
+
+	Tree tree;
+	tree.nodes = reinterpret_cast<const SceneFormat::Node*>(base);
+	tree.wideNodes = reinterpret_cast<const SceneFormat::WideNode*>(base);
+	tree.primitives = reinterpret_cast<const SceneFormat::Primitive*>(base + record.primitiveOffset);
+
+	return HitTree(tree, record.root, r, tMin, tMax, hitRecord);
+}
+
+AABB CompiledScene::ClusterBounds(uint32_t cluster) const
+{
+	return AABB(Vector3::Load(clusters[cluster].minimum), Vector3::Load(clusters[cluster].maximum));
+}
+
+void CompiledScene::SetClusterCacheLimit(uint64_t limitBytes)
+{
+	const SceneFormat::SectionRange& range = header->sections[static_cast<uint32_t>(SceneFormat::Section::Clusters)];
+	const uint64_t clusterDataOffset = header->sections[static_cast<uint32_t>(SceneFormat::Section::ClusterData)].offset;
+	clusterCache.reset(new ClusterCache(file, clusterDataOffset, clusters, static_cast<size_t>(range.count), limitBytes));
+}
+
+const ClusterCache* CompiledScene::GetClusterCache() const
+{
+	return clusterCache.get();
+}
+
+bool CompiledScene::HitTree(const Tree& tree, uint32_t root, const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
+{
+	if (header->nodeLayout == SceneFormat::NodeLayout::Wide)
+	{
+		return HitWideTree(tree, root, r, tMin, tMax, hitRecord);
+	}
+
+	uint32_t stack[BVHBuilder::MaxDepth + 1];
+	size_t stackSize = 0;
+	stack[stackSize++] = root;
+
+	bool hitAnything = false;
+	float closestDistance = tMax;
+
+	while (stackSize > 0)
+	{
+		const uint32_t nodeIndex = stack[--stackSize];
+		const SceneFormat::Node& node = tree.nodes[nodeIndex];
+
+		RT_STATISTIC_INCREMENT(bvhNodesVisited);
+
+		if (!AABB(Vector3::Load(node.minimum), Vector3::Load(node.maximum)).RayIntersection(r, tMin, closestDistance))
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (uint32_t i = node.rightOrFirst; i < node.rightOrFirst + node.count; i++)
+			{
+				if (HitPrimitive(tree.primitives[i], r, tMin, closestDistance, hitRecord))
+				{
+					hitAnything = true;
+					closestDistance = hitRecord.t;
+				}
+			}
+		}
+		else if (r.Direction()[node.axis] < 0.0f)
+		{
+			//The right child is nearer, push it last so it is visited first
+			stack[stackSize++] = nodeIndex + 1;
+			stack[stackSize++] = node.rightOrFirst;
+		}
+		else
+		{
+			stack[stackSize++] = node.rightOrFirst;
+			stack[stackSize++] = nodeIndex + 1;
+		}
+	}
+
+	return hitAnything;
+}
+
+bool CompiledScene::HitWideTree(const Tree& tree, uint32_t root, const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
+{
+	//Every node visited pushes at most three children more than it pops, and the tree is no deeper than the binary one
+	uint32_t stack[(SceneFormat::WideNodeWidth - 1) * BVHBuilder::MaxDepth + 1];
+	size_t stackSize = 0;
+	stack[stackSize++] = root;
+
+	const Vector3 origin = r.Origin();
+	const Vector3 inverseDirection(1.0f / r.Direction().x, 1.0f / r.Direction().y, 1.0f / r.Direction().z);
+
+	bool hitAnything = false;
+	float closestDistance = tMax;
+
+	while (stackSize > 0)
+	{
+		const SceneFormat::WideNode& node = tree.wideNodes[stack[--stackSize]];
+
+		RT_STATISTIC_INCREMENT(bvhNodesVisited);
+
+		float steps[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			steps[axis] = SceneFormat::QuantizationStep(node.exponent[axis]);
+		}
+
+		//Children the ray enters, sorted nearest first
+		uint32_t order[SceneFormat::WideNodeWidth];
+		float entries[SceneFormat::WideNodeWidth];
+		size_t hitCount = 0;
+
+		for (uint32_t i = 0; i < SceneFormat::WideNodeWidth && node.child[i] != SceneFormat::InvalidIndex; i++)
+		{
+			RT_STATISTIC_INCREMENT(aabbTests);
+
+			//Slab test against the decoded box, keeping where the ray enters it
+			float entry = tMin;
+			float exit = closestDistance;
+			for (int axis = 0; axis < 3 && entry < exit; axis++)
+			{
+				float t0 = (SceneFormat::Dequantize(node.origin[axis], node.lower[axis][i], steps[axis]) - origin.v[axis]) * inverseDirection.v[axis];
+				float t1 = (SceneFormat::Dequantize(node.origin[axis], node.upper[axis][i], steps[axis]) - origin.v[axis]) * inverseDirection.v[axis];
+				if (inverseDirection.v[axis] < 0.0f)
+					std::swap(t0, t1);
+
+				entry = t0 > entry ? t0 : entry;
+				exit = t1 < exit ? t1 : exit;
+			}
+
+			if (exit <= entry)
+			{
+				continue;
+			}
+
+			size_t position = hitCount++;
+			while (position > 0 && entries[position - 1] > entry)
+			{
+				order[position] = order[position - 1];
+				entries[position] = entries[position - 1];
+				position--;
+			}
+			order[position] = i;
+			entries[position] = entry;
+		}
+
+		//Leaves are intersected straight away so nearer hits can cull the interior children before they are pushed
+		size_t interiorCount = 0;
+		for (size_t i = 0; i < hitCount; i++)
+		{
+			const uint32_t child = order[i];
+			if (node.count[child] == 0)
+			{
+				order[interiorCount++] = child;
+				continue;
+			}
+
+			for (uint32_t primitive = node.child[child]; primitive < node.child[child] + node.count[child]; primitive++)
+			{
+				if (HitPrimitive(tree.primitives[primitive], r, tMin, closestDistance, hitRecord))
+				{
+					hitAnything = true;
+					closestDistance = hitRecord.t;
+				}
+			}
+		}
+
+		//Push the farthest first so the nearest is visited next
+		while (interiorCount > 0)
+		{
+			stack[stackSize++] = node.child[order[--interiorCount]];
+		}
+	}
+
+	return hitAnything;
+}
+
+AABB CompiledScene::NodeBounds(uint32_t node) const
+{
+	if (header->nodeLayout == SceneFormat::NodeLayout::Wide)
+	{
+		AABB bounds = WideChildBounds(wideNodes[node], 0);
+		for (uint32_t i = 1; i < SceneFormat::WideNodeWidth && wideNodes[node].child[i] != SceneFormat::InvalidIndex; i++)
+		{
+			bounds = AABB::SurroundingBox(bounds, WideChildBounds(wideNodes[node], i));
+		}
+		return bounds;
+	}
+
+	return AABB(Vector3::Load(nodes[node].minimum), Vector3::Load(nodes[node].maximum));
+}
+
+template<typename Function>
+auto CompiledScene::VisitPrimitive(const SceneFormat::Primitive& primitive, Function&& function) const
+{
+	const float* data = primitive.data;
+	Material* material = primitive.material != SceneFormat::InvalidIndex ? &materialViews[primitive.material] : nullptr;
+
+	switch (primitive.type)
+	{
+	case SceneFormat::PrimitiveType::Sphere:
+		return function(Sphere(Vector3::Load(data), data[3], material));
+
+	case SceneFormat::PrimitiveType::MovingSphere:
+		return function(MovingSphere(Vector3::Load(data), Vector3::Load(data + 3), data[6], data[7], data[8], material));
+
+	case SceneFormat::PrimitiveType::XYRectangle:
+		return function(XYRectangle(data[0], data[1], data[2], data[3], data[4], material));
+
+	case SceneFormat::PrimitiveType::XZRectangle:
+		return function(XZRectangle(data[0], data[1], data[2], data[3], data[4], material));
+
+	case SceneFormat::PrimitiveType::YZRectangle:
+		return function(YZRectangle(data[0], data[1], data[2], data[3], data[4], material));
+
+	case SceneFormat::PrimitiveType::Box:
+		return function(Box(Vector3::Load(data), Vector3::Load(data + 3), material));
+
+	case SceneFormat::PrimitiveType::OrientedBox:
+		return function(OrientedBox(Vector3::Load(data), Vector3::Load(data + 3), Vector3::Load(data + 6), Vector3::Load(data + 9), material));
+
+	case SceneFormat::PrimitiveType::Quad:
+		return function(Quad(Vector3::Load(data), Vector3::Load(data + 3), Vector3::Load(data + 6), material));
+
+	case SceneFormat::PrimitiveType::Translation:
+	{
+		CompiledSubtree child(this, primitive.child);
+		return function(InstanceTranslation(&child, Vector3::Load(data)));
+	}
+
+	case SceneFormat::PrimitiveType::YRotation:
+	{
+		CompiledSubtree child(this, primitive.child);
+		return function(InstanceYRotation(&child, data[0], data[1], AABB(Vector3::Load(data + 2), Vector3::Load(data + 5))));
+	}
+
+	case SceneFormat::PrimitiveType::Cluster:
+		return function(CompiledCluster(this, primitive.child));
+	}
+
+	return decltype(function(std::declval<const Hittable&>()))();
+}
+
+bool CompiledScene::HitPrimitive(const SceneFormat::Primitive& primitive, const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
+{
+	const bool hit = VisitPrimitive(primitive, [&](const Hittable& hittable)
+		{
+			return hittable.Hit(r, tMin, tMax, hitRecord);
+		});
+
+	//Instances and clusters leave the light set by the primitive hit inside them
+	const SceneFormat::PrimitiveType type = primitive.type;
+	if (hit && type != SceneFormat::PrimitiveType::Translation && type != SceneFormat::PrimitiveType::YRotation && type != SceneFormat::PrimitiveType::Cluster)
+	{
+		hitRecord.light = primitive.light;
+	}
+
+	return hit;
+}
+
+float CompiledScene::PrimitivePdfValue(uint32_t primitive, const Vector3& origin, const Vector3& direction) const
+{
+	return VisitPrimitive(primitives[primitive], [&](const Hittable& hittable)
+		{
+			return hittable.PdfValue(origin, direction);
+		});
+}
+
+Vector3 CompiledScene::PrimitiveRandom(uint32_t primitive, const Vector3& origin) const
+{
+	return VisitPrimitive(primitives[primitive], [&](const Hittable& hittable)
+		{
+			return hittable.Random(origin);
+		});
+}
+
+const LightBVH& CompiledScene::Lights() const
+{
+	return lights;
+}
+
+bool CompiledScene::IsDiffuse(uint32_t material) const
+{
+	return materials[material].type == SceneFormat::MaterialType::Lambertian;
+}
+
+template<typename Function>
+auto CompiledScene::VisitMaterial(uint32_t material, Function&& function) const
+{
+	const SceneFormat::Material& record = materials[material];
+
+	switch (record.type)
+	{
+	case SceneFormat::MaterialType::Lambertian:
+	{
+		CompiledTexture albedo(this, record.texture);
+		return function(Lambertian(&albedo));
+	}
+
+	case SceneFormat::MaterialType::Metal:
+		return function(Metal(Vector3::Load(record.data), record.data[3]));
+
+	case SceneFormat::MaterialType::Dialectric:
+		return function(Dialectric(record.data[0], record.data[1]));
+
+	case SceneFormat::MaterialType::DiffuseLight:
+	{
+		CompiledTexture emit(this, record.texture);
+		return function(DiffuseLight(&emit));
+	}
+	}
+
+	return decltype(function(std::declval<const Material&>()))();
+}
+
+bool CompiledScene::SamplesLights(uint32_t material) const
+{
+	return VisitMaterial(material, [&](const Material& runtime)
+		{
+			return runtime.SamplesLights();
+		});
+}
+
+bool CompiledScene::Scatter(uint32_t material, const Ray& r_in, const HitRecord& hitRecord, Vector3& attenuation, Ray& scattered) const
+{
+	return VisitMaterial(material, [&](const Material& runtime)
+		{
+			return runtime.Scatter(r_in, hitRecord, attenuation, scattered);
+		});
+}
+
+bool CompiledScene::Sample(uint32_t material, const Ray& r_in, const HitRecord& hitRecord, BsdfSample& sample) const
+{
+	return VisitMaterial(material, [&](const Material& runtime)
+		{
+			return runtime.Sample(r_in, hitRecord, sample);
+		});
+}
+
+Vector3 CompiledScene::Eval(uint32_t material, const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const
+{
+	return VisitMaterial(material, [&](const Material& runtime)
+		{
+			return runtime.Eval(r_in, hitRecord, direction);
+		});
+}
+
+float CompiledScene::Pdf(uint32_t material, const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const
+{
+	return VisitMaterial(material, [&](const Material& runtime)
+		{
+			return runtime.Pdf(r_in, hitRecord, direction);
+		});
+}
+
+Vector3 CompiledScene::Emitted(uint32_t material, float u, float v, const Vector3& p) const
+{
+	const SceneFormat::Material& record = materials[material];
+
+	if (record.type == SceneFormat::MaterialType::DiffuseLight)
+	{
+		CompiledTexture emit(this, record.texture);
+		return DiffuseLight(&emit).Emitted(u, v, p);
+	}
+
+	return Vector3(0.0f, 0.0f, 0.0f);
+}
+
+Vector3 CompiledScene::TextureValue(uint32_t texture, float u, float v, const Vector3& p) const
+{
+	const SceneFormat::Texture& record = textures[texture];
+
+	switch (record.type)
+	{
+	case SceneFormat::TextureType::ConstantColour:
+		return Vector3::Load(record.data);
+
+	case SceneFormat::TextureType::Checker:
+	{
+		CompiledTexture even(this, record.children[0]);
+		CompiledTexture odd(this, record.children[1]);
+		return CheckerTexture(&even, &odd).Value(u, v, p);
+	}
+
+	case SceneFormat::TextureType::Noise:
+		return NoiseTexture(PerlinNoise::FromCompiledTables(data + record.dataOffset), record.data[0]).Value(u, v, p);
+
+	case SceneFormat::TextureType::Image:
+		return ImageTexture(data + record.dataOffset, record.width, record.height).Value(u, v, p);
+	}
+
+	return Vector3(0.0f, 0.0f, 0.0f);
+}
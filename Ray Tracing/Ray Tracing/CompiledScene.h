@@ -0,0 +1,169 @@
+#pragma once
+
+#include "ClusterCache.h"
+#include "Hittable.h"
+#include "LightBVH.h"
+#include "MappedFile.h"
+#include "Material.h"
+#include "SceneFormat.h"
+#include "Texture.h"
+
+#include <filesystem>
+#include <memory>
+
+class CompiledScene;
+
+//Views the runtime classes need to refer to compiled records. Each one is a scene pointer and an index,
+//the record itself is read from the mapped file when used.
+class CompiledMaterial : public Material
+{
+public:
+	CompiledMaterial() = default;
+	CompiledMaterial(const CompiledScene* scene, uint32_t index);
+
+	bool Scatter(const Ray& r_in, const HitRecord& hitRecord, Vector3& attenuation, Ray& scattered) const override;
+	Vector3 Emitted(float u, float v, const Vector3& p) const override;
+	bool Sample(const Ray& r_in, const HitRecord& hitRecord, BsdfSample& sample) const override;
+	Vector3 Eval(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const override;
+	float Pdf(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const override;
+	bool IsDiffuse() const override;
+	bool SamplesLights() const override;
+
+private:
+	const CompiledScene* scene = nullptr;
+	uint32_t index = 0;
+};
+
+class CompiledTexture : public Texture
+{
+public:
+	CompiledTexture(const CompiledScene* scene, uint32_t index);
+
+	Vector3 Value(float u, float v, const Vector3& p) const override;
+
+private:
+	const CompiledScene* scene;
+	uint32_t index;
+};
+
+class CompiledSubtree : public Hittable
+{
+public:
+	CompiledSubtree(const CompiledScene* scene, uint32_t root);
+
+	bool Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const override;
+	bool BoundingBox(float t0, float t1, AABB& box) const override;
+
+private:
+	const CompiledScene* scene;
+	uint32_t root;
+};
+
+class CompiledCluster : public Hittable
+{
+public:
+	CompiledCluster(const CompiledScene* scene, uint32_t cluster);
+
+	bool Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const override;
+	bool BoundingBox(float t0, float t1, AABB& box) const override;
+
+private:
+	const CompiledScene* scene;
+	uint32_t cluster;
+};
+
+//A scene written by SceneCompiler, traced straight from a read only memory mapping.
+//Primitives are intersected by constructing the matching runtime object on the stack so
+//compiled and uncompiled scenes share the same intersection and shading code.
+class CompiledScene : public Hittable
+{
+public:
+	//Returns nullptr if the file is missing, truncated, from another version or fails its checksum
+	static CompiledScene* Load(const std::filesystem::path& path);
+
+	bool Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const override;
+	bool BoundingBox(float t0, float t1, AABB& box) const override;
+
+	const SceneFormat::Header& GetHeader() const;
+
+	//Bytes of BVH nodes and number of primitive records, including those inside clusters
+	uint64_t NodeBytes() const;
+	uint64_t PrimitiveCount() const;
+
+	bool HitSubtree(uint32_t root, const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const;
+	AABB NodeBounds(uint32_t node) const;
+
+	bool HitCluster(uint32_t cluster, const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const;
+	AABB ClusterBounds(uint32_t cluster) const;
+
+	//Keeps at most limitBytes of clusters resident, releasing the least recently used. Without a limit the
+	//page cache alone decides what stays in memory. Call before rendering starts.
+	void SetClusterCacheLimit(uint64_t limitBytes);
+
+	//Null unless SetClusterCacheLimit has been called
+	const ClusterCache* GetClusterCache() const;
+
+	bool Scatter(uint32_t material, const Ray& r_in, const HitRecord& hitRecord, Vector3& attenuation, Ray& scattered) const;
+	Vector3 Emitted(uint32_t material, float u, float v, const Vector3& p) const;
+	bool Sample(uint32_t material, const Ray& r_in, const HitRecord& hitRecord, BsdfSample& sample) const;
+	Vector3 Eval(uint32_t material, const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const;
+	float Pdf(uint32_t material, const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const;
+	Vector3 TextureValue(uint32_t texture, float u, float v, const Vector3& p) const;
+	bool IsDiffuse(uint32_t material) const;
+	bool SamplesLights(uint32_t material) const;
+
+	//Light BVH built by the compiler over the scene's emitters, empty if it has none
+	const LightBVH& Lights() const;
+
+	//Hittable::PdfValue and Hittable::Random of a primitive, used to sample lights
+	float PrimitivePdfValue(uint32_t primitive, const Vector3& origin, const Vector3& direction) const;
+	Vector3 PrimitiveRandom(uint32_t primitive, const Vector3& origin) const;
+
+private:
+	CompiledScene() = default;
+
+	//Node and primitive arrays a traversal runs over, either the scene's own or those of a cluster
+	struct Tree
+	{
+		const SceneFormat::Node* nodes;
+		const SceneFormat::WideNode* wideNodes;
+		const SceneFormat::Primitive* primitives;
+	};
+
+	bool HitTree(const Tree& tree, uint32_t root, const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const;
+	bool HitWideTree(const Tree& tree, uint32_t root, const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const;
+
+	bool HitPrimitive(const SceneFormat::Primitive& primitive, const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const;
+
+	//Calls function with the runtime object matching the primitive, returns a value initialised result for unknown types
+	template<typename Function>
+	auto VisitPrimitive(const SceneFormat::Primitive& primitive, Function&& function) const;
+
+	//Calls function with the runtime material matching the record, returns a value initialised result for unknown types
+	template<typename Function>
+	auto VisitMaterial(uint32_t material, Function&& function) const;
+
+	template<typename T>
+	const T* SectionData(SceneFormat::Section section) const
+	{
+		return reinterpret_cast<const T*>(file.Data() + header->sections[static_cast<uint32_t>(section)].offset);
+	}
+
+	MappedFile file;
+	const SceneFormat::Header* header = nullptr;
+	const SceneFormat::Node* nodes = nullptr;
+	const SceneFormat::Primitive* primitives = nullptr;
+	const SceneFormat::Material* materials = nullptr;
+	const SceneFormat::Texture* textures = nullptr;
+	const uint8_t* data = nullptr;
+	const SceneFormat::WideNode* wideNodes = nullptr;
+	const SceneFormat::Cluster* clusters = nullptr;
+	const uint8_t* clusterData = nullptr;
+
+	std::unique_ptr<ClusterCache> clusterCache;
+
+	LightBVH lights;
+
+	//HitRecord refers to materials by pointer, so every compiled material gets a small view object
+	std::unique_ptr<CompiledMaterial[]> materialViews;
+};
@@ -1,5 +1,7 @@
 #include "ConstantColour.h"
 
+#include "SceneCompiler.h"
+
 ConstantColour::ConstantColour(Vector3 c) 
 	: colour(c) {}
 
@@ -7,3 +9,12 @@ Vector3 ConstantColour::Value(float u, float v, const Vector3& p) const
 {
 	return colour;
 }
+
+bool ConstantColour::Compile(SceneCompiler& compiler, SceneFormat::Texture& record) const
+{
+	record.type = SceneFormat::TextureType::ConstantColour;
+	record.data[0] = colour.x;
+	record.data[1] = colour.y;
+	record.data[2] = colour.z;
+	return true;
+}
@@ -10,6 +10,8 @@ public:
 
 	Vector3 Value(float u, float v, const Vector3& p) const override;
 
+	bool Compile(SceneCompiler& compiler, SceneFormat::Texture& record) const override;
+
 private:
 	Vector3 colour;
 };
\ No newline at end of file
@@ -1,6 +1,12 @@
 #include "Dialectric.h"
 
-Dialectric::Dialectric(float ri) : refractionIndex(ri) 
+#include "Microfacet.h"
+#include "SceneCompiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+Dialectric::Dialectric(float ri, float roughness) : refractionIndex(ri), roughness(std::clamp(roughness, 0.0f, 1.0f)), alpha(this->roughness * this->roughness)
 {
 }
 
@@ -50,3 +56,144 @@ bool Dialectric::Scatter(const Ray& r_in, const HitRecord& hitRecord, Vector3& a
 
 	return true;
 }
+
+bool Dialectric::Sample(const Ray& r_in, const HitRecord& hitRecord, BsdfSample& sample) const
+{
+	const Microfacet::Frame frame(hitRecord.normal);
+	const Vector3 wo = frame.ToLocal(-GetNormalized(r_in.Direction()));
+	if (!(wo.z > 0.0f))
+	{
+		return false;
+	}
+
+	const float eta = RelativeIndex(hitRecord);
+	const bool smooth = alpha < Microfacet::SmoothAlpha;
+
+	Vector3 m = Vector3(0.0f, 0.0f, 1.0f);
+	if (!smooth)
+	{
+		const float u1 = Util::RandomFloat();
+		const float u2 = Util::RandomFloat();
+		m = Microfacet::SampleVisibleNormal(wo, alpha, u1, u2);
+	}
+
+	//Picking reflection with the Fresnel probability cancels it out of the weight
+	const float reflectance = Microfacet::FresnelDielectric(DotProduct(wo, m), eta);
+	Vector3 wi;
+	const bool reflect = Util::RandomFloat() < reflectance || !Microfacet::Refract(wo, m, eta, wi);
+	if (reflect)
+	{
+		wi = Microfacet::Reflect(wo, m);
+	}
+
+	//A rough facet can send the ray to the wrong side of the surface, the energy it loses is the BSDF's masking
+	if (reflect ? !(wi.z > 0.0f) : !(wi.z < 0.0f))
+	{
+		return false;
+	}
+
+	sample.direction = frame.ToWorld(wi);
+	sample.specular = smooth;
+	if (smooth)
+	{
+		sample.weight = Vector3(1.0f, 1.0f, 1.0f);
+		sample.pdf = 0.0f;
+		return true;
+	}
+
+	//As for Metal, the visible normal density leaves G over G1(wo)
+	const float weight = Microfacet::G(wo, wi, alpha) / Microfacet::G1(wo, alpha);
+	sample.weight = Vector3(weight, weight, weight);
+
+	float value;
+	Evaluate(wo, wi, eta, value, sample.pdf);
+	return sample.pdf > 0.0f;
+}
+
+Vector3 Dialectric::Eval(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const
+{
+	if (alpha < Microfacet::SmoothAlpha)
+	{
+		return Vector3(0.0f, 0.0f, 0.0f);
+	}
+
+	const Microfacet::Frame frame(hitRecord.normal);
+	float value;
+	float pdf;
+	Evaluate(frame.ToLocal(-GetNormalized(r_in.Direction())), frame.ToLocal(GetNormalized(direction)), RelativeIndex(hitRecord), value, pdf);
+	return Vector3(value, value, value);
+}
+
+float Dialectric::Pdf(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const
+{
+	if (alpha < Microfacet::SmoothAlpha)
+	{
+		return 0.0f;
+	}
+
+	const Microfacet::Frame frame(hitRecord.normal);
+	float value;
+	float pdf;
+	Evaluate(frame.ToLocal(-GetNormalized(r_in.Direction())), frame.ToLocal(GetNormalized(direction)), RelativeIndex(hitRecord), value, pdf);
+	return pdf;
+}
+
+bool Dialectric::Compile(SceneCompiler& compiler, SceneFormat::Material& record) const
+{
+	record.type = SceneFormat::MaterialType::Dialectric;
+	record.data[0] = refractionIndex;
+	record.data[1] = roughness;
+	return true;
+}
+
+float Dialectric::RelativeIndex(const HitRecord& hitRecord) const
+{
+	return hitRecord.frontFace ? refractionIndex : 1.0f / refractionIndex;
+}
+
+void Dialectric::Evaluate(const Vector3& wo, const Vector3& wi, float eta, float& value, float& pdf) const
+{
+	value = 0.0f;
+	pdf = 0.0f;
+	if (!(wo.z > 0.0f) || wi.z == 0.0f)
+	{
+		return;
+	}
+
+	//Walter et al. 2007. Radiance isn't scaled by eta squared on crossing, matching the smooth surface.
+	const bool reflect = wi.z > 0.0f;
+	Vector3 m = reflect ? wo + wi : wo + eta * wi;
+	if (!(m.SquaredLength() > 0.0f))
+	{
+		return;
+	}
+	m = GetNormalized(m);
+	if (m.z < 0.0f)
+	{
+		m = -m;
+	}
+
+	//Facets facing away from either direction can't connect them
+	const float cosOut = DotProduct(wo, m);
+	const float cosIn = DotProduct(wi, m);
+	if (!(cosOut > 0.0f) || (reflect ? !(cosIn > 0.0f) : !(cosIn < 0.0f)))
+	{
+		return;
+	}
+
+	const float reflectance = Microfacet::FresnelDielectric(cosOut, eta);
+	const float d = Microfacet::D(m, alpha);
+	const float g = Microfacet::G(wo, wi, alpha);
+	const float visiblePdf = Microfacet::VisibleNormalPdf(wo, m, alpha);
+
+	if (reflect)
+	{
+		value = reflectance * d * g / (4.0f * wo.z);
+		pdf = reflectance * visiblePdf / (4.0f * cosOut);
+		return;
+	}
+
+	const float denominator = (cosIn + cosOut / eta) * (cosIn + cosOut / eta);
+	value = (1.0f - reflectance) * d * g * std::abs(cosIn) * cosOut / (wo.z * denominator);
+	pdf = (1.0f - reflectance) * visiblePdf * std::abs(cosIn) / denominator;
+}
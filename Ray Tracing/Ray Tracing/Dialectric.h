@@ -6,10 +6,26 @@
 class Dialectric : public Material
 {
 public:
-	Dialectric(float ri);
+	//Roughness above zero makes a frosted GGX surface, Scatter ignores it
+	Dialectric(float ri, float roughness = 0.0f);
 
 	bool Scatter(const Ray& r_in, const HitRecord& hitRecord, Vector3& attenuation, Ray& scattered) const override;
 
+	//Chooses reflection or refraction by their Fresnel weights, through a microfacet from the visible normals when rough
+	bool Sample(const Ray& r_in, const HitRecord& hitRecord, BsdfSample& sample) const override;
+	Vector3 Eval(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const override;
+	float Pdf(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const override;
+
+	bool Compile(SceneCompiler& compiler, SceneFormat::Material& record) const override;
+
 private:
+	//Index of the side direction leaves through over the side the ray arrived from
+	float RelativeIndex(const HitRecord& hitRecord) const;
+
+	//Shared by Eval and Pdf, directions are in the hit's local frame
+	void Evaluate(const Vector3& wo, const Vector3& wi, float eta, float& value, float& pdf) const;
+
 	float refractionIndex;
+	float roughness;
+	float alpha;
 };
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "DiffuseLight.h"
 
+#include "SceneCompiler.h"
+
 bool DiffuseLight::Scatter(const Ray& r_in, const HitRecord& hitRecord, Vector3& attenuation, Ray& scattered) const
 {
 	return false;
@@ -9,3 +11,9 @@ Vector3 DiffuseLight::Emitted(float u, float v, const Vector3& p) const
 {
 	return emit->Value(u, v, p);
 }
+
+bool DiffuseLight::Compile(SceneCompiler& compiler, SceneFormat::Material& record) const
+{
+	record.type = SceneFormat::MaterialType::DiffuseLight;
+	return compiler.AddTexture(emit, record.texture);
+}
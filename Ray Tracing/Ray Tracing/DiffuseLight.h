@@ -12,6 +12,8 @@ public:
 
 	Vector3 Emitted(float u, float v, const Vector3& p) const override;
 
+	bool Compile(SceneCompiler& compiler, SceneFormat::Material& record) const override;
+
 private:
 	Texture* emit;
 };
\ No newline at end of file
@@ -0,0 +1,583 @@
+#include "DistributedRenderer.h"
+
+#include "Camera.h"
+#include "ImageData.h"
+#include "Renderer.h"
+#include "Scenes.h"
+#include "Socket.h"
+#include "TileCompression.h"
+#include "Util.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+namespace
+{
+	enum class MessageType : uint32_t
+	{
+		Job = 1,
+		RequestTile,
+		Lease,
+		TileResult,
+		Done
+	};
+
+	//Followed by the path of the compiled scene file, if any
+	struct JobMessage
+	{
+		uint32_t scene;
+		uint32_t width;
+		uint32_t height;
+		uint32_t samplesPerPixel;
+		int32_t maxBounces;
+		uint32_t seed;
+		uint32_t legacyMaterials;
+	};
+
+	//Tile rows are counted from the top of the image
+	struct LeaseMessage
+	{
+		uint32_t tileIndex;
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	constexpr size_t MaxSceneFilePath = 4096;
+
+	struct TileResultHeader
+	{
+		uint32_t tileIndex;
+		uint32_t valueCount;
+	};
+
+	bool SendMessage(Socket& socket, MessageType type, const void* payload, size_t size)
+	{
+		return socket.SendFrame(static_cast<uint32_t>(type), payload, size);
+	}
+
+	bool ReceiveMessage(Socket& socket, size_t maxSize, MessageType& type, std::vector<uint8_t>& payload)
+	{
+		uint32_t received = 0;
+		const bool valid = socket.ReceiveFrame(maxSize, received, payload);
+		type = static_cast<MessageType>(received);
+		return valid;
+	}
+
+	struct Tile
+	{
+		LeaseMessage lease;
+		bool complete = false;
+		bool leased = false;
+		size_t connectionId = 0;
+		std::chrono::steady_clock::time_point expiry;
+	};
+
+	struct Connection
+	{
+		Socket socket;
+		size_t id;
+		bool waitingForTile = false;
+	};
+
+	std::vector<Tile> SplitIntoTiles(size_t width, size_t height, size_t tileSize)
+	{
+		std::vector<Tile> tiles;
+		for (size_t y = 0; y < height; y += tileSize)
+		{
+			for (size_t x = 0; x < width; x += tileSize)
+			{
+				Tile tile;
+				tile.lease.tileIndex = static_cast<uint32_t>(tiles.size());
+				tile.lease.x = static_cast<uint32_t>(x);
+				tile.lease.y = static_cast<uint32_t>(y);
+				tile.lease.width = static_cast<uint32_t>(std::min(tileSize, width - x));
+				tile.lease.height = static_cast<uint32_t>(std::min(tileSize, height - y));
+				tiles.push_back(tile);
+			}
+		}
+		return tiles;
+	}
+
+	class WorkerProcesses
+	{
+	public:
+		bool Spawn(const std::vector<std::string>& arguments)
+		{
+#ifdef _WIN32
+			char path[MAX_PATH];
+			if (GetModuleFileNameA(nullptr, path, MAX_PATH) == 0)
+			{
+				return false;
+			}
+
+			std::string commandLine = "\"" + std::string(path) + "\"";
+			for (const std::string& argument : arguments)
+			{
+				commandLine += " \"" + argument + "\"";
+			}
+
+			STARTUPINFOA startupInfo = {};
+			startupInfo.cb = sizeof(startupInfo);
+			PROCESS_INFORMATION processInfo = {};
+			if (!CreateProcessA(path, &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startupInfo, &processInfo))
+			{
+				return false;
+			}
+
+			CloseHandle(processInfo.hThread);
+			processes.push_back(processInfo.hProcess);
+			return true;
+#else
+			const std::string path = "/proc/self/exe";
+
+			std::vector<char*> argv;
+			argv.push_back(const_cast<char*>(path.c_str()));
+			for (const std::string& argument : arguments)
+			{
+				argv.push_back(const_cast<char*>(argument.c_str()));
+			}
+			argv.push_back(nullptr);
+
+			pid_t pid;
+			if (posix_spawn(&pid, path.c_str(), nullptr, nullptr, argv.data(), environ) != 0)
+			{
+				return false;
+			}
+
+			processes.push_back(pid);
+			return true;
+#endif
+		}
+
+		void WaitAll()
+		{
+#ifdef _WIN32
+			for (HANDLE process : processes)
+			{
+				WaitForSingleObject(process, INFINITE);
+				CloseHandle(process);
+			}
+#else
+			for (pid_t pid : processes)
+			{
+				int status;
+				waitpid(pid, &status, 0);
+			}
+#endif
+			processes.clear();
+		}
+
+	private:
+#ifdef _WIN32
+		std::vector<HANDLE> processes;
+#else
+		std::vector<pid_t> processes;
+#endif
+	};
+
+	void RenderTile(const LeaseMessage& lease, const Scene& scene, const Camera& camera, const RenderSettings& settings, unsigned int seed, ThreadPool& threadPool, std::vector<float>& values)
+	{
+		values.assign(static_cast<size_t>(lease.width) * lease.height * 3, 0.0f);
+
+		std::vector<TaskFuture<void>> rows;
+		rows.reserve(lease.height);
+
+		for (uint32_t row = 0; row < lease.height; row++)
+		{
+			rows.push_back(threadPool.AddTask([&, row]()
+				{
+					const size_t imageRow = lease.y + row;
+					for (uint32_t column = 0; column < lease.width; column++)
+					{
+						const size_t x = lease.x + column;
+						const size_t y = settings.height - 1 - imageRow;
+
+						Util::SeedRandom(Renderer::PixelSeed(seed, x, y));
+						const Vector3 colour = Renderer::RenderPixel(x, y, scene, camera, settings);
+
+						float* value = &values[(static_cast<size_t>(row) * lease.width + column) * 3];
+						value[0] = colour.x;
+						value[1] = colour.y;
+						value[2] = colour.z;
+					}
+				}));
+		}
+
+		for (TaskFuture<void>& row : rows)
+		{
+			row.Wait();
+		}
+	}
+}
+
+bool Distributed::RunCoordinator(const RenderOptions& options)
+{
+	const RenderSettings& settings = options.settings;
+
+	if (options.sceneFile.size() > MaxSceneFilePath)
+	{
+		std::cerr << "Scene file path is too long\n";
+		return false;
+	}
+
+	//Check the compiled scene here, workers that fail to load it would leave the frame unfinished
+	if (!options.sceneFile.empty())
+	{
+		Scene scene;
+		if (!Scenes::Load(options.sceneFile, scene))
+		{
+			return false;
+		}
+		delete scene.world;
+	}
+
+	Socket listener = Socket::Listen(options.address);
+	if (!listener.IsValid())
+	{
+		return false;
+	}
+
+	std::vector<Tile> tiles = SplitIntoTiles(settings.width, settings.height, options.tileSize);
+	std::deque<size_t> pendingTiles;
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		pendingTiles.push_back(i);
+	}
+
+	WorkerProcesses workerProcesses;
+	for (size_t i = 0; i < options.spawnWorkers; i++)
+	{
+		const size_t hardwareThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+		const size_t workerThreads = options.threadCount != 0 ? options.threadCount : std::max<size_t>(1, hardwareThreads / options.spawnWorkers);
+
+		std::vector<std::string> arguments = { "--worker", options.address, "--threads", std::to_string(workerThreads) };
+		//Only the first worker fails so the others are left to take over its lease
+		if (i == 0 && options.failAfterTiles != 0)
+		{
+			arguments.push_back("--fail-after");
+			arguments.push_back(std::to_string(options.failAfterTiles));
+		}
+
+		if (!workerProcesses.Spawn(arguments))
+		{
+			std::cerr << "Unable to start worker process\n";
+		}
+	}
+
+	std::cout << "Coordinating " << tiles.size() << " tiles on " << options.address << "\n";
+
+	const JobMessage job = {
+		static_cast<uint32_t>(options.scene),
+		static_cast<uint32_t>(settings.width),
+		static_cast<uint32_t>(settings.height),
+		static_cast<uint32_t>(settings.samplesPerPixel),
+		static_cast<int32_t>(settings.maxBounces),
+		options.seed,
+		settings.legacyMaterials
+	};
+
+	std::vector<uint8_t> jobPayload(sizeof(job) + options.sceneFile.size());
+	std::memcpy(jobPayload.data(), &job, sizeof(job));
+	std::copy(options.sceneFile.begin(), options.sceneFile.end(), jobPayload.begin() + sizeof(job));
+
+	const size_t maxTileValues = options.tileSize * options.tileSize * 3;
+	const size_t maxPayloadSize = sizeof(TileResultHeader) + maxTileValues * sizeof(float) * 2;
+	const std::chrono::duration<double> leaseTimeout(options.leaseTimeoutSeconds);
+
+	ImageData imageData(settings.width, settings.height);
+	std::vector<Connection> connections;
+	size_t nextConnectionId = 0;
+	size_t completeTiles = 0;
+	size_t reissuedTiles = 0;
+
+	std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+	auto releaseLeases = [&](size_t connectionId)
+	{
+		for (Tile& tile : tiles)
+		{
+			if (tile.leased && !tile.complete && tile.connectionId == connectionId)
+			{
+				tile.leased = false;
+				pendingTiles.push_front(tile.lease.tileIndex);
+				reissuedTiles++;
+			}
+		}
+	};
+
+	std::vector<Socket*> sockets;
+	std::vector<bool> readable;
+	std::vector<uint8_t> payload;
+	std::vector<float> values;
+
+	//Once every tile is complete keep answering requests with Done until the workers hang up
+	std::chrono::steady_clock::time_point shutdownDeadline;
+	auto finished = [&]() { return completeTiles == tiles.size(); };
+
+	while (!finished() || (!connections.empty() && std::chrono::steady_clock::now() < shutdownDeadline))
+	{
+		sockets.clear();
+		sockets.push_back(&listener);
+		for (Connection& connection : connections)
+		{
+			sockets.push_back(&connection.socket);
+		}
+
+		Socket::WaitReadable(sockets, 100, readable);
+
+		if (readable[0])
+		{
+			Socket socket = listener.Accept();
+			if (socket.IsValid() && SendMessage(socket, MessageType::Job, jobPayload.data(), jobPayload.size()))
+			{
+				connections.push_back({ std::move(socket), nextConnectionId++ });
+			}
+		}
+
+		//Connections accepted above are not in the readable list yet
+		const size_t polledConnections = sockets.size() - 1;
+		for (size_t i = polledConnections; i-- > 0;)
+		{
+			if (!readable[i + 1])
+			{
+				continue;
+			}
+
+			Connection& connection = connections[i];
+
+			MessageType type;
+			bool valid = ReceiveMessage(connection.socket, maxPayloadSize, type, payload);
+
+			if (valid && type == MessageType::RequestTile)
+			{
+				connection.waitingForTile = true;
+			}
+			else if (valid && type == MessageType::TileResult)
+			{
+				TileResultHeader result;
+				valid = ReadPayload(payload, result) && result.tileIndex < tiles.size();
+
+				if (valid && !tiles[result.tileIndex].complete)
+				{
+					Tile& tile = tiles[result.tileIndex];
+					const size_t valueCount = static_cast<size_t>(tile.lease.width) * tile.lease.height * 3;
+
+					valid = result.valueCount == valueCount
+						&& TileCompression::Decompress(payload.data() + sizeof(result), payload.size() - sizeof(result), valueCount, values);
+
+					if (valid)
+					{
+						for (uint32_t row = 0; row < tile.lease.height; row++)
+						{
+							for (uint32_t column = 0; column < tile.lease.width; column++)
+							{
+								const float* value = &values[(static_cast<size_t>(row) * tile.lease.width + column) * 3];
+								imageData.Write(Vector3(value[0], value[1], value[2]), tile.lease.x + column, tile.lease.y + row);
+							}
+						}
+
+						tile.complete = true;
+						completeTiles++;
+
+						if (finished())
+						{
+							shutdownDeadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(leaseTimeout);
+						}
+					}
+				}
+			}
+			else
+			{
+				valid = false;
+			}
+
+			if (!valid)
+			{
+				releaseLeases(connection.id);
+				connections.erase(connections.begin() + i);
+			}
+		}
+
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		for (Tile& tile : tiles)
+		{
+			if (tile.leased && !tile.complete && now > tile.expiry)
+			{
+				tile.leased = false;
+				pendingTiles.push_front(tile.lease.tileIndex);
+				reissuedTiles++;
+			}
+		}
+
+		for (size_t i = connections.size(); i-- > 0;)
+		{
+			Connection& connection = connections[i];
+
+			//Tiles may have completed from an earlier lease while waiting in the queue
+			while (!pendingTiles.empty() && tiles[pendingTiles.front()].complete)
+			{
+				pendingTiles.pop_front();
+			}
+
+			if (!connection.waitingForTile)
+			{
+				continue;
+			}
+
+			if (finished())
+			{
+				connection.waitingForTile = false;
+				SendMessage(connection.socket, MessageType::Done, nullptr, 0);
+				continue;
+			}
+
+			if (pendingTiles.empty())
+			{
+				continue;
+			}
+
+			Tile& tile = tiles[pendingTiles.front()];
+			pendingTiles.pop_front();
+
+			tile.leased = true;
+			tile.connectionId = connection.id;
+			tile.expiry = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(leaseTimeout);
+			connection.waitingForTile = false;
+
+			if (!SendMessage(connection.socket, MessageType::Lease, &tile.lease, sizeof(tile.lease)))
+			{
+				releaseLeases(connection.id);
+				connections.erase(connections.begin() + i);
+			}
+		}
+	}
+
+	connections.clear();
+	listener.Close();
+
+	workerProcesses.WaitAll();
+
+	std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+
+	std::cout << duration << std::endl;
+	std::cout << reissuedTiles << " tiles reissued\n";
+
+	imageData.WriteImageDataToFile(options.outputPath, settings.samplesPerPixel);
+	return true;
+}
+
+bool Distributed::RunWorker(const RenderOptions& options)
+{
+	//The coordinator may still be starting up
+	Socket socket;
+	for (int attempt = 0; attempt < 50 && !socket.IsValid(); attempt++)
+	{
+		socket = Socket::Connect(options.address);
+		if (!socket.IsValid())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+	}
+
+	if (!socket.IsValid())
+	{
+		std::cerr << "Unable to connect to coordinator at " << options.address << "\n";
+		return false;
+	}
+
+	MessageType type;
+	std::vector<uint8_t> payload;
+	JobMessage job;
+	if (!ReceiveMessage(socket, sizeof(JobMessage) + MaxSceneFilePath, type, payload) || type != MessageType::Job || !ReadPayload(payload, job) || !Scenes::IsValid(job.scene))
+	{
+		std::cerr << "Coordinator did not send a job\n";
+		return false;
+	}
+
+	RenderSettings settings;
+	settings.width = job.width;
+	settings.height = job.height;
+	settings.samplesPerPixel = job.samplesPerPixel;
+	settings.maxBounces = job.maxBounces;
+	settings.legacyMaterials = job.legacyMaterials != 0;
+
+	const std::string sceneFile(payload.begin() + sizeof(job), payload.end());
+
+	//Every process must build the same scene
+	Scene scene;
+	if (!Scenes::CreateOrLoad(static_cast<SceneId>(job.scene), job.seed, sceneFile, scene))
+	{
+		return false;
+	}
+
+	const Camera camera = scene.CreateCamera(float(settings.width) / float(settings.height));
+
+	ThreadPool threadPool(options.threadCount != 0 ? options.threadCount : std::thread::hardware_concurrency(), ThreadPool::WaitPolicy::LowLatency, options.pinThreads);
+
+	std::vector<float> values;
+	size_t tilesRendered = 0;
+
+	while (SendMessage(socket, MessageType::RequestTile, nullptr, 0))
+	{
+		if (!ReceiveMessage(socket, sizeof(LeaseMessage), type, payload))
+		{
+			break;
+		}
+
+		if (type == MessageType::Done)
+		{
+			return true;
+		}
+
+		LeaseMessage lease;
+		if (type != MessageType::Lease || !ReadPayload(payload, lease) || lease.x + lease.width > settings.width || lease.y + lease.height > settings.height)
+		{
+			break;
+		}
+
+		if (options.failAfterTiles != 0 && tilesRendered == options.failAfterTiles)
+		{
+			std::cerr << "Worker abandoning tile " << lease.tileIndex << "\n";
+			return false;
+		}
+
+		RenderTile(lease, scene, camera, settings, job.seed, threadPool, values);
+
+		const std::vector<uint8_t> compressed = TileCompression::Compress(values);
+
+		std::vector<uint8_t> result(sizeof(TileResultHeader) + compressed.size());
+		const TileResultHeader resultHeader = { lease.tileIndex, static_cast<uint32_t>(values.size()) };
+		std::memcpy(result.data(), &resultHeader, sizeof(resultHeader));
+		std::copy(compressed.begin(), compressed.end(), result.begin() + sizeof(resultHeader));
+
+		if (!SendMessage(socket, MessageType::TileResult, result.data(), result.size()))
+		{
+			break;
+		}
+
+		tilesRendered++;
+	}
+
+	std::cerr << "Lost connection to coordinator\n";
+	return false;
+}
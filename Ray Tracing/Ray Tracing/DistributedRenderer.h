@@ -0,0 +1,15 @@
+#pragma once
+
+#include "CommandLine.h"
+
+//Renders a frame across several processes. The coordinator splits the image into tiles and leases
+//them one at a time to workers connected over TCP or Unix sockets. A lease that times out or whose
+//worker disconnects is reissued, and the first result returned for a tile is kept.
+namespace Distributed
+{
+	//Listens on options.address, optionally spawns local workers and writes the assembled image to options.outputPath
+	bool RunCoordinator(const RenderOptions& options);
+
+	//Connects to the coordinator at options.address and renders leased tiles until the frame is done
+	bool RunWorker(const RenderOptions& options);
+}
@@ -2,8 +2,10 @@
 
 #include "AABB.h"
 #include "Ray.h"
+#include "SceneFormat.h"
 
 class Material;
+class SceneCompiler;
 
 struct HitRecord
 {
@@ -14,6 +16,7 @@ struct HitRecord
 	Material* materialPtr;
 	Vector3 normal;
 	bool frontFace;
+	uint32_t light = SceneFormat::InvalidIndex; //Set by scenes with a light BVH when the hit emitter is one of its lights
 
 	inline void SetFaceNormal(const Ray& r, const Vector3& outward_normal) 
 	{
@@ -29,4 +32,13 @@ public:
 
 	virtual bool Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const = 0;
 	virtual bool BoundingBox(float t0, float t1, AABB& box) const = 0;
+
+	//Solid angle density of Random choosing direction from origin, zero for objects that can't be sampled
+	virtual float PdfValue(const Vector3& origin, const Vector3& direction) const { return 0.0f; }
+
+	//Direction from origin towards a random point on the object, used to sample emitters directly
+	virtual Vector3 Random(const Vector3& origin) const { return Vector3(1.0f, 0.0f, 0.0f); }
+
+	//Adds the object's primitives to a compiled scene, returns false if the object can't be compiled
+	virtual bool Compile(SceneCompiler& compiler) const { return false; }
 };
\ No newline at end of file
@@ -55,4 +55,19 @@ bool HittableList::BoundingBox(float t0, float t1, AABB& box) const
 			return false;
 		}
 	}
-}
\ No newline at end of file
+
+	return true;
+}
+
+bool HittableList::Compile(SceneCompiler& compiler) const
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		if (!list[i]->Compile(compiler))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
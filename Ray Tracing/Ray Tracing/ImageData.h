@@ -7,15 +7,20 @@
 #include <fstream>
 #include <iostream>
 #include <mutex>
+#include <vector>
 
-template<size_t width, size_t height>
 class ImageData
 {
 public:
+	ImageData(size_t width, size_t height)
+		: width(width), height(height), data(width * height, Vector3(0.0f, 0.0f, 0.0f)), totalPixelCount(width * height)
+	{
+	}
+
 	void Write(Vector3 item, size_t x, size_t y)
 	{
 		std::lock_guard<std::mutex> lockguard(mutex);
-		data[y][x] = item;
+		data[y * width + x] = item;
 		currentPixelsComplete++;
 		if (currentPixelsComplete % 10000 == 0)
 		{
@@ -26,7 +31,17 @@ public:
 	Vector3 Read(size_t x, size_t y)
 	{
 		std::lock_guard<std::mutex> lockguard(mutex);
-		return data[y][x];
+		return data[y * width + x];
+	}
+
+	size_t Width() const
+	{
+		return width;
+	}
+
+	size_t Height() const
+	{
+		return height;
 	}
 
 	void WriteImageDataToFile(std::filesystem::path filepath, size_t ns)
@@ -39,28 +54,27 @@ public:
 
 			file << "P3\n" << width << " " << height << "\n255\n";
 
-			for (const auto& row : data)
+			for (Vector3 colour : data)
 			{
-				for (Vector3 colour : row)
-				{
-					//Gamma correction
-					colour /= static_cast<float>(ns);
+				//Gamma correction
+				colour /= static_cast<float>(ns);
 
-					colour = Vector3(std::sqrt(colour.x), std::sqrt(colour.y), std::sqrt(colour.z));
+				colour = Vector3(std::sqrt(colour.x), std::sqrt(colour.y), std::sqrt(colour.z));
 
-					int ir = static_cast<int>(255.99 * colour.x);
-					int ig = static_cast<int>(255.99 * colour.y);
-					int ib = static_cast<int>(255.99 * colour.z);
+				int ir = static_cast<int>(255.99 * colour.x);
+				int ig = static_cast<int>(255.99 * colour.y);
+				int ib = static_cast<int>(255.99 * colour.z);
 
-					file << ir << " " << ig << " " << ib << "\n";
-				}
+				file << ir << " " << ig << " " << ib << "\n";
 			}
 		}
 	}
 
 private:
-	std::array<std::array<Vector3, width>, height> data;
+	size_t width;
+	size_t height;
+	std::vector<Vector3> data;
 	std::mutex mutex;
-	size_t totalPixelCount = width * height;
+	size_t totalPixelCount;
 	size_t currentPixelsComplete = 0;
-};
\ No newline at end of file
+};
@@ -1,6 +1,8 @@
 #include "ImageTexture.h"
 
-ImageTexture::ImageTexture(unsigned char* pixels, int A, int B) 
+#include "SceneCompiler.h"
+
+ImageTexture::ImageTexture(const unsigned char* pixels, int A, int B) 
 	: data(pixels), nx(A), ny(B) {}
 
 Vector3 ImageTexture::Value(float u, float v, const Vector3& p) const
@@ -17,3 +19,12 @@ Vector3 ImageTexture::Value(float u, float v, const Vector3& p) const
 
 	return Vector3(r, g, b);
 }
+
+bool ImageTexture::Compile(SceneCompiler& compiler, SceneFormat::Texture& record) const
+{
+	record.type = SceneFormat::TextureType::Image;
+	record.width = nx;
+	record.height = ny;
+	record.dataOffset = compiler.AddData(data, static_cast<size_t>(nx) * ny * 3);
+	return true;
+}
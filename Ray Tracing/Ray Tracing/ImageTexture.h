@@ -11,12 +11,14 @@ class ImageTexture : public Texture
 {
 public:
 	ImageTexture() = default;
-	ImageTexture(unsigned char* pixels, int A, int B);
+	ImageTexture(const unsigned char* pixels, int A, int B);
 
 	Vector3 Value(float u, float v, const Vector3& p) const override;
 
+	bool Compile(SceneCompiler& compiler, SceneFormat::Texture& record) const override;
+
 private:
-	unsigned char* data;
+	const unsigned char* data;
 	int nx;
 	int ny;
 };
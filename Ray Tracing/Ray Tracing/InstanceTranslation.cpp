@@ -1,5 +1,7 @@
 #include "InstanceTranslation.h"
 
+#include "SceneCompiler.h"
+
 InstanceTranslation::InstanceTranslation(Hittable* pShape, const Vector3& pTranlation) 
 	: shape(pShape), translation(pTranlation) {}
 
@@ -23,4 +25,22 @@ bool InstanceTranslation::BoundingBox(float t0, float t1, AABB& box) const
 	box = AABB(box.Min() + translation, box.Max() + translation);
 
 	return true;
-}
\ No newline at end of file
+}
+
+bool InstanceTranslation::Compile(SceneCompiler& compiler) const
+{
+	SceneFormat::Primitive primitive = {};
+	primitive.type = SceneFormat::PrimitiveType::Translation;
+	primitive.material = SceneFormat::InvalidIndex;
+	if (!compiler.AddSubtree(*shape, primitive.child))
+	{
+		return false;
+	}
+
+	primitive.data[0] = translation.x;
+	primitive.data[1] = translation.y;
+	primitive.data[2] = translation.z;
+
+	compiler.AddPrimitive(*this, primitive);
+	return true;
+}
@@ -11,6 +11,7 @@ public:
 
 	bool Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const override;
 	bool BoundingBox(float t0, float t1, AABB& box) const override;
+	bool Compile(SceneCompiler& compiler) const override;
 
 private:
 	Hittable* shape;
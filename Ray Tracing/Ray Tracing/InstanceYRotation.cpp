@@ -1,5 +1,7 @@
 #include "InstanceYRotation.h"
 
+#include "SceneCompiler.h"
+
 InstanceYRotation::InstanceYRotation(Hittable* pShape, float angle) : shape(pShape)
 {
 	float radians = Util::DegreesToRadians(angle);
@@ -33,6 +35,11 @@ InstanceYRotation::InstanceYRotation(Hittable* pShape, float angle) : shape(pSha
 	bbox = AABB(min, max);
 }
 
+InstanceYRotation::InstanceYRotation(Hittable* pShape, float sinTheta, float cosTheta, const AABB& box)
+	: shape(pShape), sinTheta(sinTheta), cosTheta(cosTheta), hasbox(true), bbox(box)
+{
+}
+
 bool InstanceYRotation::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
 {
 	Vector3 origin = r.Origin();
@@ -69,3 +76,25 @@ bool InstanceYRotation::BoundingBox(float t0, float t1, AABB& box) const
 	box = bbox;
 	return hasbox;
 }
+
+bool InstanceYRotation::Compile(SceneCompiler& compiler) const
+{
+	SceneFormat::Primitive primitive = {};
+	primitive.type = SceneFormat::PrimitiveType::YRotation;
+	primitive.material = SceneFormat::InvalidIndex;
+	if (!hasbox || !compiler.AddSubtree(*shape, primitive.child))
+	{
+		return false;
+	}
+
+	primitive.data[0] = sinTheta;
+	primitive.data[1] = cosTheta;
+	for (int i = 0; i < 3; i++)
+	{
+		primitive.data[2 + i] = bbox.Min()[i];
+		primitive.data[5 + i] = bbox.Max()[i];
+	}
+
+	compiler.AddPrimitive(*this, primitive);
+	return true;
+}
@@ -10,8 +10,12 @@ class InstanceYRotation : public Hittable
 public:
 	InstanceYRotation(Hittable* pShape, float angle);
 
+	//Takes an already rotated bounding box, used by compiled scenes
+	InstanceYRotation(Hittable* pShape, float sinTheta, float cosTheta, const AABB& box);
+
 	bool Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const override;
 	bool BoundingBox(float t0, float t1, AABB& box) const override;
+	bool Compile(SceneCompiler& compiler) const override;
 
 private:
 	Hittable* shape;
@@ -1,9 +1,69 @@
 #include "Lambertian.h"
 
+#include "Microfacet.h"
+#include "SceneCompiler.h"
+
+#include <algorithm>
+#include <cmath>
+
 bool Lambertian::Scatter(const Ray& r_in, const HitRecord& hitRecord, Vector3& attenuation, Ray& scattered) const
 {
-	Vector3 target = hitRecord.p + hitRecord.normal + Util::RandomInUnitSphere();
-	scattered = Ray(hitRecord.p, target - hitRecord.p, r_in.GetTime());
+	//A point on the unit sphere rather than in it gives directions distributed exactly as cos/pi,
+	//which is what direct light sampling assumes the indirect bounces use
+	Vector3 direction = hitRecord.normal + Util::RandomUnitVector();
+	if (direction.SquaredLength() < 1e-12f)
+	{
+		direction = hitRecord.normal;
+	}
+	scattered = Ray(hitRecord.p, direction, r_in.GetTime());
 	attenuation = albedo->Value(hitRecord.u, hitRecord.v, hitRecord.p);
 	return true;
 }
+
+bool Lambertian::Sample(const Ray& r_in, const HitRecord& hitRecord, BsdfSample& sample) const
+{
+	//Uniform on the unit disk projected up onto the hemisphere
+	const float r = std::sqrt(Util::RandomFloat());
+	const float phi = 2.0f * Util::R_PI * Util::RandomFloat();
+	const float x = r * std::cos(phi);
+	const float y = r * std::sin(phi);
+	const float z = std::sqrt(std::max(0.0f, 1.0f - x * x - y * y));
+
+	sample.direction = Microfacet::Frame(hitRecord.normal).ToWorld(Vector3(x, y, z));
+	sample.pdf = z / Util::R_PI;
+	sample.weight = albedo->Value(hitRecord.u, hitRecord.v, hitRecord.p);
+	sample.specular = false;
+	return sample.pdf > 0.0f;
+}
+
+Vector3 Lambertian::Eval(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const
+{
+	const float cosine = DotProduct(GetNormalized(direction), hitRecord.normal);
+	if (!(cosine > 0.0f))
+	{
+		return Vector3(0.0f, 0.0f, 0.0f);
+	}
+
+	return albedo->Value(hitRecord.u, hitRecord.v, hitRecord.p) * (cosine / Util::R_PI);
+}
+
+float Lambertian::Pdf(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const
+{
+	return std::max(0.0f, DotProduct(GetNormalized(direction), hitRecord.normal)) / Util::R_PI;
+}
+
+bool Lambertian::IsDiffuse() const
+{
+	return true;
+}
+
+bool Lambertian::SamplesLights() const
+{
+	return true;
+}
+
+bool Lambertian::Compile(SceneCompiler& compiler, SceneFormat::Material& record) const
+{
+	record.type = SceneFormat::MaterialType::Lambertian;
+	return compiler.AddTexture(albedo, record.texture);
+}
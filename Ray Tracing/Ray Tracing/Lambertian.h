@@ -12,6 +12,16 @@ public:
 
 	bool Scatter(const Ray& r_in, const HitRecord& hitRecord, Vector3& attenuation, Ray& scattered) const override;
 
+	//Cosine weighted hemisphere sampling, which makes the sample weight the albedo
+	bool Sample(const Ray& r_in, const HitRecord& hitRecord, BsdfSample& sample) const override;
+	Vector3 Eval(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const override;
+	float Pdf(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const override;
+
+	bool IsDiffuse() const override;
+	bool SamplesLights() const override;
+
+	bool Compile(SceneCompiler& compiler, SceneFormat::Material& record) const override;
+
 private:
 	Texture* albedo;
 };
\ No newline at end of file
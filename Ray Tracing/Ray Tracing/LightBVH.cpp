@@ -0,0 +1,264 @@
+#include "LightBVH.h"
+
+#include "CompiledScene.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	//Largest float below one, keeps rescaled random numbers inside [0, 1)
+	constexpr float OneMinusEpsilon = 0.99999994f;
+
+	float SafeSqrt(float value)
+	{
+		return std::sqrt(std::max(0.0f, value));
+	}
+
+	float SafeAcos(float value)
+	{
+		return std::acos(std::clamp(value, -1.0f, 1.0f));
+	}
+
+	//cos(max(0, a - b)) and sin(max(0, a - b)) from the sines and cosines of a and b
+	float CosSubClamped(float sinA, float cosA, float sinB, float cosB)
+	{
+		return cosA > cosB ? 1.0f : cosA * cosB + sinA * sinB;
+	}
+
+	float SinSubClamped(float sinA, float cosA, float sinB, float cosB)
+	{
+		return cosA > cosB ? 0.0f : sinA * cosB - cosA * sinB;
+	}
+
+	//Rodrigues' rotation of v by angle around the unit vector k
+	Vector3 Rotate(const Vector3& v, const Vector3& k, float angle)
+	{
+		const float cosAngle = std::cos(angle);
+		const float sinAngle = std::sin(angle);
+		return v * cosAngle + CrossProduct(k, v) * sinAngle + k * (DotProduct(k, v) * (1.0f - cosAngle));
+	}
+}
+
+float LightBounds::Importance(const Vector3& p, const Vector3& n) const
+{
+	const Vector3 center = 0.5f * (bounds.Min() + bounds.Max());
+	const float radius = 0.5f * (bounds.Max() - bounds.Min()).Length();
+
+	//Clamp the distance so points inside or next to the bounds don't get an unbounded estimate
+	const Vector3 toPoint = p - center;
+	const float distanceSquared = toPoint.SquaredLength();
+	const float clampedDistanceSquared = std::max(distanceSquared, radius);
+
+	const Vector3 wi = distanceSquared > 0.0f ? toPoint / std::sqrt(distanceSquared) : axis;
+
+	float cosThetaW = DotProduct(axis, wi);
+	if (twoSided)
+	{
+		cosThetaW = std::abs(cosThetaW);
+	}
+	const float sinThetaW = SafeSqrt(1.0f - cosThetaW * cosThetaW);
+
+	//Half angle of the cone from p that contains the bounds, everything if p is inside them
+	float cosThetaB = -1.0f;
+	if (distanceSquared > radius * radius)
+	{
+		cosThetaB = SafeSqrt(1.0f - radius * radius / distanceSquared);
+	}
+	const float sinThetaB = SafeSqrt(1.0f - cosThetaB * cosThetaB);
+
+	//Smallest angle between p and any emitting direction, widened by the normal cone and the bounds
+	const float sinThetaO = SafeSqrt(1.0f - cosThetaO * cosThetaO);
+	const float cosThetaX = CosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+	const float sinThetaX = SinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+	const float cosThetaP = CosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+	if (cosThetaP <= cosThetaE)
+	{
+		return 0.0f;
+	}
+
+	float importance = power * cosThetaP / clampedDistanceSquared;
+
+	//Lambert's cosine at the receiver, bounded the same way
+	if (n.SquaredLength() > 0.0f)
+	{
+		const float cosThetaI = std::abs(DotProduct(wi, n));
+		const float sinThetaI = SafeSqrt(1.0f - cosThetaI * cosThetaI);
+		importance *= CosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+	}
+
+	return std::max(importance, 0.0f);
+}
+
+LightBounds LightBounds::Union(const LightBounds& a, const LightBounds& b)
+{
+	if (a.power <= 0.0f)
+	{
+		return b;
+	}
+	if (b.power <= 0.0f)
+	{
+		return a;
+	}
+
+	LightBounds result;
+	result.bounds = AABB::SurroundingBox(a.bounds, b.bounds);
+	result.power = a.power + b.power;
+	result.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+	result.twoSided = a.twoSided || b.twoSided;
+
+	//Smallest cone containing both normal cones
+	const float thetaA = SafeAcos(a.cosThetaO);
+	const float thetaB = SafeAcos(b.cosThetaO);
+	const float thetaD = SafeAcos(DotProduct(a.axis, b.axis));
+
+	if (std::min(thetaD + thetaB, Util::R_PI) <= thetaA)
+	{
+		result.axis = a.axis;
+		result.cosThetaO = a.cosThetaO;
+		return result;
+	}
+
+	if (std::min(thetaD + thetaA, Util::R_PI) <= thetaB)
+	{
+		result.axis = b.axis;
+		result.cosThetaO = b.cosThetaO;
+		return result;
+	}
+
+	const float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+	const Vector3 rotationAxis = CrossProduct(a.axis, b.axis);
+	if (thetaO >= Util::R_PI || rotationAxis.SquaredLength() == 0.0f)
+	{
+		result.axis = a.axis;
+		result.cosThetaO = -1.0f;
+		return result;
+	}
+
+	result.axis = GetNormalized(Rotate(a.axis, GetNormalized(rotationAxis), thetaO - thetaA));
+	result.cosThetaO = std::cos(thetaO);
+	return result;
+}
+
+LightBVH::LightBVH(const CompiledScene* scene, const SceneFormat::LightNode* nodes, size_t nodeCount, const SceneFormat::Light* lights, size_t lightCount)
+	: scene(scene), nodes(nodes), nodeCount(nodeCount), lights(lights), lightCount(lightCount)
+{
+}
+
+bool LightBVH::Empty() const
+{
+	return nodeCount == 0;
+}
+
+size_t LightBVH::LightCount() const
+{
+	return lightCount;
+}
+
+bool LightBVH::Sample(const Vector3& p, const Vector3& n, float u, uint32_t& light, float& pmf) const
+{
+	if (Empty())
+	{
+		return false;
+	}
+
+	uint32_t nodeIndex = 0;
+	pmf = 1.0f;
+
+	while (!nodes[nodeIndex].leaf)
+	{
+		const uint32_t left = nodeIndex + 1;
+		const uint32_t right = nodes[nodeIndex].rightOrLight;
+		const float leftImportance = Importance(left, p, n);
+		const float rightImportance = Importance(right, p, n);
+
+		if (leftImportance <= 0.0f && rightImportance <= 0.0f)
+		{
+			return false;
+		}
+
+		//Reuse u for every level by rescaling the part of it that picked the child
+		const float leftProbability = leftImportance / (leftImportance + rightImportance);
+		if (u < leftProbability)
+		{
+			u = std::min(u / leftProbability, OneMinusEpsilon);
+			pmf *= leftProbability;
+			nodeIndex = left;
+		}
+		else
+		{
+			u = std::min((u - leftProbability) / (1.0f - leftProbability), OneMinusEpsilon);
+			pmf *= 1.0f - leftProbability;
+			nodeIndex = right;
+		}
+	}
+
+	if (Importance(nodeIndex, p, n) <= 0.0f)
+	{
+		return false;
+	}
+
+	light = nodes[nodeIndex].rightOrLight;
+	return true;
+}
+
+float LightBVH::Pmf(const Vector3& p, const Vector3& n, uint32_t light) const
+{
+	if (light >= lightCount)
+	{
+		return 0.0f;
+	}
+
+	uint64_t trail = lights[light].trail;
+	uint32_t nodeIndex = 0;
+	float pmf = 1.0f;
+
+	while (!nodes[nodeIndex].leaf)
+	{
+		const uint32_t left = nodeIndex + 1;
+		const uint32_t right = nodes[nodeIndex].rightOrLight;
+		const float leftImportance = Importance(left, p, n);
+		const float rightImportance = Importance(right, p, n);
+
+		const bool goRight = (trail & 1) != 0;
+		const float chosen = goRight ? rightImportance : leftImportance;
+		if (chosen <= 0.0f)
+		{
+			return 0.0f;
+		}
+
+		pmf *= chosen / (leftImportance + rightImportance);
+		nodeIndex = goRight ? right : left;
+		trail >>= 1;
+	}
+
+	return pmf;
+}
+
+Vector3 LightBVH::SampleDirection(uint32_t light, const Vector3& origin) const
+{
+	return scene->PrimitiveRandom(lights[light].primitive, origin);
+}
+
+float LightBVH::DirectionPdf(uint32_t light, const Vector3& origin, const Vector3& direction) const
+{
+	return scene->PrimitivePdfValue(lights[light].primitive, origin, direction);
+}
+
+LightBounds LightBVH::LoadBounds(const SceneFormat::LightNode& node)
+{
+	LightBounds bounds;
+	bounds.bounds = AABB(Vector3::Load(node.minimum), Vector3::Load(node.maximum));
+	bounds.power = node.power;
+	bounds.axis = Vector3::Load(node.axis);
+	bounds.cosThetaO = node.cosThetaO;
+	bounds.cosThetaE = node.cosThetaE;
+	bounds.twoSided = node.twoSided != 0;
+	return bounds;
+}
+
+float LightBVH::Importance(uint32_t node, const Vector3& p, const Vector3& n) const
+{
+	return LoadBounds(nodes[node]).Importance(p, n);
+}
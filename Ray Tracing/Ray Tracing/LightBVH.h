@@ -0,0 +1,60 @@
+#pragma once
+
+#include "AABB.h"
+#include "SceneFormat.h"
+#include "Vector3.h"
+
+#include <cstdint>
+
+class CompiledScene;
+
+//Bounds on where a group of lights is, how much they emit and in which directions
+struct LightBounds
+{
+	AABB bounds;
+	float power = 0.0f;
+	Vector3 axis = Vector3(0.0f, 0.0f, 1.0f);
+	float cosThetaO = 1.0f; //Normals lie within acos(cosThetaO) of axis
+	float cosThetaE = 0.0f; //Each normal emits within acos(cosThetaE) of itself
+	bool twoSided = false;
+
+	//Conservative estimate of the light reaching point p on a surface with normal n,
+	//pass a zero normal for points that aren't on a surface
+	float Importance(const Vector3& p, const Vector3& n) const;
+
+	static LightBounds Union(const LightBounds& a, const LightBounds& b);
+};
+
+//Stochastic light selection over the light nodes of a compiled scene. Each step down the tree picks a child
+//with probability proportional to its importance at the shading point, so bright nearby lights facing the
+//point are chosen far more often than the thousands of others.
+class LightBVH
+{
+public:
+	LightBVH() = default;
+	LightBVH(const CompiledScene* scene, const SceneFormat::LightNode* nodes, size_t nodeCount, const SceneFormat::Light* lights, size_t lightCount);
+
+	bool Empty() const;
+	size_t LightCount() const;
+
+	//u is a uniform random number, returns false if no light can reach p
+	bool Sample(const Vector3& p, const Vector3& n, float u, uint32_t& light, float& pmf) const;
+
+	//Probability that Sample picks light for the same shading point
+	float Pmf(const Vector3& p, const Vector3& n, uint32_t light) const;
+
+	//Direction from origin to a random point on the light, and the solid angle density of choosing it
+	Vector3 SampleDirection(uint32_t light, const Vector3& origin) const;
+	float DirectionPdf(uint32_t light, const Vector3& origin, const Vector3& direction) const;
+
+	static LightBounds LoadBounds(const SceneFormat::LightNode& node);
+
+private:
+	float Importance(uint32_t node, const Vector3& p, const Vector3& n) const;
+
+	const CompiledScene* scene = nullptr;
+	const SceneFormat::LightNode* nodes = nullptr;
+	size_t nodeCount = 0;
+	const SceneFormat::Light* lights = nullptr;
+	size_t lightCount = 0;
+};
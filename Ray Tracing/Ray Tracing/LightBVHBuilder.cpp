@@ -0,0 +1,178 @@
+#include "LightBVHBuilder.h"
+
+#include "Util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	constexpr int BinCount = 12;
+
+	AABB EmptyBox()
+	{
+		const float max = std::numeric_limits<float>::max();
+		return AABB(Vector3(max, max, max), Vector3(-max, -max, -max));
+	}
+
+	AABB Grow(const AABB& box, const Vector3& point)
+	{
+		return AABB::SurroundingBox(box, AABB(point, point));
+	}
+
+	float SurfaceArea(const AABB& box)
+	{
+		const Vector3 extent = box.Max() - box.Min();
+		return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	//Power weighted by the solid angle measure of the directions the lights emit into,
+	//scaled by the box's area and penalised when the box is thin along the split axis
+	float Cost(const LightBounds& light, const AABB& parentBounds, int axis)
+	{
+		const float thetaO = std::acos(std::clamp(light.cosThetaO, -1.0f, 1.0f));
+		const float thetaE = std::acos(std::clamp(light.cosThetaE, -1.0f, 1.0f));
+		const float thetaW = std::min(thetaO + thetaE, Util::R_PI);
+		const float sinThetaO = std::sqrt(std::max(0.0f, 1.0f - light.cosThetaO * light.cosThetaO));
+
+		const float orientationMeasure = 2.0f * Util::R_PI * (1.0f - light.cosThetaO) +
+			0.5f * Util::R_PI * (2.0f * thetaW * sinThetaO - std::cos(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinThetaO + light.cosThetaO);
+
+		const Vector3 extent = parentBounds.Max() - parentBounds.Min();
+		const float regularity = std::max(extent.x, std::max(extent.y, extent.z)) / extent.v[axis];
+
+		return light.power * orientationMeasure * regularity * SurfaceArea(light.bounds);
+	}
+}
+
+void LightBVHBuilder::Build(const std::vector<LightBounds>& lights, std::vector<Node>& nodes, std::vector<uint64_t>& trails) const
+{
+	nodes.clear();
+	trails.assign(lights.size(), 0);
+
+	if (lights.empty())
+	{
+		return;
+	}
+
+	std::vector<BuildLight> buildLights(lights.size());
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		buildLights[i].bounds = lights[i];
+		buildLights[i].centroid = 0.5f * (lights[i].bounds.Min() + lights[i].bounds.Max());
+		buildLights[i].index = static_cast<uint32_t>(i);
+	}
+
+	nodes.reserve(2 * lights.size());
+	BuildRecursive(buildLights, 0, buildLights.size(), 0, 0, nodes, trails);
+}
+
+size_t LightBVHBuilder::BuildRecursive(std::vector<BuildLight>& lights, size_t begin, size_t end, size_t depth, uint64_t trail, std::vector<Node>& nodes, std::vector<uint64_t>& trails) const
+{
+	LightBounds bounds;
+	AABB centroidBounds = EmptyBox();
+	for (size_t i = begin; i < end; i++)
+	{
+		bounds = LightBounds::Union(bounds, lights[i].bounds);
+		centroidBounds = Grow(centroidBounds, lights[i].centroid);
+	}
+
+	const size_t nodeIndex = nodes.size();
+	nodes.emplace_back();
+	nodes[nodeIndex].bounds = bounds;
+
+	const size_t count = end - begin;
+	if (count == 1)
+	{
+		nodes[nodeIndex].leaf = true;
+		nodes[nodeIndex].rightOrLight = lights[begin].index;
+		trails[lights[begin].index] = trail;
+		return nodeIndex;
+	}
+
+	int axis = 0;
+	float position = 0.0f;
+	size_t middle = begin;
+
+	//Median splits below this depth halve the count each level, which keeps every trail within MaxDepth bits
+	if (depth < MaxDepth / 2 && FindSplit(lights, begin, end, bounds.bounds, centroidBounds, axis, position))
+	{
+		middle = std::partition(lights.begin() + begin, lights.begin() + end, [axis, position](const BuildLight& light)
+			{
+				return light.centroid.v[axis] < position;
+			}) - lights.begin();
+	}
+
+	if (middle == begin || middle == end)
+	{
+		const Vector3 extent = centroidBounds.Max() - centroidBounds.Min();
+		axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		middle = begin + count / 2;
+		std::nth_element(lights.begin() + begin, lights.begin() + middle, lights.begin() + end, [axis](const BuildLight& a, const BuildLight& b)
+			{
+				return a.centroid.v[axis] < b.centroid.v[axis];
+			});
+	}
+
+	BuildRecursive(lights, begin, middle, depth + 1, trail, nodes, trails);
+	const size_t right = BuildRecursive(lights, middle, end, depth + 1, trail | (uint64_t(1) << depth), nodes, trails);
+	nodes[nodeIndex].rightOrLight = static_cast<uint32_t>(right);
+
+	return nodeIndex;
+}
+
+bool LightBVHBuilder::FindSplit(const std::vector<BuildLight>& lights, size_t begin, size_t end, const AABB& bounds, const AABB& centroidBounds, int& axis, float& position) const
+{
+	float bestCost = std::numeric_limits<float>::max();
+	bool found = false;
+
+	for (int candidateAxis = 0; candidateAxis < 3; candidateAxis++)
+	{
+		const float minimum = centroidBounds.Min().v[candidateAxis];
+		const float extent = centroidBounds.Max().v[candidateAxis] - minimum;
+		if (!(extent > 0.0f))
+		{
+			continue;
+		}
+
+		LightBounds binBounds[BinCount];
+		const float scale = BinCount / extent;
+		for (size_t i = begin; i < end; i++)
+		{
+			const int bin = std::min(BinCount - 1, static_cast<int>((lights[i].centroid.v[candidateAxis] - minimum) * scale));
+			binBounds[bin] = LightBounds::Union(binBounds[bin], lights[i].bounds);
+		}
+
+		//Sweep from the right to get the bounds of everything right of each plane
+		LightBounds rightBounds[BinCount - 1];
+		LightBounds rightSide;
+		for (int plane = BinCount - 1; plane > 0; plane--)
+		{
+			rightSide = LightBounds::Union(rightSide, binBounds[plane]);
+			rightBounds[plane - 1] = rightSide;
+		}
+
+		LightBounds leftSide;
+		for (int plane = 0; plane < BinCount - 1; plane++)
+		{
+			leftSide = LightBounds::Union(leftSide, binBounds[plane]);
+
+			if (leftSide.power <= 0.0f || rightBounds[plane].power <= 0.0f)
+			{
+				continue;
+			}
+
+			const float cost = Cost(leftSide, bounds, candidateAxis) + Cost(rightBounds[plane], bounds, candidateAxis);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				axis = candidateAxis;
+				position = minimum + extent * static_cast<float>(plane + 1) / BinCount;
+				found = true;
+			}
+		}
+	}
+
+	return found;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "LightBVH.h"
+
+#include <cstdint>
+#include <vector>
+
+//Builds a light BVH with one light per leaf, splitting with the surface area orientation heuristic so that
+//lights close together and facing the same way share subtrees. Nodes are emitted depth first like BVHBuilder.
+class LightBVHBuilder
+{
+public:
+	struct Node
+	{
+		LightBounds bounds;
+		uint32_t rightOrLight = 0; //Right child of an interior node or the index of the leaf's light
+		bool leaf = false;
+	};
+
+	//Each level of the tree is one bit of a light's trail
+	static constexpr size_t MaxDepth = 64;
+
+	//trails receives, for every light, the branches taken from the root to its leaf with bit i set for a right turn at depth i
+	void Build(const std::vector<LightBounds>& lights, std::vector<Node>& nodes, std::vector<uint64_t>& trails) const;
+
+private:
+	struct BuildLight
+	{
+		LightBounds bounds;
+		Vector3 centroid;
+		uint32_t index;
+	};
+
+	size_t BuildRecursive(std::vector<BuildLight>& lights, size_t begin, size_t end, size_t depth, uint64_t trail, std::vector<Node>& nodes, std::vector<uint64_t>& trails) const;
+
+	//Returns false if no split plane separates the lights
+	bool FindSplit(const std::vector<BuildLight>& lights, size_t begin, size_t end, const AABB& bounds, const AABB& centroidBounds, int& axis, float& position) const;
+};
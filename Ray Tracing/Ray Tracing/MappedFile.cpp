@@ -0,0 +1,163 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		std::swap(data, other.data);
+		std::swap(size, other.size);
+#ifdef _WIN32
+		std::swap(file, other.file);
+		std::swap(mapping, other.mapping);
+#endif
+	}
+	return *this;
+}
+
+bool MappedFile::Open(const std::filesystem::path& path)
+{
+	Close();
+
+#ifdef _WIN32
+	file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		file = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	const int descriptor = open(path.c_str(), O_RDONLY);
+	if (descriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size == 0)
+	{
+		close(descriptor);
+		return false;
+	}
+
+	void* mapped = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+	close(descriptor);
+
+	if (mapped == MAP_FAILED)
+	{
+		return false;
+	}
+
+	data = static_cast<const uint8_t*>(mapped);
+	size = static_cast<size_t>(status.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (data != nullptr)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mapping != nullptr)
+	{
+		CloseHandle(mapping);
+	}
+	if (file != nullptr)
+	{
+		CloseHandle(file);
+	}
+	file = nullptr;
+	mapping = nullptr;
+#else
+	if (data != nullptr)
+	{
+		munmap(const_cast<uint8_t*>(data), size);
+	}
+#endif
+
+	data = nullptr;
+	size = 0;
+}
+
+const uint8_t* MappedFile::Data() const
+{
+	return data;
+}
+
+size_t MappedFile::Size() const
+{
+	return size;
+}
+
+void MappedFile::Prefetch(size_t offset, size_t length) const
+{
+#ifdef _WIN32
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast<uint8_t*>(data + offset);
+	range.NumberOfBytes = length;
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	madvise(const_cast<uint8_t*>(data + offset), length, MADV_WILLNEED);
+#endif
+}
+
+void MappedFile::Release(size_t offset, size_t length) const
+{
+#ifdef _WIN32
+	//Unlocking pages that were never locked still removes them from the working set
+	VirtualUnlock(const_cast<uint8_t*>(data + offset), length);
+#else
+	madvise(const_cast<uint8_t*>(data + offset), length, MADV_DONTNEED);
+#endif
+}
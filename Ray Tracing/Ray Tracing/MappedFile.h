@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+//Read only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::filesystem::path& path);
+	void Close();
+
+	const uint8_t* Data() const;
+	size_t Size() const;
+
+	//Hints for a page aligned range: Prefetch starts reading it in, Release drops its pages from memory.
+	//Released pages are read back from the file if they are touched again.
+	void Prefetch(size_t offset, size_t length) const;
+	void Release(size_t offset, size_t length) const;
+
+private:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+};
@@ -4,3 +4,42 @@ Vector3 Material::Emitted(float u, float v, const Vector3& p) const
 {
 	return Vector3(0.0f, 0.0f, 0.0f);
 }
+
+bool Material::Sample(const Ray& r_in, const HitRecord& hitRecord, BsdfSample& sample) const
+{
+	Ray scattered;
+	if (!Scatter(r_in, hitRecord, sample.weight, scattered))
+	{
+		return false;
+	}
+
+	sample.direction = scattered.Direction();
+	sample.pdf = 0.0f;
+	sample.specular = true;
+	return true;
+}
+
+Vector3 Material::Eval(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const
+{
+	return Vector3(0.0f, 0.0f, 0.0f);
+}
+
+float Material::Pdf(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const
+{
+	return 0.0f;
+}
+
+bool Material::IsDiffuse() const
+{
+	return false;
+}
+
+bool Material::SamplesLights() const
+{
+	return false;
+}
+
+bool Material::Compile(SceneCompiler& compiler, SceneFormat::Material& record) const
+{
+	return false;
+}
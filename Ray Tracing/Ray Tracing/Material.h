@@ -2,12 +2,43 @@
 
 #include "Hittable.h"
 #include "Ray.h"
+#include "SceneFormat.h"
+
+class SceneCompiler;
+
+//A direction chosen by Material::Sample
+struct BsdfSample
+{
+	Vector3 direction;
+	Vector3 weight; //Eval over pdf, what the path's throughput is multiplied by
+	float pdf = 0.0f; //Solid angle density of direction, zero for specular samples
+	bool specular = false; //Chosen from a delta lobe that Eval and Pdf can't see
+};
 
 class Material
 {
 public:
 	virtual ~Material() = default;
 
+	//The original sampling of each material, kept for the legacy look
 	virtual bool Scatter(const Ray& r_in, const HitRecord& hitRecord, Vector3& attenuation, Ray& scattered) const = 0;
 	virtual Vector3 Emitted(float u, float v, const Vector3& p) const;
-};
\ No newline at end of file
+
+	//Importance samples the BSDF for light arriving at the hit, returns false if the path ends here.
+	//Materials without their own sampling fall back to Scatter and report it as specular.
+	virtual bool Sample(const Ray& r_in, const HitRecord& hitRecord, BsdfSample& sample) const;
+
+	//BSDF times the cosine at direction, and the density Sample has of choosing direction. Specular lobes aren't included.
+	virtual Vector3 Eval(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const;
+	virtual float Pdf(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const;
+
+	//Diffuse materials have their direct light sampled through the scene's lights, Scatter's attenuation is then their albedo
+	virtual bool IsDiffuse() const;
+
+	//Materials that only reflect and have no specular lobe have their direct light sampled through the scene's lights
+	//when rendering with Sample, weighted against Sample's own directions with multiple importance sampling
+	virtual bool SamplesLights() const;
+
+	//Fills in the material's compiled record, returns false if the material can't be compiled
+	virtual bool Compile(SceneCompiler& compiler, SceneFormat::Material& record) const;
+};
@@ -1,6 +1,9 @@
 #include "Metal.h"
 
-Metal::Metal(const Vector3& a, float f) : albedo(a), fuzz(std::clamp(f, 0.0f, 1.0f))
+#include "Microfacet.h"
+#include "SceneCompiler.h"
+
+Metal::Metal(const Vector3& a, float f) : albedo(a), fuzz(std::clamp(f, 0.0f, 1.0f)), alpha(fuzz * fuzz)
 {
 }
 
@@ -10,4 +13,83 @@ bool Metal::Scatter(const Ray& r_in, const HitRecord& hitRecord, Vector3& attenu
 	scattered = Ray(hitRecord.p, reflected, 0.0f);
 	attenuation = albedo;
 	return DotProduct(scattered.Direction(), hitRecord.normal) > 0.0f;
-}
\ No newline at end of file
+}
+
+bool Metal::Sample(const Ray& r_in, const HitRecord& hitRecord, BsdfSample& sample) const
+{
+	const Microfacet::Frame frame(hitRecord.normal);
+	const Vector3 wo = frame.ToLocal(-GetNormalized(r_in.Direction()));
+	if (!(wo.z > 0.0f))
+	{
+		return false;
+	}
+
+	if (alpha < Microfacet::SmoothAlpha)
+	{
+		sample.direction = frame.ToWorld(Vector3(-wo.x, -wo.y, wo.z));
+		sample.weight = Microfacet::FresnelSchlick(wo.z, albedo);
+		sample.pdf = 0.0f;
+		sample.specular = true;
+		return true;
+	}
+
+	const float u1 = Util::RandomFloat();
+	const float u2 = Util::RandomFloat();
+	const Vector3 m = Microfacet::SampleVisibleNormal(wo, alpha, u1, u2);
+	const Vector3 wi = Microfacet::Reflect(wo, m);
+	if (!(wi.z > 0.0f))
+	{
+		return false;
+	}
+
+	//D and the visible normal density's G1(wo) cancel, leaving Fresnel and the shadowing of wi
+	sample.direction = frame.ToWorld(wi);
+	sample.weight = Microfacet::FresnelSchlick(DotProduct(wo, m), albedo) * (Microfacet::G(wo, wi, alpha) / Microfacet::G1(wo, alpha));
+	sample.pdf = Microfacet::VisibleNormalPdf(wo, m, alpha) / (4.0f * DotProduct(wo, m));
+	sample.specular = false;
+	return sample.pdf > 0.0f;
+}
+
+Vector3 Metal::Eval(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const
+{
+	const Microfacet::Frame frame(hitRecord.normal);
+	const Vector3 wo = frame.ToLocal(-GetNormalized(r_in.Direction()));
+	const Vector3 wi = frame.ToLocal(GetNormalized(direction));
+	if (alpha < Microfacet::SmoothAlpha || !(wo.z > 0.0f) || !(wi.z > 0.0f))
+	{
+		return Vector3(0.0f, 0.0f, 0.0f);
+	}
+
+	//The cosine of wi cancels the one in the BSDF's denominator
+	const Vector3 m = GetNormalized(wo + wi);
+	return Microfacet::FresnelSchlick(DotProduct(wo, m), albedo) * (Microfacet::D(m, alpha) * Microfacet::G(wo, wi, alpha) / (4.0f * wo.z));
+}
+
+float Metal::Pdf(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const
+{
+	const Microfacet::Frame frame(hitRecord.normal);
+	const Vector3 wo = frame.ToLocal(-GetNormalized(r_in.Direction()));
+	const Vector3 wi = frame.ToLocal(GetNormalized(direction));
+	if (alpha < Microfacet::SmoothAlpha || !(wo.z > 0.0f) || !(wi.z > 0.0f))
+	{
+		return 0.0f;
+	}
+
+	const Vector3 m = GetNormalized(wo + wi);
+	return Microfacet::VisibleNormalPdf(wo, m, alpha) / (4.0f * DotProduct(wo, m));
+}
+
+bool Metal::SamplesLights() const
+{
+	return alpha >= Microfacet::SmoothAlpha;
+}
+
+bool Metal::Compile(SceneCompiler& compiler, SceneFormat::Material& record) const
+{
+	record.type = SceneFormat::MaterialType::Metal;
+	record.data[0] = albedo.x;
+	record.data[1] = albedo.y;
+	record.data[2] = albedo.z;
+	record.data[3] = fuzz;
+	return true;
+}
@@ -10,7 +10,18 @@ public:
 
 	bool Scatter(const Ray& r_in, const HitRecord& hitRecord, Vector3& attenuation, Ray& scattered) const override;
 
+	//GGX conductor with roughness fuzz squared, sampled from the visible normals. Albedo is the reflectance at
+	//normal incidence. With no fuzz it is a perfect mirror.
+	bool Sample(const Ray& r_in, const HitRecord& hitRecord, BsdfSample& sample) const override;
+	Vector3 Eval(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const override;
+	float Pdf(const Ray& r_in, const HitRecord& hitRecord, const Vector3& direction) const override;
+
+	bool SamplesLights() const override;
+
+	bool Compile(SceneCompiler& compiler, SceneFormat::Material& record) const override;
+
 private:
 	Vector3 albedo;
 	float fuzz;
+	float alpha;
 };
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "Microfacet.h"
+
+#include "Util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	float Lambda(const Vector3& v, float alpha)
+	{
+		const float cosSquared = v.z * v.z;
+		if (!(cosSquared > 0.0f))
+		{
+			return std::numeric_limits<float>::infinity();
+		}
+
+		const float tanSquared = std::max(0.0f, 1.0f - cosSquared) / cosSquared;
+		return 0.5f * (std::sqrt(1.0f + alpha * alpha * tanSquared) - 1.0f);
+	}
+}
+
+Microfacet::Frame::Frame(const Vector3& normal)
+	: n(normal)
+{
+	//Duff et al. 2017, continuous everywhere except where the sign of z flips
+	const float sign = std::copysign(1.0f, normal.z);
+	const float a = -1.0f / (sign + normal.z);
+	const float b = normal.x * normal.y * a;
+	s = Vector3(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+	t = Vector3(b, sign + normal.y * normal.y * a, -normal.y);
+}
+
+Vector3 Microfacet::Frame::ToLocal(const Vector3& v) const
+{
+	return Vector3(DotProduct(v, s), DotProduct(v, t), DotProduct(v, n));
+}
+
+Vector3 Microfacet::Frame::ToWorld(const Vector3& v) const
+{
+	return v.x * s + v.y * t + v.z * n;
+}
+
+float Microfacet::D(const Vector3& m, float alpha)
+{
+	if (!(m.z > 0.0f))
+	{
+		return 0.0f;
+	}
+
+	const float alphaSquared = alpha * alpha;
+	const float denominator = m.z * m.z * (alphaSquared - 1.0f) + 1.0f;
+	return alphaSquared / (Util::R_PI * denominator * denominator);
+}
+
+float Microfacet::G1(const Vector3& v, float alpha)
+{
+	return 1.0f / (1.0f + Lambda(v, alpha));
+}
+
+float Microfacet::G(const Vector3& wo, const Vector3& wi, float alpha)
+{
+	return 1.0f / (1.0f + Lambda(wo, alpha) + Lambda(wi, alpha));
+}
+
+Vector3 Microfacet::SampleVisibleNormal(const Vector3& wo, float alpha, float u1, float u2)
+{
+	//Stretch the view so the distribution becomes a hemisphere, sample the projected disk it covers, then unstretch
+	const Vector3 stretched = GetNormalized(Vector3(alpha * wo.x, alpha * wo.y, wo.z));
+
+	const float lengthSquared = stretched.x * stretched.x + stretched.y * stretched.y;
+	const Vector3 t1 = lengthSquared > 0.0f ? Vector3(-stretched.y, stretched.x, 0.0f) / std::sqrt(lengthSquared) : Vector3(1.0f, 0.0f, 0.0f);
+	const Vector3 t2 = CrossProduct(stretched, t1);
+
+	const float r = std::sqrt(u1);
+	const float phi = 2.0f * Util::R_PI * u2;
+	const float p1 = r * std::cos(phi);
+	const float s = 0.5f * (1.0f + stretched.z);
+	const float p2 = (1.0f - s) * std::sqrt(std::max(0.0f, 1.0f - p1 * p1)) + s * r * std::sin(phi);
+
+	const Vector3 hemisphereNormal = p1 * t1 + p2 * t2 + std::sqrt(std::max(0.0f, 1.0f - p1 * p1 - p2 * p2)) * stretched;
+	return GetNormalized(Vector3(alpha * hemisphereNormal.x, alpha * hemisphereNormal.y, std::max(1e-6f, hemisphereNormal.z)));
+}
+
+float Microfacet::VisibleNormalPdf(const Vector3& wo, const Vector3& m, float alpha)
+{
+	if (!(wo.z > 0.0f))
+	{
+		return 0.0f;
+	}
+
+	return G1(wo, alpha) * std::max(0.0f, DotProduct(wo, m)) * D(m, alpha) / wo.z;
+}
+
+float Microfacet::FresnelDielectric(float cosine, float eta)
+{
+	const float sinTransmittedSquared = (1.0f - cosine * cosine) / (eta * eta);
+	if (sinTransmittedSquared >= 1.0f)
+	{
+		return 1.0f;
+	}
+
+	const float cosTransmitted = std::sqrt(1.0f - sinTransmittedSquared);
+	const float parallel = (eta * cosine - cosTransmitted) / (eta * cosine + cosTransmitted);
+	const float perpendicular = (cosine - eta * cosTransmitted) / (cosine + eta * cosTransmitted);
+	return 0.5f * (parallel * parallel + perpendicular * perpendicular);
+}
+
+Vector3 Microfacet::FresnelSchlick(float cosine, const Vector3& f0)
+{
+	const float weight = std::pow(1.0f - std::clamp(cosine, 0.0f, 1.0f), 5.0f);
+	return f0 + (Vector3(1.0f, 1.0f, 1.0f) - f0) * weight;
+}
+
+Vector3 Microfacet::Reflect(const Vector3& wo, const Vector3& m)
+{
+	return 2.0f * DotProduct(wo, m) * m - wo;
+}
+
+bool Microfacet::Refract(const Vector3& wo, const Vector3& m, float eta, Vector3& wi)
+{
+	const float cosine = DotProduct(wo, m);
+	const float sinTransmittedSquared = std::max(0.0f, 1.0f - cosine * cosine) / (eta * eta);
+	if (sinTransmittedSquared >= 1.0f)
+	{
+		return false;
+	}
+
+	const float cosTransmitted = std::sqrt(1.0f - sinTransmittedSquared);
+	wi = -wo / eta + (cosine / eta - cosTransmitted) * m;
+	return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Vector3.h"
+
+//Isotropic GGX microfacet distribution shared by the glossy materials. Directions are given in the local frame of
+//the surface, where z is the shading normal, and alpha is the distribution's roughness.
+namespace Microfacet
+{
+	//Orthonormal basis around a normal
+	struct Frame
+	{
+		explicit Frame(const Vector3& normal);
+
+		Vector3 ToLocal(const Vector3& v) const;
+		Vector3 ToWorld(const Vector3& v) const;
+
+		Vector3 s;
+		Vector3 t;
+		Vector3 n;
+	};
+
+	//Below this roughness a surface is treated as a perfect mirror or refractor
+	constexpr float SmoothAlpha = 1e-3f;
+
+	//Density of microfacet normal m
+	float D(const Vector3& m, float alpha);
+
+	//Smith masking of v, and the height correlated masking and shadowing of a pair of directions
+	float G1(const Vector3& v, float alpha);
+	float G(const Vector3& wo, const Vector3& wi, float alpha);
+
+	//Samples a normal from the microfacets visible from wo (Heitz 2018), wo must be above the surface
+	Vector3 SampleVisibleNormal(const Vector3& wo, float alpha, float u1, float u2);
+	float VisibleNormalPdf(const Vector3& wo, const Vector3& m, float alpha);
+
+	//Unpolarised Fresnel reflectance of a dielectric interface, eta is the index ratio of the far side over the near side
+	float FresnelDielectric(float cosine, float eta);
+
+	//Schlick's approximation for a conductor with normal incidence reflectance f0
+	Vector3 FresnelSchlick(float cosine, const Vector3& f0);
+
+	//Perfect mirror reflection of wo about m
+	Vector3 Reflect(const Vector3& wo, const Vector3& m);
+
+	//Refraction of wo through a facet with normal m on wo's side, false on total internal reflection
+	bool Refract(const Vector3& wo, const Vector3& m, float eta, Vector3& wi);
+}
@@ -1,10 +1,15 @@
 #include "MovingSphere.h"
 
+#include "SceneCompiler.h"
+#include "Statistics.h"
+
 MovingSphere::MovingSphere(Vector3 cen0, Vector3 cen1, float t0, float t1, float r, Material* m) :
 	center0(cen0), center1(cen1), time0(t0), time1(t1), radius(r), material(m) {}
 
 bool MovingSphere::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
 {
+	RT_STATISTIC_INCREMENT(primitiveTests);
+
 	const Vector3 oc = r.Origin() - Center(r.GetTime());
 
 	const float a = DotProduct(r.Direction(), r.Direction());
@@ -55,3 +60,26 @@ bool MovingSphere::BoundingBox(float t0, float t1, AABB& box) const
 
 	return true;
 }
+
+bool MovingSphere::Compile(SceneCompiler& compiler) const
+{
+	SceneFormat::Primitive primitive = {};
+	primitive.type = SceneFormat::PrimitiveType::MovingSphere;
+	if (!compiler.AddMaterial(material, primitive.material))
+	{
+		return false;
+	}
+
+	primitive.data[0] = center0.x;
+	primitive.data[1] = center0.y;
+	primitive.data[2] = center0.z;
+	primitive.data[3] = center1.x;
+	primitive.data[4] = center1.y;
+	primitive.data[5] = center1.z;
+	primitive.data[6] = time0;
+	primitive.data[7] = time1;
+	primitive.data[8] = radius;
+
+	compiler.AddPrimitive(*this, primitive);
+	return true;
+}
@@ -1,10 +1,23 @@
 #include "NoiseTexture.h"
 
+#include "SceneCompiler.h"
+
 NoiseTexture::NoiseTexture(float sc)
 	: scale(sc) {}
 
+NoiseTexture::NoiseTexture(const PerlinNoise& noise, float sc)
+	: noise(noise), scale(sc) {}
+
 Vector3 NoiseTexture::Value(float u, float v, const Vector3& p) const
 {
 	//return Vector3(1.0f, 1.0f, 1.0f) * noise.Generate(scale * p);
 	return Vector3(1.0f, 1.0f, 1.0f) * 0.5 * (1.0f + std::sin(scale * p.z + 10.0f * noise.Turbulence(p)));
 }
+
+bool NoiseTexture::Compile(SceneCompiler& compiler, SceneFormat::Texture& record) const
+{
+	record.type = SceneFormat::TextureType::Noise;
+	record.data[0] = scale;
+	record.dataOffset = noise.Compile(compiler);
+	return true;
+}
@@ -9,9 +9,12 @@ class NoiseTexture : public Texture
 public:
 	NoiseTexture() = default;
 	NoiseTexture(float sc);
+	NoiseTexture(const PerlinNoise& noise, float sc);
 
 	Vector3 Value(float u, float v, const Vector3& p) const override;
 
+	bool Compile(SceneCompiler& compiler, SceneFormat::Texture& record) const override;
+
 private:
 	PerlinNoise noise;
 	float scale = 1.0f;
@@ -0,0 +1,89 @@
+#include "OrientedBox.h"
+
+#include "Box.h"
+#include "SceneCompiler.h"
+#include "Statistics.h"
+#include "Util.h"
+
+#include <cmath>
+
+OrientedBox::OrientedBox(const Vector3& center, const Vector3& halfExtents, const Vector3& axisX, const Vector3& axisY, Material* material)
+	: center(center), halfExtents(halfExtents), axes{ axisX, axisY, CrossProduct(axisX, axisY) }, material(material)
+{
+}
+
+bool OrientedBox::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
+{
+	RT_STATISTIC_INCREMENT(primitiveTests);
+
+	//The axes are orthonormal so t is the same in the local frame
+	const Vector3 offset = r.Origin() - center;
+	const Vector3 direction = r.Direction();
+	const Vector3 localOrigin(DotProduct(offset, axes[0]), DotProduct(offset, axes[1]), DotProduct(offset, axes[2]));
+	const Vector3 localDirection(DotProduct(direction, axes[0]), DotProduct(direction, axes[1]), DotProduct(direction, axes[2]));
+
+	SlabHit slabs;
+	float t;
+	int face;
+	if (!Box::Slabs(localOrigin, localDirection, -halfExtents, halfExtents, slabs) || !Box::ClosestFace(slabs, tMin, tMax, t, face))
+	{
+		return false;
+	}
+
+	hitRecord.t = t;
+	hitRecord.p = r.PointAtTime(t);
+	hitRecord.materialPtr = material;
+
+	Vector3 localNormal;
+	Box::FaceHit(localOrigin + t * localDirection, -halfExtents, halfExtents, face, localNormal, hitRecord.u, hitRecord.v);
+	hitRecord.SetFaceNormal(r, localNormal[face / 2] * axes[face / 2]);
+
+	return true;
+}
+
+bool OrientedBox::BoundingBox(float t0, float t1, AABB& box) const
+{
+	//Each axis of the box reaches as far along a world axis as its half extent times the cosine between them
+	Vector3 reach(0.0f, 0.0f, 0.0f);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		reach += halfExtents[axis] * Vector3(std::abs(axes[axis].x), std::abs(axes[axis].y), std::abs(axes[axis].z));
+	}
+
+	box = AABB(center - reach, center + reach);
+	return true;
+}
+
+bool OrientedBox::Compile(SceneCompiler& compiler) const
+{
+	SceneFormat::Primitive primitive = {};
+	primitive.type = SceneFormat::PrimitiveType::OrientedBox;
+	if (!compiler.AddMaterial(material, primitive.material))
+	{
+		return false;
+	}
+
+	center.Store(primitive.data);
+	halfExtents.Store(primitive.data + 3);
+	axes[0].Store(primitive.data + 6);
+	axes[1].Store(primitive.data + 9);
+
+	compiler.AddPrimitive(*this, primitive);
+	return true;
+}
+
+OrientedBox* OrientedBox::YRotated(const Vector3& size, float angle, const Vector3& offset, Material* material)
+{
+	const float radians = Util::DegreesToRadians(angle);
+	const float sinTheta = std::sin(radians);
+	const float cosTheta = std::cos(radians);
+
+	const Vector3 axisX(cosTheta, 0.0f, -sinTheta);
+	const Vector3 axisY(0.0f, 1.0f, 0.0f);
+	const Vector3 axisZ(sinTheta, 0.0f, cosTheta);
+
+	const Vector3 halfExtents = 0.5f * size;
+	const Vector3 center = offset + halfExtents.x * axisX + halfExtents.y * axisY + halfExtents.z * axisZ;
+
+	return new OrientedBox(center, halfExtents, axisX, axisY, material);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Hittable.h"
+
+//A box with its own orthonormal axes, intersected as an axis aligned box in its local frame. Replaces an
+//axis aligned box wrapped in rotation and translation instances with a single leaf.
+class OrientedBox : public Hittable
+{
+public:
+	OrientedBox() = default;
+
+	//axisX and axisY must be orthonormal, the third axis is their cross product
+	OrientedBox(const Vector3& center, const Vector3& halfExtents, const Vector3& axisX, const Vector3& axisY, Material* material);
+
+	bool Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const override;
+	bool BoundingBox(float t0, float t1, AABB& box) const override;
+	bool Compile(SceneCompiler& compiler) const override;
+
+	//The box [0, size] turned by angle degrees about the y axis through the origin and then moved by offset,
+	//the placement InstanceYRotation and InstanceTranslation give a Box
+	static OrientedBox* YRotated(const Vector3& size, float angle, const Vector3& offset, Material* material);
+
+private:
+	Vector3 center;
+	Vector3 halfExtents;
+	Vector3 axes[3];
+
+	Material* material;
+};
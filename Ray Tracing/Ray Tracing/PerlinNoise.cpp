@@ -1,5 +1,10 @@
 #include "PerlinNoise.h"
 
+#include "SceneCompiler.h"
+
+#include <cstring>
+#include <vector>
+
 PerlinNoise::PerlinNoise()
 {
 	randFloat = PerlinNoise::PerlinGenerate();
@@ -8,6 +13,18 @@ PerlinNoise::PerlinNoise()
 	permz = PerlinNoise::GeneratePermutation();
 }
 
+PerlinNoise::PerlinNoise(const float* randFloat, const int* permx, const int* permy, const int* permz)
+	: randFloat(randFloat), permx(permx), permy(permy), permz(permz)
+{
+}
+
+PerlinNoise PerlinNoise::FromCompiledTables(const uint8_t* tables)
+{
+	const float* randFloat = reinterpret_cast<const float*>(tables);
+	const int* permutations = reinterpret_cast<const int*>(randFloat + PointCount);
+	return PerlinNoise(randFloat, permutations, permutations + PointCount, permutations + 2 * PointCount);
+}
+
 float PerlinNoise::Generate(const Vector3& p) const
 {
 	float u = p.x - std::floor(p.x);
@@ -107,4 +124,18 @@ int* PerlinNoise::GeneratePermutation()
 	Permute(p, 256);
 
 	return p;
-}
\ No newline at end of file
+}
+
+uint64_t PerlinNoise::Compile(SceneCompiler& compiler) const
+{
+	static_assert(sizeof(float) == sizeof(int), "Compiled noise tables are laid out as 32 bit values");
+
+	std::vector<uint8_t> tables(4 * PointCount * sizeof(float));
+	uint8_t* destination = tables.data();
+	std::memcpy(destination, randFloat, PointCount * sizeof(float));
+	std::memcpy(destination += PointCount * sizeof(float), permx, PointCount * sizeof(int));
+	std::memcpy(destination += PointCount * sizeof(int), permy, PointCount * sizeof(int));
+	std::memcpy(destination += PointCount * sizeof(int), permz, PointCount * sizeof(int));
+
+	return compiler.AddData(tables.data(), tables.size());
+}
@@ -4,21 +4,35 @@
 #include "Util.h"
 
 #include <array>
+#include <cstdint>
+
+class SceneCompiler;
 
 class PerlinNoise
 {
 public:
+	static constexpr int PointCount = 256;
+
 	PerlinNoise();
 
+	//Uses existing tables without copying them, such as those stored in a compiled scene
+	PerlinNoise(const float* randFloat, const int* permx, const int* permy, const int* permz);
+
+	//Wraps the tables stored by Compile
+	static PerlinNoise FromCompiledTables(const uint8_t* tables);
+
 	float Generate(const Vector3& p) const;
 	float Turbulence(const Vector3& p, int depth = 7) const;
 	float TrilinearInterpolation(float c[2][2][2], float u, float v, float w) const;
+
+	//Stores the random tables in the compiled scene's data section and returns their offset
+	uint64_t Compile(SceneCompiler& compiler) const;
 	
 private:
-	float* randFloat;
-	int* permx;
-	int* permy;
-	int* permz;
+	const float* randFloat;
+	const int* permx;
+	const int* permy;
+	const int* permz;
 
 	void Permute(int* p, int n);
 
@@ -0,0 +1,262 @@
+#include "ProgressiveRenderer.h"
+
+#include "Checkpoint.h"
+#include "Renderer.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	//Grid spacing of the first pass in pixels, a power of two so AccumulationBuffer can find the sampled pixel
+	//covering any other
+	constexpr size_t CoarsestStride = 8;
+
+	using Clock = std::chrono::steady_clock;
+
+	struct PassContext
+	{
+		const RenderOptions& options;
+		const Scene& scene;
+		const Camera& camera;
+		AccumulationBuffer& buffer;
+		size_t pass;
+		size_t stride;
+		uint32_t target;
+		bool hasBudget;
+		Clock::time_point deadline;
+		std::atomic<bool>& outOfTime;
+		std::mutex& commitMutex;
+		std::vector<size_t>& changedTiles;
+	};
+
+	size_t FirstOnGrid(size_t value, size_t stride)
+	{
+		return (value + stride - 1) / stride * stride;
+	}
+
+	void RenderTilePass(const PassContext& context, TileProgress& tile, size_t tileIndex)
+	{
+		const size_t stride = context.stride;
+		const size_t gridX = FirstOnGrid(tile.x0, stride);
+		const size_t gridY = FirstOnGrid(tile.y0, stride);
+		const size_t gridWidth = gridX < tile.x1 ? (tile.x1 - gridX + stride - 1) / stride : 0;
+		const size_t gridHeight = gridY < tile.y1 ? (tile.y1 - gridY + stride - 1) / stride : 0;
+
+		//Trace into a copy so a checkpoint being written never sees the tile half way through a pixel
+		const size_t tileWidth = tile.x1 - tile.x0;
+		std::vector<AccumulationBuffer::Pixel> pixels;
+		pixels.reserve(tileWidth * (tile.y1 - tile.y0));
+		for (size_t y = tile.y0; y < tile.y1; y++)
+		{
+			for (size_t x = tile.x0; x < tile.x1; x++)
+			{
+				pixels.push_back(context.buffer.Get(x, y));
+			}
+		}
+
+		//Reseeding std::mt19937 costs microseconds, too much to do for every pixel of every pass
+		const size_t resumeAt = tile.nextPixel;
+		if (resumeAt > 0)
+		{
+			Util::RestoreRandomState(tile.randomState);
+		}
+		else
+		{
+			Util::SeedRandom(Renderer::PixelSeed(Renderer::PixelSeed(context.options.seed, tile.x0, tile.y0), context.pass, 0));
+		}
+
+		size_t next = resumeAt;
+		for (; next < gridWidth * gridHeight; next++)
+		{
+			if (context.hasBudget && (context.outOfTime.load(std::memory_order_relaxed) || Clock::now() >= context.deadline))
+			{
+				context.outOfTime.store(true, std::memory_order_relaxed);
+				break;
+			}
+
+			const size_t x = gridX + (next % gridWidth) * stride;
+			const size_t y = gridY + (next / gridWidth) * stride;
+
+			AccumulationBuffer::Pixel& pixel = pixels[(y - tile.y0) * tileWidth + (x - tile.x0)];
+			for (uint32_t s = pixel.samples; s < context.target; s++)
+			{
+				pixel.Add(Renderer::RenderSample(x, y, context.scene, context.camera, context.options.settings));
+			}
+		}
+
+		const bool finished = next == gridWidth * gridHeight;
+		if (!finished && next == resumeAt)
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(context.commitMutex);
+
+		for (size_t y = tile.y0; y < tile.y1; y++)
+		{
+			for (size_t x = tile.x0; x < tile.x1; x++)
+			{
+				context.buffer.Get(x, y) = pixels[(y - tile.y0) * tileWidth + (x - tile.x0)];
+			}
+		}
+
+		if (finished)
+		{
+			tile.passesDone = static_cast<uint32_t>(context.pass + 1);
+			tile.nextPixel = 0;
+			tile.randomState.clear();
+		}
+		else
+		{
+			tile.nextPixel = static_cast<uint32_t>(next);
+			tile.randomState = Util::SaveRandomState();
+		}
+
+		context.changedTiles.push_back(tileIndex);
+	}
+}
+
+bool Progressive::Render(const RenderOptions& options, const Scene& scene, const Camera& camera, ThreadPool& threadPool, AccumulationBuffer& buffer)
+{
+	const RenderSettings& settings = options.settings;
+
+	std::vector<TileProgress> tiles;
+	for (size_t y0 = 0; y0 < settings.height; y0 += options.tileSize)
+	{
+		for (size_t x0 = 0; x0 < settings.width; x0 += options.tileSize)
+		{
+			TileProgress tile;
+			tile.x0 = x0;
+			tile.y0 = y0;
+			tile.x1 = std::min(x0 + options.tileSize, settings.width);
+			tile.y1 = std::min(y0 + options.tileSize, settings.height);
+			tiles.push_back(tile);
+		}
+	}
+
+	std::unique_ptr<Checkpoint> checkpoint;
+	if (!options.checkpointPath.empty())
+	{
+		checkpoint = std::make_unique<Checkpoint>(options.checkpointPath, options);
+		if (!checkpoint->Load(buffer, tiles))
+		{
+			return false;
+		}
+	}
+
+	std::mutex commitMutex;
+	std::vector<size_t> changedTiles;
+
+	const auto checkpointInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.checkpointIntervalSeconds));
+	Clock::time_point nextCheckpoint = Clock::now() + checkpointInterval;
+	auto saveCheckpoint = [&]()
+	{
+		std::lock_guard<std::mutex> lock(commitMutex);
+		checkpoint->Save(buffer, tiles, changedTiles);
+		changedTiles.clear();
+		nextCheckpoint = Clock::now() + checkpointInterval;
+	};
+
+	//Passes every tile has finished are skipped when resuming
+	size_t firstPass = std::numeric_limits<size_t>::max();
+	for (const TileProgress& tile : tiles)
+	{
+		firstPass = std::min<size_t>(firstPass, tile.passesDone);
+	}
+
+	const bool hasBudget = options.timeBudgetSeconds > 0.0;
+	const Clock::time_point start = Clock::now();
+	const Clock::time_point deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.timeBudgetSeconds));
+	std::atomic<bool> outOfTime(false);
+
+	size_t stride = CoarsestStride;
+	size_t targetSamples = 1;
+
+	for (size_t pass = 0;; pass++)
+	{
+		const uint32_t target = static_cast<uint32_t>(std::min(targetSamples, settings.samplesPerPixel));
+
+		if (pass >= firstPass)
+		{
+			const PassContext context = { options, scene, camera, buffer, pass, stride, target, hasBudget, deadline, outOfTime, commitMutex, changedTiles };
+
+			std::vector<TaskFuture<void>> tasks;
+			for (size_t tile = 0; tile < tiles.size(); tile++)
+			{
+				if (tiles[tile].passesDone == pass)
+				{
+					tasks.push_back(threadPool.AddTask(RenderTilePass, std::cref(context), std::ref(tiles[tile]), tile));
+				}
+			}
+
+			for (TaskFuture<void>& task : tasks)
+			{
+				while (checkpoint != nullptr && task.WaitUntil(nextCheckpoint) == std::future_status::timeout)
+				{
+					saveCheckpoint();
+				}
+				task.Wait();
+			}
+
+			const float noise = stride == 1 ? buffer.RelativeNoise() : std::numeric_limits<float>::infinity();
+			const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+
+			std::cout << "Pass " << pass << ": " << target << " spp";
+			if (stride > 1)
+			{
+				std::cout << " every " << stride << " pixels";
+			}
+			std::cout << ", " << elapsed << " ms";
+			if (noise != std::numeric_limits<float>::infinity())
+			{
+				std::cout << ", noise " << noise;
+			}
+			std::cout << "\n";
+
+			buffer.WriteImage(options.previewPath);
+
+			if (outOfTime.load(std::memory_order_relaxed))
+			{
+				std::cout << "Stopped at the time budget\n";
+				break;
+			}
+
+			if (options.targetNoise > 0.0f && noise <= options.targetNoise)
+			{
+				std::cout << "Reached the target noise\n";
+				break;
+			}
+		}
+
+		if (stride == 1 && target == settings.samplesPerPixel)
+		{
+			break;
+		}
+
+		if (stride > 1)
+		{
+			stride /= 2;
+		}
+		else
+		{
+			targetSamples *= 2;
+		}
+	}
+
+	if (checkpoint != nullptr)
+	{
+		saveCheckpoint();
+	}
+
+	return true;
+}
+
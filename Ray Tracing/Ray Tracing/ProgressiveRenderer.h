@@ -0,0 +1,21 @@
+#pragma once
+
+#include "AccumulationBuffer.h"
+#include "Camera.h"
+#include "CommandLine.h"
+#include "Scenes.h"
+
+#include "ThreadPool.h"
+
+//Renders a frame in passes that refine it for previewing. The first passes trace one sample on a coarse grid
+//of pixels and halve the grid spacing each time, later passes double every pixel's sample count up to
+//--spp. All samples land in one accumulation buffer so nothing traced by an earlier pass is repeated.
+namespace Progressive
+{
+	//Writes options.previewPath after every pass and stops early once options.timeBudgetSeconds have passed or
+	//the estimated noise falls to options.targetNoise. A pass cut short by the time budget keeps the pixels it
+	//finished. Each pass seeds every tile separately, so the image doesn't depend on the thread count.
+	//With options.checkpointPath set, the render carries on from the checkpoint if there is one and saves it every
+	//options.checkpointIntervalSeconds and on finishing. Returns false if the checkpoint can't be used.
+	bool Render(const RenderOptions& options, const Scene& scene, const Camera& camera, ThreadPool& threadPool, AccumulationBuffer& buffer);
+}
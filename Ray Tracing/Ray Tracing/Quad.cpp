@@ -0,0 +1,111 @@
+#include "Quad.h"
+
+#include "SceneCompiler.h"
+#include "Statistics.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+Quad::Quad(const Vector3& q, const Vector3& u, const Vector3& v, Material* material)
+	: q(q), u(u), v(v), material(material)
+{
+	const Vector3 n = CrossProduct(u, v);
+	w = n / DotProduct(n, n);
+	normal = GetNormalized(n);
+	distance = DotProduct(normal, q);
+}
+
+bool Quad::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
+{
+	RT_STATISTIC_INCREMENT(primitiveTests);
+
+	//Rays parallel to the plane give an infinite or NaN t, which the range test rejects
+	const float t = (distance - DotProduct(normal, r.Origin())) / DotProduct(normal, r.Direction());
+	if (!(t >= tMin && t <= tMax))
+	{
+		return false;
+	}
+
+	const Vector3 p = r.PointAtTime(t);
+	const Vector3 planar = p - q;
+	const float alpha = DotProduct(w, CrossProduct(planar, v));
+	const float beta = DotProduct(w, CrossProduct(u, planar));
+
+	if ((alpha < 0.0f) | (alpha > 1.0f) | (beta < 0.0f) | (beta > 1.0f))
+	{
+		return false;
+	}
+
+	hitRecord.t = t;
+	hitRecord.p = p;
+	hitRecord.u = alpha;
+	hitRecord.v = beta;
+	hitRecord.materialPtr = material;
+	hitRecord.SetFaceNormal(r, normal);
+
+	return true;
+}
+
+bool Quad::BoundingBox(float t0, float t1, AABB& box) const
+{
+	const Vector3 corners[4] = { q, q + u, q + v, q + u + v };
+
+	Vector3 minimum = q;
+	Vector3 maximum = q;
+	for (const Vector3& corner : corners)
+	{
+		minimum = Vector3(std::min(minimum.x, corner.x), std::min(minimum.y, corner.y), std::min(minimum.z, corner.z));
+		maximum = Vector3(std::max(maximum.x, corner.x), std::max(maximum.y, corner.y), std::max(maximum.z, corner.z));
+	}
+
+	//Pad like the rectangles do so a quad lying in an axis plane still has a box with some thickness
+	const float largest = std::max({ 1.0f, std::abs(minimum.x), std::abs(minimum.y), std::abs(minimum.z), std::abs(maximum.x), std::abs(maximum.y), std::abs(maximum.z) });
+	const float padding = 0.0001f * largest;
+	box = AABB(minimum - Vector3(padding, padding, padding), maximum + Vector3(padding, padding, padding));
+	return true;
+}
+
+float Quad::PdfValue(const Vector3& origin, const Vector3& direction) const
+{
+	HitRecord hitRecord;
+	if (!Hit(Ray(origin, direction, 0.0f), 0.001f, std::numeric_limits<float>::max(), hitRecord))
+	{
+		return 0.0f;
+	}
+
+	//Convert the uniform density over the area into a density over directions
+	const float distanceSquared = hitRecord.t * hitRecord.t * direction.SquaredLength();
+	const float cosine = std::abs(DotProduct(direction, hitRecord.normal)) / direction.Length();
+	return distanceSquared / (cosine * Area());
+}
+
+Vector3 Quad::Random(const Vector3& origin) const
+{
+	const float a = Util::RandomFloat();
+	const float b = Util::RandomFloat();
+	return q + a * u + b * v - origin;
+}
+
+bool Quad::Compile(SceneCompiler& compiler) const
+{
+	SceneFormat::Primitive primitive = {};
+	primitive.type = SceneFormat::PrimitiveType::Quad;
+	if (!compiler.AddMaterial(material, primitive.material))
+	{
+		return false;
+	}
+
+	q.Store(primitive.data);
+	u.Store(primitive.data + 3);
+	v.Store(primitive.data + 6);
+
+	compiler.AddPrimitive(*this, primitive);
+	return true;
+}
+
+float Quad::Area() const
+{
+	return CrossProduct(u, v).Length();
+}
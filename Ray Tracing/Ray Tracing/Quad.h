@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Hittable.h"
+
+//A parallelogram in any orientation, the general form of the axis aligned rectangles
+class Quad : public Hittable
+{
+public:
+	Quad() = default;
+
+	//Corner q with edges u and v, u x v is the outward normal and the texture coordinates run along u and v
+	Quad(const Vector3& q, const Vector3& u, const Vector3& v, Material* material);
+
+	bool Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const override;
+	bool BoundingBox(float t0, float t1, AABB& box) const override;
+	float PdfValue(const Vector3& origin, const Vector3& direction) const override;
+	Vector3 Random(const Vector3& origin) const override;
+	bool Compile(SceneCompiler& compiler) const override;
+
+	float Area() const;
+
+private:
+	Vector3 q;
+	Vector3 u;
+	Vector3 v;
+
+	//Projects a point in the plane onto the edges, (u x v) / |u x v|^2
+	Vector3 w;
+	Vector3 normal;
+	float distance;
+
+	Material* material;
+};
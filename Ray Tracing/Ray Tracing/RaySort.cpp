@@ -0,0 +1,77 @@
+#include "RaySort.h"
+
+#include <algorithm>
+
+namespace
+{
+	constexpr int MortonBitsPerAxis = 9;
+	constexpr uint32_t MortonCells = 1u << MortonBitsPerAxis;
+
+	//Spreads the low 9 bits of value out so there are two zero bits between each of them
+	uint32_t SpreadBits(uint32_t value)
+	{
+		value &= 0x1FF;
+		value = (value | (value << 16)) & 0x030000FF;
+		value = (value | (value << 8)) & 0x0300F00F;
+		value = (value | (value << 4)) & 0x030C30C3;
+		value = (value | (value << 2)) & 0x09249249;
+		return value;
+	}
+
+	uint32_t Cell(float value, float minimum, float extent)
+	{
+		const float position = extent > 0.0f ? (value - minimum) / extent : 0.0f;
+		return static_cast<uint32_t>(std::clamp(position * MortonCells, 0.0f, static_cast<float>(MortonCells - 1)));
+	}
+}
+
+uint32_t RaySort::Key(const Ray& ray, const AABB& bounds)
+{
+	const Vector3 direction = ray.Direction();
+	const uint32_t octant = (direction.x < 0.0f ? 4u : 0u) | (direction.y < 0.0f ? 2u : 0u) | (direction.z < 0.0f ? 1u : 0u);
+
+	const Vector3 origin = ray.Origin();
+	const Vector3 minimum = bounds.Min();
+	const Vector3 extent = bounds.Max() - bounds.Min();
+
+	const uint32_t morton = (SpreadBits(Cell(origin.x, minimum.x, extent.x)) << 2)
+		| (SpreadBits(Cell(origin.y, minimum.y, extent.y)) << 1)
+		| SpreadBits(Cell(origin.z, minimum.z, extent.z));
+
+	return (octant << (3 * MortonBitsPerAxis)) | morton;
+}
+
+void RaySort::SortByKey(std::vector<uint64_t>& entries, std::vector<uint64_t>& scratch)
+{
+	scratch.resize(entries.size());
+
+	for (int shift = 32; shift < 64; shift += 8)
+	{
+		size_t counts[256] = {};
+		for (uint64_t entry : entries)
+		{
+			counts[(entry >> shift) & 0xFF]++;
+		}
+
+		//Every key shares this digit, the pass wouldn't move anything
+		if (counts[(entries.empty() ? 0 : entries[0] >> shift) & 0xFF] == entries.size())
+		{
+			continue;
+		}
+
+		size_t offset = 0;
+		for (size_t& count : counts)
+		{
+			const size_t bucketSize = count;
+			count = offset;
+			offset += bucketSize;
+		}
+
+		for (uint64_t entry : entries)
+		{
+			scratch[counts[(entry >> shift) & 0xFF]++] = entry;
+		}
+
+		entries.swap(scratch);
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "AABB.h"
+#include "Ray.h"
+
+#include <cstdint>
+#include <vector>
+
+//Orders batches of rays so that consecutive rays start close together and point the same way, which keeps
+//their BVH traversals walking the same nodes while those are still in cache.
+namespace RaySort
+{
+	//Direction octant in the top 3 bits, then a 27 bit Morton code of the origin's position within bounds, which
+	//should be the bounds of the batch's origins rather than the scene so the cells are fine enough to matter
+	uint32_t Key(const Ray& ray, const AABB& bounds);
+
+	//Entries hold a key in the upper 32 bits and a payload, usually an index, in the lower 32. Sorts by key with
+	//a stable 8 bit LSD radix sort, scratch is resized as needed and can be reused between calls.
+	void SortByKey(std::vector<uint64_t>& entries, std::vector<uint64_t>& scratch);
+}
@@ -0,0 +1,442 @@
+#include "RenderDaemon.h"
+
+#include "Camera.h"
+#include "ImageData.h"
+#include "Renderer.h"
+#include "SceneCache.h"
+#include "Scenes.h"
+#include "Socket.h"
+#include "TileCompression.h"
+#include "Util.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	enum class MessageType : uint32_t
+	{
+		Job = 1,
+		Tile,
+		Done
+	};
+
+	//Which of the job's camera fields replace the scene's own
+	enum CameraOverride : uint32_t
+	{
+		OverrideLookFrom = 1,
+		OverrideLookAt = 2,
+		OverrideFov = 4
+	};
+
+	//Followed by the path of the compiled scene file, if any
+	struct JobMessage
+	{
+		uint32_t jobId;
+		uint32_t scene;
+		uint32_t seed;
+		uint32_t width;
+		uint32_t height;
+		uint32_t samplesPerPixel;
+		int32_t maxBounces;
+		uint32_t legacyMaterials;
+		uint32_t tileSize;
+		uint32_t cameraOverrides;
+		float lookFrom[3];
+		float lookAt[3];
+		float verticalFov;
+	};
+
+	//Followed by the compressed radiance sums of the tile, whose rows are counted from the top of the image
+	struct TileMessage
+	{
+		uint32_t jobId;
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+		uint32_t height;
+		uint32_t valueCount;
+	};
+
+	enum class JobStatus : uint32_t
+	{
+		Complete,
+		Cancelled, //Replaced by a newer job from the same client
+		Failed
+	};
+
+	struct DoneMessage
+	{
+		uint32_t jobId;
+		JobStatus status;
+		uint32_t startMicroseconds; //From receiving the job to its tiles being queued
+		uint32_t milliseconds;
+	};
+
+	constexpr size_t MaxSceneFilePath = 4096;
+	constexpr uint32_t MaxImageSize = 16384;
+	constexpr uint32_t MaxTileSize = 256;
+
+	struct Job
+	{
+		JobMessage message;
+		std::string sceneFile;
+	};
+
+	struct FinishedTile
+	{
+		TileMessage header;
+		std::vector<float> values;
+	};
+
+	bool SendMessage(Socket& socket, MessageType type, const void* payload, size_t size)
+	{
+		return socket.SendFrame(static_cast<uint32_t>(type), payload, size);
+	}
+
+	bool ReceiveMessage(Socket& socket, size_t maxSize, MessageType& type, std::vector<uint8_t>& payload)
+	{
+		uint32_t received = 0;
+		const bool valid = socket.ReceiveFrame(maxSize, received, payload);
+		type = static_cast<MessageType>(received);
+		return valid;
+	}
+
+	bool ParseJob(MessageType type, const std::vector<uint8_t>& payload, Job& job)
+	{
+		if (type != MessageType::Job || !ReadPayload(payload, job.message))
+		{
+			return false;
+		}
+
+		const JobMessage& message = job.message;
+		job.sceneFile.assign(payload.begin() + sizeof(message), payload.end());
+
+		return Scenes::IsValid(message.scene)
+			&& message.width >= 1 && message.width <= MaxImageSize && message.height >= 1 && message.height <= MaxImageSize
+			&& message.samplesPerPixel >= 1 && message.tileSize >= 1 && message.tileSize <= MaxTileSize;
+	}
+
+	//Renders job on the pool, sending tiles to client as they finish. Returns early with Cancelled if the client
+	//sends another job, which is left in nextJob, or disconnects, which clears connected.
+	JobStatus RenderJob(Socket& client, const Job& job, SceneCache& sceneCache, ThreadPool& threadPool, Clock::duration& startTime, bool& hasNextJob, Job& nextJob, bool& connected)
+	{
+		const Clock::time_point received = Clock::now();
+		const JobMessage& message = job.message;
+
+		bool wasCached = false;
+		const Scene* cachedScene = sceneCache.Get(static_cast<SceneId>(message.scene), message.seed, job.sceneFile, wasCached);
+		if (cachedScene == nullptr)
+		{
+			return JobStatus::Failed;
+		}
+
+		Scene scene = *cachedScene;
+		if (message.cameraOverrides & OverrideLookFrom)
+		{
+			scene.lookFrom = Vector3(message.lookFrom[0], message.lookFrom[1], message.lookFrom[2]);
+		}
+		if (message.cameraOverrides & OverrideLookAt)
+		{
+			scene.lookAt = Vector3(message.lookAt[0], message.lookAt[1], message.lookAt[2]);
+		}
+		if (message.cameraOverrides & OverrideFov)
+		{
+			scene.verticalFov = message.verticalFov;
+		}
+
+		RenderSettings settings;
+		settings.width = message.width;
+		settings.height = message.height;
+		settings.samplesPerPixel = message.samplesPerPixel;
+		settings.maxBounces = message.maxBounces;
+		settings.legacyMaterials = message.legacyMaterials != 0;
+
+		const Camera camera = scene.CreateCamera(float(settings.width) / float(settings.height));
+
+		std::atomic<bool> cancelled(false);
+		std::atomic<size_t> finishedTasks(0);
+		std::mutex finishedMutex;
+		std::vector<FinishedTile> finishedTiles;
+
+		size_t taskCount = 0;
+		for (uint32_t y0 = 0; y0 < message.height; y0 += message.tileSize)
+		{
+			for (uint32_t x0 = 0; x0 < message.width; x0 += message.tileSize)
+			{
+				TileMessage tile = { message.jobId, x0, y0, std::min(message.tileSize, message.width - x0), std::min(message.tileSize, message.height - y0), 0 };
+				tile.valueCount = tile.width * tile.height * 3;
+
+				threadPool.Submit([&, tile]()
+					{
+						std::vector<float> values(tile.valueCount);
+						for (uint32_t row = 0; row < tile.height && !cancelled.load(std::memory_order_relaxed); row++)
+						{
+							for (uint32_t column = 0; column < tile.width; column++)
+							{
+								const size_t x = tile.x + column;
+								const size_t y = settings.height - 1 - (tile.y + row);
+
+								Util::SeedRandom(Renderer::PixelSeed(message.seed, x, y));
+								const Vector3 colour = Renderer::RenderPixel(x, y, scene, camera, settings);
+
+								float* value = &values[(static_cast<size_t>(row) * tile.width + column) * 3];
+								value[0] = colour.x;
+								value[1] = colour.y;
+								value[2] = colour.z;
+							}
+						}
+
+						if (!cancelled.load(std::memory_order_relaxed))
+						{
+							std::lock_guard<std::mutex> lock(finishedMutex);
+							finishedTiles.push_back({ tile, std::move(values) });
+						}
+						finishedTasks.fetch_add(1, std::memory_order_release);
+					});
+				taskCount++;
+			}
+		}
+
+		startTime = Clock::now() - received;
+		std::cout << "Job " << message.jobId << ": " << (job.sceneFile.empty() ? Scenes::GetName(static_cast<SceneId>(message.scene)) : job.sceneFile.c_str())
+			<< (wasCached ? " (cached)" : "") << ", tracing after " << std::chrono::duration_cast<std::chrono::microseconds>(startTime).count() << " us\n";
+
+		std::vector<FinishedTile> sending;
+		auto sendFinishedTiles = [&]()
+		{
+			{
+				std::lock_guard<std::mutex> lock(finishedMutex);
+				sending.swap(finishedTiles);
+			}
+
+			for (const FinishedTile& tile : sending)
+			{
+				if (cancelled.load(std::memory_order_relaxed))
+				{
+					break;
+				}
+
+				const std::vector<uint8_t> compressed = TileCompression::Compress(tile.values);
+
+				std::vector<uint8_t> payload(sizeof(tile.header) + compressed.size());
+				std::memcpy(payload.data(), &tile.header, sizeof(tile.header));
+				std::copy(compressed.begin(), compressed.end(), payload.begin() + sizeof(tile.header));
+
+				if (!SendMessage(client, MessageType::Tile, payload.data(), payload.size()))
+				{
+					connected = false;
+					cancelled.store(true, std::memory_order_relaxed);
+				}
+			}
+			sending.clear();
+		};
+
+		std::vector<bool> readable;
+		std::vector<uint8_t> payload;
+		while (finishedTasks.load(std::memory_order_acquire) < taskCount)
+		{
+			Socket::WaitReadable({ &client }, 1, readable);
+			if (readable[0] && connected && !hasNextJob)
+			{
+				MessageType type;
+				if (ReceiveMessage(client, sizeof(JobMessage) + MaxSceneFilePath, type, payload) && ParseJob(type, payload, nextJob))
+				{
+					hasNextJob = true;
+				}
+				else
+				{
+					connected = false;
+				}
+				cancelled.store(true, std::memory_order_relaxed);
+			}
+
+			sendFinishedTiles();
+		}
+		sendFinishedTiles();
+
+		return cancelled.load(std::memory_order_relaxed) ? JobStatus::Cancelled : JobStatus::Complete;
+	}
+
+	void Serve(Socket& client, SceneCache& sceneCache, ThreadPool& threadPool)
+	{
+		Job job;
+		bool hasJob = false;
+		bool connected = true;
+		std::vector<uint8_t> payload;
+
+		while (connected)
+		{
+			if (!hasJob)
+			{
+				MessageType type;
+				if (!ReceiveMessage(client, sizeof(JobMessage) + MaxSceneFilePath, type, payload) || !ParseJob(type, payload, job))
+				{
+					break;
+				}
+			}
+
+			const Clock::time_point start = Clock::now();
+			Clock::duration startTime = Clock::duration::zero();
+			Job nextJob;
+			hasJob = false;
+			const JobStatus status = RenderJob(client, job, sceneCache, threadPool, startTime, hasJob, nextJob, connected);
+
+			const auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+			std::cout << "Job " << job.message.jobId << (status == JobStatus::Complete ? " complete" : status == JobStatus::Cancelled ? " cancelled" : " failed")
+				<< " after " << milliseconds << " ms\n";
+
+			const DoneMessage done = { job.message.jobId, status, static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(startTime).count()), static_cast<uint32_t>(milliseconds) };
+			if (connected && !SendMessage(client, MessageType::Done, &done, sizeof(done)))
+			{
+				break;
+			}
+
+			if (hasJob)
+			{
+				job = nextJob;
+			}
+		}
+	}
+}
+
+bool Daemon::Run(const RenderOptions& options)
+{
+	Socket listener = Socket::Listen(options.address);
+	if (!listener.IsValid())
+	{
+		std::cerr << "Failed to listen on " << options.address << "\n";
+		return false;
+	}
+
+	ThreadPool threadPool(options.threadCount != 0 ? options.threadCount : std::thread::hardware_concurrency(), ThreadPool::WaitPolicy::LowLatency, options.pinThreads);
+	SceneCache sceneCache(options.sceneCacheDirectory, options.sceneCacheSize, options.compileOptions, &threadPool);
+
+	std::cout << "Render daemon listening on " << options.address << "\n";
+
+	while (true)
+	{
+		Socket client = listener.Accept();
+		if (client.IsValid())
+		{
+			Serve(client, sceneCache, threadPool);
+		}
+	}
+}
+
+bool Daemon::Submit(const RenderOptions& options)
+{
+	const RenderSettings& settings = options.settings;
+
+	if (options.sceneFile.size() > MaxSceneFilePath)
+	{
+		std::cerr << "Scene file path is too long\n";
+		return false;
+	}
+
+	Socket socket = Socket::Connect(options.address);
+	if (!socket.IsValid())
+	{
+		std::cerr << "Failed to connect to " << options.address << "\n";
+		return false;
+	}
+
+	JobMessage job = {};
+	job.jobId = 1;
+	job.scene = static_cast<uint32_t>(options.scene);
+	job.seed = options.seed;
+	job.width = static_cast<uint32_t>(settings.width);
+	job.height = static_cast<uint32_t>(settings.height);
+	job.samplesPerPixel = static_cast<uint32_t>(settings.samplesPerPixel);
+	job.maxBounces = settings.maxBounces;
+	job.legacyMaterials = settings.legacyMaterials;
+	job.tileSize = static_cast<uint32_t>(std::min<size_t>(options.tileSize, MaxTileSize));
+	if (options.lookFrom)
+	{
+		job.cameraOverrides |= OverrideLookFrom;
+		options.lookFrom->Store(job.lookFrom);
+	}
+	if (options.lookAt)
+	{
+		job.cameraOverrides |= OverrideLookAt;
+		options.lookAt->Store(job.lookAt);
+	}
+	if (options.verticalFov)
+	{
+		job.cameraOverrides |= OverrideFov;
+		job.verticalFov = *options.verticalFov;
+	}
+
+	std::vector<uint8_t> payload(sizeof(job) + options.sceneFile.size());
+	std::memcpy(payload.data(), &job, sizeof(job));
+	std::copy(options.sceneFile.begin(), options.sceneFile.end(), payload.begin() + sizeof(job));
+
+	const Clock::time_point sent = Clock::now();
+	if (!SendMessage(socket, MessageType::Job, payload.data(), payload.size()))
+	{
+		std::cerr << "Lost connection to daemon\n";
+		return false;
+	}
+
+	const size_t maxPayloadSize = sizeof(TileMessage) + static_cast<size_t>(job.tileSize) * job.tileSize * 3 * sizeof(float) * 2;
+
+	ImageData imageData(settings.width, settings.height);
+	std::vector<float> values;
+	bool firstTile = true;
+
+	MessageType type;
+	while (ReceiveMessage(socket, maxPayloadSize, type, payload))
+	{
+		TileMessage tile;
+		if (type == MessageType::Tile && ReadPayload(payload, tile) && tile.jobId == job.jobId
+			&& tile.x + tile.width <= job.width && tile.y + tile.height <= job.height && tile.valueCount == tile.width * tile.height * 3
+			&& TileCompression::Decompress(payload.data() + sizeof(tile), payload.size() - sizeof(tile), tile.valueCount, values))
+		{
+			if (firstTile)
+			{
+				std::cout << "First tile after " << std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - sent).count() << " ms\n";
+				firstTile = false;
+			}
+
+			for (uint32_t row = 0; row < tile.height; row++)
+			{
+				for (uint32_t column = 0; column < tile.width; column++)
+				{
+					const float* value = &values[(static_cast<size_t>(row) * tile.width + column) * 3];
+					imageData.Write(Vector3(value[0], value[1], value[2]), tile.x + column, tile.y + row);
+				}
+			}
+		}
+		else if (type == MessageType::Done)
+		{
+			DoneMessage done;
+			if (!ReadPayload(payload, done) || done.status != JobStatus::Complete)
+			{
+				std::cerr << "Daemon failed to render the job\n";
+				return false;
+			}
+
+			std::cout << "Daemon started tracing after " << done.startMicroseconds << " us and finished in " << done.milliseconds << " ms\n";
+			imageData.WriteImageDataToFile(options.outputPath, settings.samplesPerPixel);
+			return true;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	std::cerr << "Lost connection to daemon\n";
+	return false;
+}
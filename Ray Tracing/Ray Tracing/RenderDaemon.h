@@ -0,0 +1,17 @@
+#pragma once
+
+#include "CommandLine.h"
+
+//A long running render service. The daemon keeps one thread pool and an LRU cache of compiled scenes for its whole
+//life, so a job only pays for tracing: one that reuses a cached scene and only moves the camera starts rendering
+//as soon as it arrives. Clients connect over TCP or a Unix socket and send jobs, and tiles are streamed back as
+//they finish. A job sent while another is rendering cancels the older one, so an interactive client can keep
+//sending camera moves and only ever waits for the latest.
+namespace Daemon
+{
+	//Listens on options.address and serves clients one at a time until the process is stopped
+	bool Run(const RenderOptions& options);
+
+	//Sends the job described by options to the daemon at options.address and writes the image to options.outputPath
+	bool Submit(const RenderOptions& options);
+}
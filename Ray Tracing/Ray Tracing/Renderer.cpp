@@ -0,0 +1,390 @@
+#include "Renderer.h"
+
+#include "LightBVH.h"
+#include "Material.h"
+#include "RaySort.h"
+#include "Statistics.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace
+{
+	//Counted per thread so the hot path never touches shared memory
+	thread_local uint64_t rayCount = 0;
+
+	//A point on a light chosen for next event estimation
+	struct LightSample
+	{
+		uint32_t light;
+		Vector3 direction;
+		float pdf; //Solid angle density, including the probability of choosing the light
+	};
+
+	//One light chosen by the light BVH and one point on it, returns false if no light can reach the hit
+	bool SampleLight(const Scene& scene, const HitRecord& hitRecord, LightSample& sample)
+	{
+		float pmf;
+		if (!scene.lights->Sample(hitRecord.p, hitRecord.normal, Util::RandomFloat(), sample.light, pmf))
+		{
+			return false;
+		}
+
+		sample.direction = scene.lights->SampleDirection(sample.light, hitRecord.p);
+		sample.pdf = pmf * scene.lights->DirectionPdf(sample.light, hitRecord.p, sample.direction);
+		return sample.pdf > 0.0f;
+	}
+
+	//Traces the shadow ray of a light sample, returning the light's emission if it is the first thing the ray hits
+	Vector3 LightEmission(const Scene& scene, const Ray& r, const HitRecord& hitRecord, const LightSample& sample)
+	{
+		rayCount++;
+		RT_STATISTIC_INCREMENT(rays);
+
+		HitRecord lightRecord;
+		if (!scene.world->Hit(Ray(hitRecord.p, sample.direction, r.GetTime()), 0.001f, std::numeric_limits<float>::max(), lightRecord) || lightRecord.light != sample.light)
+		{
+			return Vector3(0.0f, 0.0f, 0.0f);
+		}
+
+		return lightRecord.materialPtr->Emitted(lightRecord.u, lightRecord.v, lightRecord.p);
+	}
+
+	//Next event estimation for a diffuse hit with the legacy materials, whose bounces never find the lights themselves
+	Vector3 SampleDirectLight(const Scene& scene, const Ray& r, const HitRecord& hitRecord, const Vector3& albedo)
+	{
+		LightSample sample;
+		if (!SampleLight(scene, hitRecord, sample))
+		{
+			return Vector3(0.0f, 0.0f, 0.0f);
+		}
+
+		const float cosine = DotProduct(sample.direction, hitRecord.normal) / sample.direction.Length();
+		if (!(cosine > 0.0f))
+		{
+			return Vector3(0.0f, 0.0f, 0.0f);
+		}
+
+		return albedo * LightEmission(scene, r, hitRecord, sample) * (cosine / (Util::R_PI * sample.pdf));
+	}
+
+	//Veach's power heuristic with an exponent of two
+	float PowerHeuristic(float pdf, float otherPdf)
+	{
+		const float weight = pdf * pdf;
+		return weight / (weight + otherPdf * otherPdf);
+	}
+
+	//Next event estimation through the BSDF, weighted against the chance Material::Sample finds the same light
+	Vector3 SampleDirectLight(const Scene& scene, const Ray& r, const HitRecord& hitRecord)
+	{
+		LightSample sample;
+		if (!SampleLight(scene, hitRecord, sample))
+		{
+			return Vector3(0.0f, 0.0f, 0.0f);
+		}
+
+		//Skip the shadow ray when the surface wouldn't reflect the light anyway
+		const Vector3 bsdf = hitRecord.materialPtr->Eval(r, hitRecord, sample.direction);
+		if (!(bsdf.x > 0.0f || bsdf.y > 0.0f || bsdf.z > 0.0f))
+		{
+			return Vector3(0.0f, 0.0f, 0.0f);
+		}
+
+		const float weight = PowerHeuristic(sample.pdf, hitRecord.materialPtr->Pdf(r, hitRecord, sample.direction));
+		return bsdf * LightEmission(scene, r, hitRecord, sample) * (weight / sample.pdf);
+	}
+
+	//Where the ray being traced was scattered from, so emission it finds can be weighted against the light sample taken there
+	struct ScatterOrigin
+	{
+		Vector3 point;
+		Vector3 normal;
+		float pdf = 0.0f; //Solid angle density Material::Sample had of the ray's direction
+		bool lightsSampled = false; //The scattering hit gathered direct light from the scene's lights
+	};
+
+	//What one ray of a path picks up where it lands, and the ray that continues the path if there is one
+	struct Bounce
+	{
+		Vector3 radiance = Vector3(0.0f, 0.0f, 0.0f);
+		Vector3 attenuation;
+		Ray scattered;
+		bool continues = false;
+		ScatterOrigin origin;
+	};
+
+	Vector3 EmittedRadiance(const Ray& r, const Scene& scene, const HitRecord& hitRecord, const ScatterOrigin& origin, bool legacyMaterials)
+	{
+		if (!origin.lightsSampled || hitRecord.light == SceneFormat::InvalidIndex)
+		{
+			return hitRecord.materialPtr->Emitted(hitRecord.u, hitRecord.v, hitRecord.p);
+		}
+
+		//With the legacy materials the light sample gathered everything the bounce could have found
+		if (legacyMaterials)
+		{
+			return Vector3(0.0f, 0.0f, 0.0f);
+		}
+
+		const float lightPdf = scene.lights->Pmf(origin.point, origin.normal, hitRecord.light) * scene.lights->DirectionPdf(hitRecord.light, origin.point, r.Direction());
+		return hitRecord.materialPtr->Emitted(hitRecord.u, hitRecord.v, hitRecord.p) * PowerHeuristic(origin.pdf, lightPdf);
+	}
+
+	bool Scatter(const Ray& r, const HitRecord& hitRecord, bool legacyMaterials, Bounce& bounce)
+	{
+		if (legacyMaterials)
+		{
+			return hitRecord.materialPtr->Scatter(r, hitRecord, bounce.attenuation, bounce.scattered);
+		}
+
+		BsdfSample sample;
+		if (!hitRecord.materialPtr->Sample(r, hitRecord, sample))
+		{
+			return false;
+		}
+
+		bounce.attenuation = sample.weight;
+		bounce.scattered = Ray(hitRecord.p, sample.direction, r.GetTime());
+		bounce.origin.pdf = sample.specular ? 0.0f : sample.pdf;
+		return true;
+	}
+
+	Bounce TraceBounce(const Ray& r, const Scene& scene, const ScatterOrigin& origin, bool legacyMaterials)
+	{
+		Bounce bounce;
+		HitRecord hitRecord;
+
+		rayCount++;
+		RT_STATISTIC_INCREMENT(rays);
+
+		// If the ray hits nothing, return the background color.
+		if (!scene.world->Hit(r, 0.001f, std::numeric_limits<float>::max(), hitRecord))
+		{
+			bounce.radiance = scene.background;
+			return bounce;
+		}
+
+		bounce.radiance = EmittedRadiance(r, scene, hitRecord, origin, legacyMaterials);
+
+#if RAYTRACING_STATISTICS
+		const std::chrono::steady_clock::time_point scatterStart = std::chrono::steady_clock::now();
+		bounce.continues = Scatter(r, hitRecord, legacyMaterials, bounce);
+		Statistics::Current().scatterNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - scatterStart).count();
+#else
+		bounce.continues = Scatter(r, hitRecord, legacyMaterials, bounce);
+#endif
+
+		if (!bounce.continues)
+		{
+			return bounce;
+		}
+
+		RT_STATISTIC_INCREMENT(bounces);
+
+		if (legacyMaterials)
+		{
+			bounce.origin.lightsSampled = scene.lights != nullptr && hitRecord.materialPtr->IsDiffuse();
+			if (bounce.origin.lightsSampled)
+			{
+				bounce.radiance += SampleDirectLight(scene, r, hitRecord, bounce.attenuation);
+			}
+			return bounce;
+		}
+
+		bounce.origin.lightsSampled = scene.lights != nullptr && hitRecord.materialPtr->SamplesLights();
+		if (bounce.origin.lightsSampled)
+		{
+			bounce.origin.point = hitRecord.p;
+			bounce.origin.normal = hitRecord.normal;
+			bounce.radiance += SampleDirectLight(scene, r, hitRecord);
+		}
+
+		return bounce;
+	}
+
+	//A path of the tile renderer waiting for its next ray to be traced
+	struct PathState
+	{
+		Ray ray;
+		Vector3 throughput;
+		uint32_t pixel;
+		ScatterOrigin origin;
+	};
+
+	Vector3 TracePath(const Ray& r, const Scene& scene, int depth, const ScatterOrigin& origin, bool legacyMaterials)
+	{
+		// If we've exceeded the ray bounce limit, no more light is gathered.
+		if (depth <= 0)
+		{
+			return Vector3(0, 0, 0);
+		}
+
+		const Bounce bounce = TraceBounce(r, scene, origin, legacyMaterials);
+		if (!bounce.continues)
+		{
+			return bounce.radiance;
+		}
+
+		return bounce.radiance + bounce.attenuation * TracePath(bounce.scattered, scene, depth - 1, bounce.origin, legacyMaterials);
+	}
+
+	//Largest number of paths a tile advances together, bounds the memory used by one tile
+	constexpr size_t MaxTilePaths = 1 << 16;
+}
+
+Vector3 Renderer::Colour(const Ray& r, const Scene& scene, int depth, bool legacyMaterials)
+{
+	return TracePath(r, scene, depth, ScatterOrigin(), legacyMaterials);
+}
+
+Vector3 Renderer::RenderSample(size_t x, size_t y, const Scene& scene, const Camera& camera, const RenderSettings& settings)
+{
+	const float u = static_cast<float>(x + Util::RandomFloat()) / static_cast<float>(settings.width);
+	const float v = static_cast<float>(y + Util::RandomFloat()) / static_cast<float>(settings.height);
+
+	const Ray r = camera.GetRay(u, v);
+
+	return Colour(r, scene, settings.maxBounces, settings.legacyMaterials);
+}
+
+Vector3 Renderer::RenderPixel(size_t x, size_t y, const Scene& scene, const Camera& camera, const RenderSettings& settings)
+{
+#if RAYTRACING_STATISTICS
+	Statistics::BeginPixel();
+#endif
+
+	Vector3 colour(0.0f, 0.0f, 0.0f);
+
+	for (size_t s = 0; s < settings.samplesPerPixel; s++)
+	{
+		colour += RenderSample(x, y, scene, camera, settings);
+	}
+
+#if RAYTRACING_STATISTICS
+	Statistics::EndPixel();
+#endif
+
+	return colour;
+}
+
+void Renderer::RenderTile(size_t x0, size_t y0, size_t x1, size_t y1, const Scene& scene, const Camera& camera, const RenderSettings& settings, bool sortRays, std::vector<Vector3>& colours, std::vector<TraversalCounters>* pixelCounters)
+{
+	const size_t tileWidth = x1 - x0;
+	const size_t pixelCount = tileWidth * (y1 - y0);
+	colours.assign(pixelCount, Vector3(0.0f, 0.0f, 0.0f));
+	if (pixelCounters != nullptr)
+	{
+		pixelCounters->assign(pixelCount, TraversalCounters());
+	}
+
+#if RAYTRACING_STATISTICS
+	//Paths of every pixel in the tile are traced interleaved, so each bounce's counters are handed to its pixel as it finishes
+	TraversalCounters tileCounters;
+#endif
+
+	std::vector<PathState> paths;
+	std::vector<PathState> nextPaths;
+	std::vector<uint64_t> sortEntries;
+	std::vector<uint64_t> sortScratch;
+
+	//Large tiles at high sample counts take their samples a few at a time
+	const size_t samplesPerPass = std::max<size_t>(1, std::min(settings.samplesPerPixel, MaxTilePaths / std::max<size_t>(1, pixelCount)));
+
+	for (size_t firstSample = 0; firstSample < settings.samplesPerPixel; firstSample += samplesPerPass)
+	{
+		const size_t sampleCount = std::min(samplesPerPass, settings.samplesPerPixel - firstSample);
+
+		//Camera rays are already coherent in pixel order
+		paths.clear();
+		for (size_t pixel = 0; pixel < pixelCount; pixel++)
+		{
+			const size_t x = x0 + pixel % tileWidth;
+			const size_t y = y0 + pixel / tileWidth;
+			for (size_t s = 0; s < sampleCount; s++)
+			{
+				const float u = static_cast<float>(x + Util::RandomFloat()) / static_cast<float>(settings.width);
+				const float v = static_cast<float>(y + Util::RandomFloat()) / static_cast<float>(settings.height);
+				paths.push_back({ camera.GetRay(u, v), Vector3(1.0f, 1.0f, 1.0f), static_cast<uint32_t>(pixel), ScatterOrigin() });
+			}
+		}
+
+		for (int depth = settings.maxBounces; depth > 0 && !paths.empty(); depth--)
+		{
+			if (sortRays && depth < settings.maxBounces)
+			{
+				//Morton cells span the bounce's own origins, the scene bounds can be far larger than where rays are
+				Vector3 minimum = paths[0].ray.Origin();
+				Vector3 maximum = minimum;
+				for (const PathState& path : paths)
+				{
+					minimum = Vector3(std::min(minimum.x, path.ray.Origin().x), std::min(minimum.y, path.ray.Origin().y), std::min(minimum.z, path.ray.Origin().z));
+					maximum = Vector3(std::max(maximum.x, path.ray.Origin().x), std::max(maximum.y, path.ray.Origin().y), std::max(maximum.z, path.ray.Origin().z));
+				}
+				const AABB originBounds(minimum, maximum);
+
+				sortEntries.clear();
+				for (size_t i = 0; i < paths.size(); i++)
+				{
+					sortEntries.push_back((static_cast<uint64_t>(RaySort::Key(paths[i].ray, originBounds)) << 32) | i);
+				}
+				RaySort::SortByKey(sortEntries, sortScratch);
+
+				nextPaths.clear();
+				for (uint64_t entry : sortEntries)
+				{
+					nextPaths.push_back(paths[static_cast<uint32_t>(entry)]);
+				}
+				paths.swap(nextPaths);
+			}
+
+			nextPaths.clear();
+			for (const PathState& path : paths)
+			{
+#if RAYTRACING_STATISTICS
+				Statistics::BeginPixel();
+#endif
+				const Bounce bounce = TraceBounce(path.ray, scene, path.origin, settings.legacyMaterials);
+				colours[path.pixel] += path.throughput * bounce.radiance;
+#if RAYTRACING_STATISTICS
+				tileCounters += Statistics::Current();
+				if (pixelCounters != nullptr)
+				{
+					(*pixelCounters)[path.pixel] += Statistics::Current();
+				}
+#endif
+
+				if (bounce.continues)
+				{
+					nextPaths.push_back({ bounce.scattered, path.throughput * bounce.attenuation, path.pixel, bounce.origin });
+				}
+			}
+			paths.swap(nextPaths);
+		}
+	}
+
+#if RAYTRACING_STATISTICS
+	Statistics::Current() = tileCounters;
+	Statistics::EndPixel();
+#endif
+}
+
+unsigned int Renderer::PixelSeed(unsigned int seed, size_t x, size_t y)
+{
+	//SplitMix64 finaliser over the combined coordinates
+	uint64_t hash = (static_cast<uint64_t>(seed) << 32) ^ (static_cast<uint64_t>(y) << 16) ^ static_cast<uint64_t>(x);
+	hash += 0x9E3779B97F4A7C15ull;
+	hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+	hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+	hash ^= hash >> 31;
+	return static_cast<unsigned int>(hash);
+}
+
+uint64_t Renderer::TakeRayCount()
+{
+	uint64_t count = rayCount;
+	rayCount = 0;
+	return count;
+}
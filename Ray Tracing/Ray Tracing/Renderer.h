@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Camera.h"
+#include "Hittable.h"
+#include "Ray.h"
+#include "Scenes.h"
+#include "Statistics.h"
+#include "Vector3.h"
+
+#include <cstdint>
+#include <vector>
+
+struct RenderSettings
+{
+	size_t width = 1920;
+	size_t height = 1080;
+	size_t samplesPerPixel = 100;
+	int maxBounces = 50;
+	bool legacyMaterials = false; //Trace with Material::Scatter and light sampling on diffuse surfaces only, as before BSDF sampling
+};
+
+namespace Renderer
+{
+	//Radiance arriving along a camera ray. Surfaces that sample the scene's lights directly weight the emission their
+	//bounces find against those samples, or with legacyMaterials leave it out since the sample already counted it.
+	Vector3 Colour(const Ray& r, const Scene& scene, int depth, bool legacyMaterials = false);
+
+	//Traces one jittered camera ray through the pixel
+	Vector3 RenderSample(size_t x, size_t y, const Scene& scene, const Camera& camera, const RenderSettings& settings);
+
+	//Returns the sum of all samples taken for the pixel, the caller divides by the sample count.
+	//With RAYTRACING_STATISTICS enabled the pixel's counters are left in Statistics::Current().
+	Vector3 RenderPixel(size_t x, size_t y, const Scene& scene, const Camera& camera, const RenderSettings& settings);
+
+	//Renders the pixels in [x0, x1) x [y0, y1) breadth first: every path of the tile advances one bounce at a time.
+	//With sortRays the secondary rays of each bounce are traced in order of direction octant and origin Morton
+	//code so consecutive rays walk the same BVH nodes. Random numbers are drawn in tracing order, so seed the
+	//calling thread per tile for repeatable images. colours receives each pixel's sum of samples, row by row.
+	//pixelCounters, when given, receives each pixel's traversal counters in the same order; they stay zero unless
+	//RAYTRACING_STATISTICS is enabled. Statistics::Current() is left holding the whole tile's counters.
+	void RenderTile(size_t x0, size_t y0, size_t x1, size_t y1, const Scene& scene, const Camera& camera, const RenderSettings& settings, bool sortRays, std::vector<Vector3>& colours, std::vector<TraversalCounters>* pixelCounters = nullptr);
+
+	//Seed for a pixel's random numbers, so a pixel renders identically whichever thread or process traces it
+	unsigned int PixelSeed(unsigned int seed, size_t x, size_t y);
+
+	//Returns the number of rays traced by the calling thread since the last call and resets it
+	uint64_t TakeRayCount();
+}
@@ -0,0 +1,97 @@
+#include "SceneCache.h"
+
+#include "Hittable.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <iostream>
+#include <system_error>
+
+namespace
+{
+	//A scene file rewritten since it was mapped is loaded again
+	std::string FileKey(const std::filesystem::path& path)
+	{
+		std::error_code error;
+		const auto modified = std::filesystem::last_write_time(path, error);
+		return path.string() + "@" + (error ? "" : std::to_string(modified.time_since_epoch().count()));
+	}
+}
+
+SceneCache::SceneCache(const std::filesystem::path& directory, size_t capacity, const CompileOptions& compileOptions, ThreadPool* threadPool)
+	: directory(directory), capacity(std::max<size_t>(1, capacity)), compileOptions(compileOptions), threadPool(threadPool)
+{
+}
+
+SceneCache::~SceneCache()
+{
+	for (Entry& entry : entries)
+	{
+		delete entry.scene.world;
+	}
+}
+
+const Scene* SceneCache::Get(SceneId id, unsigned int seed, const std::string& sceneFile, bool& wasCached)
+{
+	const std::filesystem::path path = sceneFile.empty() ? CompiledPath(id, seed) : std::filesystem::path(sceneFile);
+
+	const std::string key = FileKey(path);
+
+	auto found = std::find_if(entries.begin(), entries.end(), [&key](const Entry& entry) { return entry.key == key; });
+	wasCached = found != entries.end();
+	if (wasCached)
+	{
+		found->lastUse = ++clock;
+		return &found->scene;
+	}
+
+	Scene scene;
+	const bool onDisk = !sceneFile.empty() || std::filesystem::exists(path);
+	if (!onDisk || !Scenes::Load(path, scene))
+	{
+		if (!sceneFile.empty())
+		{
+			return nullptr;
+		}
+
+		//The scene graph built to compile from is never freed, but it is only built once per cache directory
+		std::cout << "Compiling " << Scenes::GetName(id) << " to " << path.string() << "\n";
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		Util::SeedRandom(seed);
+		if (!Scenes::Compile(Scenes::Create(id), path, compileOptions, threadPool) || !Scenes::Load(path, scene))
+		{
+			return nullptr;
+		}
+	}
+
+	if (entries.size() >= capacity)
+	{
+		auto oldest = std::min_element(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+		delete oldest->scene.world;
+		entries.erase(oldest);
+	}
+
+	//Compiling changes the file's time, key it by the file that was actually loaded
+	entries.push_back({ FileKey(path), scene, ++clock });
+	return &entries.back().scene;
+}
+
+std::filesystem::path SceneCache::CompiledPath(SceneId id, unsigned int seed) const
+{
+	std::string name = std::string(Scenes::GetName(id)) + "-" + std::to_string(seed);
+	if (compileOptions.duplicationBudget > 0.0f)
+	{
+		name += "-sbvh" + std::to_string(compileOptions.duplicationBudget);
+	}
+	if (compileOptions.nodeLayout == SceneFormat::NodeLayout::Wide)
+	{
+		name += "-wide";
+	}
+	if (compileOptions.clusterSize > 0)
+	{
+		name += "-clusters" + std::to_string(compileOptions.clusterSize);
+	}
+
+	return directory / (name + ".rtscene");
+}
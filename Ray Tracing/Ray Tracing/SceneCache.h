@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Scenes.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+//Compiled scenes kept mapped between the jobs of a render daemon, evicting the least recently used once more than
+//capacity are loaded. Built in scenes are compiled into directory the first time they are asked for and mapped
+//from there afterwards, so a scene is only ever built once per seed and compile options, even across restarts.
+class SceneCache
+{
+public:
+	//Scenes are compiled on threadPool if given
+	SceneCache(const std::filesystem::path& directory, size_t capacity, const CompileOptions& compileOptions, ThreadPool* threadPool = nullptr);
+	~SceneCache();
+
+	SceneCache(const SceneCache&) = delete;
+	SceneCache& operator=(const SceneCache&) = delete;
+
+	//Loads sceneFile if it isn't empty, otherwise the compiled form of id built with seed. Returns nullptr if the
+	//scene can't be loaded. The scene stays valid until the next call, which may evict it.
+	const Scene* Get(SceneId id, unsigned int seed, const std::string& sceneFile, bool& wasCached);
+
+private:
+	struct Entry
+	{
+		std::string key;
+		Scene scene;
+		uint64_t lastUse;
+	};
+
+	std::filesystem::path CompiledPath(SceneId id, unsigned int seed) const;
+
+	std::filesystem::path directory;
+	size_t capacity;
+	CompileOptions compileOptions;
+	ThreadPool* threadPool;
+	std::vector<Entry> entries;
+	uint64_t clock = 0;
+};
@@ -0,0 +1,555 @@
+#include "SceneCompiler.h"
+
+#include "Hittable.h"
+#include "LightBVHBuilder.h"
+#include "Material.h"
+#include "Quad.h"
+#include "Texture.h"
+#include "Util.h"
+#include "WideBVHBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	void AppendBytes(std::vector<uint8_t>& destination, const void* bytes, size_t size)
+	{
+		const uint8_t* begin = static_cast<const uint8_t*>(bytes);
+		destination.insert(destination.end(), begin, begin + size);
+	}
+
+	void StoreVector(float destination[3], const Vector3& v)
+	{
+		destination[0] = v.x;
+		destination[1] = v.y;
+		destination[2] = v.z;
+	}
+
+	//Bounds of the part of a primitive inside box, exact for spheres and as tight as box otherwise
+	AABB ClipPrimitive(const SceneFormat::Primitive& primitive, const AABB& box)
+	{
+		if (primitive.type != SceneFormat::PrimitiveType::Sphere)
+		{
+			return box;
+		}
+
+		const Vector3 center(primitive.data[0], primitive.data[1], primitive.data[2]);
+		const float radius = primitive.data[3];
+
+		//Distance from the center to the box along each axis
+		Vector3 gap;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			gap.v[axis] = std::max(0.0f, std::max(box.Min().v[axis] - center.v[axis], center.v[axis] - box.Max().v[axis]));
+		}
+
+		if (gap.SquaredLength() > radius * radius)
+		{
+			const float max = std::numeric_limits<float>::max();
+			return AABB(Vector3(max, max, max), Vector3(-max, -max, -max));
+		}
+
+		//Inside the box the sphere is no wider along an axis than its cross section at the nearest point on the other two
+		Vector3 minimum;
+		Vector3 maximum;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float gapSquared = gap.SquaredLength() - gap.v[axis] * gap.v[axis];
+			const float halfExtent = std::sqrt(std::max(0.0f, radius * radius - gapSquared));
+			minimum.v[axis] = std::max(box.Min().v[axis], center.v[axis] - halfExtent);
+			maximum.v[axis] = std::min(box.Max().v[axis], center.v[axis] + halfExtent);
+		}
+
+		return AABB(minimum, maximum);
+	}
+}
+
+SceneCompiler::SceneCompiler(const CompileOptions& options, ThreadPool* threadPool)
+	: options(options), threadPool(threadPool)
+{
+}
+
+bool SceneCompiler::Compile(const Scene& scene, const std::filesystem::path& path)
+{
+	std::vector<PendingPrimitive> topLevel;
+	currentTree = &topLevel;
+
+	for (const Hittable* object : scene.objects)
+	{
+		if (!object->Compile(*this))
+		{
+			std::cerr << "Scene contains an object that can't be compiled\n";
+			return false;
+		}
+	}
+
+	currentTree = nullptr;
+
+	if (options.clusterSize > 0)
+	{
+		BuildClusters(topLevel);
+	}
+
+	//Lights inside instances would need their transforms applied, only top level emitters are sampled
+	const size_t firstTopLevel = tree.primitives.size();
+
+	uint32_t root;
+	std::vector<uint32_t> topLevelOrder;
+	if (!BuildTree(topLevel, tree, root, topLevelOrder))
+	{
+		return false;
+	}
+
+	BuildLights(firstTopLevel, topLevelOrder);
+
+	SceneFormat::Header header = {};
+	std::memcpy(header.magic, SceneFormat::Magic, sizeof(header.magic));
+	header.version = SceneFormat::Version;
+	header.headerSize = sizeof(SceneFormat::Header);
+	header.rootNode = root;
+	header.nodeLayout = options.nodeLayout;
+	StoreVector(header.lookFrom, scene.lookFrom);
+	StoreVector(header.lookAt, scene.lookAt);
+	header.verticalFov = scene.verticalFov;
+	header.aperture = scene.aperture;
+	header.focusDistance = scene.focusDistance;
+	StoreVector(header.background, scene.background);
+
+	const std::pair<const void*, size_t> sections[] = {
+		{ tree.nodes.data(), tree.nodes.size() * sizeof(SceneFormat::Node) },
+		{ tree.primitives.data(), tree.primitives.size() * sizeof(SceneFormat::Primitive) },
+		{ materials.data(), materials.size() * sizeof(SceneFormat::Material) },
+		{ textures.data(), textures.size() * sizeof(SceneFormat::Texture) },
+		{ data.data(), data.size() },
+		{ lightNodes.data(), lightNodes.size() * sizeof(SceneFormat::LightNode) },
+		{ lights.data(), lights.size() * sizeof(SceneFormat::Light) },
+		{ tree.wideNodes.data(), tree.wideNodes.size() * sizeof(SceneFormat::WideNode) },
+		{ clusters.data(), clusters.size() * sizeof(SceneFormat::Cluster) },
+		{ clusterData.data(), clusterData.size() }
+	};
+	const size_t counts[] = { tree.nodes.size(), tree.primitives.size(), materials.size(), textures.size(), data.size(), lightNodes.size(), lights.size(),
+		tree.wideNodes.size(), clusters.size(), clusterData.size() };
+
+	uint64_t offset = AlignUp(sizeof(header), SceneFormat::SectionAlignment);
+	for (size_t i = 0; i < static_cast<size_t>(SceneFormat::Section::Count); i++)
+	{
+		if (i == static_cast<size_t>(SceneFormat::Section::ClusterData))
+		{
+			offset = AlignUp(offset, SceneFormat::ClusterAlignment);
+		}
+
+		header.sections[i].offset = offset;
+		header.sections[i].count = counts[i];
+		offset = AlignUp(offset + sections[i].second, SceneFormat::SectionAlignment);
+	}
+	header.fileSize = offset;
+
+	std::vector<uint8_t> file(static_cast<size_t>(header.fileSize), 0);
+	for (size_t i = 0; i < static_cast<size_t>(SceneFormat::Section::Count); i++)
+	{
+		if (sections[i].second > 0)
+		{
+			std::memcpy(file.data() + header.sections[i].offset, sections[i].first, sections[i].second);
+		}
+	}
+
+	//The checksum covers the header too, it is computed while the checksum field is still zero
+	std::memcpy(file.data(), &header, sizeof(header));
+	header.checksum = SceneFormat::Checksum(file.data(), file.size());
+	std::memcpy(file.data(), &header, sizeof(header));
+
+	std::ofstream stream(path, std::ios::binary);
+	if (!stream.is_open() || !stream.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size())))
+	{
+		std::cerr << "Unable to write " << path << "\n";
+		return false;
+	}
+
+	return true;
+}
+
+void SceneCompiler::AddPrimitive(const Hittable& source, const SceneFormat::Primitive& primitive)
+{
+	PendingPrimitive pending;
+	pending.primitive = primitive;
+	pending.primitive.light = SceneFormat::InvalidIndex;
+	source.BoundingBox(0.0f, 1.0f, pending.bounds);
+	currentTree->push_back(pending);
+}
+
+bool SceneCompiler::AddSubtree(const Hittable& object, uint32_t& root)
+{
+	std::vector<PendingPrimitive> subtree;
+	std::vector<PendingPrimitive>* parentTree = currentTree;
+	currentTree = &subtree;
+
+	const bool compiled = object.Compile(*this);
+
+	currentTree = parentTree;
+
+	std::vector<uint32_t> order;
+	return compiled && BuildTree(subtree, tree, root, order);
+}
+
+bool SceneCompiler::AddMaterial(const Material* material, uint32_t& index)
+{
+	const auto existing = materialIndices.find(material);
+	if (existing != materialIndices.end())
+	{
+		index = existing->second;
+		return true;
+	}
+
+	SceneFormat::Material record = {};
+	record.texture = SceneFormat::InvalidIndex;
+	if (material == nullptr || !material->Compile(*this, record))
+	{
+		std::cerr << "Scene contains a material that can't be compiled\n";
+		return false;
+	}
+
+	index = static_cast<uint32_t>(materials.size());
+	materials.push_back(record);
+	materialIndices.emplace(material, index);
+	materialSources.push_back(material);
+	return true;
+}
+
+bool SceneCompiler::AddTexture(const Texture* texture, uint32_t& index)
+{
+	const auto existing = textureIndices.find(texture);
+	if (existing != textureIndices.end())
+	{
+		index = existing->second;
+		return true;
+	}
+
+	SceneFormat::Texture record = {};
+	record.children[0] = SceneFormat::InvalidIndex;
+	record.children[1] = SceneFormat::InvalidIndex;
+	if (texture == nullptr || !texture->Compile(*this, record))
+	{
+		std::cerr << "Scene contains a texture that can't be compiled\n";
+		return false;
+	}
+
+	index = static_cast<uint32_t>(textures.size());
+	textures.push_back(record);
+	textureIndices.emplace(texture, index);
+	return true;
+}
+
+uint64_t SceneCompiler::AddData(const void* bytes, size_t size)
+{
+	//Keep every block aligned for the largest type stored in it
+	data.resize(static_cast<size_t>(AlignUp(data.size(), 8)));
+
+	const uint64_t offset = data.size();
+	const uint8_t* begin = static_cast<const uint8_t*>(bytes);
+	data.insert(data.end(), begin, begin + size);
+	return offset;
+}
+
+bool SceneCompiler::BuildTree(const std::vector<PendingPrimitive>& pending, Tree& tree, uint32_t& root, std::vector<uint32_t>& order)
+{
+	if (pending.empty())
+	{
+		std::cerr << "Can't compile an empty scene or instance\n";
+		return false;
+	}
+
+	std::vector<AABB> bounds;
+	bounds.reserve(pending.size());
+	for (const PendingPrimitive& primitive : pending)
+	{
+		bounds.push_back(primitive.bounds);
+	}
+
+	std::vector<BVHBuilder::Node> treeNodes;
+	CreateBuilder(pending).Build(bounds, treeNodes, order, threadPool);
+
+	const uint32_t nodeBase = static_cast<uint32_t>(tree.nodes.size());
+	const uint32_t primitiveBase = static_cast<uint32_t>(tree.primitives.size());
+
+	for (uint32_t index : order)
+	{
+		tree.primitives.push_back(pending[index].primitive);
+	}
+
+	if (options.nodeLayout == SceneFormat::NodeLayout::Wide)
+	{
+		root = WideBVHBuilder().Build(treeNodes, primitiveBase, tree.wideNodes);
+		return true;
+	}
+
+	for (const BVHBuilder::Node& treeNode : treeNodes)
+	{
+		SceneFormat::Node node;
+		StoreVector(node.minimum, treeNode.bounds.Min());
+		StoreVector(node.maximum, treeNode.bounds.Max());
+		node.count = static_cast<uint16_t>(treeNode.count);
+		node.axis = static_cast<uint16_t>(treeNode.axis);
+		node.rightOrFirst = treeNode.rightOrFirst + (treeNode.count > 0 ? primitiveBase : nodeBase);
+		tree.nodes.push_back(node);
+	}
+
+	root = nodeBase;
+	return true;
+}
+
+BVHBuilder SceneCompiler::CreateBuilder(const std::vector<PendingPrimitive>& pending) const
+{
+	BVHBuilder builder;
+	if (options.duplicationBudget > 0.0f)
+	{
+		builder.EnableSpatialSplits(options.duplicationBudget, [&pending](uint32_t primitive, const AABB& box)
+			{
+				return ClipPrimitive(pending[primitive].primitive, box);
+			});
+	}
+	return builder;
+}
+
+void SceneCompiler::BuildClusters(std::vector<PendingPrimitive>& topLevel)
+{
+	//Emitters stay at the top level so the light BVH can refer to them, instances already have their own subtree
+	std::vector<PendingPrimitive> clustered;
+	std::vector<PendingPrimitive> remaining;
+	for (const PendingPrimitive& pending : topLevel)
+	{
+		const SceneFormat::PrimitiveType type = pending.primitive.type;
+		const bool instance = type == SceneFormat::PrimitiveType::Translation || type == SceneFormat::PrimitiveType::YRotation;
+		const bool emitter = pending.primitive.material != SceneFormat::InvalidIndex && materials[pending.primitive.material].type == SceneFormat::MaterialType::DiffuseLight;
+		(instance || emitter ? remaining : clustered).push_back(pending);
+	}
+
+	if (clustered.empty())
+	{
+		return;
+	}
+
+	//Clusters are the largest subtrees of a full tree over the primitives that fit, so they follow the
+	//same partition the tree would have used and the top level tree rebuilds roughly its upper levels
+	std::vector<AABB> bounds;
+	for (const PendingPrimitive& pending : clustered)
+	{
+		bounds.push_back(pending.bounds);
+	}
+
+	std::vector<BVHBuilder::Node> treeNodes;
+	std::vector<uint32_t> order;
+	CreateBuilder(clustered).Build(bounds, treeNodes, order, threadPool);
+
+	//Leaves are written depth first, so every subtree covers a contiguous range of order
+	std::vector<std::pair<uint32_t, uint32_t>> ranges(treeNodes.size());
+	for (size_t i = treeNodes.size(); i-- > 0;)
+	{
+		const BVHBuilder::Node& node = treeNodes[i];
+		ranges[i] = node.count > 0 ? std::make_pair(node.rightOrFirst, node.rightOrFirst + node.count) : std::make_pair(ranges[i + 1].first, ranges[node.rightOrFirst].second);
+	}
+
+	std::vector<uint32_t> stack = { 0 };
+	while (!stack.empty())
+	{
+		const uint32_t node = stack.back();
+		stack.pop_back();
+
+		if (treeNodes[node].count == 0 && ranges[node].second - ranges[node].first > options.clusterSize)
+		{
+			stack.push_back(treeNodes[node].rightOrFirst);
+			stack.push_back(node + 1);
+			continue;
+		}
+
+		std::vector<PendingPrimitive> cluster;
+		for (uint32_t i = ranges[node].first; i < ranges[node].second; i++)
+		{
+			cluster.push_back(clustered[order[i]]);
+		}
+		remaining.push_back(WriteCluster(cluster));
+	}
+
+	topLevel = std::move(remaining);
+}
+
+SceneCompiler::PendingPrimitive SceneCompiler::WriteCluster(const std::vector<PendingPrimitive>& pending)
+{
+	Tree clusterTree;
+	uint32_t root;
+	std::vector<uint32_t> order;
+	BuildTree(pending, clusterTree, root, order);
+
+	SceneFormat::Cluster cluster = {};
+	cluster.offset = AlignUp(clusterData.size(), SceneFormat::ClusterAlignment);
+	cluster.root = root;
+	cluster.primitiveCount = static_cast<uint32_t>(clusterTree.primitives.size());
+	clusterData.resize(static_cast<size_t>(cluster.offset));
+
+	if (options.nodeLayout == SceneFormat::NodeLayout::Wide)
+	{
+		cluster.nodeCount = static_cast<uint32_t>(clusterTree.wideNodes.size());
+		AppendBytes(clusterData, clusterTree.wideNodes.data(), clusterTree.wideNodes.size() * sizeof(SceneFormat::WideNode));
+	}
+	else
+	{
+		cluster.nodeCount = static_cast<uint32_t>(clusterTree.nodes.size());
+		AppendBytes(clusterData, clusterTree.nodes.data(), clusterTree.nodes.size() * sizeof(SceneFormat::Node));
+	}
+
+	clusterData.resize(static_cast<size_t>(AlignUp(clusterData.size(), SceneFormat::SectionAlignment)));
+	cluster.primitiveOffset = clusterData.size() - cluster.offset;
+	AppendBytes(clusterData, clusterTree.primitives.data(), clusterTree.primitives.size() * sizeof(SceneFormat::Primitive));
+	cluster.size = clusterData.size() - cluster.offset;
+
+	AABB bounds = pending[0].bounds;
+	for (const PendingPrimitive& primitive : pending)
+	{
+		bounds = AABB::SurroundingBox(bounds, primitive.bounds);
+	}
+	StoreVector(cluster.minimum, bounds.Min());
+	StoreVector(cluster.maximum, bounds.Max());
+
+	PendingPrimitive reference = {};
+	reference.primitive.type = SceneFormat::PrimitiveType::Cluster;
+	reference.primitive.material = SceneFormat::InvalidIndex;
+	reference.primitive.child = static_cast<uint32_t>(clusters.size());
+	reference.primitive.light = SceneFormat::InvalidIndex;
+	reference.bounds = bounds;
+
+	clusters.push_back(cluster);
+	return reference;
+}
+
+void SceneCompiler::BuildLights(size_t first, const std::vector<uint32_t>& order)
+{
+	std::vector<LightBounds> bounds;
+	std::vector<uint32_t> lightPrimitives;
+	std::unordered_map<uint32_t, uint32_t> pendingLights;
+
+	for (size_t i = first; i < tree.primitives.size(); i++)
+	{
+		const SceneFormat::Primitive& primitive = tree.primitives[i];
+
+		const auto existing = pendingLights.find(order[i - first]);
+		if (existing != pendingLights.end())
+		{
+			tree.primitives[i].light = existing->second;
+			continue;
+		}
+
+		const float* values = primitive.data;
+
+		LightBounds light;
+		float area = 0.0f;
+		Vector3 center;
+
+		switch (primitive.type)
+		{
+		case SceneFormat::PrimitiveType::Sphere:
+			center = Vector3(values[0], values[1], values[2]);
+			area = 4.0f * Util::R_PI * values[3] * values[3];
+			light.bounds = AABB(center - Vector3(values[3], values[3], values[3]), center + Vector3(values[3], values[3], values[3]));
+			light.cosThetaO = -1.0f;
+			break;
+
+		case SceneFormat::PrimitiveType::XYRectangle:
+		case SceneFormat::PrimitiveType::XZRectangle:
+		case SceneFormat::PrimitiveType::YZRectangle:
+		{
+			//Rectangles store the ranges of their two in plane axes then the plane's position on the third
+			const int normalAxis = primitive.type == SceneFormat::PrimitiveType::XYRectangle ? 2 : (primitive.type == SceneFormat::PrimitiveType::XZRectangle ? 1 : 0);
+			const int firstAxis = normalAxis == 0 ? 1 : 0;
+			const int secondAxis = normalAxis == 2 ? 1 : 2;
+
+			Vector3 minimum;
+			Vector3 maximum;
+			minimum.v[firstAxis] = values[0];
+			maximum.v[firstAxis] = values[1];
+			minimum.v[secondAxis] = values[2];
+			maximum.v[secondAxis] = values[3];
+			minimum.v[normalAxis] = values[4];
+			maximum.v[normalAxis] = values[4];
+
+			center = 0.5f * (minimum + maximum);
+			area = (values[1] - values[0]) * (values[3] - values[2]);
+			light.bounds = AABB(minimum, maximum);
+			light.axis = Vector3(0.0f, 0.0f, 0.0f);
+			light.axis.v[normalAxis] = 1.0f;
+			light.cosThetaO = 1.0f;
+			light.twoSided = true;
+			break;
+		}
+
+		case SceneFormat::PrimitiveType::Quad:
+		{
+			//Quads store their corner and then their two edges
+			const Vector3 corner = Vector3::Load(values);
+			const Vector3 edgeU = Vector3::Load(values + 3);
+			const Vector3 edgeV = Vector3::Load(values + 6);
+			const Quad quad(corner, edgeU, edgeV, nullptr);
+
+			center = corner + 0.5f * (edgeU + edgeV);
+			area = quad.Area();
+			quad.BoundingBox(0.0f, 1.0f, light.bounds);
+			light.axis = GetNormalized(CrossProduct(edgeU, edgeV));
+			light.cosThetaO = 1.0f;
+			light.twoSided = true;
+			break;
+		}
+
+		default:
+			continue;
+		}
+
+		//Diffuse emitters radiate over the whole hemisphere around each normal
+		const Vector3 radiance = materialSources[primitive.material]->Emitted(0.5f, 0.5f, center);
+		const float luminance = 0.2126f * radiance.x + 0.7152f * radiance.y + 0.0722f * radiance.z;
+		light.power = luminance * area * Util::R_PI * (light.twoSided ? 2.0f : 1.0f);
+		light.cosThetaE = 0.0f;
+
+		if (light.power > 0.0f)
+		{
+			tree.primitives[i].light = static_cast<uint32_t>(bounds.size());
+			pendingLights.emplace(order[i - first], tree.primitives[i].light);
+			bounds.push_back(light);
+			lightPrimitives.push_back(static_cast<uint32_t>(i));
+		}
+	}
+
+	std::vector<LightBVHBuilder::Node> treeNodes;
+	std::vector<uint64_t> trails;
+	LightBVHBuilder().Build(bounds, treeNodes, trails);
+
+	for (const LightBVHBuilder::Node& treeNode : treeNodes)
+	{
+		SceneFormat::LightNode node = {};
+		StoreVector(node.minimum, treeNode.bounds.bounds.Min());
+		StoreVector(node.maximum, treeNode.bounds.bounds.Max());
+		StoreVector(node.axis, treeNode.bounds.axis);
+		node.power = treeNode.bounds.power;
+		node.cosThetaO = treeNode.bounds.cosThetaO;
+		node.cosThetaE = treeNode.bounds.cosThetaE;
+		node.rightOrLight = treeNode.rightOrLight;
+		node.leaf = treeNode.leaf ? 1 : 0;
+		node.twoSided = treeNode.bounds.twoSided ? 1 : 0;
+		lightNodes.push_back(node);
+	}
+
+	for (size_t i = 0; i < lightPrimitives.size(); i++)
+	{
+		SceneFormat::Light light = {};
+		light.primitive = lightPrimitives[i];
+		light.trail = trails[i];
+		lights.push_back(light);
+	}
+}
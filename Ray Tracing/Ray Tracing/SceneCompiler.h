@@ -0,0 +1,101 @@
+#pragma once
+
+#include "AABB.h"
+#include "BVHBuilder.h"
+#include "SceneFormat.h"
+#include "Scenes.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+class Hittable;
+class Material;
+class Texture;
+class ThreadPool;
+
+//Flattens a scene into the SceneFormat blob. Hittables, materials and textures describe themselves
+//through their Compile functions, the compiler deduplicates shared materials and textures and builds
+//a SAH BVH over the primitives of the scene and of every instanced subtree. Top level emitters also get a
+//light BVH so the renderer can pick the lights that matter for each shading point.
+//
+//With a cluster size set, the top level primitives are grouped into spatially coherent clusters that each
+//get their own page aligned block and BVH, and the top level tree only references the clusters. Tracing
+//then touches the pages of the clusters a ray actually enters, so scenes larger than memory stream through
+//the page cache. Emitters and instances stay at the top level.
+class SceneCompiler
+{
+public:
+	//A duplicationBudget above zero builds spatial split BVHs (SBVH), straddling primitives are then clipped
+	//into both children instead of bloating them. NodeLayout::Wide stores the trees as quantized 4 wide nodes.
+	//Given a pool, large BVHs without spatial splits are built in parallel.
+	explicit SceneCompiler(const CompileOptions& options = CompileOptions(), ThreadPool* threadPool = nullptr);
+
+	bool Compile(const Scene& scene, const std::filesystem::path& path);
+
+	//Adds a primitive to the tree currently being built, bounds are taken from source
+	void AddPrimitive(const Hittable& source, const SceneFormat::Primitive& primitive);
+
+	//Compiles object into its own tree and returns the root node, used by instances
+	bool AddSubtree(const Hittable& object, uint32_t& root);
+
+	bool AddMaterial(const Material* material, uint32_t& index);
+	bool AddTexture(const Texture* texture, uint32_t& index);
+
+	//Appends raw bytes to the data section and returns their offset within it
+	uint64_t AddData(const void* bytes, size_t size);
+
+private:
+	struct PendingPrimitive
+	{
+		SceneFormat::Primitive primitive;
+		AABB bounds;
+	};
+
+	struct Tree
+	{
+		std::vector<SceneFormat::Node> nodes;
+		std::vector<SceneFormat::WideNode> wideNodes;
+		std::vector<SceneFormat::Primitive> primitives;
+	};
+
+	//Appends a BVH over pending to tree, order receives the index into pending of every primitive written
+	//and spatial splits can repeat them
+	bool BuildTree(const std::vector<PendingPrimitive>& pending, Tree& tree, uint32_t& root, std::vector<uint32_t>& order);
+
+	//Moves every primitive of topLevel that can live in a cluster into one, replacing them with cluster primitives
+	void BuildClusters(std::vector<PendingPrimitive>& topLevel);
+
+	//Configured for the options, the clipper refers to pending so it must outlive the builder
+	BVHBuilder CreateBuilder(const std::vector<PendingPrimitive>& pending) const;
+
+	//Writes a cluster's tree to the cluster data section and returns the primitive that references it
+	PendingPrimitive WriteCluster(const std::vector<PendingPrimitive>& pending);
+
+	//Builds the light BVH over the emitting spheres and rectangles among the primitives written from first onwards,
+	//order maps them back to the pending primitive they were made from so duplicates share one light
+	void BuildLights(size_t first, const std::vector<uint32_t>& order);
+
+	//The top level tree and every instanced subtree
+	Tree tree;
+
+	std::vector<SceneFormat::Material> materials;
+	std::vector<SceneFormat::Texture> textures;
+	std::vector<uint8_t> data;
+	std::vector<SceneFormat::LightNode> lightNodes;
+	std::vector<SceneFormat::Light> lights;
+	std::vector<SceneFormat::Cluster> clusters;
+	std::vector<uint8_t> clusterData;
+
+	//Source of each compiled material, used to estimate how much light an emitter gives off
+	std::vector<const Material*> materialSources;
+
+	std::unordered_map<const Material*, uint32_t> materialIndices;
+	std::unordered_map<const Texture*, uint32_t> textureIndices;
+
+	std::vector<PendingPrimitive>* currentTree = nullptr;
+
+	CompileOptions options;
+	ThreadPool* threadPool;
+};
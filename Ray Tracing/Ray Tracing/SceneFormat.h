@@ -0,0 +1,237 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//On disk layout of a compiled scene. Everything is plain data addressed by index or by byte offset from
+//the start of its section, so the file can be memory mapped and traced directly without any pointer fixups.
+//Values are stored in the byte order of the machine that compiled the scene.
+namespace SceneFormat
+{
+	constexpr char Magic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0' };
+	constexpr uint32_t Version = 5;
+
+	//Sections start on cache line boundaries
+	constexpr uint64_t SectionAlignment = 64;
+
+	//Clusters start on page boundaries so each one can be paged in and released on its own
+	constexpr uint64_t ClusterAlignment = 4096;
+
+	constexpr uint32_t InvalidIndex = 0xFFFFFFFF;
+
+	enum class Section : uint32_t
+	{
+		Nodes,
+		Primitives,
+		Materials,
+		Textures,
+		Data,
+		LightNodes,
+		Lights,
+		WideNodes,
+		Clusters,
+		ClusterData, //Starts on a ClusterAlignment boundary, counted in bytes
+		Count
+	};
+
+	//Which node section the root node, instance children and traversal use. The other section is left empty.
+	enum class NodeLayout : uint32_t
+	{
+		Binary,
+		Wide
+	};
+
+	struct SectionRange
+	{
+		uint64_t offset; //From the start of the file
+		uint64_t count; //Records, or bytes for the data section
+	};
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t headerSize;
+		uint64_t fileSize;
+		uint64_t checksum; //FNV-1a of the whole file with this field zeroed
+
+		uint32_t rootNode;
+		NodeLayout nodeLayout;
+
+		float lookFrom[3];
+		float lookAt[3];
+		float verticalFov;
+		float aperture;
+		float focusDistance;
+		float background[3];
+
+		SectionRange sections[static_cast<uint32_t>(Section::Count)];
+	};
+
+	//Nodes are stored depth first so an interior node's left child directly follows it
+	struct Node
+	{
+		float minimum[3];
+		uint32_t rightOrFirst; //Right child of an interior node or the first primitive of a leaf
+		float maximum[3];
+		uint16_t count; //Primitive count, zero for interior nodes
+		uint16_t axis; //Split axis of an interior node, used to visit the nearer child first
+	};
+
+	//Compressed node with up to four children in one cache line. Child bounds are stored as 8 bit offsets from
+	//origin in steps of 2^exponent along each axis, rounded outwards so the decoded boxes always contain the
+	//exact ones. A child with a non zero count is a leaf of that many primitives starting at child, an interior
+	//child is the index of another wide node and unused slots hold InvalidIndex.
+	struct WideNode
+	{
+		float origin[3];
+		int8_t exponent[3];
+		uint8_t reserved;
+		uint32_t child[4];
+		uint8_t lower[3][4];
+		uint8_t upper[3][4];
+		uint8_t count[4];
+		uint32_t padding;
+	};
+
+	constexpr uint32_t WideNodeWidth = 4;
+
+	//Exponents stay within the range of normal floats so the step can be built straight from its bits
+	constexpr int MinimumExponent = -126;
+	constexpr int MaximumExponent = 127;
+
+	//Step between quantized values along an axis, 2^exponent
+	inline float QuantizationStep(int8_t exponent)
+	{
+		const uint32_t bits = static_cast<uint32_t>(exponent + 127) << 23;
+		float step;
+		std::memcpy(&step, &bits, sizeof(step));
+		return step;
+	}
+
+	//Decoding is defined here so the compiler rounds with exactly the arithmetic that traversal uses
+	inline float Dequantize(float origin, uint8_t value, float step)
+	{
+		return origin + static_cast<float>(value) * step;
+	}
+
+	enum class PrimitiveType : uint32_t
+	{
+		Sphere,
+		MovingSphere,
+		XYRectangle,
+		XZRectangle,
+		YZRectangle,
+		Translation,
+		YRotation,
+		Cluster,
+		Box,
+		OrientedBox,
+		Quad
+	};
+
+	//Instances reference the root node of their own subtree through child and clusters store their index in
+	//the clusters section there. Emitters that the light BVH samples store their index in the lights section
+	//in light, everything else stores InvalidIndex.
+	struct Primitive
+	{
+		PrimitiveType type;
+		uint32_t material;
+		uint32_t child;
+		uint32_t light;
+		float data[12];
+	};
+
+	enum class MaterialType : uint32_t
+	{
+		Lambertian,
+		Metal,
+		Dialectric,
+		DiffuseLight
+	};
+
+	struct Material
+	{
+		MaterialType type;
+		uint32_t texture;
+		float data[4];
+	};
+
+	enum class TextureType : uint32_t
+	{
+		ConstantColour,
+		Checker,
+		Noise,
+		Image
+	};
+
+	//Noise tables and image pixels live in the data section at dataOffset
+	struct Texture
+	{
+		TextureType type;
+		uint32_t children[2];
+		float data[3];
+		uint64_t dataOffset;
+		int32_t width;
+		int32_t height;
+	};
+
+	//Light nodes bound the position, power and emission directions of every light below them. Normals lie
+	//within acos(cosThetaO) of axis and each normal emits within acos(cosThetaE) of itself. Nodes are
+	//stored depth first like the geometry nodes and every leaf holds exactly one light.
+	struct LightNode
+	{
+		float minimum[3];
+		float power;
+		float maximum[3];
+		uint32_t rightOrLight; //Right child of an interior node or the light of a leaf
+		float axis[3];
+		float cosThetaO;
+		float cosThetaE;
+		uint32_t leaf;
+		uint32_t twoSided;
+		uint32_t reserved;
+	};
+
+	//A self contained block of the cluster data section holding a group of nearby primitives and their own BVH,
+	//in the scene's node layout. Node and primitive indices inside the block are local to it so a cluster only
+	//touches its own pages.
+	struct Cluster
+	{
+		uint64_t offset; //From the start of the cluster data section, a multiple of ClusterAlignment
+		uint64_t size;
+		uint64_t primitiveOffset; //From the start of the cluster, nodes start at zero
+		uint32_t nodeCount;
+		uint32_t primitiveCount;
+		uint32_t root;
+		uint32_t reserved;
+		float minimum[3];
+		float maximum[3];
+	};
+
+	struct Light
+	{
+		uint32_t primitive;
+		uint32_t reserved;
+		uint64_t trail; //Bit i is set if the path from the root to the light's leaf goes right at depth i
+	};
+
+	//FNV-1a, pass the previous result as hash to continue over several blocks
+	inline uint64_t Checksum(const uint8_t* bytes, size_t size, uint64_t hash = 14695981039346656037ull)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	static_assert(sizeof(Node) == 32, "Two BVH nodes per cache line");
+	static_assert(sizeof(Primitive) == 64, "One primitive per cache line");
+	static_assert(sizeof(LightNode) == 64, "One light node per cache line");
+	static_assert(sizeof(WideNode) == 64, "One wide node per cache line");
+	static_assert(sizeof(Cluster) == 64, "One cluster per cache line");
+	static_assert(sizeof(Header) % 8 == 0, "Header must keep 8 byte alignment");
+}
@@ -1,8 +1,8 @@
 #include "Scenes.h"
 
-#include "Box.h"
 #include "BVHNode.h"
 #include "CheckerTexture.h"
+#include "CompiledScene.h"
 #include "ConstantColour.h"
 #include "Dialectric.h"
 #include "DiffuseLight.h"
@@ -12,97 +12,329 @@
 #include "MovingSphere.h"
 #include "NoiseTexture.h"
 #include "HittableList.h"
+#include "OrientedBox.h"
 #include "Sphere.h"
 #include "XYRectangle.h"
 #include "XZRectangle.h"
 #include "YZRectangle.h"
-#include "InstanceYRotation.h"
-#include "InstanceTranslation.h"
+#include "SceneCompiler.h"
 #include "Util.h"
 
-Hittable* Scenes::RandomScene()
+namespace
 {
-    int n = 500;
-    Hittable** list = new Hittable * [n + 1];
-
-    Texture* checker = new CheckerTexture(new ConstantColour(Vector3(0.2f, 0.3f, 0.1f)), new ConstantColour(Vector3(0.9f, 0.9f, 0.9f)));
-    list[0] = new Sphere(Vector3(0.0f, -1000.0f, 0.0f), 1000, new Lambertian(checker));
+    Hittable* RandomSmallSphere(const Vector3& center, float chooseMaterial)
+    {
+        if (chooseMaterial < 0.8f) //diffuse
+        {
+            //return new MovingSphere(center, center + Vector3(0, 0.5 * Util::RandomFloat(), 0), 0.0, 1.0, 0.2, new Lambertian(new ConstantColour(Vector3(Util::RandomFloat() * Util::RandomFloat(), Util::RandomFloat() * Util::RandomFloat(), Util::RandomFloat() * Util::RandomFloat()))));
+            return new Sphere(center, 0.2f, new Lambertian(new ConstantColour(Vector3(Util::RandomFloat() * Util::RandomFloat(), Util::RandomFloat() * Util::RandomFloat(), Util::RandomFloat() * Util::RandomFloat()))));
+        }
+        else if (chooseMaterial < 0.95f) //metal
+        {
+            return new Sphere(center, 0.2f, new Metal(Vector3(0.5f * (1.0f + Util::RandomFloat()), 0.5f * (1.0f + Util::RandomFloat()), 0.5f * (1.0f + Util::RandomFloat())), 0.5f * Util::RandomFloat()));
+        }
+        else //glass
+        {
+            return new Sphere(center, 0.2f, new Dialectric(1.5f));
+        }
+    }
 
-    int i = 1;
-    for (int a = -11; a < 11; a++)
+    std::vector<Hittable*> RandomSceneObjects(int halfExtent)
     {
-        for (int b = -11; b < 11; b++)
+        std::vector<Hittable*> list;
+        list.reserve(static_cast<size_t>(4 * halfExtent * halfExtent + 4));
+
+        Texture* checker = new CheckerTexture(new ConstantColour(Vector3(0.2f, 0.3f, 0.1f)), new ConstantColour(Vector3(0.9f, 0.9f, 0.9f)));
+        list.push_back(new Sphere(Vector3(0.0f, -1000.0f, 0.0f), 1000, new Lambertian(checker)));
+
+        for (int a = -halfExtent; a < halfExtent; a++)
         {
-            float chooseMaterial = Util::RandomFloat();
-            Vector3 center(a + 0.9f * Util::RandomFloat(), 0.2f, b + 0.9f * Util::RandomFloat());
-            if ((center - Vector3(4.0f, 0.0f, 2.0f)).Length() > 0.9f)
+            for (int b = -halfExtent; b < halfExtent; b++)
             {
-                if (chooseMaterial < 0.8f) //diffuse
-                {
-                    //list[i++] = new MovingSphere(center, center + Vector3(0, 0.5 * Util::RandomFloat(), 0), 0.0, 1.0, 0.2, new Lambertian(new ConstantColour(Vector3(Util::RandomFloat() * Util::RandomFloat(), Util::RandomFloat() * Util::RandomFloat(), Util::RandomFloat() * Util::RandomFloat()))));
-                    list[i++] = new Sphere(center, 0.2f, new Lambertian(new ConstantColour(Vector3(Util::RandomFloat() * Util::RandomFloat(), Util::RandomFloat() * Util::RandomFloat(), Util::RandomFloat() * Util::RandomFloat()))));
-                }
-                else if (chooseMaterial < 0.95f) //metal
+                float chooseMaterial = Util::RandomFloat();
+                Vector3 center(a + 0.9f * Util::RandomFloat(), 0.2f, b + 0.9f * Util::RandomFloat());
+                if ((center - Vector3(4.0f, 0.0f, 2.0f)).Length() > 0.9f)
                 {
-                    list[i++] = new Sphere(center, 0.2f, new Metal(Vector3(0.5f * (1.0f + Util::RandomFloat()), 0.5f * (1.0f + Util::RandomFloat()), 0.5f * (1.0f + Util::RandomFloat())), 0.5f * Util::RandomFloat()));
-                }
-                else //glass
-                {
-                    list[i++] = new Sphere(center, 0.2f, new Dialectric(1.5f));
+                    list.push_back(RandomSmallSphere(center, chooseMaterial));
                 }
             }
         }
+
+        list.push_back(new Sphere(Vector3(0.0f, 1.0f, 0.0f), 1.0f, new Dialectric(1.5f)));
+        list.push_back(new Sphere(Vector3(-4.0f, 1.0f, 0.0f), 1.0f, new Lambertian(new ConstantColour(Vector3(0.4f, 0.2f, 0.1f)))));
+        list.push_back(new Sphere(Vector3(4.0f, 1.0f, 0.0f), 1.0f, new Metal(Vector3(0.7f, 0.6f, 0.5f), 0.0f)));
+
+        return list;
     }
 
-    list[i++] = new Sphere(Vector3(0.0f, 1.0f, 0.0f), 1.0f, new Dialectric(1.5f));
-    list[i++] = new Sphere(Vector3(-4.0f, 1.0f, 0.0f), 1.0f, new Lambertian(new ConstantColour(Vector3(0.4f, 0.2f, 0.1f))));
-    list[i++] = new Sphere(Vector3(4.0f, 1.0f, 0.0f), 1.0f, new Metal(Vector3(0.7f, 0.6f, 0.5f), 0.0f));
+    std::vector<Hittable*> TwoPerlinSpheresObjects()
+    {
+        Texture* perlinNoiseTexture = new NoiseTexture(1.0);
+
+        std::vector<Hittable*> list;
+        list.push_back(new Sphere(Vector3(0.0f, 2.0f, 0.0f), 2.0f, new Lambertian(perlinNoiseTexture)));
+        list.push_back(new Sphere(Vector3(0.0f, -1000, 0.0f), 1000.0f, new Lambertian(perlinNoiseTexture)));
+        list.push_back(new Sphere(Vector3(0.0f, 7.0f, 0.0f), 2.0f, new DiffuseLight(new ConstantColour(Vector3(4.0f, 4.0f, 4.0f)))));
+        list.push_back(new XYRectangle(3.0f, 5.0f, 1.0f, 3.0f, -2.0f, new DiffuseLight(new ConstantColour(Vector3(4.0f, 4.0f, 4.0f)))));
 
-    return new BVHNode(list, i, 0.0f, 1.0f);
+        return list;
+    }
+
+    std::vector<Hittable*> CornellBoxObjects()
+    {
+        Material* red = new Lambertian(new ConstantColour(Vector3(0.65f, 0.05f, 0.05f)));
+        Material* white = new Lambertian(new ConstantColour(Vector3(0.73f, 0.73f, 0.73f)));
+        Material* green = new Lambertian(new ConstantColour(Vector3(0.12f, 0.45f, 0.15f)));
+        Material* light = new DiffuseLight(new ConstantColour(Vector3(15.0f, 15.0f, 15.0f)));
+
+        std::vector<Hittable*> list;
+        list.push_back(new YZRectangle(0.0f, 555.0f, 0.0f, 555.0f, 555.0f, green));
+        list.push_back(new YZRectangle(0.0f, 555.0f, 0.0f, 555.0f, 0.0f, red));
+        list.push_back(new XZRectangle(213.0f, 343.0f, 227, 332.0f, 554.0f, light));
+        list.push_back(new XZRectangle(0.0f, 555.0f, 0.0f, 555.0f, 0.0f, white));
+        list.push_back(new XZRectangle(0.0f, 555.0f, 0.0f, 555.0f, 555.0f, white));
+        list.push_back(new XYRectangle(0.0f, 555.0f, 0.0f, 555.0f, 555.0f, white));
+
+        list.push_back(OrientedBox::YRotated(Vector3(165.0f, 330.0f, 165.0f), 15.0f, Vector3(265.0f, 0.0f, 295.0f), white));
+        list.push_back(OrientedBox::YRotated(Vector3(165.0f, 165.0f, 165.0f), -18.0f, Vector3(130.0f, 0.0f, 65.0f), white));
+
+        return list;
+    }
+
+    //The Cornell box with its blocks and a sphere made glossy, lit only by the small ceiling light
+    std::vector<Hittable*> GlossyCornellBoxObjects()
+    {
+        std::vector<Hittable*> list = CornellBoxObjects();
+        list.pop_back();
+        list.pop_back();
+
+        Material* white = new Lambertian(new ConstantColour(Vector3(0.73f, 0.73f, 0.73f)));
+        list.push_back(OrientedBox::YRotated(Vector3(165.0f, 330.0f, 165.0f), 15.0f, Vector3(265.0f, 0.0f, 295.0f), new Metal(Vector3(0.95f, 0.64f, 0.54f), 0.5f)));
+        list.push_back(OrientedBox::YRotated(Vector3(165.0f, 165.0f, 165.0f), -18.0f, Vector3(130.0f, 0.0f, 65.0f), white));
+        list.push_back(new Sphere(Vector3(212.5f, 255.0f, 147.5f), 90.0f, new Dialectric(1.5f, 0.3f)));
+        list.push_back(new Sphere(Vector3(420.0f, 60.0f, 100.0f), 60.0f, new Metal(Vector3(0.9f, 0.9f, 0.9f), 0.25f)));
+
+        return list;
+    }
+
+    std::vector<Hittable*> ManyLightsObjects(int gridSize)
+    {
+        std::vector<Hittable*> list;
+        list.reserve(static_cast<size_t>(gridSize * gridSize + 8));
+
+        Material* white = new Lambertian(new ConstantColour(Vector3(0.73f, 0.73f, 0.73f)));
+        list.push_back(new XZRectangle(-20.0f, 20.0f, -20.0f, 20.0f, 0.0f, white));
+        list.push_back(new XYRectangle(-20.0f, 20.0f, 0.0f, 10.0f, -8.0f, white));
+
+        list.push_back(new Sphere(Vector3(-3.0f, 1.0f, 0.0f), 1.0f, new Lambertian(new ConstantColour(Vector3(0.4f, 0.2f, 0.1f)))));
+        list.push_back(new Sphere(Vector3(0.0f, 1.0f, 0.0f), 1.0f, new Dialectric(1.5f)));
+        list.push_back(new Sphere(Vector3(3.0f, 1.0f, 0.0f), 1.0f, new Metal(Vector3(0.7f, 0.6f, 0.5f), 0.1f)));
+
+        //A rig of small coloured bulbs, each one too small to be found reliably by following bounces
+        const float spacing = 16.0f / gridSize;
+        for (int a = 0; a < gridSize; a++)
+        {
+            for (int b = 0; b < gridSize; b++)
+            {
+                const Vector3 center(-8.0f + (a + 0.5f) * spacing, 4.0f + Util::RandomFloat(), -6.0f + (b + 0.5f) * spacing);
+                const Vector3 colour(0.5f + 0.5f * Util::RandomFloat(), 0.5f + 0.5f * Util::RandomFloat(), 0.5f + 0.5f * Util::RandomFloat());
+                list.push_back(new Sphere(center, 0.03f, new DiffuseLight(new ConstantColour(4.0f * colour))));
+            }
+        }
+
+        return list;
+    }
+}
+
+Camera Scene::CreateCamera(float aspectRatio) const
+{
+    return Camera(lookFrom, lookAt, Vector3(0.0f, 1.0f, 0.0f), verticalFov, aspectRatio, aperture, focusDistance, 0.0f, 1.0f);
+}
+
+Hittable* Scenes::RandomScene()
+{
+    return Create(SceneId::RandomScene).world;
 }
 
 Hittable* Scenes::TwoPerlinSpheres()
 {
-    constexpr int listSize = 4;
+    return Create(SceneId::TwoPerlinSpheres).world;
+}
 
-    Texture* perlinNoiseTexture = new NoiseTexture(1.0);
+Hittable* Scenes::CornellBox()
+{
+    return Create(SceneId::CornellBox).world;
+}
+
+Scene Scenes::CreateObjects(SceneId id)
+{
+    Scene scene;
+
+    switch (id)
+    {
+    case SceneId::RandomScene:
+        scene.objects = RandomSceneObjects(11);
+        scene.useBVH = true;
+        scene.lookFrom = Vector3(13.0f, 2.0f, 30.0f);
+        scene.lookAt = Vector3(0.0f, 0.0f, 0.0f);
+        scene.focusDistance = 10.0f;
+        scene.aperture = 0.0f;
+        scene.verticalFov = 20.0f;
+        scene.background = Vector3(0.70f, 0.80f, 1.00f);
+        break;
+
+    case SceneId::CornellBox:
+        scene.objects = CornellBoxObjects();
+        scene.lookFrom = Vector3(278.0f, 278.0f, -800.0f);
+        scene.lookAt = Vector3(278.0f, 278.0f, 0.0f);
+        scene.verticalFov = 40.0f;
+        scene.aperture = 0.0f;
+        scene.focusDistance = 10.0f;
+        scene.background = Vector3(0.0f, 0.0f, 0.0f);
+        break;
+
+    case SceneId::TwoPerlinSpheres:
+        scene.objects = TwoPerlinSpheresObjects();
+        scene.lookFrom = Vector3(13.0f, 2.0f, 3.0f);
+        scene.lookAt = Vector3(0.0f, 0.0f, 0.0f);
+        scene.focusDistance = 10.0f;
+        scene.aperture = 0.0f;
+        scene.verticalFov = 20.0f;
+        scene.background = Vector3(0.0f, 0.0f, 0.0f);
+        break;
 
-    Hittable** list = new Hittable * [listSize];
-    list[0] = new Sphere(Vector3(0.0f, 2.0f, 0.0f), 2.0f, new Lambertian(perlinNoiseTexture));
-    list[1] = new Sphere(Vector3(0.0f, -1000, 0.0f), 1000.0f, new Lambertian(perlinNoiseTexture));
-    list[2] = new Sphere(Vector3(0.0f, 7.0f, 0.0f), 2.0f, new DiffuseLight(new ConstantColour(Vector3(4.0f, 4.0f, 4.0f))));
-    list[3] = new XYRectangle(3.0f, 5.0f, 1.0f, 3.0f, -2.0f, new DiffuseLight(new ConstantColour(Vector3(4.0f, 4.0f, 4.0f))));
+    case SceneId::LargeRandomScene:
+        scene.objects = RandomSceneObjects(LargeSceneGridSize / 2);
+        scene.useBVH = true;
+        scene.lookFrom = Vector3(26.0f, 6.0f, 60.0f);
+        scene.lookAt = Vector3(0.0f, 0.0f, 0.0f);
+        scene.focusDistance = 10.0f;
+        scene.aperture = 0.0f;
+        scene.verticalFov = 30.0f;
+        scene.background = Vector3(0.70f, 0.80f, 1.00f);
+        break;
 
-    return new HittableList(list, listSize);
+    case SceneId::GlossyCornellBox:
+        scene.objects = GlossyCornellBoxObjects();
+        scene.lookFrom = Vector3(278.0f, 278.0f, -800.0f);
+        scene.lookAt = Vector3(278.0f, 278.0f, 0.0f);
+        scene.verticalFov = 40.0f;
+        scene.aperture = 0.0f;
+        scene.focusDistance = 10.0f;
+        scene.background = Vector3(0.0f, 0.0f, 0.0f);
+        break;
+
+    case SceneId::ManyLights:
+        scene.objects = ManyLightsObjects(ManyLightsGridSize);
+        scene.useBVH = true;
+        scene.lookFrom = Vector3(0.0f, 3.0f, 12.0f);
+        scene.lookAt = Vector3(0.0f, 1.5f, 0.0f);
+        scene.focusDistance = 10.0f;
+        scene.aperture = 0.0f;
+        scene.verticalFov = 40.0f;
+        scene.background = Vector3(0.0f, 0.0f, 0.0f);
+        break;
+    }
+
+    return scene;
 }
 
-Hittable* Scenes::CornellBox()
+void Scenes::BuildWorld(Scene& scene)
+{
+    Hittable** list = new Hittable * [scene.objects.size()];
+    std::copy(scene.objects.begin(), scene.objects.end(), list);
+
+    if (scene.useBVH)
+    {
+        scene.world = new BVHNode(list, scene.objects.size(), 0.0f, 1.0f);
+    }
+    else
+    {
+        scene.world = new HittableList(list, static_cast<int>(scene.objects.size()));
+    }
+}
+
+Scene Scenes::Create(SceneId id)
+{
+    Scene scene = CreateObjects(id);
+    BuildWorld(scene);
+    return scene;
+}
+
+const char* Scenes::GetName(SceneId id)
+{
+    switch (id)
+    {
+    case SceneId::RandomScene:
+        return "RandomScene";
+    case SceneId::CornellBox:
+        return "CornellBox";
+    case SceneId::TwoPerlinSpheres:
+        return "TwoPerlinSpheres";
+    case SceneId::LargeRandomScene:
+        return "LargeRandomScene";
+    case SceneId::ManyLights:
+        return "ManyLights";
+    case SceneId::GlossyCornellBox:
+        return "GlossyCornellBox";
+    }
+
+    return "Unknown";
+}
+
+bool Scenes::IsValid(uint32_t id)
+{
+    for (SceneId scene : All)
+    {
+        if (static_cast<uint32_t>(scene) == id)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Scenes::Compile(const Scene& scene, const std::filesystem::path& path, const CompileOptions& options, ThreadPool* threadPool)
+{
+    SceneCompiler compiler(options, threadPool);
+    return compiler.Compile(scene, path);
+}
+
+bool Scenes::Load(const std::filesystem::path& path, Scene& scene)
 {
-    constexpr int listSize = 8;
-
-    int i = 0;
-    Material* red = new Lambertian(new ConstantColour(Vector3(0.65f, 0.05f, 0.05f)));
-    Material* white = new Lambertian(new ConstantColour(Vector3(0.73f, 0.73f, 0.73f)));
-    Material* green = new Lambertian(new ConstantColour(Vector3(0.12f, 0.45f, 0.15f)));
-    Material* light = new DiffuseLight(new ConstantColour(Vector3(15.0f, 15.0f, 15.0f)));
-
-    Hittable** list = new Hittable * [listSize];
-    list[i++] = new YZRectangle(0.0f, 555.0f, 0.0f, 555.0f, 555.0f, green);
-    list[i++] = new YZRectangle(0.0f, 555.0f, 0.0f, 555.0f, 0.0f, red);
-    list[i++] = new XZRectangle(213.0f, 343.0f, 227, 332.0f, 554.0f, light);
-    list[i++] = new XZRectangle(0.0f, 555.0f, 0.0f, 555.0f, 0.0f, white);
-    list[i++] = new XZRectangle(0.0f, 555.0f, 0.0f, 555.0f, 555.0f, white);
-    list[i++] = new XYRectangle(0.0f, 555.0f, 0.0f, 555.0f, 555.0f, white);
-
-    Hittable* box1 = new Box(Vector3(0.0f, 0.0f, 0.0f), Vector3(165.0f, 330.0f, 165.0f), white);
-    box1 = new InstanceYRotation(box1, 15.0f);
-    box1 = new InstanceTranslation(box1, Vector3(265.0f, 0.0f, 295.0f));
-    list[i++] = box1;
-
-    Hittable* box2 = new Box(Vector3(0.0f, 0.0f, 0.0f), Vector3(165.0f, 165.0f, 165.0f), white);
-    box2 = new InstanceYRotation(box2, -18.0f);
-    box2 = new InstanceTranslation(box2, Vector3(130.0f, 0.0f, 65.0f));
-    list[i++] = box2;
-
-    return new HittableList(list, listSize);
+    CompiledScene* compiled = CompiledScene::Load(path);
+    if (compiled == nullptr)
+    {
+        return false;
+    }
+
+    const SceneFormat::Header& header = compiled->GetHeader();
+
+    scene = Scene();
+    scene.world = compiled;
+    if (!compiled->Lights().Empty())
+    {
+        scene.lights = &compiled->Lights();
+    }
+    scene.lookFrom = Vector3(header.lookFrom[0], header.lookFrom[1], header.lookFrom[2]);
+    scene.lookAt = Vector3(header.lookAt[0], header.lookAt[1], header.lookAt[2]);
+    scene.verticalFov = header.verticalFov;
+    scene.aperture = header.aperture;
+    scene.focusDistance = header.focusDistance;
+    scene.background = Vector3(header.background[0], header.background[1], header.background[2]);
+
+    return true;
+}
+
+bool Scenes::CreateOrLoad(SceneId id, unsigned int seed, const std::filesystem::path& path, Scene& scene)
+{
+    if (!path.empty())
+    {
+        return Load(path, scene);
+    }
+
+    Util::SeedRandom(seed);
+    scene = Create(id);
+    return true;
 }
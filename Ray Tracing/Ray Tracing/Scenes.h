@@ -1,11 +1,91 @@
 #pragma once
 
+#include "Camera.h"
+#include "SceneFormat.h"
+#include "Vector3.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
 class Hittable;
+class LightBVH;
+class ThreadPool;
+
+enum class SceneId
+{
+	RandomScene,
+	CornellBox,
+	TwoPerlinSpheres,
+	LargeRandomScene,
+	ManyLights,
+	GlossyCornellBox
+};
+
+struct Scene
+{
+	//Top level objects of the scene, world is built over these
+	std::vector<Hittable*> objects;
+	bool useBVH = false;
+
+	Hittable* world = nullptr;
+
+	//Emitters the renderer samples directly, only compiled scenes have them
+	const LightBVH* lights = nullptr;
+
+	Vector3 lookFrom = Vector3(0.0f, 0.0f, 0.0f);
+	Vector3 lookAt = Vector3(0.0f, 0.0f, -1.0f);
+	float verticalFov = 40.0f;
+	float aperture = 0.0f;
+	float focusDistance = 10.0f;
+	Vector3 background = Vector3(0.0f, 0.0f, 0.0f);
+
+	Camera CreateCamera(float aspectRatio) const;
+};
+
+//How Scenes::Compile lays out the BVH of a compiled scene
+struct CompileOptions
+{
+	float duplicationBudget = 0.0f; //Above zero builds spatial split BVHs that may reference this fraction of extra primitives
+	SceneFormat::NodeLayout nodeLayout = SceneFormat::NodeLayout::Binary;
+	size_t clusterSize = 0; //Above zero groups top level primitives into page aligned clusters of up to this many
+};
 
 namespace Scenes
 {
 	Hittable* RandomScene();
 	Hittable* TwoPerlinSpheres();
 	Hittable* CornellBox();
+
+	//Builds the objects and camera settings of a scene without building its world
+	Scene CreateObjects(SceneId id);
+
+	//Builds the world (BVH or flat list) over the scenes objects
+	void BuildWorld(Scene& scene);
+
+	Scene Create(SceneId id);
+
+	const char* GetName(SceneId id);
+
+	//Every built in scene, which is all a new scene needs adding to for the command line and daemon to accept it
+	constexpr SceneId All[] = { SceneId::RandomScene, SceneId::CornellBox, SceneId::TwoPerlinSpheres, SceneId::LargeRandomScene, SceneId::ManyLights, SceneId::GlossyCornellBox };
+
+	//Whether a scene id received from elsewhere, such as in a daemon job, names one of All
+	bool IsValid(uint32_t id);
+
+	//Writes the scene to a compiled scene file that Load can map straight back in, building its BVHs on threadPool if given
+	bool Compile(const Scene& scene, const std::filesystem::path& path, const CompileOptions& options = CompileOptions(), ThreadPool* threadPool = nullptr);
+
+	//Maps a compiled scene file, the world traces the file in place
+	bool Load(const std::filesystem::path& path, Scene& scene);
+
+	//Loads path if it isn't empty, otherwise seeds the random engine and builds id
+	bool CreateOrLoad(SceneId id, unsigned int seed, const std::filesystem::path& path, Scene& scene);
+
+	//Number of spheres along each side of the grid used by LargeRandomScene
+	constexpr int LargeSceneGridSize = 200;
+
+	//Number of small emitters along each side of the grid hung over ManyLights
+	constexpr int ManyLightsGridSize = 64;
 }
 
@@ -0,0 +1,366 @@
+#include "Socket.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+const SocketHandle Socket::InvalidHandle = INVALID_SOCKET;
+#else
+const SocketHandle Socket::InvalidHandle = -1;
+#endif
+
+namespace
+{
+#ifdef MSG_NOSIGNAL
+	constexpr int SendFlags = MSG_NOSIGNAL; //A worker dropping out must not kill the coordinator with SIGPIPE
+#else
+	constexpr int SendFlags = 0;
+#endif
+
+	void CloseSocketHandle(SocketHandle handle)
+	{
+#ifdef _WIN32
+		closesocket(handle);
+#else
+		close(handle);
+#endif
+	}
+
+	bool InitialiseSockets()
+	{
+#ifdef _WIN32
+		static const bool initialised = []()
+		{
+			WSADATA data;
+			return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+		}();
+		return initialised;
+#else
+		return true;
+#endif
+	}
+
+	bool SplitAddress(const std::string& address, std::string& scheme, std::string& host, std::string& port)
+	{
+		const size_t schemeEnd = address.find(':');
+		if (schemeEnd == std::string::npos)
+		{
+			return false;
+		}
+
+		scheme = address.substr(0, schemeEnd);
+		if (scheme == "unix")
+		{
+			host = address.substr(schemeEnd + 1);
+			return !host.empty();
+		}
+
+		const size_t portStart = address.rfind(':');
+		if (scheme != "tcp" || portStart == schemeEnd)
+		{
+			return false;
+		}
+
+		host = address.substr(schemeEnd + 1, portStart - schemeEnd - 1);
+		port = address.substr(portStart + 1);
+		return true;
+	}
+
+	addrinfo* Resolve(const std::string& host, const std::string& port, bool passive)
+	{
+		addrinfo hints = {};
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+		addrinfo* result = nullptr;
+		if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0)
+		{
+			return nullptr;
+		}
+		return result;
+	}
+
+	void DisableNagle(SocketHandle handle)
+	{
+		int enable = 1;
+		setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enable), sizeof(enable));
+	}
+}
+
+Socket::Socket(SocketHandle handle)
+	: handle(handle)
+{
+}
+
+Socket::~Socket()
+{
+	Close();
+}
+
+Socket::Socket(Socket&& other) noexcept
+	: handle(other.handle), unixPath(std::move(other.unixPath))
+{
+	other.handle = InvalidHandle;
+	other.unixPath.clear();
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		handle = other.handle;
+		unixPath = std::move(other.unixPath);
+		other.handle = InvalidHandle;
+		other.unixPath.clear();
+	}
+	return *this;
+}
+
+Socket Socket::Listen(const std::string& address)
+{
+	std::string scheme, host, port;
+	if (!InitialiseSockets() || !SplitAddress(address, scheme, host, port))
+	{
+		std::cerr << "Invalid address " << address << "\n";
+		return Socket();
+	}
+
+	if (scheme == "unix")
+	{
+#ifdef _WIN32
+		std::cerr << "Unix sockets are not supported on this platform\n";
+		return Socket();
+#else
+		sockaddr_un local = {};
+		local.sun_family = AF_UNIX;
+		if (host.size() >= sizeof(local.sun_path))
+		{
+			return Socket();
+		}
+		std::strncpy(local.sun_path, host.c_str(), sizeof(local.sun_path) - 1);
+		unlink(host.c_str());
+
+		Socket listener(socket(AF_UNIX, SOCK_STREAM, 0));
+		if (!listener.IsValid() || bind(listener.handle, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0 || listen(listener.handle, SOMAXCONN) != 0)
+		{
+			std::cerr << "Unable to listen on " << address << "\n";
+			return Socket();
+		}
+		listener.unixPath = host;
+		return listener;
+#endif
+	}
+
+	addrinfo* info = Resolve(host, port, true);
+	if (info == nullptr)
+	{
+		std::cerr << "Unable to resolve " << address << "\n";
+		return Socket();
+	}
+
+	Socket listener(socket(info->ai_family, info->ai_socktype, info->ai_protocol));
+	int reuse = 1;
+	const bool listening = listener.IsValid()
+		&& setsockopt(listener.handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse)) == 0
+		&& bind(listener.handle, info->ai_addr, static_cast<int>(info->ai_addrlen)) == 0
+		&& listen(listener.handle, SOMAXCONN) == 0;
+	freeaddrinfo(info);
+
+	if (!listening)
+	{
+		std::cerr << "Unable to listen on " << address << "\n";
+		return Socket();
+	}
+
+	return listener;
+}
+
+Socket Socket::Connect(const std::string& address)
+{
+	std::string scheme, host, port;
+	if (!InitialiseSockets() || !SplitAddress(address, scheme, host, port))
+	{
+		std::cerr << "Invalid address " << address << "\n";
+		return Socket();
+	}
+
+	if (scheme == "unix")
+	{
+#ifdef _WIN32
+		return Socket();
+#else
+		sockaddr_un remote = {};
+		remote.sun_family = AF_UNIX;
+		if (host.size() >= sizeof(remote.sun_path))
+		{
+			return Socket();
+		}
+		std::strncpy(remote.sun_path, host.c_str(), sizeof(remote.sun_path) - 1);
+
+		Socket connection(socket(AF_UNIX, SOCK_STREAM, 0));
+		if (!connection.IsValid() || connect(connection.handle, reinterpret_cast<sockaddr*>(&remote), sizeof(remote)) != 0)
+		{
+			return Socket();
+		}
+		return connection;
+#endif
+	}
+
+	addrinfo* info = Resolve(host, port, false);
+	if (info == nullptr)
+	{
+		return Socket();
+	}
+
+	Socket connection(socket(info->ai_family, info->ai_socktype, info->ai_protocol));
+	const bool connected = connection.IsValid() && connect(connection.handle, info->ai_addr, static_cast<int>(info->ai_addrlen)) == 0;
+	freeaddrinfo(info);
+
+	if (!connected)
+	{
+		return Socket();
+	}
+
+	DisableNagle(connection.handle);
+	return connection;
+}
+
+Socket Socket::Accept()
+{
+	Socket connection(accept(handle, nullptr, nullptr));
+	if (connection.IsValid() && unixPath.empty())
+	{
+		DisableNagle(connection.handle);
+	}
+	return connection;
+}
+
+bool Socket::IsValid() const
+{
+	return handle != InvalidHandle;
+}
+
+void Socket::Close()
+{
+	if (IsValid())
+	{
+		CloseSocketHandle(handle);
+		handle = InvalidHandle;
+	}
+
+#ifndef _WIN32
+	if (!unixPath.empty())
+	{
+		unlink(unixPath.c_str());
+		unixPath.clear();
+	}
+#endif
+}
+
+bool Socket::SendAll(const void* data, size_t size)
+{
+	const char* bytes = static_cast<const char*>(data);
+	while (size > 0)
+	{
+#ifdef _WIN32
+		const int sent = send(handle, bytes, static_cast<int>(std::min<size_t>(size, INT_MAX)), SendFlags);
+#else
+		const ssize_t sent = send(handle, bytes, size, SendFlags);
+#endif
+		if (sent <= 0)
+		{
+			return false;
+		}
+
+		bytes += sent;
+		size -= static_cast<size_t>(sent);
+	}
+	return true;
+}
+
+bool Socket::ReceiveAll(void* data, size_t size)
+{
+	char* bytes = static_cast<char*>(data);
+	while (size > 0)
+	{
+#ifdef _WIN32
+		const int received = recv(handle, bytes, static_cast<int>(std::min<size_t>(size, INT_MAX)), 0);
+#else
+		const ssize_t received = recv(handle, bytes, size, 0);
+#endif
+		if (received <= 0)
+		{
+			return false;
+		}
+
+		bytes += received;
+		size -= static_cast<size_t>(received);
+	}
+	return true;
+}
+
+bool Socket::SendFrame(uint32_t type, const void* payload, size_t size)
+{
+	const uint32_t header[2] = { type, static_cast<uint32_t>(size) };
+	return SendAll(header, sizeof(header)) && (size == 0 || SendAll(payload, size));
+}
+
+bool Socket::ReceiveFrame(size_t maxSize, uint32_t& type, std::vector<uint8_t>& payload)
+{
+	uint32_t header[2];
+	if (!ReceiveAll(header, sizeof(header)) || header[1] > maxSize)
+	{
+		return false;
+	}
+
+	type = header[0];
+	payload.resize(header[1]);
+	return header[1] == 0 || ReceiveAll(payload.data(), payload.size());
+}
+
+bool Socket::WaitReadable(const std::vector<Socket*>& sockets, int timeoutMilliseconds, std::vector<bool>& readable)
+{
+#ifdef _WIN32
+	std::vector<WSAPOLLFD> descriptors(sockets.size());
+#else
+	std::vector<pollfd> descriptors(sockets.size());
+#endif
+	for (size_t i = 0; i < sockets.size(); i++)
+	{
+		descriptors[i].fd = sockets[i]->handle;
+		descriptors[i].events = POLLIN;
+		descriptors[i].revents = 0;
+	}
+
+#ifdef _WIN32
+	const int ready = WSAPoll(descriptors.data(), static_cast<ULONG>(descriptors.size()), timeoutMilliseconds);
+#else
+	const int ready = poll(descriptors.data(), descriptors.size(), timeoutMilliseconds);
+#endif
+
+	readable.assign(sockets.size(), false);
+	for (size_t i = 0; i < sockets.size(); i++)
+	{
+		//Hang ups count as readable so the following receive reports the disconnect
+		readable[i] = (descriptors[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+	}
+
+	return ready > 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+using SocketHandle = SOCKET;
+#else
+using SocketHandle = int;
+#endif
+
+//Thin blocking socket wrapper. Addresses are "tcp:HOST:PORT" or, on POSIX systems, "unix:PATH".
+class Socket
+{
+public:
+	Socket() = default;
+	~Socket();
+
+	Socket(Socket&& other) noexcept;
+	Socket& operator=(Socket&& other) noexcept;
+
+	Socket(const Socket&) = delete;
+	Socket& operator=(const Socket&) = delete;
+
+	static Socket Listen(const std::string& address);
+	static Socket Connect(const std::string& address);
+
+	Socket Accept();
+
+	bool IsValid() const;
+	void Close();
+
+	bool SendAll(const void* data, size_t size);
+	bool ReceiveAll(void* data, size_t size);
+
+	//Frames are a message type and payload size followed by the payload. ReceiveFrame fails on payloads over maxSize.
+	bool SendFrame(uint32_t type, const void* payload, size_t size);
+	bool ReceiveFrame(size_t maxSize, uint32_t& type, std::vector<uint8_t>& payload);
+
+	//Waits up to timeoutMilliseconds for any socket to become readable, readable[i] is set for each ready socket
+	static bool WaitReadable(const std::vector<Socket*>& sockets, int timeoutMilliseconds, std::vector<bool>& readable);
+
+private:
+	explicit Socket(SocketHandle handle);
+
+	static const SocketHandle InvalidHandle;
+
+	SocketHandle handle = InvalidHandle;
+	std::string unixPath; //Removed when a listening unix socket closes
+};
+
+//Copies the fixed size record at the start of a message payload, false if the payload is too short
+template<typename T>
+bool ReadPayload(const std::vector<uint8_t>& payload, T& value)
+{
+	if (payload.size() < sizeof(T))
+	{
+		return false;
+	}
+	std::memcpy(&value, payload.data(), sizeof(T));
+	return true;
+}
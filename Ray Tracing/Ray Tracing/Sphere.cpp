@@ -1,19 +1,25 @@
 #include "Sphere.h"
 
+#include "SceneCompiler.h"
+#include "Statistics.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <limits>
+
 Sphere::Sphere(Vector3 cen, float r, Material* m)
     : center(cen), radius(r), material(m) {}
 
 bool Sphere::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
 {
-    SIMD::Vector rO = { r.Origin().x, r.Origin().y, r.Origin().z, 0.0f };
-    SIMD::Vector rD = { r.Direction().x, r.Direction().y, r.Direction().z, 0.0f };
-    SIMD::Vector sC = { center.x, center.y, center.z, 0.0f };
+    RT_STATISTIC_INCREMENT(primitiveTests);
 
-    const SIMD::Vector oc = rO - sC;
+    const Vector3 direction = r.Direction();
+    const Vector3 oc = r.Origin() - center;
 
-    const float a = SIMD::Vector::DotProduct(rD, rD);
-    const float b = SIMD::Vector::DotProduct(oc, rD);
-    const float c = SIMD::Vector::DotProduct(oc, oc) - radius * radius;
+    const float a = DotProduct(direction, direction);
+    const float b = DotProduct(oc, direction);
+    const float c = DotProduct(oc, oc) - radius * radius;
 
     const float discriminant = b * b - a * c;
 
@@ -49,4 +55,64 @@ bool Sphere::BoundingBox(float t0, float t1, AABB& box) const
 {
     box = AABB(center - Vector3(radius, radius, radius), center + Vector3(radius, radius, radius));
     return true;
-}
\ No newline at end of file
+}
+
+float Sphere::PdfValue(const Vector3& origin, const Vector3& direction) const
+{
+    HitRecord hitRecord;
+    if (!Hit(Ray(origin, direction, 0.0f), 0.001f, std::numeric_limits<float>::max(), hitRecord))
+    {
+        return 0.0f;
+    }
+
+    //From inside every direction reaches the sphere
+    const float distanceSquared = (center - origin).SquaredLength();
+    if (distanceSquared <= radius * radius)
+    {
+        return 1.0f / (4.0f * Util::R_PI);
+    }
+
+    const float cosThetaMax = std::sqrt(1.0f - radius * radius / distanceSquared);
+    return 1.0f / (2.0f * Util::R_PI * (1.0f - cosThetaMax));
+}
+
+Vector3 Sphere::Random(const Vector3& origin) const
+{
+    const Vector3 direction = center - origin;
+    const float distanceSquared = direction.SquaredLength();
+    if (distanceSquared <= radius * radius)
+    {
+        return Util::RandomUnitVector();
+    }
+
+    //Uniform over the cone of directions that hit the sphere, around the axis w
+    const float cosThetaMax = std::sqrt(1.0f - radius * radius / distanceSquared);
+    const float z = 1.0f + Util::RandomFloat() * (cosThetaMax - 1.0f);
+    const float phi = 2.0f * Util::R_PI * Util::RandomFloat();
+    const float sinTheta = std::sqrt(std::max(0.0f, 1.0f - z * z));
+
+    const Vector3 w = direction / std::sqrt(distanceSquared);
+    const Vector3 a = std::abs(w.x) > 0.9f ? Vector3(0.0f, 1.0f, 0.0f) : Vector3(1.0f, 0.0f, 0.0f);
+    const Vector3 v = GetNormalized(CrossProduct(w, a));
+    const Vector3 u = CrossProduct(w, v);
+
+    return std::cos(phi) * sinTheta * u + std::sin(phi) * sinTheta * v + z * w;
+}
+
+bool Sphere::Compile(SceneCompiler& compiler) const
+{
+    SceneFormat::Primitive primitive = {};
+    primitive.type = SceneFormat::PrimitiveType::Sphere;
+    if (!compiler.AddMaterial(material, primitive.material))
+    {
+        return false;
+    }
+
+    primitive.data[0] = center.x;
+    primitive.data[1] = center.y;
+    primitive.data[2] = center.z;
+    primitive.data[3] = radius;
+
+    compiler.AddPrimitive(*this, primitive);
+    return true;
+}
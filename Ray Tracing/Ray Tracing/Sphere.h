@@ -2,8 +2,6 @@
 
 #include "Hittable.h"
 
-#include <Vector.h>
-
 class Sphere : public Hittable
 {
 public:
@@ -12,6 +10,9 @@ public:
 
     bool Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const override;
     bool BoundingBox(float t0, float t1, AABB& box) const override;
+    float PdfValue(const Vector3& origin, const Vector3& direction) const override;
+    Vector3 Random(const Vector3& origin) const override;
+    bool Compile(SceneCompiler& compiler) const override;
 
 private:
     Vector3 center;
@@ -0,0 +1,230 @@
+#include "Statistics.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+	//Padded so threads updating their own totals never share a cache line
+	struct alignas(64) ThreadTotals
+	{
+		TraversalCounters counters;
+	};
+
+	//Totals live in the registry rather than in thread_local storage so they outlive the pool's threads.
+	//The mutex is only taken the first time a thread records a pixel.
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadTotals>> registry;
+
+	thread_local TraversalCounters currentPixel;
+	thread_local ThreadTotals* threadTotals = nullptr;
+
+	ThreadTotals& GetThreadTotals()
+	{
+		if (threadTotals == nullptr)
+		{
+			std::lock_guard<std::mutex> lockguard(registryMutex);
+			registry.push_back(std::make_unique<ThreadTotals>());
+			threadTotals = registry.back().get();
+		}
+
+		return *threadTotals;
+	}
+
+	uint32_t Saturate(uint64_t value)
+	{
+		return static_cast<uint32_t>(std::min<uint64_t>(value, UINT32_MAX));
+	}
+
+	//Black -> blue -> cyan -> green -> yellow -> red
+	std::array<float, 3> FalseColour(float t)
+	{
+		constexpr std::array<std::array<float, 3>, 6> ramp = { {
+			{ 0.0f, 0.0f, 0.0f },
+			{ 0.0f, 0.0f, 1.0f },
+			{ 0.0f, 1.0f, 1.0f },
+			{ 0.0f, 1.0f, 0.0f },
+			{ 1.0f, 1.0f, 0.0f },
+			{ 1.0f, 0.0f, 0.0f } } };
+
+		t = std::clamp(t, 0.0f, 1.0f) * static_cast<float>(ramp.size() - 1);
+		const size_t index = std::min(static_cast<size_t>(t), ramp.size() - 2);
+		const float blend = t - static_cast<float>(index);
+
+		std::array<float, 3> colour;
+		for (size_t c = 0; c < 3; c++)
+		{
+			colour[c] = ramp[index][c] + (ramp[index + 1][c] - ramp[index][c]) * blend;
+		}
+		return colour;
+	}
+
+	void PrintRow(std::ostream& stream, const std::string& name, const TraversalCounters& counters)
+	{
+		stream << std::setw(10) << name
+			<< std::setw(14) << counters.rays
+			<< std::setw(16) << counters.bvhNodesVisited
+			<< std::setw(16) << counters.aabbTests
+			<< std::setw(16) << counters.primitiveTests
+			<< std::setw(14) << counters.bounces
+			<< std::setw(14) << counters.scatterNanoseconds / 1000000 << "\n";
+	}
+}
+
+TraversalCounters& TraversalCounters::operator+=(const TraversalCounters& other)
+{
+	rays += other.rays;
+	bvhNodesVisited += other.bvhNodesVisited;
+	aabbTests += other.aabbTests;
+	primitiveTests += other.primitiveTests;
+	bounces += other.bounces;
+	scatterNanoseconds += other.scatterNanoseconds;
+	return *this;
+}
+
+TraversalCounters& Statistics::Current()
+{
+	return currentPixel;
+}
+
+void Statistics::BeginPixel()
+{
+	currentPixel = TraversalCounters();
+}
+
+const TraversalCounters& Statistics::EndPixel()
+{
+	GetThreadTotals().counters += currentPixel;
+	return currentPixel;
+}
+
+std::vector<TraversalCounters> Statistics::PerThreadTotals()
+{
+	std::lock_guard<std::mutex> lockguard(registryMutex);
+
+	std::vector<TraversalCounters> totals;
+	for (const std::unique_ptr<ThreadTotals>& thread : registry)
+	{
+		totals.push_back(thread->counters);
+	}
+	return totals;
+}
+
+TraversalCounters Statistics::Total()
+{
+	TraversalCounters total;
+	for (const TraversalCounters& thread : PerThreadTotals())
+	{
+		total += thread;
+	}
+	return total;
+}
+
+StatisticsImage::StatisticsImage(size_t width, size_t height)
+	: width(width), height(height), pixels(width * height)
+{
+}
+
+void StatisticsImage::Write(size_t x, size_t y, const TraversalCounters& counters)
+{
+	PixelCounters& pixel = pixels[y * width + x];
+	pixel.bvhNodesVisited = Saturate(counters.bvhNodesVisited);
+	pixel.aabbTests = Saturate(counters.aabbTests);
+	pixel.primitiveTests = Saturate(counters.primitiveTests);
+	pixel.bounces = Saturate(counters.bounces);
+	pixel.scatterMicroseconds = Saturate(counters.scatterNanoseconds / 1000);
+}
+
+float StatisticsImage::Value(const PixelCounters& pixel, HeatmapMetric metric) const
+{
+	switch (metric)
+	{
+	case HeatmapMetric::TraversalCost:
+		return static_cast<float>(pixel.bvhNodesVisited) + static_cast<float>(pixel.primitiveTests);
+	case HeatmapMetric::BVHNodesVisited:
+		return static_cast<float>(pixel.bvhNodesVisited);
+	case HeatmapMetric::AABBTests:
+		return static_cast<float>(pixel.aabbTests);
+	case HeatmapMetric::PrimitiveTests:
+		return static_cast<float>(pixel.primitiveTests);
+	case HeatmapMetric::Bounces:
+		return static_cast<float>(pixel.bounces);
+	case HeatmapMetric::ScatterTime:
+		return static_cast<float>(pixel.scatterMicroseconds);
+	}
+
+	return 0.0f;
+}
+
+void StatisticsImage::WriteHeatmap(const std::filesystem::path& filepath, HeatmapMetric metric) const
+{
+	if (pixels.empty())
+	{
+		return;
+	}
+
+	//Normalise against the 99th percentile so a handful of outliers don't wash out the rest of the image
+	std::vector<float> values(pixels.size());
+	std::transform(pixels.begin(), pixels.end(), values.begin(), [this, metric](const PixelCounters& pixel) { return Value(pixel, metric); });
+
+	std::vector<float> sorted = values;
+	const size_t percentileIndex = (sorted.size() - 1) * 99 / 100;
+	std::nth_element(sorted.begin(), sorted.begin() + percentileIndex, sorted.end());
+	const float scale = sorted[percentileIndex] > 0.0f ? 1.0f / sorted[percentileIndex] : 0.0f;
+
+	std::ofstream file(filepath);
+	if (!file.is_open())
+	{
+		return;
+	}
+
+	file << "P3\n" << width << " " << height << "\n255\n";
+	for (float value : values)
+	{
+		const std::array<float, 3> colour = FalseColour(value * scale);
+		file << static_cast<int>(255.99f * colour[0]) << " " << static_cast<int>(255.99f * colour[1]) << " " << static_cast<int>(255.99f * colour[2]) << "\n";
+	}
+}
+
+void StatisticsImage::PrintSummary(std::ostream& stream, size_t samplesPerPixel) const
+{
+	const std::vector<TraversalCounters> threads = Statistics::PerThreadTotals();
+	TraversalCounters total;
+	for (const TraversalCounters& thread : threads)
+	{
+		total += thread;
+	}
+
+	stream << std::setw(10) << "thread" << std::setw(14) << "rays" << std::setw(16) << "bvh nodes" << std::setw(16) << "aabb tests"
+		<< std::setw(16) << "prim tests" << std::setw(14) << "bounces" << std::setw(14) << "scatter ms" << "\n";
+
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		PrintRow(stream, std::to_string(i), threads[i]);
+	}
+	PrintRow(stream, "total", total);
+
+	const double rays = static_cast<double>(std::max<uint64_t>(total.rays, 1));
+	const double primaryRays = static_cast<double>(std::max<size_t>(pixels.size() * samplesPerPixel, 1));
+
+	stream << std::fixed << std::setprecision(2)
+		<< "\nper ray:          " << total.bvhNodesVisited / rays << " nodes, " << total.aabbTests / rays << " aabb tests, "
+		<< total.primitiveTests / rays << " primitive tests, " << total.scatterNanoseconds / rays << " ns scatter\n"
+		<< "per camera ray:   " << total.bounces / primaryRays << " bounces, " << total.rays / primaryRays << " rays\n";
+
+	//Most expensive pixel helps locate bad BVH regions in the heatmap
+	auto cost = [this](const PixelCounters& pixel) { return Value(pixel, HeatmapMetric::TraversalCost); };
+	auto worst = std::max_element(pixels.begin(), pixels.end(), [&cost](const PixelCounters& a, const PixelCounters& b) { return cost(a) < cost(b); });
+	if (worst != pixels.end())
+	{
+		const size_t index = static_cast<size_t>(worst - pixels.begin());
+		stream << "most expensive pixel: (" << index % width << ", " << index / width << ") with "
+			<< worst->bvhNodesVisited << " nodes and " << worst->primitiveTests << " primitive tests\n";
+	}
+
+	stream.unsetf(std::ios_base::floatfield);
+}
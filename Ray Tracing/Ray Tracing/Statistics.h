@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <vector>
+
+//Define RAYTRACING_STATISTICS=1 in the preprocessor definitions to count traversal work per ray and per pixel.
+//When disabled the counters compile away entirely.
+#ifndef RAYTRACING_STATISTICS
+#define RAYTRACING_STATISTICS 0
+#endif
+
+struct TraversalCounters
+{
+	uint64_t rays = 0;
+	uint64_t bvhNodesVisited = 0;
+	uint64_t aabbTests = 0;
+	uint64_t primitiveTests = 0;
+	uint64_t bounces = 0;
+	uint64_t scatterNanoseconds = 0;
+
+	TraversalCounters& operator+=(const TraversalCounters& other);
+};
+
+namespace Statistics
+{
+	//Counters for the pixel currently being traced by the calling thread
+	TraversalCounters& Current();
+
+	void BeginPixel();
+
+	//Adds the current pixel's counters to the calling thread's totals and returns them
+	const TraversalCounters& EndPixel();
+
+	//Totals of every thread that has traced a pixel. Only call once rendering has finished.
+	std::vector<TraversalCounters> PerThreadTotals();
+	TraversalCounters Total();
+}
+
+#if RAYTRACING_STATISTICS
+#define RT_STATISTIC_INCREMENT(counter) (++Statistics::Current().counter)
+#else
+#define RT_STATISTIC_INCREMENT(counter) ((void)0)
+#endif
+
+enum class HeatmapMetric
+{
+	TraversalCost, //BVH nodes visited plus primitive tests
+	BVHNodesVisited,
+	AABBTests,
+	PrimitiveTests,
+	Bounces,
+	ScatterTime
+};
+
+//Per pixel counters kept at 32 bits to keep a full resolution buffer small
+class StatisticsImage
+{
+public:
+	StatisticsImage(size_t width, size_t height);
+
+	//Each pixel is only ever written by the task that rendered it so no locking is needed
+	void Write(size_t x, size_t y, const TraversalCounters& counters);
+
+	void WriteHeatmap(const std::filesystem::path& filepath, HeatmapMetric metric) const;
+
+	void PrintSummary(std::ostream& stream, size_t samplesPerPixel) const;
+
+private:
+	struct PixelCounters
+	{
+		uint32_t bvhNodesVisited = 0;
+		uint32_t aabbTests = 0;
+		uint32_t primitiveTests = 0;
+		uint32_t bounces = 0;
+		uint32_t scatterMicroseconds = 0;
+	};
+
+	float Value(const PixelCounters& pixel, HeatmapMetric metric) const;
+
+	size_t width;
+	size_t height;
+	std::vector<PixelCounters> pixels;
+};
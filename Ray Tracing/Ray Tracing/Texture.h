@@ -1,11 +1,17 @@
 #pragma once
 
+#include "SceneFormat.h"
 #include "Vector3.h"
 
+class SceneCompiler;
+
 class Texture
 {
 public:
 	virtual ~Texture() = default;
 
 	virtual Vector3 Value(float u, float v, const Vector3& p) const = 0;
+
+	//Fills in the texture's compiled record, returns false if the texture can't be compiled
+	virtual bool Compile(SceneCompiler& compiler, SceneFormat::Texture& record) const { return false; }
 };
\ No newline at end of file
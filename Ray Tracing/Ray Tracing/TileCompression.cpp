@@ -0,0 +1,156 @@
+#include "TileCompression.h"
+
+#include <cstring>
+
+namespace
+{
+	//Control bytes below 128 are followed by (control + 1) literal bytes,
+	//control bytes from 128 repeat the following byte (control - 126) times
+	constexpr size_t MaxLiteralRun = 128;
+	constexpr size_t MinRepeatRun = 2;
+	constexpr size_t MaxRepeatRun = 129;
+
+	void EncodePlane(const std::vector<uint8_t>& plane, std::vector<uint8_t>& output)
+	{
+		size_t i = 0;
+		while (i < plane.size())
+		{
+			size_t run = 1;
+			while (i + run < plane.size() && run < MaxRepeatRun && plane[i + run] == plane[i])
+			{
+				run++;
+			}
+
+			if (run >= MinRepeatRun)
+			{
+				output.push_back(static_cast<uint8_t>(run + 126));
+				output.push_back(plane[i]);
+				i += run;
+				continue;
+			}
+
+			//Gather literals until the next repeat starts
+			const size_t literalStart = i;
+			while (i < plane.size() && i - literalStart < MaxLiteralRun)
+			{
+				if (i + 1 < plane.size() && plane[i + 1] == plane[i])
+				{
+					break;
+				}
+				i++;
+			}
+
+			output.push_back(static_cast<uint8_t>(i - literalStart - 1));
+			output.insert(output.end(), plane.begin() + literalStart, plane.begin() + i);
+		}
+	}
+
+	bool DecodePlane(const uint8_t*& data, const uint8_t* end, size_t count, uint8_t* plane)
+	{
+		size_t written = 0;
+		while (written < count)
+		{
+			if (data >= end)
+			{
+				return false;
+			}
+
+			const uint8_t control = *data++;
+			if (control < 128)
+			{
+				const size_t literals = static_cast<size_t>(control) + 1;
+				if (written + literals > count || static_cast<size_t>(end - data) < literals)
+				{
+					return false;
+				}
+				std::memcpy(plane + written, data, literals);
+				data += literals;
+				written += literals;
+			}
+			else
+			{
+				const size_t repeats = static_cast<size_t>(control) - 126;
+				if (written + repeats > count || data >= end)
+				{
+					return false;
+				}
+				std::memset(plane + written, *data++, repeats);
+				written += repeats;
+			}
+		}
+
+		return true;
+	}
+}
+
+std::vector<uint8_t> TileCompression::Compress(const std::vector<float>& values)
+{
+	std::vector<uint8_t> planes[4];
+	for (std::vector<uint8_t>& plane : planes)
+	{
+		plane.resize(values.size());
+	}
+
+	uint32_t previous = 0;
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &values[i], sizeof(bits));
+
+		const uint32_t delta = bits ^ previous;
+		previous = bits;
+
+		for (size_t byte = 0; byte < 4; byte++)
+		{
+			planes[byte][i] = static_cast<uint8_t>(delta >> (byte * 8));
+		}
+	}
+
+	std::vector<uint8_t> output;
+	output.reserve(values.size() * sizeof(float));
+
+	//Most significant plane first, it compresses best
+	for (size_t byte = 4; byte-- > 0;)
+	{
+		EncodePlane(planes[byte], output);
+	}
+
+	return output;
+}
+
+bool TileCompression::Decompress(const uint8_t* data, size_t size, size_t valueCount, std::vector<float>& values)
+{
+	std::vector<uint8_t> planes[4];
+	const uint8_t* end = data + size;
+
+	for (size_t byte = 4; byte-- > 0;)
+	{
+		planes[byte].resize(valueCount);
+		if (!DecodePlane(data, end, valueCount, planes[byte].data()))
+		{
+			return false;
+		}
+	}
+
+	if (data != end)
+	{
+		return false;
+	}
+
+	values.resize(valueCount);
+
+	uint32_t previous = 0;
+	for (size_t i = 0; i < valueCount; i++)
+	{
+		uint32_t delta = 0;
+		for (size_t byte = 0; byte < 4; byte++)
+		{
+			delta |= static_cast<uint32_t>(planes[byte][i]) << (byte * 8);
+		}
+
+		previous ^= delta;
+		std::memcpy(&values[i], &previous, sizeof(previous));
+	}
+
+	return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//Lossless compression for tiles of float radiance sums sent between render processes.
+//Neighbouring values share most of their high bits so each float is XORed with the previous one,
+//the results are split into byte planes and each plane is run length encoded.
+namespace TileCompression
+{
+	std::vector<uint8_t> Compress(const std::vector<float>& values);
+
+	//Returns false if the data is malformed or doesn't decode to exactly valueCount floats
+	bool Decompress(const uint8_t* data, size_t size, size_t valueCount, std::vector<float>& values);
+}
@@ -1,19 +1,53 @@
 #include "Util.h"
 
 #include <random>
+#include <sstream>
 
 float Util::DegreesToRadians(float degrees)
 {
 	return degrees * R_PI / 180.0f;
 }
 
+namespace
+{
+	//Each thread owns its engine so render tasks never share (or race on) random state
+	std::mt19937& RandomEngine()
+	{
+		thread_local std::mt19937 mt(std::random_device{}());
+		return mt;
+	}
+}
+
+void Util::SeedRandom(unsigned int seed)
+{
+	RandomEngine().seed(seed);
+}
+
+std::string Util::SaveRandomState()
+{
+	std::ostringstream stream;
+	stream << RandomEngine();
+	return stream.str();
+}
+
+bool Util::RestoreRandomState(const std::string& state)
+{
+	std::istringstream stream(state);
+	std::mt19937 engine;
+	if (!(stream >> engine))
+	{
+		return false;
+	}
+
+	RandomEngine() = engine;
+	return true;
+}
+
 float Util::RandomFloat()
 {
-	static std::random_device rd;
-	static std::mt19937 mt(rd());
-	static std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+	std::uniform_real_distribution<float> dist(0.0f, 1.0f);
 
-	return dist(mt);
+	return dist(RandomEngine());
 }
 
 Vector3 Util::RandomInUnitSphere()
@@ -28,6 +62,18 @@ Vector3 Util::RandomInUnitSphere()
 	return p;
 }
 
+Vector3 Util::RandomUnitVector()
+{
+	Vector3 p;
+
+	do
+	{
+		p = RandomInUnitSphere();
+	} while (p.SquaredLength() < 1e-12f);
+
+	return GetNormalized(p);
+}
+
 Vector3 Util::RandomInUnitDisk()
 {
 	Vector3 p;
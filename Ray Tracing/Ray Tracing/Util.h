@@ -2,14 +2,24 @@
 
 #include "Vector3.h"
 
+#include <string>
+
 namespace Util
 {
 	constexpr float R_PI = 3.14159265359f;
 
 	float DegreesToRadians(float degrees);
 
+	//Seeds the calling thread's random engine so results can be reproduced
+	void SeedRandom(unsigned int seed);
+
+	//The calling thread's random engine state, so a stream can be stopped and carried on later exactly where it left off
+	std::string SaveRandomState();
+	bool RestoreRandomState(const std::string& state);
+
 	float RandomFloat();
 	Vector3 RandomInUnitSphere();
+	Vector3 RandomUnitVector();
 	Vector3 RandomInUnitDisk();
 
 	Vector3 Reflect(const Vector3& v1, const Vector3& v2);
@@ -0,0 +1,145 @@
+#include "WideBVHBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	constexpr int QuantizedMaximum = 255;
+}
+
+uint32_t WideBVHBuilder::Build(const std::vector<BVHBuilder::Node>& binary, uint32_t primitiveBase, std::vector<SceneFormat::WideNode>& nodes) const
+{
+	return BuildRecursive(binary, 0, primitiveBase, nodes);
+}
+
+uint32_t WideBVHBuilder::BuildRecursive(const std::vector<BVHBuilder::Node>& binary, uint32_t node, uint32_t primitiveBase, std::vector<SceneFormat::WideNode>& nodes) const
+{
+	const uint32_t wideIndex = static_cast<uint32_t>(nodes.size());
+	nodes.emplace_back();
+
+	//A single leaf root still gets a wide node so traversal always starts at one
+	std::vector<uint32_t> children;
+	if (binary[node].count > 0)
+	{
+		children.push_back(node);
+	}
+	else
+	{
+		children.push_back(node + 1);
+		children.push_back(binary[node].rightOrFirst);
+	}
+
+	//Open the interior child with the largest surface area, it is the one most rays would enter anyway
+	while (children.size() < SceneFormat::WideNodeWidth)
+	{
+		size_t largest = children.size();
+		float largestArea = -1.0f;
+		for (size_t i = 0; i < children.size(); i++)
+		{
+			const BVHBuilder::Node& child = binary[children[i]];
+			const float area = BVHBuilder::SurfaceArea(child.bounds);
+			if (child.count == 0 && area > largestArea)
+			{
+				largest = i;
+				largestArea = area;
+			}
+		}
+
+		if (largest == children.size())
+		{
+			break;
+		}
+
+		const uint32_t opened = children[largest];
+		children[largest] = opened + 1;
+		children.push_back(binary[opened].rightOrFirst);
+	}
+
+	std::vector<AABB> childBounds;
+	AABB bounds = binary[children[0]].bounds;
+	for (uint32_t child : children)
+	{
+		childBounds.push_back(binary[child].bounds);
+		bounds = AABB::SurroundingBox(bounds, binary[child].bounds);
+	}
+
+	SceneFormat::WideNode wide = {};
+	for (int axis = 0; axis < 3; axis++)
+	{
+		wide.origin[axis] = bounds.Min().v[axis];
+
+		//Smallest power of two step that spans the node in 255 steps, grown if rounding pushes a bound past the top
+		int exponent = 0;
+		const float extent = bounds.Max().v[axis] - bounds.Min().v[axis];
+		if (extent > 0.0f)
+		{
+			std::frexp(extent / QuantizedMaximum, &exponent);
+		}
+
+		exponent = std::clamp(exponent, SceneFormat::MinimumExponent, SceneFormat::MaximumExponent);
+		while (!Quantize(childBounds, axis, static_cast<int8_t>(exponent), wide) && exponent < SceneFormat::MaximumExponent)
+		{
+			exponent++;
+		}
+		wide.exponent[axis] = static_cast<int8_t>(exponent);
+	}
+
+	for (size_t i = 0; i < SceneFormat::WideNodeWidth; i++)
+	{
+		wide.child[i] = SceneFormat::InvalidIndex;
+	}
+
+	//Recursing grows nodes, so this node is written back by index once its children have been placed
+	for (size_t i = 0; i < children.size(); i++)
+	{
+		const BVHBuilder::Node& child = binary[children[i]];
+		if (child.count > 0)
+		{
+			wide.child[i] = child.rightOrFirst + primitiveBase;
+			wide.count[i] = static_cast<uint8_t>(child.count);
+		}
+		else
+		{
+			wide.child[i] = BuildRecursive(binary, children[i], primitiveBase, nodes);
+		}
+	}
+
+	nodes[wideIndex] = wide;
+	return wideIndex;
+}
+
+bool WideBVHBuilder::Quantize(const std::vector<AABB>& children, int axis, int8_t exponent, SceneFormat::WideNode& node)
+{
+	const float origin = node.origin[axis];
+	const float step = SceneFormat::QuantizationStep(exponent);
+
+	for (size_t i = 0; i < children.size(); i++)
+	{
+		const float minimum = children[i].Min().v[axis];
+		const float maximum = children[i].Max().v[axis];
+
+		//Round outwards, then step until the decoded value really is outside since the division can round inwards
+		int lower = static_cast<int>(std::clamp(std::floor((minimum - origin) / step), 0.0f, static_cast<float>(QuantizedMaximum)));
+		while (lower > 0 && SceneFormat::Dequantize(origin, static_cast<uint8_t>(lower), step) > minimum)
+		{
+			lower--;
+		}
+
+		int upper = static_cast<int>(std::clamp(std::ceil((maximum - origin) / step), 0.0f, static_cast<float>(QuantizedMaximum)));
+		while (upper < QuantizedMaximum && SceneFormat::Dequantize(origin, static_cast<uint8_t>(upper), step) < maximum)
+		{
+			upper++;
+		}
+
+		if (SceneFormat::Dequantize(origin, static_cast<uint8_t>(upper), step) < maximum)
+		{
+			return false;
+		}
+
+		node.lower[axis][i] = static_cast<uint8_t>(lower);
+		node.upper[axis][i] = static_cast<uint8_t>(upper);
+	}
+
+	return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "BVHBuilder.h"
+#include "SceneFormat.h"
+
+#include <cstdint>
+#include <vector>
+
+//Collapses a binary BVHBuilder tree into 4 wide, quantized SceneFormat::WideNodes. Each wide node absorbs the
+//grandchildren of its largest interior children until it has four, so the tree is roughly half as deep and
+//a quarter of the node count, and every node fits in one cache line.
+class WideBVHBuilder
+{
+public:
+	//binary uses the indices BVHBuilder produced, primitiveBase is added to the first primitive of every leaf and
+	//nodes may already hold other trees. Returns the index of the new root in nodes.
+	uint32_t Build(const std::vector<BVHBuilder::Node>& binary, uint32_t primitiveBase, std::vector<SceneFormat::WideNode>& nodes) const;
+
+private:
+	uint32_t BuildRecursive(const std::vector<BVHBuilder::Node>& binary, uint32_t node, uint32_t primitiveBase, std::vector<SceneFormat::WideNode>& nodes) const;
+
+	//Quantizes the child bounds against their union, returns false if an axis doesn't fit in 8 bits with exponent
+	static bool Quantize(const std::vector<AABB>& children, int axis, int8_t exponent, SceneFormat::WideNode& node);
+};
@@ -1,10 +1,20 @@
 #include "XYRectangle.h"
 
+#include "SceneCompiler.h"
+#include "Statistics.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 XYRectangle::XYRectangle(float _x0, float _x1, float _y0, float _y1, float _k, Material* mat) 
 	: x0(_x0), x1(_x1), y0(_y0), y1(_y1), k(_k), mp(mat) {}
 
 bool XYRectangle::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
 {
+	RT_STATISTIC_INCREMENT(primitiveTests);
+
 	float t = (k - r.Origin().z) / r.Direction().z;
 
 	if (t < tMin || t > tMax)
@@ -33,6 +43,49 @@ bool XYRectangle::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord
 
 bool XYRectangle::BoundingBox(float t0, float t1, AABB& box) const
 {
-	box = AABB(Vector3(x0, y0, k - 0.00001f), Vector3(x1, y1, k + 0.00001f));
+	//Padding must scale with k, a fixed amount rounds away for planes far from the origin and leaves a box no ray can hit
+	const float padding = 0.0001f * std::max(1.0f, std::abs(k));
+	box = AABB(Vector3(x0, y0, k - padding), Vector3(x1, y1, k + padding));
+	return true;
+}
+
+float XYRectangle::PdfValue(const Vector3& origin, const Vector3& direction) const
+{
+	HitRecord hitRecord;
+	if (!Hit(Ray(origin, direction, 0.0f), 0.001f, std::numeric_limits<float>::max(), hitRecord))
+	{
+		return 0.0f;
+	}
+
+	//Convert the uniform density over the area into a density over directions
+	const float area = (x1 - x0) * (y1 - y0);
+	const float distanceSquared = hitRecord.t * hitRecord.t * direction.SquaredLength();
+	const float cosine = std::abs(DotProduct(direction, hitRecord.normal)) / direction.Length();
+	return distanceSquared / (cosine * area);
+}
+
+Vector3 XYRectangle::Random(const Vector3& origin) const
+{
+	const float a = x0 + Util::RandomFloat() * (x1 - x0);
+	const float b = y0 + Util::RandomFloat() * (y1 - y0);
+	return Vector3(a, b, k) - origin;
+}
+
+bool XYRectangle::Compile(SceneCompiler& compiler) const
+{
+	SceneFormat::Primitive primitive = {};
+	primitive.type = SceneFormat::PrimitiveType::XYRectangle;
+	if (!compiler.AddMaterial(mp, primitive.material))
+	{
+		return false;
+	}
+
+	primitive.data[0] = x0;
+	primitive.data[1] = x1;
+	primitive.data[2] = y0;
+	primitive.data[3] = y1;
+	primitive.data[4] = k;
+
+	compiler.AddPrimitive(*this, primitive);
 	return true;
-}
\ No newline at end of file
+}
@@ -11,6 +11,9 @@ public:
 
 	bool Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const override;
 	bool BoundingBox(float t0, float t1, AABB& box) const override;
+	float PdfValue(const Vector3& origin, const Vector3& direction) const override;
+	Vector3 Random(const Vector3& origin) const override;
+	bool Compile(SceneCompiler& compiler) const override;
 
 private:
 	Material* mp;
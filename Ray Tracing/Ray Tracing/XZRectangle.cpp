@@ -1,11 +1,21 @@
 #include "XZRectangle.h"
 
+#include "SceneCompiler.h"
+#include "Statistics.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 XZRectangle::XZRectangle(float _x0, float _x1, float _z0, float _z1, float _k, Material* mat) 
 	: x0(_x0), x1(_x1), z0(_z0), z1(_z1), k(_k), mp(mat) 
 {}
 
 bool XZRectangle::Hit(const Ray & r, float tMin, float tMax, HitRecord & hitRecord) const
 {
+	RT_STATISTIC_INCREMENT(primitiveTests);
+
 	auto t = (k - r.Origin().y) / r.Direction().y;
 
 	if (t < tMin || t > tMax)
@@ -35,6 +45,49 @@ bool XZRectangle::Hit(const Ray & r, float tMin, float tMax, HitRecord & hitReco
 
 bool XZRectangle::BoundingBox(float t0, float t1, AABB& box) const
 {
-	box = AABB(Vector3(x0, k - 0.00001f, z0), Vector3(x1, k + 0.00001f, z1));
+	//Padding must scale with k, a fixed amount rounds away for planes far from the origin and leaves a box no ray can hit
+	const float padding = 0.0001f * std::max(1.0f, std::abs(k));
+	box = AABB(Vector3(x0, k - padding, z0), Vector3(x1, k + padding, z1));
+	return true;
+}
+
+float XZRectangle::PdfValue(const Vector3& origin, const Vector3& direction) const
+{
+	HitRecord hitRecord;
+	if (!Hit(Ray(origin, direction, 0.0f), 0.001f, std::numeric_limits<float>::max(), hitRecord))
+	{
+		return 0.0f;
+	}
+
+	//Convert the uniform density over the area into a density over directions
+	const float area = (x1 - x0) * (z1 - z0);
+	const float distanceSquared = hitRecord.t * hitRecord.t * direction.SquaredLength();
+	const float cosine = std::abs(DotProduct(direction, hitRecord.normal)) / direction.Length();
+	return distanceSquared / (cosine * area);
+}
+
+Vector3 XZRectangle::Random(const Vector3& origin) const
+{
+	const float a = x0 + Util::RandomFloat() * (x1 - x0);
+	const float b = z0 + Util::RandomFloat() * (z1 - z0);
+	return Vector3(a, k, b) - origin;
+}
+
+bool XZRectangle::Compile(SceneCompiler& compiler) const
+{
+	SceneFormat::Primitive primitive = {};
+	primitive.type = SceneFormat::PrimitiveType::XZRectangle;
+	if (!compiler.AddMaterial(mp, primitive.material))
+	{
+		return false;
+	}
+
+	primitive.data[0] = x0;
+	primitive.data[1] = x1;
+	primitive.data[2] = z0;
+	primitive.data[3] = z1;
+	primitive.data[4] = k;
+
+	compiler.AddPrimitive(*this, primitive);
 	return true;
 }
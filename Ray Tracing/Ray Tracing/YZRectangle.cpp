@@ -1,10 +1,20 @@
 #include "YZRectangle.h"
 
+#include "SceneCompiler.h"
+#include "Statistics.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 YZRectangle::YZRectangle(float _y0, float _y1, float _z0, float _z1, float _k, Material* mat) 
 	: y0(_y0), y1(_y1), z0(_z0), z1(_z1), k(_k), mp(mat) {}
 
 bool YZRectangle::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord) const
 {
+	RT_STATISTIC_INCREMENT(primitiveTests);
+
 	float t = (k - r.Origin().x) / r.Direction().x;
 
 	if (t < tMin || t > tMax)
@@ -33,6 +43,49 @@ bool YZRectangle::Hit(const Ray& r, float tMin, float tMax, HitRecord& hitRecord
 
 bool YZRectangle::BoundingBox(float t0, float t1, AABB& box) const
 {
-	box = AABB(Vector3(k - 0.00001f, y0, z0), Vector3(k + 0.00001f, y1, z1));
+	//Padding must scale with k, a fixed amount rounds away for planes far from the origin and leaves a box no ray can hit
+	const float padding = 0.0001f * std::max(1.0f, std::abs(k));
+	box = AABB(Vector3(k - padding, y0, z0), Vector3(k + padding, y1, z1));
+	return true;
+}
+
+float YZRectangle::PdfValue(const Vector3& origin, const Vector3& direction) const
+{
+	HitRecord hitRecord;
+	if (!Hit(Ray(origin, direction, 0.0f), 0.001f, std::numeric_limits<float>::max(), hitRecord))
+	{
+		return 0.0f;
+	}
+
+	//Convert the uniform density over the area into a density over directions
+	const float area = (y1 - y0) * (z1 - z0);
+	const float distanceSquared = hitRecord.t * hitRecord.t * direction.SquaredLength();
+	const float cosine = std::abs(DotProduct(direction, hitRecord.normal)) / direction.Length();
+	return distanceSquared / (cosine * area);
+}
+
+Vector3 YZRectangle::Random(const Vector3& origin) const
+{
+	const float a = y0 + Util::RandomFloat() * (y1 - y0);
+	const float b = z0 + Util::RandomFloat() * (z1 - z0);
+	return Vector3(k, a, b) - origin;
+}
+
+bool YZRectangle::Compile(SceneCompiler& compiler) const
+{
+	SceneFormat::Primitive primitive = {};
+	primitive.type = SceneFormat::PrimitiveType::YZRectangle;
+	if (!compiler.AddMaterial(mp, primitive.material))
+	{
+		return false;
+	}
+
+	primitive.data[0] = y0;
+	primitive.data[1] = y1;
+	primitive.data[2] = z0;
+	primitive.data[3] = z1;
+	primitive.data[4] = k;
+
+	compiler.AddPrimitive(*this, primitive);
 	return true;
 }
@@ -1,122 +1,141 @@
 #include "Camera.h"
+#include "AccumulationBuffer.h"
+#include "CommandLine.h"
+#include "CompiledScene.h"
+#include "DistributedRenderer.h"
 #include "ImageData.h"
 #include "Material.h"
+#include "ProgressiveRenderer.h"
 #include "Ray.h"
+#include "RenderDaemon.h"
+#include "Renderer.h"
 #include "Util.h"
 #include "Scenes.h"
+#include "Statistics.h"
 #include "Vector3.h"
 
 #include "ThreadPool.h"
 
-constexpr int imageWidth = 1920;
-constexpr int imageHeight = 1080;
-constexpr int sampleCount = 100;
+void RayTracePixel(const size_t x, const size_t y, const Scene& scene, const Camera& camera, const RenderSettings& settings, unsigned int seed, ImageData& imageData)
+{
+	Util::SeedRandom(Renderer::PixelSeed(seed, x, y));
+	const Vector3 colour = Renderer::RenderPixel(x, y, scene, camera, settings);
 
-ImageData<imageWidth, imageHeight> imageData;
+	imageData.Write(colour, x, settings.height - 1 - y);
+}
 
-Vector3 Colour(const Ray& r, Vector3 background, Hittable* world, int depth)
+void RayTraceTile(const size_t x0, const size_t y0, const size_t x1, const size_t y1, const Scene& scene, const Camera& camera, const RenderSettings& settings, unsigned int seed, ImageData& imageData, StatisticsImage* statisticsImage)
 {
-	HitRecord hitRecord;
+	//Tiles draw their random numbers in tracing order, seed by the tile's first pixel
+	Util::SeedRandom(Renderer::PixelSeed(seed, x0, y0));
 
-	// If we've exceeded the ray bounce limit, no more light is gathered.
-	if (depth <= 0)
-	{
-		return Vector3(0, 0, 0);
-	}
+	std::vector<Vector3> colours;
+	std::vector<TraversalCounters> pixelCounters;
+	Renderer::RenderTile(x0, y0, x1, y1, scene, camera, settings, true, colours, statisticsImage != nullptr ? &pixelCounters : nullptr);
 
-	// If the ray hits nothing, return the background color.
-	if (!world->Hit(r, 0.001f, std::numeric_limits<float>::max(), hitRecord))
+	for (size_t y = y0; y < y1; y++)
 	{
-		return background;
+		for (size_t x = x0; x < x1; x++)
+		{
+			const size_t pixel = (y - y0) * (x1 - x0) + (x - x0);
+			imageData.Write(colours[pixel], x, settings.height - 1 - y);
+			if (statisticsImage != nullptr)
+			{
+				statisticsImage->Write(x, settings.height - 1 - y, pixelCounters[pixel]);
+			}
+		}
 	}
-
-	Ray scattered;
-	Vector3 attenuation;
-	Vector3 emitted = hitRecord.materialPtr->Emitted(hitRecord.u, hitRecord.v, hitRecord.p);
-
-	if (!hitRecord.materialPtr->Scatter(r, hitRecord, attenuation, scattered))
-	{
-		return emitted;
-	}		
-
-	return emitted + attenuation * Colour(scattered, background, world, depth - 1);
 }
 
-void RayTracePixel(const size_t x, const size_t y, const Vector3 background, Hittable* world, const Camera& camera, size_t maxBounces)
+#if RAYTRACING_STATISTICS
+void RayTracePixelWithStatistics(const size_t x, const size_t y, const Scene& scene, const Camera& camera, const RenderSettings& settings, unsigned int seed, ImageData& imageData, StatisticsImage& statisticsImage)
 {
-	Vector3 colour(0.0f, 0.0f, 0.0f);
-
-	for (int s = 0; s < sampleCount; s++)
-	{
-		const float u = static_cast<float>(x + Util::RandomFloat()) / static_cast<float>(imageWidth);
-		const float v = static_cast<float>(y + Util::RandomFloat()) / static_cast<float>(imageHeight);
+	RayTracePixel(x, y, scene, camera, settings, seed, imageData);
 
-		const Ray r = camera.GetRay(u, v);
-
-		colour += Colour(r, background, world, maxBounces);
-	}
-
-	imageData.Write(colour, x, imageHeight-1 - y);
+	statisticsImage.Write(x, settings.height - 1 - y, Statistics::Current());
 }
+#endif
 
-int main()
+bool RenderLocal(const RenderOptions& options)
 {
-	ThreadPool threadPool(std::thread::hardware_concurrency());
-
-	size_t sceneOption = 0;
+	const RenderSettings& settings = options.settings;
 
-	size_t maxBounces = 50;
+	ThreadPool threadPool(options.threadCount != 0 ? options.threadCount : std::thread::hardware_concurrency(), ThreadPool::WaitPolicy::LowLatency, options.pinThreads);
 
-	Hittable* world;
+	ImageData imageData(settings.width, settings.height);
 
-	Vector3 lookfrom;
-	Vector3 lookat;
-	float vfov;
-	float dist_to_focus = 10.0f;
-	float aperture = 0.0f;
-	Vector3 background;
+#if RAYTRACING_STATISTICS
+	StatisticsImage statisticsImage(settings.width, settings.height);
+#endif
 
-	switch (sceneOption)
+	Scene scene;
+	if (!Scenes::CreateOrLoad(options.scene, options.seed, options.sceneFile, scene))
 	{
-	case 0:
-		lookfrom = Vector3(13.0f, 2.0f, 30.0f);
-		lookat = Vector3(0.0f, 0.0f, 0.0f);
-		dist_to_focus = 10.0f;
-		aperture = 0.0f;
-		vfov = 20.0f;
-		background = Vector3(0.70f, 0.80f, 1.00f);
-		world = Scenes::RandomScene();
-		break;
+		return false;
+	}
 
-	case 1:
-		lookfrom = Vector3(278.0f, 278.0f, -800.0f);
-		lookat = Vector3(278.0f, 278.0f, 0.0f);
-		vfov = 40.0f;
-		aperture = 0.0f;
-		dist_to_focus = 10.0f;
-		background = Vector3(0.0f, 0.0f, 0.0f);
-		world = Scenes::CornellBox();
-		break;
+	//A scene file loads as a compiled scene
+	CompiledScene* compiledScene = !options.sceneFile.empty() ? static_cast<CompiledScene*>(scene.world) : nullptr;
+	if (compiledScene != nullptr && options.clusterCacheMegabytes > 0)
+	{
+		compiledScene->SetClusterCacheLimit(static_cast<uint64_t>(options.clusterCacheMegabytes) << 20);
+	}
 
-	case 2:
-		lookfrom = Vector3(13.0f, 2.0f, 3.0f);
-		lookat = Vector3(0.0f, 0.0f, 0.0f);
-		dist_to_focus = 10.0f;
-		aperture = 0.0f;
-		vfov = 20.0f;
-		world = Scenes::TwoPerlinSpheres();
-		break;
+	if (options.lookFrom)
+	{
+		scene.lookFrom = *options.lookFrom;
+	}
+	if (options.lookAt)
+	{
+		scene.lookAt = *options.lookAt;
+	}
+	if (options.verticalFov)
+	{
+		scene.verticalFov = *options.verticalFov;
 	}
 
-	Camera camera(lookfrom, lookat, Vector3(0.0f, 1.0f, 0.0f), vfov, float(imageWidth) / float(imageHeight), aperture, dist_to_focus, 0.0f, 1.0f);
+	Camera camera = scene.CreateCamera(float(settings.width) / float(settings.height));
+
+	if (options.progressive)
+	{
+		AccumulationBuffer buffer(settings.width, settings.height);
+		const bool rendered = Progressive::Render(options, scene, camera, threadPool, buffer);
+		threadPool.Stop(true);
+
+		return rendered && buffer.WriteImage(options.outputPath);
+	}
 
 	std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
-	for (int y = imageHeight - 1; y >= 0; y--)
+	if (options.sortRays)
 	{
-		for (int x = 0; x < imageWidth; x++)
-		{
-			threadPool.AddTask(RayTracePixel, x, y, background, world, camera, maxBounces);
-		}
+		const size_t tilesX = (settings.width + options.tileSize - 1) / options.tileSize;
+		const size_t tilesY = (settings.height + options.tileSize - 1) / options.tileSize;
+		threadPool.ParallelFor(0, tilesX * tilesY, 1, [&](size_t tile)
+			{
+				const size_t x0 = (tile % tilesX) * options.tileSize;
+				const size_t y0 = (tile / tilesX) * options.tileSize;
+				const size_t x1 = std::min(x0 + options.tileSize, settings.width);
+				const size_t y1 = std::min(y0 + options.tileSize, settings.height);
+	#if RAYTRACING_STATISTICS
+				RayTraceTile(x0, y0, x1, y1, scene, camera, settings, options.seed, imageData, &statisticsImage);
+	#else
+				RayTraceTile(x0, y0, x1, y1, scene, camera, settings, options.seed, imageData, nullptr);
+	#endif
+			});
+	}
+	else
+	{
+		//Pixels are split into ranges as threads go idle rather than queued one task each, top row first
+		threadPool.ParallelFor(0, settings.width * settings.height, 0, [&](size_t pixel)
+			{
+				const size_t x = pixel % settings.width;
+				const size_t y = settings.height - 1 - pixel / settings.width;
+	#if RAYTRACING_STATISTICS
+				RayTracePixelWithStatistics(x, y, scene, camera, settings, options.seed, imageData, statisticsImage);
+	#else
+				RayTracePixel(x, y, scene, camera, settings, options.seed, imageData);
+	#endif
+			});
 	}
 	threadPool.Stop(true);
 
@@ -125,5 +144,68 @@ int main()
 
 	std::cout << duration << std::endl;
 
-	imageData.WriteImageDataToFile("render.ppm", sampleCount);
-}
\ No newline at end of file
+	if (compiledScene != nullptr && compiledScene->GetClusterCache() != nullptr)
+	{
+		const ClusterCache& cache = *compiledScene->GetClusterCache();
+		std::cout << "Cluster cache: " << cache.Loads() << " loads, " << cache.Evictions() << " evictions\n";
+	}
+
+	imageData.WriteImageDataToFile(options.outputPath, settings.samplesPerPixel);
+
+#if RAYTRACING_STATISTICS
+	statisticsImage.PrintSummary(std::cout, settings.samplesPerPixel);
+	statisticsImage.WriteHeatmap("heatmap.ppm", HeatmapMetric::TraversalCost);
+	statisticsImage.WriteHeatmap("heatmap_scatter.ppm", HeatmapMetric::ScatterTime);
+#endif
+
+	return true;
+}
+
+bool CompileScene(const RenderOptions& options)
+{
+	Util::SeedRandom(options.seed);
+	const Scene scene = Scenes::Create(options.scene);
+
+	ThreadPool threadPool(options.threadCount != 0 ? options.threadCount : std::thread::hardware_concurrency(), ThreadPool::WaitPolicy::LowLatency, options.pinThreads);
+	if (!Scenes::Compile(scene, options.compiledScenePath, options.compileOptions, &threadPool))
+	{
+		return false;
+	}
+
+	std::cout << "Compiled " << Scenes::GetName(options.scene) << " to " << options.compiledScenePath << "\n";
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	RenderOptions options;
+	if (!CommandLine::Parse(argc, argv, options))
+	{
+		return 1;
+	}
+
+	bool success = false;
+	switch (options.mode)
+	{
+	case RenderMode::Local:
+		success = RenderLocal(options);
+		break;
+	case RenderMode::Coordinator:
+		success = Distributed::RunCoordinator(options);
+		break;
+	case RenderMode::Worker:
+		success = Distributed::RunWorker(options);
+		break;
+	case RenderMode::CompileScene:
+		success = CompileScene(options);
+		break;
+	case RenderMode::Daemon:
+		success = Daemon::Run(options);
+		break;
+	case RenderMode::Submit:
+		success = Daemon::Submit(options);
+		break;
+	}
+
+	return success ? 0 : 1;
+}
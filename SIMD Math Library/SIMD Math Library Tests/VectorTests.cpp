@@ -164,6 +164,60 @@ namespace SIMDTests
 			Assert::AreEqual(expectedResult, result, L"Result is incorrect");
 		}
 
+		TEST_METHOD(DotProduct3)
+		{
+			SIMD::Vector vector1(5.0f, 4.0f, 7.0f, 100.0f);
+			SIMD::Vector vector2(9.0f, 3.0f, 11.0f, 100.0f);
+
+			float expectedResult = vector1.x * vector2.x + vector1.y * vector2.y + vector1.z * vector2.z;
+
+			float result = SIMD::Vector::DotProduct3(vector1, vector2);
+
+			Assert::AreEqual(expectedResult, result, L"Result is incorrect");
+		}
+
+		TEST_METHOD(MinMax)
+		{
+			SIMD::Vector vector1(5.0f, -4.0f, 7.0f, 1.0f);
+			SIMD::Vector vector2(9.0f, 3.0f, -11.0f, 2.0f);
+
+			SIMD::Vector minimum = SIMD::Vector::Min(vector1, vector2);
+			Assert::AreEqual(5.0f, minimum.x, L"X is incorrect");
+			Assert::AreEqual(-4.0f, minimum.y, L"Y is incorrect");
+			Assert::AreEqual(-11.0f, minimum.z, L"Z is incorrect");
+			Assert::AreEqual(1.0f, minimum.w, L"W is incorrect");
+
+			SIMD::Vector maximum = SIMD::Vector::Max(vector1, vector2);
+			Assert::AreEqual(9.0f, maximum.x, L"X is incorrect");
+			Assert::AreEqual(3.0f, maximum.y, L"Y is incorrect");
+			Assert::AreEqual(7.0f, maximum.z, L"Z is incorrect");
+			Assert::AreEqual(2.0f, maximum.w, L"W is incorrect");
+		}
+
+		TEST_METHOD(Load3)
+		{
+			const float values[3] = { 10.0f, 20.0f, 30.0f };
+
+			SIMD::Vector vector = SIMD::Vector::Load3(values);
+
+			Assert::AreEqual(10.0f, vector.x, L"X is incorrect");
+			Assert::AreEqual(20.0f, vector.y, L"Y is incorrect");
+			Assert::AreEqual(30.0f, vector.z, L"Z is incorrect");
+			Assert::AreEqual(0.0f, vector.w, L"W is incorrect");
+		}
+
+		TEST_METHOD(Store3)
+		{
+			float values[4] = { 0.0f, 0.0f, 0.0f, 99.0f };
+
+			SIMD::Vector::Store3(values, SIMD::Vector(10.0f, 20.0f, 30.0f, 40.0f));
+
+			Assert::AreEqual(10.0f, values[0], L"X is incorrect");
+			Assert::AreEqual(20.0f, values[1], L"Y is incorrect");
+			Assert::AreEqual(30.0f, values[2], L"Z is incorrect");
+			Assert::AreEqual(99.0f, values[3], L"Value after Z was overwritten");
+		}
+
 		TEST_METHOD(Equality)
 		{
 			const float x1 = 10.0f;
@@ -131,5 +131,37 @@ namespace SIMD
 
 			return dot.x + dot.y + dot.z + dot.w;
 		}
+
+		//Ignores w, for vectors whose fourth lane is padding
+		static float DotProduct3(const Vector& v1, const Vector& v2)
+		{
+			Vector dot = v1 * v2;
+
+			return dot.x + dot.y + dot.z;
+		}
+
+		static Vector Min(const Vector& v1, const Vector& v2)
+		{
+			return _mm_min_ps(v1.v, v2.v);
+		}
+
+		static Vector Max(const Vector& v1, const Vector& v2)
+		{
+			return _mm_max_ps(v1.v, v2.v);
+		}
+
+		//Loads three floats with w set to zero, never reading past values[2] so it is safe at the end of an allocation
+		static Vector Load3(const float* values)
+		{
+			const __m128 xy = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(values));
+			return _mm_movelh_ps(xy, _mm_load_ss(values + 2));
+		}
+
+		//Stores x, y and z only, leaving whatever follows values[2] untouched
+		static void Store3(float* values, const Vector& param)
+		{
+			_mm_storel_pi(reinterpret_cast<__m64*>(values), param.v);
+			_mm_store_ss(values + 2, _mm_movehl_ps(param.v, param.v));
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,625 @@
+#include "BoundedConcurrentQueue.h"
+#include "ConcurrentQueue.h"
+#include "CoTask.h"
+#include "CpuTopology.h"
+#include "TaskGraph.h"
+#include "TaskGroup.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct BenchmarkSettings
+	{
+		std::vector<size_t> threadCounts = { 1, 2, 4, 8, 16, 32, 64 };
+		size_t items = 1 << 20;
+		size_t tasks = 1 << 18;
+		size_t capacity = 1024;
+		size_t repeats = 3;
+		size_t latencySamples = 2000;
+		std::string outputPath = "threadpool_benchmark.json";
+	};
+
+	struct QueueResult
+	{
+		double milliseconds = 0.0;
+		bool correct = true;
+	};
+
+	struct QueueRun
+	{
+		size_t producers = 0;
+		size_t consumers = 0;
+		QueueResult mutexQueue;
+		QueueResult lockFreeQueue;
+	};
+
+	struct TaskRun
+	{
+		const char* name = "";
+		size_t threads = 0;
+		double milliseconds = 0.0;
+		bool correct = true;
+	};
+
+	struct LatencyRun
+	{
+		const char* policy = "";
+		int64_t gapMicroseconds = 0;
+		double medianMicroseconds = 0.0;
+		double p99Microseconds = 0.0;
+	};
+
+	struct LaneRun
+	{
+		size_t reservedWorkers = 0;
+		const char* priority = "";
+		ThreadPool::LaneStatistics statistics;
+	};
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	double MegaPerSecond(uint64_t count, double milliseconds)
+	{
+		return milliseconds > 0.0 ? static_cast<double>(count) / (milliseconds * 1000.0) : 0.0;
+	}
+
+	std::vector<size_t> ParseThreadCounts(const std::string& list)
+	{
+		std::vector<size_t> counts;
+		std::stringstream stream(list);
+		std::string item;
+		while (std::getline(stream, item, ','))
+		{
+			counts.push_back(std::max<size_t>(1, std::stoul(item)));
+		}
+		return counts;
+	}
+
+	//Producers push their share of the values 1..items, consumers pop until the queue is closed and drained. The
+	//sum of everything popped checks that no value was lost or delivered twice.
+	template<class Queue>
+	QueueResult RunQueue(Queue& queue, size_t producers, size_t consumers, size_t items)
+	{
+		std::atomic<bool> start{ false };
+		std::atomic<uint64_t> poppedSum{ 0 };
+
+		std::vector<std::thread> consumerThreads;
+		for (size_t consumer = 0; consumer < consumers; ++consumer)
+		{
+			consumerThreads.emplace_back([&]()
+				{
+					while (!start.load())
+					{
+						std::this_thread::yield();
+					}
+
+					uint64_t sum = 0;
+					uint64_t value;
+					while (queue.WaitPop(value))
+					{
+						sum += value;
+					}
+					poppedSum.fetch_add(sum);
+				});
+		}
+
+		std::vector<std::thread> producerThreads;
+		for (size_t producer = 0; producer < producers; ++producer)
+		{
+			producerThreads.emplace_back([&, producer]()
+				{
+					while (!start.load())
+					{
+						std::this_thread::yield();
+					}
+
+					for (uint64_t value = producer + 1; value <= items; value += producers)
+					{
+						queue.Push(value);
+					}
+				});
+		}
+
+		const Clock::time_point begin = Clock::now();
+		start.store(true);
+
+		for (std::thread& thread : producerThreads)
+		{
+			thread.join();
+		}
+		queue.CloseQueue();
+		for (std::thread& thread : consumerThreads)
+		{
+			thread.join();
+		}
+
+		QueueResult result;
+		result.milliseconds = MillisecondsSince(begin);
+		result.correct = poppedSum.load() == static_cast<uint64_t>(items) * (items + 1) / 2;
+		return result;
+	}
+
+	//Best of the repeats, each on a fresh queue
+	template<class Queue, class... Arguements>
+	QueueResult BenchmarkQueue(const BenchmarkSettings& settings, size_t producers, size_t consumers, Arguements... arguements)
+	{
+		QueueResult best;
+		for (size_t repeat = 0; repeat < settings.repeats; ++repeat)
+		{
+			Queue queue(arguements...);
+			const QueueResult result = RunQueue(queue, producers, consumers, settings.items);
+			if (repeat == 0 || result.milliseconds < best.milliseconds)
+			{
+				best.milliseconds = result.milliseconds;
+			}
+			best.correct = best.correct && result.correct;
+		}
+		return best;
+	}
+
+	std::vector<QueueRun> RunQueueBenchmarks(const BenchmarkSettings& settings)
+	{
+		//Equal numbers of producers and consumers, then many producers feeding one consumer as event and log queues do
+		std::vector<std::pair<size_t, size_t>> shapes;
+		for (size_t count : settings.threadCounts)
+		{
+			shapes.emplace_back(count, count);
+		}
+		for (size_t count : settings.threadCounts)
+		{
+			if (count > 1)
+			{
+				shapes.emplace_back(count, 1);
+			}
+		}
+
+		std::vector<QueueRun> runs;
+		for (const std::pair<size_t, size_t>& shape : shapes)
+		{
+			QueueRun run;
+			run.producers = shape.first;
+			run.consumers = shape.second;
+			run.mutexQueue = BenchmarkQueue<ConcurrentQueue<uint64_t>>(settings, run.producers, run.consumers);
+			run.lockFreeQueue = BenchmarkQueue<BoundedConcurrentQueue<uint64_t>>(settings, run.producers, run.consumers, settings.capacity);
+			runs.push_back(run);
+		}
+		return runs;
+	}
+
+	//Tiny tasks added from outside the pool, so the time is dominated by the cost of adding and running a task
+	template<class AddTasks>
+	TaskRun BenchmarkTasks(const BenchmarkSettings& settings, const char* name, size_t threads, AddTasks addTasks, bool pinThreads = false)
+	{
+		TaskRun run;
+		run.name = name;
+		run.threads = threads;
+		for (size_t repeat = 0; repeat < settings.repeats; ++repeat)
+		{
+			ThreadPool threadPool(threads, ThreadPool::WaitPolicy::LowLatency, pinThreads);
+			std::atomic<uint64_t> sum{ 0 };
+
+			const Clock::time_point begin = Clock::now();
+			addTasks(threadPool, sum);
+			threadPool.Stop(true);
+			const double milliseconds = MillisecondsSince(begin);
+
+			if (repeat == 0 || milliseconds < run.milliseconds)
+			{
+				run.milliseconds = milliseconds;
+			}
+			run.correct = run.correct && sum.load() == static_cast<uint64_t>(settings.tasks) * (settings.tasks - 1) / 2;
+		}
+		return run;
+	}
+
+#if defined(__cpp_impl_coroutine)
+	//A task of the CoAwait benchmark, which suspends while the task it added runs instead of running tasks meanwhile
+	CoTask<void> AwaitAdded(ThreadPool& threadPool, std::atomic<uint64_t>& sum, uint64_t task)
+	{
+		co_await threadPool.Schedule();
+		const uint64_t added = co_await threadPool.AddTask([task]() { return task + 1; });
+		sum.fetch_add(task + added, std::memory_order_relaxed);
+	}
+#endif
+
+	std::vector<TaskRun> RunTaskBenchmarks(const BenchmarkSettings& settings)
+	{
+		//Built once and run by every repeat: layers of GraphWidth nodes, each waiting for two nodes of the layer before
+		const size_t GraphWidth = 64;
+		std::atomic<uint64_t>* graphSum = nullptr;
+		TaskGraph graph;
+		std::vector<TaskGraph::Node> nodes;
+		nodes.reserve(settings.tasks);
+		for (uint64_t task = 0; task < settings.tasks; ++task)
+		{
+			nodes.push_back(graph.AddNode("", [&graphSum, task]() { graphSum->fetch_add(task, std::memory_order_relaxed); }));
+			if (task >= GraphWidth)
+			{
+				const size_t above = static_cast<size_t>(task) - GraphWidth;
+				const size_t aboveRight = above - above % GraphWidth + (above + 1) % GraphWidth;
+				nodes.back().Succeed(nodes[above]).Succeed(nodes[aboveRight]);
+			}
+		}
+
+		std::vector<TaskRun> runs;
+		for (size_t threads : settings.threadCounts)
+		{
+			runs.push_back(BenchmarkTasks(settings, "AddTask", threads, [&settings](ThreadPool& threadPool, std::atomic<uint64_t>& sum)
+				{
+					std::vector<TaskFuture<uint64_t>> futures;
+					futures.reserve(settings.tasks);
+					for (uint64_t task = 0; task < settings.tasks; ++task)
+					{
+						futures.push_back(threadPool.AddTask([task]() { return task; }));
+					}
+
+					uint64_t total = 0;
+					for (TaskFuture<uint64_t>& future : futures)
+					{
+						total += future.Get();
+					}
+					sum.store(total);
+				}));
+
+			runs.push_back(BenchmarkTasks(settings, "Submit", threads, [&settings](ThreadPool& threadPool, std::atomic<uint64_t>& sum)
+				{
+					for (uint64_t task = 0; task < settings.tasks; ++task)
+					{
+						threadPool.Submit([&sum, task]() { sum.fetch_add(task, std::memory_order_relaxed); });
+					}
+				}));
+
+			//The same work as a loop, split into ranges as threads ask for work instead of queued one task per item
+			runs.push_back(BenchmarkTasks(settings, "ParallelFor", threads, [&settings](ThreadPool& threadPool, std::atomic<uint64_t>& sum)
+				{
+					threadPool.ParallelFor(0, settings.tasks, 0, [&sum](size_t task) { sum.fetch_add(task, std::memory_order_relaxed); });
+				}));
+
+			//The same loop on workers pinned to cores, stealing from their own NUMA node first
+			runs.push_back(BenchmarkTasks(settings, "PinnedFor", threads, [&settings](ThreadPool& threadPool, std::atomic<uint64_t>& sum)
+				{
+					threadPool.ParallelFor(0, settings.tasks, 0, [&sum](size_t task) { sum.fetch_add(task, std::memory_order_relaxed); });
+				}, true));
+
+			runs.push_back(BenchmarkTasks(settings, "Reduce", threads, [&settings](ThreadPool& threadPool, std::atomic<uint64_t>& sum)
+				{
+					sum.store(threadPool.ParallelReduce(size_t(0), settings.tasks, size_t(0), uint64_t(0),
+						[](size_t task) { return static_cast<uint64_t>(task); },
+						[](uint64_t left, uint64_t right) { return left + right; }, true));
+				}));
+
+			//Every task waits for one it added, which only finishes because waiting runs tasks instead of blocking
+			runs.push_back(BenchmarkTasks(settings, "Wait", threads, [&settings](ThreadPool& threadPool, std::atomic<uint64_t>& sum)
+				{
+					TaskGroup group(threadPool);
+					for (uint64_t task = 0; task + 1 < settings.tasks; task += 2)
+					{
+						group.Run([&threadPool, &sum, task]()
+							{
+								TaskFuture<uint64_t> inner = threadPool.AddTask([task]() { return task + 1; });
+								sum.fetch_add(task + threadPool.Get(inner), std::memory_order_relaxed);
+							});
+					}
+					group.Wait();
+				}));
+
+#if defined(__cpp_impl_coroutine)
+			//The same work as coroutines awaiting the task they added
+			runs.push_back(BenchmarkTasks(settings, "CoAwait", threads, [&settings](ThreadPool& threadPool, std::atomic<uint64_t>& sum)
+				{
+					std::vector<CoTask<void>> coroutines;
+					coroutines.reserve(settings.tasks / 2);
+					for (uint64_t task = 0; task + 1 < settings.tasks; task += 2)
+					{
+						coroutines.push_back(AwaitAdded(threadPool, sum, task));
+					}
+
+					TaskFuture<void> all = WhenAll(std::move(coroutines)).Start();
+					threadPool.Wait(all);
+				}));
+#endif
+
+			runs.push_back(BenchmarkTasks(settings, "TaskGraph", threads, [&graph, &graphSum](ThreadPool& threadPool, std::atomic<uint64_t>& sum)
+				{
+					graphSum = &sum;
+					graph.Run(threadPool);
+				}));
+		}
+		return runs;
+	}
+
+	//Time from adding a task to an idle worker starting it, after the worker has been idle for a gap long enough to
+	//still be spinning or to have parked. Waits with TaskFuture::Get so the caller never runs the task itself.
+	LatencyRun BenchmarkWakeLatency(const BenchmarkSettings& settings, ThreadPool::WaitPolicy policy, const char* name, int64_t gapMicroseconds)
+	{
+		ThreadPool threadPool(1, policy);
+		std::vector<double> samples;
+		samples.reserve(settings.latencySamples);
+		for (size_t sample = 0; sample < settings.latencySamples; ++sample)
+		{
+			const Clock::time_point idleUntil = Clock::now() + std::chrono::microseconds(gapMicroseconds);
+			while (Clock::now() < idleUntil)
+			{
+			}
+
+			const Clock::time_point added = Clock::now();
+			TaskFuture<Clock::time_point> started = threadPool.AddTask([]() { return Clock::now(); });
+			samples.push_back(std::chrono::duration<double, std::micro>(started.Get() - added).count());
+		}
+
+		std::sort(samples.begin(), samples.end());
+		LatencyRun run;
+		run.policy = name;
+		run.gapMicroseconds = gapMicroseconds;
+		run.medianMicroseconds = samples[samples.size() / 2];
+		run.p99Microseconds = samples[samples.size() * 99 / 100];
+		return run;
+	}
+
+	std::vector<LatencyRun> RunLatencyBenchmarks(const BenchmarkSettings& settings)
+	{
+		std::vector<LatencyRun> runs;
+		for (int64_t gapMicroseconds : { 0, 10, 100, 1000 })
+		{
+			runs.push_back(BenchmarkWakeLatency(settings, ThreadPool::WaitPolicy::LowLatency, "LowLatency", gapMicroseconds));
+			runs.push_back(BenchmarkWakeLatency(settings, ThreadPool::WaitPolicy::PowerSaving, "PowerSaving", gapMicroseconds));
+		}
+		return runs;
+	}
+
+	//Threads and task length of the priority lane runs
+	const size_t LaneThreads = 4;
+	const int64_t LaneTaskMicroseconds = 20;
+
+	size_t LaneTaskCount(const BenchmarkSettings& settings)
+	{
+		return std::max<size_t>(64, settings.tasks / 64);
+	}
+
+	//A burst of low priority background tasks with normal and high priority tasks mixed in, with and without a worker
+	//reserved for high priority, reporting how long each priority's tasks waited to start
+	std::vector<LaneRun> RunLaneBenchmarks(const BenchmarkSettings& settings)
+	{
+		const auto work = []()
+		{
+			const Clock::time_point until = Clock::now() + std::chrono::microseconds(LaneTaskMicroseconds);
+			while (Clock::now() < until)
+			{
+			}
+		};
+
+		const ThreadPool::Priority priorities[] = { ThreadPool::Priority::High, ThreadPool::Priority::Normal, ThreadPool::Priority::Low };
+		const char* const names[] = { "High", "Normal", "Low" };
+
+		std::vector<LaneRun> runs;
+		for (size_t reservedWorkers = 0; reservedWorkers < 2; ++reservedWorkers)
+		{
+			ThreadPool threadPool(LaneThreads);
+			threadPool.ReserveWorkers(reservedWorkers);
+			threadPool.SetLaneStatistics(true);
+			for (size_t task = 0; task < LaneTaskCount(settings); ++task)
+			{
+				threadPool.Submit(ThreadPool::Priority::Low, work);
+				if (task % 4 == 0)
+				{
+					threadPool.Submit(ThreadPool::Priority::Normal, work);
+				}
+				if (task % 8 == 0)
+				{
+					threadPool.Submit(ThreadPool::Priority::High, work);
+				}
+			}
+			threadPool.Stop(true);
+
+			for (size_t lane = 0; lane < ThreadPool::PriorityCount; ++lane)
+			{
+				LaneRun run;
+				run.reservedWorkers = threadPool.GetReservedWorkers();
+				run.priority = names[lane];
+				run.statistics = threadPool.GetLaneStatistics(priorities[lane]);
+				runs.push_back(run);
+			}
+		}
+		return runs;
+	}
+
+	void PrintResults(const BenchmarkSettings& settings, const std::vector<QueueRun>& runs, const std::vector<TaskRun>& tasks, const std::vector<LatencyRun>& latencies, const std::vector<LaneRun>& lanes)
+	{
+		const CpuTopology topology = CpuTopology::Detect();
+		std::cout << settings.items << " items, bounded capacity " << BoundedConcurrentQueue<uint64_t>(settings.capacity).Capacity()
+			<< ", best of " << settings.repeats << ", " << std::thread::hardware_concurrency() << " hardware threads on "
+			<< topology.GetCoreCount() << " cores and " << topology.GetNodeCount() << " NUMA nodes\n\n";
+
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << std::setw(10) << "producers" << std::setw(10) << "consumers" << std::setw(16) << "mutex Mop/s"
+			<< std::setw(18) << "lock-free Mop/s" << std::setw(10) << "speedup" << "\n";
+		for (const QueueRun& run : runs)
+		{
+			const double mutexRate = MegaPerSecond(settings.items, run.mutexQueue.milliseconds);
+			const double lockFreeRate = MegaPerSecond(settings.items, run.lockFreeQueue.milliseconds);
+			std::cout << std::setw(10) << run.producers
+				<< std::setw(10) << run.consumers
+				<< std::setw(16) << mutexRate
+				<< std::setw(18) << lockFreeRate
+				<< std::setw(10) << (mutexRate > 0.0 ? lockFreeRate / mutexRate : 0.0);
+			if (!run.mutexQueue.correct || !run.lockFreeQueue.correct)
+			{
+				std::cout << "  CHECKSUM MISMATCH";
+			}
+			std::cout << "\n";
+		}
+
+		std::cout << "\n" << settings.tasks << " tasks\n";
+		std::cout << std::setw(12) << "task" << std::setw(10) << "threads" << std::setw(14) << "ns/task" << std::setw(14) << "Mtask/s" << "\n";
+		for (const TaskRun& run : tasks)
+		{
+			std::cout << std::setw(12) << run.name
+				<< std::setw(10) << run.threads
+				<< std::setw(14) << run.milliseconds * 1e6 / settings.tasks
+				<< std::setw(14) << MegaPerSecond(settings.tasks, run.milliseconds);
+			if (!run.correct)
+			{
+				std::cout << "  CHECKSUM MISMATCH";
+			}
+			std::cout << "\n";
+		}
+
+		std::cout << "\nwake latency, " << settings.latencySamples << " samples\n";
+		std::cout << std::setw(12) << "policy" << std::setw(10) << "idle us" << std::setw(14) << "median us" << std::setw(14) << "p99 us" << "\n";
+		for (const LatencyRun& run : latencies)
+		{
+			std::cout << std::setw(12) << run.policy
+				<< std::setw(10) << run.gapMicroseconds
+				<< std::setw(14) << run.medianMicroseconds
+				<< std::setw(14) << run.p99Microseconds << "\n";
+		}
+
+		std::cout << "\npriority lanes, " << LaneTaskCount(settings) << " low, 1 in 4 normal and 1 in 8 high priority tasks of "
+			<< LaneTaskMicroseconds << " us on " << LaneThreads << " threads\n";
+		std::cout << std::setw(10) << "reserved" << std::setw(10) << "priority" << std::setw(10) << "tasks"
+			<< std::setw(16) << "avg wait us" << std::setw(16) << "max wait us" << "\n";
+		for (const LaneRun& run : lanes)
+		{
+			std::cout << std::setw(10) << run.reservedWorkers
+				<< std::setw(10) << run.priority
+				<< std::setw(10) << run.statistics.tasks
+				<< std::setw(16) << run.statistics.averageWaitMicroseconds
+				<< std::setw(16) << run.statistics.maxWaitMicroseconds << "\n";
+		}
+	}
+
+	void WriteQueueResultJson(std::ofstream& file, const char* key, const QueueResult& result, size_t items)
+	{
+		file << "\"" << key << "\": { \"ms\": " << result.milliseconds
+			<< ", \"mopsPerSecond\": " << MegaPerSecond(items, result.milliseconds)
+			<< ", \"correct\": " << (result.correct ? "true" : "false") << " }";
+	}
+
+	void WriteJson(const BenchmarkSettings& settings, const std::vector<QueueRun>& runs, const std::vector<TaskRun>& tasks, const std::vector<LatencyRun>& latencies, const std::vector<LaneRun>& lanes)
+	{
+		std::ofstream file(settings.outputPath);
+		if (!file.is_open())
+		{
+			std::cerr << "Unable to open " << settings.outputPath << "\n";
+			return;
+		}
+
+		file << std::setprecision(6) << std::fixed;
+		file << "{\n";
+		file << "  \"items\": " << settings.items << ",\n";
+		file << "  \"capacity\": " << settings.capacity << ",\n";
+		file << "  \"repeats\": " << settings.repeats << ",\n";
+		const CpuTopology topology = CpuTopology::Detect();
+		file << "  \"hardwareThreads\": " << std::thread::hardware_concurrency() << ",\n";
+		file << "  \"cores\": " << topology.GetCoreCount() << ",\n";
+		file << "  \"numaNodes\": " << topology.GetNodeCount() << ",\n";
+		file << "  \"queues\": [\n";
+		for (size_t i = 0; i < runs.size(); i++)
+		{
+			const QueueRun& run = runs[i];
+			file << "    { \"producers\": " << run.producers << ", \"consumers\": " << run.consumers << ", ";
+			WriteQueueResultJson(file, "mutex", run.mutexQueue, settings.items);
+			file << ", ";
+			WriteQueueResultJson(file, "lockFree", run.lockFreeQueue, settings.items);
+			file << " }" << (i + 1 < runs.size() ? "," : "") << "\n";
+		}
+		file << "  ],\n";
+		file << "  \"tasks\": [\n";
+		for (size_t i = 0; i < tasks.size(); i++)
+		{
+			const TaskRun& run = tasks[i];
+			file << "    { \"name\": \"" << run.name << "\", \"threads\": " << run.threads
+				<< ", \"count\": " << settings.tasks
+				<< ", \"ms\": " << run.milliseconds
+				<< ", \"nsPerTask\": " << run.milliseconds * 1e6 / settings.tasks
+				<< ", \"correct\": " << (run.correct ? "true" : "false") << " }" << (i + 1 < tasks.size() ? "," : "") << "\n";
+		}
+		file << "  ],\n";
+		file << "  \"wakeLatency\": [\n";
+		for (size_t i = 0; i < latencies.size(); i++)
+		{
+			const LatencyRun& run = latencies[i];
+			file << "    { \"policy\": \"" << run.policy << "\", \"idleMicroseconds\": " << run.gapMicroseconds
+				<< ", \"samples\": " << settings.latencySamples
+				<< ", \"medianMicroseconds\": " << run.medianMicroseconds
+				<< ", \"p99Microseconds\": " << run.p99Microseconds << " }" << (i + 1 < latencies.size() ? "," : "") << "\n";
+		}
+		file << "  ],\n";
+		file << "  \"lanes\": [\n";
+		for (size_t i = 0; i < lanes.size(); i++)
+		{
+			const LaneRun& run = lanes[i];
+			file << "    { \"reservedWorkers\": " << run.reservedWorkers << ", \"priority\": \"" << run.priority << "\""
+				<< ", \"tasks\": " << run.statistics.tasks
+				<< ", \"averageWaitMicroseconds\": " << run.statistics.averageWaitMicroseconds
+				<< ", \"maxWaitMicroseconds\": " << run.statistics.maxWaitMicroseconds << " }" << (i + 1 < lanes.size() ? "," : "") << "\n";
+		}
+		file << "  ]\n";
+		file << "}\n";
+	}
+}
+
+//Usage: "Thread Pool Benchmark" [--quick] [--threads 1,2,4] [--items N] [--tasks N] [--capacity N] [--output threadpool_benchmark.json]
+int main(int argc, char** argv)
+{
+	BenchmarkSettings settings;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string argument = argv[i];
+		if (argument == "--quick")
+		{
+			settings.items = 1 << 16;
+			settings.tasks = 1 << 14;
+			settings.repeats = 1;
+			settings.latencySamples = 200;
+		}
+		else if (argument == "--threads" && i + 1 < argc)
+		{
+			settings.threadCounts = ParseThreadCounts(argv[++i]);
+		}
+		else if (argument == "--items" && i + 1 < argc)
+		{
+			settings.items = std::max<size_t>(1, std::stoul(argv[++i]));
+		}
+		else if (argument == "--tasks" && i + 1 < argc)
+		{
+			settings.tasks = std::max<size_t>(1, std::stoul(argv[++i]));
+		}
+		else if (argument == "--capacity" && i + 1 < argc)
+		{
+			settings.capacity = std::max<size_t>(2, std::stoul(argv[++i]));
+		}
+		else if (argument == "--output" && i + 1 < argc)
+		{
+			settings.outputPath = argv[++i];
+		}
+	}
+
+	const std::vector<QueueRun> runs = RunQueueBenchmarks(settings);
+	const std::vector<TaskRun> tasks = RunTaskBenchmarks(settings);
+	const std::vector<LatencyRun> latencies = RunLatencyBenchmarks(settings);
+	const std::vector<LaneRun> lanes = RunLaneBenchmarks(settings);
+
+	PrintResults(settings, runs, tasks, latencies, lanes);
+	WriteJson(settings, runs, tasks, latencies, lanes);
+
+	return 0;
+}
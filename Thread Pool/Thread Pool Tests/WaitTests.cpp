@@ -0,0 +1,61 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "../Thread Pool/ThreadPool.h"
+
+#include <chrono>
+#include <thread>
+#include <utility>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace ThreadPoolTests
+{
+	TEST_CLASS(WaitTests)
+	{
+	public:
+		TEST_METHOD(WokenForLaterTask)
+		{
+			Assert::IsTrue(WaitForLaterTask(0), L"Waiting task never ran the task it waits for");
+		}
+
+		TEST_METHOD(WokenForLaterTaskWithReservedWorkers)
+		{
+			Assert::IsTrue(WaitForLaterTask(1), L"Waiting task never ran the task it waits for");
+		}
+
+	private:
+		//One task waits for a future that a task added while it sleeps completes. The other worker is either asleep
+		//or reserved for high priority tasks, so only the waiting task can run it.
+		static bool WaitForLaterTask(size_t reservedWorkers)
+		{
+			ThreadPool threadPool(2);
+			threadPool.ReserveWorkers(reservedWorkers);
+
+			TaskPromise<int> promise;
+			TaskFuture<int> future = promise.GetFuture();
+			TaskFuture<int> waiting = threadPool.AddTask([&threadPool, &future]() { return threadPool.Get(future); });
+
+			//Gives the waiting task time to go to sleep
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+			threadPool.AddTask([promise = std::move(promise)]() mutable
+				{
+					auto result = []() { return 7; };
+					promise.Run(result);
+				});
+
+			const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+			while (!waiting.Ready() && std::chrono::steady_clock::now() < deadline)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			const bool woken = waiting.Ready();
+
+			//If it never was, a worker no longer reserved can run the task it waits for, so the test still finishes
+			threadPool.ReserveWorkers(0);
+			const int result = waiting.Get();
+			return woken && result == 7;
+		}
+	};
+}
@@ -0,0 +1,322 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+
+//Lock-free bounded multi producer multi consumer queue after Dmitry Vyukov's ring buffer, with the interface of
+//ConcurrentQueue. Each cell has a sequence number saying which lap of the ring it is ready to be written or read
+//in, so producers only contend on the enqueue position and consumers on the dequeue position. Threads only block
+//when the queue is full (Push) or empty (WaitPop), and the lock they block on is never taken while neither waits.
+template<class DataType>
+class BoundedConcurrentQueue
+{
+public:
+	explicit BoundedConcurrentQueue(size_t minimumCapacity = 1024)
+	{
+		size_t capacity = 2;
+		while (capacity < minimumCapacity)
+		{
+			capacity <<= 1;
+		}
+
+		mask = capacity - 1;
+		cells.reset(new Cell[capacity]);
+		for (size_t index = 0; index < capacity; ++index)
+		{
+			cells[index].sequence.store(index, std::memory_order_relaxed);
+		}
+	}
+
+	BoundedConcurrentQueue(const BoundedConcurrentQueue&) = delete;
+	BoundedConcurrentQueue& operator=(const BoundedConcurrentQueue&) = delete;
+
+	~BoundedConcurrentQueue()
+	{
+		Invalidate();
+		while (TryTake([](DataType&) {}))
+		{
+		}
+	}
+
+	bool TryPop(DataType& out)
+	{
+		if (!valid.load())
+		{
+			return false;
+		}
+
+		if (!TryTake([&out](DataType& value) { out = std::move(value); }))
+		{
+			return false;
+		}
+
+		WakeOne(waitingProducers, notFull);
+		return true;
+	}
+
+	//Blocks while the queue is empty, returns false once it is invalidated, or closed and drained
+	bool WaitPop(DataType& out)
+	{
+		for (size_t attempt = 0;; ++attempt)
+		{
+			if (TryPop(out))
+			{
+				return true;
+			}
+
+			if (!valid.load() || (closed.load() && !CanTake()))
+			{
+				return false;
+			}
+
+			if (attempt < SpinCount)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(waitMutex);
+			waitingConsumers.fetch_add(1);
+			//Pairs with the fence in WakeOne, either this sees the pushed value or the producer sees the waiter
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			notEmpty.wait(lock, [this]() { return CanTake() || !valid.load() || closed.load(); });
+			waitingConsumers.fetch_sub(1);
+		}
+	}
+
+	void Pop()
+	{
+		if (TryTake([](DataType&) {}))
+		{
+			WakeOne(waitingProducers, notFull);
+		}
+	}
+
+	//Blocks while the queue is full, the value is dropped if the queue is closed or invalidated first
+	void Push(DataType event)
+	{
+		for (size_t attempt = 0;; ++attempt)
+		{
+			if (closed.load() || !valid.load())
+			{
+				return;
+			}
+
+			if (TryEmplace(std::move(event)))
+			{
+				WakeOne(waitingConsumers, notEmpty);
+				return;
+			}
+
+			if (attempt < SpinCount)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(waitMutex);
+			waitingProducers.fetch_add(1);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			notFull.wait(lock, [this]() { return CanEmplace() || !valid.load() || closed.load(); });
+			waitingProducers.fetch_sub(1);
+		}
+	}
+
+	void MovePush(DataType event)
+	{
+		Push(std::move(event));
+	}
+
+	//Never blocks, returns false and leaves event untouched if the queue is full or closed
+	bool TryPush(const DataType& event)
+	{
+		return TryPushValue(event);
+	}
+
+	bool TryPush(DataType&& event)
+	{
+		return TryPushValue(std::move(event));
+	}
+
+	//a snapshot that may already be stale
+	size_t Size() const
+	{
+		const size_t dequeued = dequeuePosition.load();
+		const size_t enqueued = enqueuePosition.load();
+		return enqueued > dequeued ? enqueued - dequeued : 0;
+	}
+
+	bool Empty() const
+	{
+		return Size() == 0;
+	}
+
+	size_t Capacity() const
+	{
+		return mask + 1;
+	}
+
+	void Clear()
+	{
+		while (TryTake([](DataType&) {}))
+		{
+		}
+		WakeAll();
+	}
+
+	void Invalidate()
+	{
+		valid.store(false);
+		WakeAll();
+	}
+
+	void CloseQueue()
+	{
+		closed.store(true);
+		WakeAll();
+	}
+
+private:
+	struct Cell
+	{
+		DataType* Value()
+		{
+			return reinterpret_cast<DataType*>(&storage);
+		}
+
+		std::atomic<size_t> sequence{ 0 };
+		alignas(DataType) unsigned char storage[sizeof(DataType)];
+	};
+
+	//Attempts at a full or empty queue before blocking, each yielding the rest of the time slice
+	static constexpr size_t SpinCount = 64;
+
+	template<class Value>
+	bool TryPushValue(Value&& event)
+	{
+		if (closed.load() || !valid.load() || !TryEmplace(std::forward<Value>(event)))
+		{
+			return false;
+		}
+
+		WakeOne(waitingConsumers, notEmpty);
+		return true;
+	}
+
+	//Claims the cell at the enqueue position and only then constructs the value in it, so a failed attempt leaves
+	//the value where it was
+	template<class Value>
+	bool TryEmplace(Value&& value)
+	{
+		size_t position = enqueuePosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell& cell = cells[position & mask];
+			const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			const std::ptrdiff_t lap = static_cast<std::ptrdiff_t>(sequence - position);
+			if (lap == 0)
+			{
+				if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					new (&cell.storage) DataType(std::forward<Value>(value));
+					cell.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (lap < 0)
+			{
+				return false; //the cell still holds the value from the previous lap, the queue is full
+			}
+			else
+			{
+				position = enqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	template<class Consumer>
+	bool TryTake(Consumer&& consume)
+	{
+		size_t position = dequeuePosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell& cell = cells[position & mask];
+			const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			const std::ptrdiff_t lap = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+			if (lap == 0)
+			{
+				if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					DataType* value = cell.Value();
+					consume(*value);
+					value->~DataType();
+					cell.sequence.store(position + mask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (lap < 0)
+			{
+				return false; //nothing has been written to the cell this lap, the queue is empty
+			}
+			else
+			{
+				position = dequeuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	//Whether a TryTake or TryEmplace may succeed. A cell that has moved on to a later lap means another thread got
+	//there first and the position is stale, which counts as maybe so the caller tries again rather than sleeping.
+	bool CanTake() const
+	{
+		const size_t position = dequeuePosition.load(std::memory_order_relaxed);
+		const size_t sequence = cells[position & mask].sequence.load(std::memory_order_acquire);
+		return static_cast<std::ptrdiff_t>(sequence - (position + 1)) >= 0;
+	}
+
+	bool CanEmplace() const
+	{
+		const size_t position = enqueuePosition.load(std::memory_order_relaxed);
+		const size_t sequence = cells[position & mask].sequence.load(std::memory_order_acquire);
+		return static_cast<std::ptrdiff_t>(sequence - position) >= 0;
+	}
+
+	void WakeOne(const std::atomic<size_t>& waiting, std::condition_variable& condition)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiting.load(std::memory_order_relaxed) > 0)
+		{
+			std::lock_guard<std::mutex> lock(waitMutex);
+			condition.notify_one();
+		}
+	}
+
+	void WakeAll()
+	{
+		std::lock_guard<std::mutex> lock(waitMutex);
+		notEmpty.notify_all();
+		notFull.notify_all();
+	}
+
+	std::unique_ptr<Cell[]> cells;
+	size_t mask = 0;
+
+	//Producers and consumers each hammer their own position, keep them off each other's cache line
+	alignas(64) std::atomic<size_t> enqueuePosition{ 0 };
+	alignas(64) std::atomic<size_t> dequeuePosition{ 0 };
+
+	alignas(64) std::atomic<bool> valid{ true };
+	std::atomic<bool> closed{ false };
+
+	std::mutex waitMutex;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+	std::atomic<size_t> waitingConsumers{ 0 };
+	std::atomic<size_t> waitingProducers{ 0 };
+};
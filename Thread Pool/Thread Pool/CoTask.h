@@ -0,0 +1,550 @@
+#pragma once
+
+#include "ObjectPool.h"
+#include "TaskFuture.h"
+#include "ThreadPool.h"
+
+#if defined(__cpp_impl_coroutine)
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//Coroutine frames in size classes of FrameGranularity bytes, each recycled through its own ObjectPool, so calling a
+//coroutine allocates nothing once the pools have warmed up. Frames larger than the largest class use the heap.
+class CoroutineFrames
+{
+public:
+	static void* Allocate(size_t size)
+	{
+		const size_t sizeClass = SizeClass(size);
+		return sizeClass < SizeClassCount ? Functions()[sizeClass].allocate() : ::operator new(size);
+	}
+
+	static void Free(void* frame, size_t size)
+	{
+		const size_t sizeClass = SizeClass(size);
+		if (sizeClass < SizeClassCount)
+		{
+			Functions()[sizeClass].free(frame);
+		}
+		else
+		{
+			::operator delete(frame);
+		}
+	}
+
+private:
+	static constexpr size_t FrameGranularity = 64;
+	static constexpr size_t SizeClassCount = 16; //frames of up to a kilobyte
+
+	//Left uninitialised, the coroutine initialises its frame itself
+	template<size_t Size>
+	struct alignas(std::max_align_t) Frame
+	{
+		Frame()
+		{
+		}
+
+		unsigned char bytes[Size];
+	};
+
+	struct SizeClassFunctions
+	{
+		void* (*allocate)();
+		void (*free)(void* frame);
+	};
+
+	static size_t SizeClass(size_t size)
+	{
+		return size == 0 ? 0 : (size - 1) / FrameGranularity;
+	}
+
+	template<size_t Index>
+	static void* AllocateFrame()
+	{
+		return ObjectPool<Frame<(Index + 1) * FrameGranularity>>::Create();
+	}
+
+	template<size_t Index>
+	static void FreeFrame(void* frame)
+	{
+		ObjectPool<Frame<(Index + 1) * FrameGranularity>>::Destroy(static_cast<Frame<(Index + 1) * FrameGranularity>*>(frame));
+	}
+
+	template<size_t... Indices>
+	static const SizeClassFunctions* Functions(std::index_sequence<Indices...>)
+	{
+		static const SizeClassFunctions functions[] = { { &AllocateFrame<Indices>, &FreeFrame<Indices> }... };
+		return functions;
+	}
+
+	static const SizeClassFunctions* Functions()
+	{
+		return Functions(std::make_index_sequence<SizeClassCount>());
+	}
+};
+
+//A coroutine nobody awaits, which runs as soon as it is called and frees itself when it finishes. It must not throw.
+class DetachedCoroutine
+{
+public:
+	struct promise_type
+	{
+		static void* operator new(size_t size)
+		{
+			return CoroutineFrames::Allocate(size);
+		}
+
+		static void operator delete(void* frame, size_t size)
+		{
+			CoroutineFrames::Free(frame, size);
+		}
+
+		DetachedCoroutine get_return_object() const
+		{
+			return DetachedCoroutine();
+		}
+
+		std::suspend_never initial_suspend() const noexcept
+		{
+			return {};
+		}
+
+		std::suspend_never final_suspend() const noexcept
+		{
+			return {};
+		}
+
+		void return_void() const
+		{
+		}
+
+		void unhandled_exception() const
+		{
+			std::terminate();
+		}
+	};
+};
+
+//What a CoTask's coroutine returned or threw
+template<class ValueType>
+class CoTaskResult
+{
+public:
+	template<class Value = ValueType>
+	void return_value(Value&& result)
+	{
+		auto forward = [&result]() -> ValueType { return std::forward<Value>(result); };
+		value.Emplace(forward);
+	}
+
+	void unhandled_exception()
+	{
+		exception = std::current_exception();
+	}
+
+	ValueType Take()
+	{
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+		return value.Take();
+	}
+
+private:
+	std::exception_ptr exception;
+	TaskValue<ValueType> value;
+};
+
+template<>
+class CoTaskResult<void>
+{
+public:
+	void return_void() const
+	{
+	}
+
+	void unhandled_exception()
+	{
+		exception = std::current_exception();
+	}
+
+	void Take()
+	{
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+	}
+
+private:
+	std::exception_ptr exception;
+};
+
+//A coroutine returning ValueType. It starts when first awaited, on the thread awaiting it, and once it finishes it
+//resumes whoever awaited it on the thread it finished on. Awaiting ThreadPool::Schedule moves it onto a worker, and
+//awaiting a TaskFuture or another CoTask suspends it without blocking the thread, which goes back to running other
+//tasks until the result resumes it. Start runs one from code that isn't a coroutine. A task has to have finished
+//before it is destroyed, which awaiting it or its future ensures.
+template<class ValueType>
+class CoTask
+{
+	static_assert(!std::is_reference<ValueType>::value, "tasks returning references aren't supported");
+
+public:
+	class promise_type;
+
+	CoTask() = default;
+
+	CoTask(CoTask&& other) noexcept
+		: handle(other.handle)
+	{
+		other.handle = nullptr;
+	}
+
+	CoTask& operator=(CoTask&& other) noexcept
+	{
+		std::swap(handle, other.handle);
+		return *this;
+	}
+
+	CoTask(const CoTask&) = delete;
+	CoTask& operator=(const CoTask&) = delete;
+
+	~CoTask()
+	{
+		if (handle)
+		{
+			handle.destroy();
+		}
+	}
+
+	bool Valid() const
+	{
+		return static_cast<bool>(handle);
+	}
+
+	bool Done() const
+	{
+		return handle.done();
+	}
+
+	//Suspends the awaiting coroutine until the task finishes, then returns its result or throws what it threw
+	class ResultAwaiter;
+
+	ResultAwaiter operator co_await() &
+	{
+		return ResultAwaiter(handle);
+	}
+
+	ResultAwaiter operator co_await() &&
+	{
+		return ResultAwaiter(handle);
+	}
+
+	//Suspends the awaiting coroutine until the task finishes, leaving its result for co_await to take
+	class CompletionAwaiter;
+
+	CompletionAwaiter Completion()
+	{
+		return CompletionAwaiter(handle);
+	}
+
+	//Runs the task on the calling thread until it first suspends and returns a future for its result, for waiting on
+	//it from code that isn't a coroutine, such as with ThreadPool::Wait, which runs the pool's tasks meanwhile
+	TaskFuture<ValueType> Start() &&
+	{
+		TaskPromise<ValueType> promise;
+		TaskFuture<ValueType> future = promise.GetFuture();
+		Fulfil(std::move(*this), std::move(promise));
+		return future;
+	}
+
+private:
+	using Handle = std::coroutine_handle<promise_type>;
+
+	//Resumes the awaiting coroutine straight from the finished one, without growing the stack
+	struct FinalAwaiter
+	{
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		std::coroutine_handle<> await_suspend(Handle finished) const noexcept
+		{
+			return finished.promise().continuation;
+		}
+
+		void await_resume() const noexcept
+		{
+		}
+	};
+
+	class Awaiter
+	{
+	public:
+		explicit Awaiter(Handle handle)
+			: handle(handle)
+		{
+		}
+
+		bool await_ready() const
+		{
+			return handle.done();
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+		{
+			handle.promise().continuation = awaiting;
+			return handle;
+		}
+
+	protected:
+		Handle handle;
+	};
+
+	explicit CoTask(Handle handle)
+		: handle(handle)
+	{
+	}
+
+	static DetachedCoroutine Fulfil(CoTask task, TaskPromise<ValueType> promise)
+	{
+		co_await task.Completion();
+		auto take = [&task]() { return task.handle.promise().Take(); };
+		promise.Run(take);
+	}
+
+	Handle handle;
+};
+
+template<class ValueType>
+class CoTask<ValueType>::promise_type : public CoTaskResult<ValueType>
+{
+public:
+	static void* operator new(size_t size)
+	{
+		return CoroutineFrames::Allocate(size);
+	}
+
+	static void operator delete(void* frame, size_t size)
+	{
+		CoroutineFrames::Free(frame, size);
+	}
+
+	CoTask get_return_object()
+	{
+		return CoTask(Handle::from_promise(*this));
+	}
+
+	std::suspend_always initial_suspend() const noexcept
+	{
+		return {};
+	}
+
+	FinalAwaiter final_suspend() const noexcept
+	{
+		return {};
+	}
+
+	std::coroutine_handle<> continuation = std::noop_coroutine();
+};
+
+template<class ValueType>
+class CoTask<ValueType>::ResultAwaiter : public Awaiter
+{
+public:
+	using Awaiter::Awaiter;
+
+	ValueType await_resume()
+	{
+		return this->handle.promise().Take();
+	}
+};
+
+template<class ValueType>
+class CoTask<ValueType>::CompletionAwaiter : public Awaiter
+{
+public:
+	using Awaiter::Awaiter;
+
+	void await_resume() const
+	{
+	}
+};
+
+//Suspends until every task has finished. It counts itself as unfinished until it has started them all, so a task
+//finishing straight away can't resume the awaiting coroutine while it is still starting the others.
+template<class ValueType>
+class AllFinished
+{
+public:
+	explicit AllFinished(std::vector<CoTask<ValueType>>& tasks)
+		: tasks(tasks), remaining(tasks.size() + 1)
+	{
+	}
+
+	bool await_ready() const
+	{
+		return tasks.empty();
+	}
+
+	bool await_suspend(std::coroutine_handle<> handle)
+	{
+		awaiting = handle;
+		for (CoTask<ValueType>& task : tasks)
+		{
+			Signal(task, *this);
+		}
+		return remaining.fetch_sub(1) > 1;
+	}
+
+	void await_resume() const
+	{
+	}
+
+private:
+	static DetachedCoroutine Signal(CoTask<ValueType>& task, AllFinished& join)
+	{
+		co_await task.Completion();
+
+		//The awaiter is gone once the coroutine resumes, only this frame is touched after that
+		if (join.remaining.fetch_sub(1) == 1)
+		{
+			join.awaiting.resume();
+		}
+	}
+
+	std::vector<CoTask<ValueType>>& tasks;
+	std::atomic<size_t> remaining;
+	std::coroutine_handle<> awaiting;
+};
+
+//Tasks raced by WhenAny, shared with the ones still running after the first has finished
+template<class ValueType>
+class FirstFinished
+{
+public:
+	struct Race
+	{
+		explicit Race(std::vector<CoTask<ValueType>> tasks)
+			: tasks(std::move(tasks))
+		{
+		}
+
+		std::vector<CoTask<ValueType>> tasks;
+		std::atomic<bool> finished{ false };
+		std::atomic<int> arrived{ 0 }; //the winner and the awaiter, whichever arrives second resumes the coroutine
+		size_t winner = 0;
+		std::coroutine_handle<> awaiting;
+	};
+
+	explicit FirstFinished(std::shared_ptr<Race> race)
+		: race(std::move(race))
+	{
+	}
+
+	bool await_ready() const
+	{
+		return false;
+	}
+
+	bool await_suspend(std::coroutine_handle<> handle)
+	{
+		race->awaiting = handle;
+		for (size_t index = 0; index < race->tasks.size(); ++index)
+		{
+			Signal(race, index);
+		}
+		return race->arrived.fetch_add(1) == 0;
+	}
+
+	size_t await_resume() const
+	{
+		return race->winner;
+	}
+
+private:
+	static DetachedCoroutine Signal(std::shared_ptr<Race> race, size_t index)
+	{
+		co_await race->tasks[index].Completion();
+
+		if (!race->finished.exchange(true))
+		{
+			race->winner = index;
+			if (race->arrived.fetch_add(1) == 1)
+			{
+				race->awaiting.resume();
+			}
+		}
+	}
+
+	std::shared_ptr<Race> race;
+};
+
+//Awaits every task and returns their results in order, or throws the first exception in that order. Each task runs
+//on the awaiting thread until it first suspends before the next is started, so tasks that begin by awaiting
+//ThreadPool::Schedule run in parallel.
+template<class ValueType>
+CoTask<std::vector<ValueType>> WhenAll(std::vector<CoTask<ValueType>> tasks)
+{
+	co_await AllFinished<ValueType>(tasks);
+
+	std::vector<ValueType> results;
+	results.reserve(tasks.size());
+	for (CoTask<ValueType>& task : tasks)
+	{
+		results.push_back(co_await task);
+	}
+	co_return results;
+}
+
+inline CoTask<void> WhenAll(std::vector<CoTask<void>> tasks)
+{
+	co_await AllFinished<void>(tasks);
+
+	for (CoTask<void>& task : tasks)
+	{
+		co_await task;
+	}
+}
+
+//Awaits the first task to finish and returns its index and result, or throws what it threw. Tasks are started as
+//WhenAll starts them. Coroutines can't be cancelled, so the others keep running and their results are dropped.
+template<class ValueType>
+CoTask<std::pair<size_t, ValueType>> WhenAny(std::vector<CoTask<ValueType>> tasks)
+{
+	if (tasks.empty())
+	{
+		throw std::invalid_argument("WhenAny needs at least one task");
+	}
+
+	std::shared_ptr<typename FirstFinished<ValueType>::Race> race = std::make_shared<typename FirstFinished<ValueType>::Race>(std::move(tasks));
+	const size_t winner = co_await FirstFinished<ValueType>(race);
+	co_return std::pair<size_t, ValueType>(winner, co_await race->tasks[winner]);
+}
+
+inline CoTask<size_t> WhenAny(std::vector<CoTask<void>> tasks)
+{
+	if (tasks.empty())
+	{
+		throw std::invalid_argument("WhenAny needs at least one task");
+	}
+
+	std::shared_ptr<FirstFinished<void>::Race> race = std::make_shared<FirstFinished<void>::Race>(std::move(tasks));
+	const size_t winner = co_await FirstFinished<void>(race);
+	co_await race->tasks[winner];
+	co_return winner;
+}
+
+#endif
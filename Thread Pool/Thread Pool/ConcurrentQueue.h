@@ -3,6 +3,7 @@
 #include <condition_variable>
 #include <mutex>
 #include <queue>
+#include <utility>
 
 template<class DataType>
 class ConcurrentQueue
@@ -32,7 +33,9 @@ public:
 	bool WaitPop(DataType& out)
 	{
 		std::unique_lock<std::mutex> lock(queueMutex);
+		++waiting;
 		condition.wait(lock, [this]() { return !queue.empty() || !valid || close; }); //wait until the workQueue is not empty
+		--waiting;
 
 		if (queue.empty() || !valid)
 		{
@@ -56,8 +59,8 @@ public:
 		std::lock_guard<std::mutex> lockguard(queueMutex);
 		if (!close)
 		{
-			queue.push(event);
-			condition.notify_one();
+			queue.push(std::move(event));
+			NotifyWaiter();
 		}
 	}
 
@@ -67,7 +70,7 @@ public:
 		if (!close)
 		{
 			queue.push(std::move(event));
-			condition.notify_one();
+			NotifyWaiter();
 		}
 	}
 
@@ -105,9 +108,19 @@ public:
 	}
 
 private:
+	//Waiters count themselves under the lock, so a push with nobody waiting skips the notify
+	void NotifyWaiter()
+	{
+		if (waiting > 0)
+		{
+			condition.notify_one();
+		}
+	}
+
 	std::mutex queueMutex;
 	std::condition_variable condition;
 	std::queue<DataType> queue;
 	bool valid = true;
 	bool close = false;
+	size_t waiting = 0;
 };
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <map>
+#include <new>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#define CPU_TOPOLOGY_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#ifdef CPU_TOPOLOGY_LEAN_AND_MEAN
+#undef WIN32_LEAN_AND_MEAN
+#undef CPU_TOPOLOGY_LEAN_AND_MEAN
+#endif
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//The logical processors the process may run on, grouped into physical cores and NUMA nodes, used to pin a pool's
+//workers and to place memory on the node whose workers use it. Linux reads it from /sys and Windows asks the system
+//for it, both leaving out processors outside the process's affinity mask, such as those of other cpusets.
+//Anywhere else, or if it can't be read, every hardware thread is its own core on one node and pinning does nothing.
+//Nodes are numbered from 0 in the order the system lists them.
+class CpuTopology
+{
+public:
+	struct Processor
+	{
+		size_t id = 0; //the system's number for it, which pinning takes
+		size_t core = 0; //shared by the hardware threads of one physical core
+		size_t node = 0;
+		size_t thread = 0; //which of its core's hardware threads it is, 0 for the first
+	};
+
+	static CpuTopology Detect()
+	{
+		CpuTopology topology;
+		if (!topology.Read() || topology.processors.empty())
+		{
+			topology = CpuTopology();
+			const size_t count = std::max<unsigned int>(1, std::thread::hardware_concurrency());
+			for (size_t id = 0; id < count; ++id)
+			{
+				Processor processor;
+				processor.id = id;
+				processor.core = id;
+				topology.processors.push_back(processor);
+			}
+		}
+
+		topology.NumberThreads();
+		return topology;
+	}
+
+	const std::vector<Processor>& GetProcessors() const
+	{
+		return processors;
+	}
+
+	size_t GetCoreCount() const
+	{
+		return coreCount;
+	}
+
+	size_t GetNodeCount() const
+	{
+		return std::max<size_t>(1, nodeIds.size());
+	}
+
+	//Processors in the order workers are pinned to them: the first hardware thread of every core node by node, then
+	//the second of every core and so on, so each worker has a core to itself before any share one, and workers next
+	//to each other in the order share a node
+	std::vector<Processor> PlacementOrder() const
+	{
+		std::vector<Processor> order = processors;
+		std::stable_sort(order.begin(), order.end(), [](const Processor& left, const Processor& right)
+			{
+				return std::tie(left.thread, left.node, left.core) < std::tie(right.thread, right.node, right.core);
+			});
+		return order;
+	}
+
+	//Keeps the calling thread on one processor, returns false where that isn't supported or fails
+	static bool PinCurrentThread(size_t processorId)
+	{
+#if defined(_WIN32)
+		if (processorId >= sizeof(DWORD_PTR) * 8)
+		{
+			return false;
+		}
+		return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << processorId) != 0;
+#elif defined(__linux__)
+		if (processorId >= CPU_SETSIZE)
+		{
+			return false;
+		}
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(processorId, &set);
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+		(void)processorId;
+		return false;
+#endif
+	}
+
+	//Whole pages of memory that prefer node's memory wherever they are first touched, for a large buffer only one
+	//node's workers use, which the first thread to touch it may not be one of. Without NUMA support it is ordinary
+	//memory. Returns nullptr if the memory can't be allocated, free it with FreeOnNode.
+	void* AllocateOnNode(size_t bytes, size_t node) const
+	{
+#if defined(_WIN32)
+		void* memory = nullptr;
+		if (node < nodeIds.size())
+		{
+			memory = VirtualAllocExNuma(GetCurrentProcess(), nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, static_cast<DWORD>(nodeIds[node]));
+		}
+		if (memory == nullptr)
+		{
+			memory = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		}
+		return memory;
+#elif defined(__linux__)
+		void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED)
+		{
+			return nullptr;
+		}
+
+		if (node < nodeIds.size())
+		{
+			//Only a preference, pages still come from other nodes once this one is full. Fails harmlessly on kernels
+			//without NUMA support, leaving the memory where it is first touched.
+			const size_t bitsPerWord = sizeof(unsigned long) * 8;
+			std::vector<unsigned long> mask(nodeIds[node] / bitsPerWord + 1, 0);
+			mask[nodeIds[node] / bitsPerWord] |= 1ul << (nodeIds[node] % bitsPerWord);
+			syscall(SYS_mbind, memory, bytes, PreferredPolicy, mask.data(), mask.size() * bitsPerWord + 1, 0);
+		}
+		return memory;
+#else
+		(void)node;
+		return ::operator new(bytes, std::nothrow);
+#endif
+	}
+
+	static void FreeOnNode(void* memory, size_t bytes)
+	{
+		if (memory == nullptr)
+		{
+			return;
+		}
+
+#if defined(_WIN32)
+		(void)bytes;
+		VirtualFree(memory, 0, MEM_RELEASE);
+#elif defined(__linux__)
+		munmap(memory, bytes);
+#else
+		(void)bytes;
+		::operator delete(memory);
+#endif
+	}
+
+private:
+#if defined(__linux__)
+	//MPOL_PREFERRED from linux/mempolicy.h
+	static constexpr int PreferredPolicy = 1;
+
+	//Reads a list such as "0-3,8-11" as /sys writes them
+	static std::vector<size_t> ReadList(const std::string& path)
+	{
+		std::vector<size_t> values;
+		std::ifstream file(path);
+		std::string list;
+		if (!std::getline(file, list))
+		{
+			return values;
+		}
+
+		size_t position = 0;
+		while (position < list.size())
+		{
+			size_t end = list.find(',', position);
+			if (end == std::string::npos)
+			{
+				end = list.size();
+			}
+
+			const std::string range = list.substr(position, end - position);
+			const size_t dash = range.find('-');
+			if (!range.empty() && range.find_first_not_of("0123456789-\n") == std::string::npos)
+			{
+				const size_t first = std::stoul(range.substr(0, dash));
+				const size_t last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+				for (size_t value = first; value <= last; ++value)
+				{
+					values.push_back(value);
+				}
+			}
+			position = end + 1;
+		}
+		return values;
+	}
+
+	static bool ReadNumber(const std::string& path, size_t& value)
+	{
+		std::ifstream file(path);
+		return static_cast<bool>(file >> value);
+	}
+
+	bool Read()
+	{
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		const bool restricted = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+		const std::string cpuDirectory = "/sys/devices/system/cpu/";
+		std::map<std::pair<size_t, size_t>, size_t> cores; //package and core id to core
+		for (size_t id : ReadList(cpuDirectory + "online"))
+		{
+			if (restricted && (id >= CPU_SETSIZE || !CPU_ISSET(id, &allowed)))
+			{
+				continue;
+			}
+
+			const std::string topology = cpuDirectory + "cpu" + std::to_string(id) + "/topology/";
+			size_t package = 0;
+			size_t coreId = id;
+			ReadNumber(topology + "physical_package_id", package);
+			ReadNumber(topology + "core_id", coreId);
+
+			Processor processor;
+			processor.id = id;
+			processor.core = cores.emplace(std::make_pair(package, coreId), cores.size()).first->second;
+			processors.push_back(processor);
+		}
+
+		const std::string nodeDirectory = "/sys/devices/system/node/";
+		for (size_t nodeId : ReadList(nodeDirectory + "online"))
+		{
+			const std::vector<size_t> nodeProcessors = ReadList(nodeDirectory + "node" + std::to_string(nodeId) + "/cpulist");
+			bool used = false;
+			for (Processor& processor : processors)
+			{
+				if (std::find(nodeProcessors.begin(), nodeProcessors.end(), processor.id) != nodeProcessors.end())
+				{
+					processor.node = nodeIds.size();
+					used = true;
+				}
+			}
+
+			//Nodes the process can't run on, such as memory only nodes, aren't counted
+			if (used)
+			{
+				nodeIds.push_back(nodeId);
+			}
+		}
+
+		return !processors.empty();
+	}
+#elif defined(_WIN32)
+	bool Read()
+	{
+		DWORD length = 0;
+		GetLogicalProcessorInformation(nullptr, &length);
+		if (length == 0)
+		{
+			return false;
+		}
+
+		std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> information(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+		if (!GetLogicalProcessorInformation(information.data(), &length))
+		{
+			return false;
+		}
+
+		DWORD_PTR allowed = 0;
+		DWORD_PTR system = 0;
+		if (!GetProcessAffinityMask(GetCurrentProcess(), &allowed, &system) || allowed == 0)
+		{
+			allowed = ~static_cast<DWORD_PTR>(0);
+		}
+
+		const size_t maskBits = sizeof(ULONG_PTR) * 8;
+		std::vector<size_t> processorNodes(maskBits, 0);
+		for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& entry : information)
+		{
+			//Nodes the process can't run on aren't counted
+			if (entry.Relationship == RelationNumaNode && (entry.ProcessorMask & allowed) != 0)
+			{
+				for (size_t id = 0; id < maskBits; ++id)
+				{
+					if (entry.ProcessorMask & (static_cast<ULONG_PTR>(1) << id))
+					{
+						processorNodes[id] = nodeIds.size();
+					}
+				}
+				nodeIds.push_back(entry.NumaNode.NodeNumber);
+			}
+		}
+
+		size_t core = 0;
+		for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& entry : information)
+		{
+			if (entry.Relationship == RelationProcessorCore && (entry.ProcessorMask & allowed) != 0)
+			{
+				for (size_t id = 0; id < maskBits; ++id)
+				{
+					if (entry.ProcessorMask & allowed & (static_cast<ULONG_PTR>(1) << id))
+					{
+						Processor processor;
+						processor.id = id;
+						processor.core = core;
+						processor.node = processorNodes[id];
+						processors.push_back(processor);
+					}
+				}
+				++core;
+			}
+		}
+
+		std::sort(processors.begin(), processors.end(), [](const Processor& left, const Processor& right) { return left.id < right.id; });
+		return !processors.empty();
+	}
+#else
+	bool Read()
+	{
+		return false;
+	}
+#endif
+
+	//Numbers each core's hardware threads in processor order and counts the cores
+	void NumberThreads()
+	{
+		std::vector<size_t> threadsOnCore;
+		for (Processor& processor : processors)
+		{
+			if (processor.core >= threadsOnCore.size())
+			{
+				threadsOnCore.resize(processor.core + 1, 0);
+			}
+			processor.thread = threadsOnCore[processor.core]++;
+		}
+		coreCount = threadsOnCore.size();
+	}
+
+	std::vector<Processor> processors;
+	std::vector<size_t> nodeIds; //the system's number for each node, empty when nodes are unknown
+	size_t coreCount = 0;
+};
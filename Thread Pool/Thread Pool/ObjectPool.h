@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+//Recycles the memory of objects that are often created on one thread and destroyed on another, such as tasks and
+//their futures. Each thread keeps a cache of free slots and trades whole batches with a shared depot, so creating
+//or destroying an object touches no allocator and the depot's lock is taken once per batch. Slots are only handed
+//back to the system when the program exits.
+template<class Type>
+class ObjectPool
+{
+public:
+	template<class... Arguements>
+	static Type* Create(Arguements&&... arguements)
+	{
+		return new (Allocate()) Type(std::forward<Arguements>(arguements)...);
+	}
+
+	static void Destroy(Type* object)
+	{
+		if (object != nullptr)
+		{
+			object->~Type();
+			Free(object);
+		}
+	}
+
+private:
+	union Slot
+	{
+		Slot* next;
+		alignas(Type) unsigned char storage[sizeof(Type)];
+	};
+
+	//Slots moved between a thread's cache and the depot at once, a cache holds at most two batches
+	static constexpr size_t BatchSize = 64;
+
+	struct Batch
+	{
+		Slot* head;
+		size_t count;
+	};
+
+	struct Depot
+	{
+		~Depot()
+		{
+			for (const Batch& batch : batches)
+			{
+				DeleteSlots(batch.head);
+			}
+		}
+
+		std::mutex mutex;
+		std::vector<Batch> batches;
+	};
+
+	struct Cache
+	{
+		~Cache()
+		{
+			if (head != nullptr)
+			{
+				Depot& depot = GetDepot();
+				std::lock_guard<std::mutex> lock(depot.mutex);
+				depot.batches.push_back({ head, count });
+			}
+		}
+
+		Slot* head = nullptr;
+		size_t count = 0;
+	};
+
+	static Depot& GetDepot()
+	{
+		static Depot depot;
+		return depot;
+	}
+
+	static Cache& GetCache()
+	{
+		static thread_local Cache cache;
+		return cache;
+	}
+
+	static void* Allocate()
+	{
+		Cache& cache = GetCache();
+		if (cache.head == nullptr && !TakeBatch(cache))
+		{
+			return new Slot;
+		}
+
+		Slot* slot = cache.head;
+		cache.head = slot->next;
+		--cache.count;
+		return slot;
+	}
+
+	static bool TakeBatch(Cache& cache)
+	{
+		Depot& depot = GetDepot();
+		std::lock_guard<std::mutex> lock(depot.mutex);
+		if (depot.batches.empty())
+		{
+			return false;
+		}
+
+		cache.head = depot.batches.back().head;
+		cache.count = depot.batches.back().count;
+		depot.batches.pop_back();
+		return true;
+	}
+
+	static void Free(void* memory)
+	{
+		Cache& cache = GetCache();
+		Slot* slot = static_cast<Slot*>(memory);
+		slot->next = cache.head;
+		cache.head = slot;
+		++cache.count;
+
+		if (cache.count == 2 * BatchSize)
+		{
+			//Keep one batch for this thread's next allocations, hand the other to threads that allocate more than they free
+			Slot* batch = cache.head;
+			Slot* last = batch;
+			for (size_t index = 1; index < BatchSize; ++index)
+			{
+				last = last->next;
+			}
+			cache.head = last->next;
+			cache.count -= BatchSize;
+			last->next = nullptr;
+
+			Depot& depot = GetDepot();
+			std::lock_guard<std::mutex> lock(depot.mutex);
+			depot.batches.push_back({ batch, BatchSize });
+		}
+	}
+
+	static void DeleteSlots(Slot* slot)
+	{
+		while (slot != nullptr)
+		{
+			Slot* next = slot->next;
+			delete slot;
+			slot = next;
+		}
+	}
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//A move-only callable taking no arguments, which unlike std::function can hold move-only callables. Callables of up
+//to InlineSize bytes that move without throwing are stored inside the task, so a task the size of a cache line
+//needs no allocation. Larger ones are stored on the heap.
+class Task
+{
+public:
+	static constexpr size_t InlineSize = 64 - sizeof(void*);
+
+	Task() = default;
+
+	template<class Function, class = typename std::enable_if<!std::is_same<typename std::decay<Function>::type, Task>::value>::type>
+	Task(Function&& function)
+	{
+		using Callable = typename std::decay<Function>::type;
+		Construct<Callable>(std::forward<Function>(function), StoresInline<Callable>());
+	}
+
+	Task(Task&& other) noexcept
+	{
+		MoveFrom(other);
+	}
+
+	Task& operator=(Task&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Reset();
+			MoveFrom(other);
+		}
+		return *this;
+	}
+
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+
+	~Task()
+	{
+		Reset();
+	}
+
+	void operator()()
+	{
+		operations->invoke(storage);
+	}
+
+	explicit operator bool() const
+	{
+		return operations != nullptr;
+	}
+
+	void Reset()
+	{
+		if (operations != nullptr)
+		{
+			operations->destroy(storage);
+			operations = nullptr;
+		}
+	}
+
+private:
+	struct Operations
+	{
+		void (*invoke)(void* storage);
+		void (*move)(void* from, void* to); //move constructs into to and destroys from
+		void (*destroy)(void* storage);
+	};
+
+	template<class Callable>
+	using StoresInline = std::integral_constant<bool, sizeof(Callable) <= InlineSize
+		&& alignof(Callable) <= alignof(std::max_align_t)
+		&& std::is_nothrow_move_constructible<Callable>::value>;
+
+	template<class Callable>
+	struct InlineOperations
+	{
+		static Callable& Get(void* storage)
+		{
+			return *static_cast<Callable*>(storage);
+		}
+
+		static void Invoke(void* storage)
+		{
+			Get(storage)();
+		}
+
+		static void Move(void* from, void* to)
+		{
+			new (to) Callable(std::move(Get(from)));
+			Get(from).~Callable();
+		}
+
+		static void Destroy(void* storage)
+		{
+			Get(storage).~Callable();
+		}
+
+		static const Operations* Table()
+		{
+			static const Operations table = { Invoke, Move, Destroy };
+			return &table;
+		}
+	};
+
+	template<class Callable>
+	struct HeapOperations
+	{
+		static Callable*& Get(void* storage)
+		{
+			return *static_cast<Callable**>(storage);
+		}
+
+		static void Invoke(void* storage)
+		{
+			(*Get(storage))();
+		}
+
+		static void Move(void* from, void* to)
+		{
+			new (to) Callable*(Get(from));
+		}
+
+		static void Destroy(void* storage)
+		{
+			delete Get(storage);
+		}
+
+		static const Operations* Table()
+		{
+			static const Operations table = { Invoke, Move, Destroy };
+			return &table;
+		}
+	};
+
+	template<class Callable, class Function>
+	void Construct(Function&& function, std::true_type)
+	{
+		new (storage) Callable(std::forward<Function>(function));
+		operations = InlineOperations<Callable>::Table();
+	}
+
+	template<class Callable, class Function>
+	void Construct(Function&& function, std::false_type)
+	{
+		new (storage) Callable*(new Callable(std::forward<Function>(function)));
+		operations = HeapOperations<Callable>::Table();
+	}
+
+	void MoveFrom(Task& other)
+	{
+		if (other.operations != nullptr)
+		{
+			other.operations->move(other.storage, storage);
+			operations = other.operations;
+			other.operations = nullptr;
+		}
+	}
+
+	alignas(std::max_align_t) unsigned char storage[InlineSize];
+	const Operations* operations = nullptr;
+};
@@ -0,0 +1,434 @@
+#pragma once
+
+#include "ObjectPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+template<class ValueType>
+class TaskFuture;
+
+//Storage for a task's result, which a void task doesn't have
+template<class ValueType>
+class TaskValue
+{
+public:
+	TaskValue() = default;
+	TaskValue(const TaskValue&) = delete;
+	TaskValue& operator=(const TaskValue&) = delete;
+
+	~TaskValue()
+	{
+		if (constructed)
+		{
+			reinterpret_cast<ValueType*>(&storage)->~ValueType();
+		}
+	}
+
+	template<class Function>
+	void Emplace(Function& function)
+	{
+		new (&storage) ValueType(function());
+		constructed = true;
+	}
+
+	ValueType Take()
+	{
+		return std::move(*reinterpret_cast<ValueType*>(&storage));
+	}
+
+private:
+	alignas(ValueType) unsigned char storage[sizeof(ValueType)];
+	bool constructed = false;
+};
+
+template<>
+class TaskValue<void>
+{
+public:
+	template<class Function>
+	void Emplace(Function& function)
+	{
+		function();
+	}
+
+	void Take()
+	{
+	}
+};
+
+//State shared by a TaskPromise and its TaskFuture. States come from an ObjectPool, so once the pool has warmed up
+//a task with a future allocates nothing.
+template<class ValueType>
+class TaskState
+{
+	static_assert(!std::is_reference<ValueType>::value, "tasks returning references aren't supported");
+
+public:
+	enum class Status : uint32_t
+	{
+		Pending,
+		Value,
+		Exception,
+		Broken
+	};
+
+	static TaskState* Create()
+	{
+		return ObjectPool<TaskState>::Create();
+	}
+
+	void AddReference()
+	{
+		references.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void Release()
+	{
+		if (references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			ObjectPool<TaskState>::Destroy(this);
+		}
+	}
+
+	bool Ready() const
+	{
+		return status.load(std::memory_order_acquire) != Status::Pending;
+	}
+
+	void Wait()
+	{
+		if (Ready())
+		{
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		waiting.fetch_add(1);
+		//Pairs with the fence in Complete, either this sees the result or the task sees the waiter
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		condition.wait(lock, [this]() { return Ready(); });
+		waiting.fetch_sub(1);
+	}
+
+	template<class Clock, class Duration>
+	bool WaitUntil(const std::chrono::time_point<Clock, Duration>& time)
+	{
+		if (Ready())
+		{
+			return true;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		waiting.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const bool ready = condition.wait_until(lock, time, [this]() { return Ready(); });
+		waiting.fetch_sub(1);
+		return ready;
+	}
+
+	//Calls continuation(context) once the result is set, on the thread setting it. Returns false without calling it
+	//if the result is already there. Only one continuation can be waiting.
+	bool Then(void (*continuation)(void*), void* context)
+	{
+		if (Ready())
+		{
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		waiting.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (Ready())
+		{
+			waiting.fetch_sub(1);
+			return false;
+		}
+
+		this->continuation = continuation;
+		continuationContext = context;
+		return true;
+	}
+
+	//Runs the task and stores what it returned or threw
+	template<class Function>
+	void Run(Function& function)
+	{
+		try
+		{
+			value.Emplace(function);
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+			Complete(Status::Exception);
+			return;
+		}
+
+		Complete(Status::Value);
+	}
+
+	//The task was dropped without running
+	void Break()
+	{
+		if (!Ready())
+		{
+			Complete(Status::Broken);
+		}
+	}
+
+	//Waits for the result, then moves it out or throws what the task threw, or broken_promise if it never ran
+	ValueType Take()
+	{
+		Wait();
+
+		const Status result = status.load(std::memory_order_acquire);
+		if (result == Status::Exception)
+		{
+			std::rethrow_exception(exception);
+		}
+		if (result == Status::Broken)
+		{
+			throw std::future_error(std::future_errc::broken_promise);
+		}
+
+		return value.Take();
+	}
+
+private:
+	void Complete(Status result)
+	{
+		status.store(result, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiting.load(std::memory_order_relaxed) > 0)
+		{
+			void (*waitingContinuation)(void*) = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				condition.notify_all();
+				std::swap(waitingContinuation, continuation);
+			}
+
+			if (waitingContinuation != nullptr)
+			{
+				waiting.fetch_sub(1);
+				waitingContinuation(continuationContext);
+			}
+		}
+	}
+
+	std::atomic<Status> status{ Status::Pending };
+	std::atomic<uint32_t> references{ 1 };
+	std::atomic<uint32_t> waiting{ 0 };
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::exception_ptr exception;
+	TaskValue<ValueType> value;
+	void (*continuation)(void*) = nullptr;
+	void* continuationContext = nullptr;
+};
+
+//Sets the result of a TaskFuture. Destroying a promise that hasn't run breaks its future.
+template<class ValueType>
+class TaskPromise
+{
+public:
+	TaskPromise()
+		: state(TaskState<ValueType>::Create())
+	{
+	}
+
+	TaskPromise(TaskPromise&& other) noexcept
+		: state(other.state)
+	{
+		other.state = nullptr;
+	}
+
+	TaskPromise& operator=(TaskPromise&& other) noexcept
+	{
+		std::swap(state, other.state);
+		return *this;
+	}
+
+	TaskPromise(const TaskPromise&) = delete;
+	TaskPromise& operator=(const TaskPromise&) = delete;
+
+	~TaskPromise()
+	{
+		if (state != nullptr)
+		{
+			state->Break();
+			state->Release();
+		}
+	}
+
+	TaskFuture<ValueType> GetFuture()
+	{
+		state->AddReference();
+		return TaskFuture<ValueType>(state);
+	}
+
+	template<class Function>
+	void Run(Function& function)
+	{
+		state->Run(function);
+		state->Release();
+		state = nullptr;
+	}
+
+private:
+	TaskState<ValueType>* state;
+};
+
+//The result of a task added to a ThreadPool, used like a std::future
+template<class ValueType>
+class TaskFuture
+{
+public:
+	TaskFuture() = default;
+
+	TaskFuture(TaskFuture&& other) noexcept
+		: state(other.state)
+	{
+		other.state = nullptr;
+	}
+
+	TaskFuture& operator=(TaskFuture&& other) noexcept
+	{
+		std::swap(state, other.state);
+		return *this;
+	}
+
+	TaskFuture(const TaskFuture&) = delete;
+	TaskFuture& operator=(const TaskFuture&) = delete;
+
+	~TaskFuture()
+	{
+		if (state != nullptr)
+		{
+			state->Release();
+		}
+	}
+
+	bool Valid() const
+	{
+		return state != nullptr;
+	}
+
+	bool Ready() const
+	{
+		return state->Ready();
+	}
+
+	void Wait() const
+	{
+		state->Wait();
+	}
+
+	template<class Rep, class Period>
+	std::future_status WaitFor(const std::chrono::duration<Rep, Period>& duration) const
+	{
+		return WaitUntil(std::chrono::steady_clock::now() + duration);
+	}
+
+	template<class Clock, class Duration>
+	std::future_status WaitUntil(const std::chrono::time_point<Clock, Duration>& time) const
+	{
+		return state->WaitUntil(time) ? std::future_status::ready : std::future_status::timeout;
+	}
+
+	//Waits for and returns the result, leaving the future invalid as std::future::get does
+	ValueType Get()
+	{
+		ReleaseOnExit taken{ state };
+		state = nullptr;
+		return taken.state->Take();
+	}
+
+	//Calls continuation(context) on the thread that sets the result, or returns false without calling it if the result
+	//is already set. Only one continuation can wait on a future, ThreadPool::Wait and co_await each use it.
+	bool Then(void (*continuation)(void*), void* context) const
+	{
+		return state->Then(continuation, context);
+	}
+
+#if defined(__cpp_impl_coroutine)
+	//co_await suspends the coroutine until the result is set and resumes it on the thread that set it, usually the
+	//worker that ran the task, then returns the result as Get does
+	class Awaiter
+	{
+	public:
+		explicit Awaiter(TaskFuture& future)
+			: future(future)
+		{
+		}
+
+		bool await_ready() const
+		{
+			return future.Ready();
+		}
+
+		bool await_suspend(std::coroutine_handle<> handle)
+		{
+			this->handle = handle;
+			return future.Then(&Awaiter::Resume, this);
+		}
+
+		ValueType await_resume()
+		{
+			return future.Get();
+		}
+
+	private:
+		static void Resume(void* awaiter)
+		{
+			static_cast<Awaiter*>(awaiter)->handle.resume();
+		}
+
+		TaskFuture& future;
+		std::coroutine_handle<> handle;
+	};
+
+	Awaiter operator co_await() &
+	{
+		return Awaiter(*this);
+	}
+
+	Awaiter operator co_await() &&
+	{
+		return Awaiter(*this);
+	}
+#endif
+
+private:
+	friend class TaskPromise<ValueType>;
+
+	struct ReleaseOnExit
+	{
+		~ReleaseOnExit()
+		{
+			state->Release();
+		}
+
+		TaskState<ValueType>* state;
+	};
+
+	explicit TaskFuture(TaskState<ValueType>* state)
+		: state(state)
+	{
+	}
+
+	TaskState<ValueType>* state = nullptr;
+};
@@ -0,0 +1,377 @@
+#pragma once
+
+#include "Task.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+//Tasks with dependencies between them, built once and run as many times as needed, such as every frame. Each node
+//counts its predecessors down as they finish, and the predecessor finishing last runs the node itself if it is the
+//most critical one it made ready, handing any others to the pool. Nothing waits on a future: a node only starts
+//once everything it needs is done, and the thread calling Run helps with the graph's nodes until all have run.
+//Nodes are prioritised by their critical path, the largest total cost of any chain from the node to the end of the
+//graph, so the chains that bound how long a run takes are started first. A node's cost is what SetCost gave it,
+//otherwise how long it took the last time the graph was run with tracing on, otherwise 1.
+class TaskGraph
+{
+public:
+	//Refers to a node of a graph, for adding edges and continuations
+	class Node
+	{
+	public:
+		Node() = default;
+
+		//Adds a node that runs after this one and returns it
+		template<class Function>
+		Node Then(std::string name, Function&& function);
+
+		//This node runs before successor
+		Node& Precede(Node successor)
+		{
+			graph->AddEdge(index, successor.index);
+			return *this;
+		}
+
+		//This node runs after predecessor
+		Node& Succeed(Node predecessor)
+		{
+			graph->AddEdge(predecessor.index, index);
+			return *this;
+		}
+
+		//An estimate of how long the node takes in microseconds, used in place of measured times
+		Node& SetCost(double cost)
+		{
+			graph->nodes[index].cost = cost;
+			return *this;
+		}
+
+		size_t GetIndex() const
+		{
+			return index;
+		}
+
+	private:
+		friend class TaskGraph;
+
+		Node(TaskGraph* graph, size_t index)
+			: graph(graph), index(index)
+		{
+		}
+
+		TaskGraph* graph = nullptr;
+		size_t index = 0;
+	};
+
+	//When and where a node ran during the last traced run, in microseconds from the start of the run
+	struct NodeTiming
+	{
+		size_t thread = 0; //the worker's index, or the pool's thread count for the thread calling Run
+		double start = 0.0;
+		double duration = 0.0;
+	};
+
+	TaskGraph() = default;
+	TaskGraph(const TaskGraph&) = delete;
+	TaskGraph& operator=(const TaskGraph&) = delete;
+
+	//The function is called once per run and must not throw
+	template<class Function>
+	Node AddNode(std::string name, Function&& function)
+	{
+		NodeData node;
+		node.name = std::move(name);
+		node.function = Task(std::forward<Function>(function));
+		nodes.push_back(std::move(node));
+		sorted = false;
+		return Node(this, nodes.size() - 1);
+	}
+
+	//Runs every node once on the pool, returning when all have finished. Returns false without running anything if
+	//the dependencies form a cycle. A graph can't be changed or run again while it is running.
+	bool Run(ThreadPool& pool)
+	{
+		if (!sorted && !Sort())
+		{
+			return false;
+		}
+
+		if (nodes.empty())
+		{
+			return true;
+		}
+
+		Prioritise();
+
+		for (size_t index = 0; index < nodes.size(); ++index)
+		{
+			pending[index].store(nodes[index].predecessorCount, std::memory_order_relaxed);
+		}
+
+		if (tracing)
+		{
+			trace.assign(nodes.size(), NodeTiming());
+			runStart = Clock::now();
+		}
+
+		ThreadPool::JoinCounter join(nodes.size());
+		threadPool = &pool;
+		runJoin = &join;
+
+		//Roots are sorted least critical first, the most critical is run here
+		for (size_t root = 0; root + 1 < roots.size(); ++root)
+		{
+			Spawn(roots[root]);
+		}
+		Execute(roots.back());
+
+		pool.HelpUntilDone(join);
+		threadPool = nullptr;
+		runJoin = nullptr;
+		return true;
+	}
+
+	//Records when and on which thread each node runs, and uses the times as the nodes' costs in later runs
+	void SetTracing(bool enabled)
+	{
+		tracing = enabled;
+	}
+
+	const std::vector<NodeTiming>& GetTrace() const
+	{
+		return trace;
+	}
+
+	//Writes the last traced run in the Chrome trace event format, viewable in chrome://tracing or Perfetto
+	bool WriteTrace(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file.is_open())
+		{
+			std::cerr << "Unable to open " << path << "\n";
+			return false;
+		}
+
+		file << "{ \"traceEvents\": [\n";
+		for (size_t index = 0; index < trace.size(); ++index)
+		{
+			file << "  { \"name\": \"";
+			WriteEscaped(file, nodes[index].name);
+			file << "\", \"ph\": \"X\", \"pid\": 0"
+				<< ", \"tid\": " << trace[index].thread
+				<< ", \"ts\": " << trace[index].start
+				<< ", \"dur\": " << trace[index].duration
+				<< ", \"args\": { \"priority\": " << nodes[index].priority << " } }" << (index + 1 < trace.size() ? "," : "") << "\n";
+		}
+		file << "] }\n";
+		return true;
+	}
+
+	size_t GetNodeCount() const
+	{
+		return nodes.size();
+	}
+
+	const std::string& GetName(size_t index) const
+	{
+		return nodes[index].name;
+	}
+
+	//The node's critical path as of the last run, in microseconds or the units of SetCost
+	double GetPriority(size_t index) const
+	{
+		return nodes[index].priority;
+	}
+
+private:
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct NodeData
+	{
+		std::string name;
+		Task function;
+		std::vector<size_t> successors; //least critical first once the graph has been prioritised
+		size_t predecessorCount = 0;
+		double cost = 0.0; //0 if not given
+		double measured = 0.0; //0 if not traced yet
+		double priority = 0.0;
+	};
+
+	//Writes text as the inside of a JSON string
+	static void WriteEscaped(std::ostream& stream, const std::string& text)
+	{
+		static const char hexDigits[] = "0123456789abcdef";
+		for (char character : text)
+		{
+			const unsigned char code = static_cast<unsigned char>(character);
+			if (character == '"' || character == '\\')
+			{
+				stream << '\\' << character;
+			}
+			else if (code < 0x20)
+			{
+				stream << "\\u00" << hexDigits[code >> 4] << hexDigits[code & 0xF];
+			}
+			else
+			{
+				stream << character;
+			}
+		}
+	}
+
+	void AddEdge(size_t from, size_t to)
+	{
+		nodes[from].successors.push_back(to);
+		++nodes[to].predecessorCount;
+		sorted = false;
+	}
+
+	//Orders the nodes so each comes after its predecessors, returns false if there is a cycle
+	bool Sort()
+	{
+		order.clear();
+		roots.clear();
+
+		std::vector<size_t> remaining(nodes.size());
+		for (size_t index = 0; index < nodes.size(); ++index)
+		{
+			remaining[index] = nodes[index].predecessorCount;
+			if (remaining[index] == 0)
+			{
+				order.push_back(index);
+				roots.push_back(index);
+			}
+		}
+
+		for (size_t position = 0; position < order.size(); ++position)
+		{
+			for (size_t successor : nodes[order[position]].successors)
+			{
+				if (--remaining[successor] == 0)
+				{
+					order.push_back(successor);
+				}
+			}
+		}
+
+		if (order.size() != nodes.size())
+		{
+			std::cerr << "TaskGraph has a cycle, " << nodes.size() - order.size() << " nodes can never run\n";
+			return false;
+		}
+
+		pending.reset(new std::atomic<size_t>[nodes.size()]);
+		sorted = true;
+		return true;
+	}
+
+	//Works out each node's critical path from the end of the graph back
+	void Prioritise()
+	{
+		for (size_t position = order.size(); position-- > 0;)
+		{
+			NodeData& node = nodes[order[position]];
+
+			double longestSuccessor = 0.0;
+			for (size_t successor : node.successors)
+			{
+				longestSuccessor = std::max(longestSuccessor, nodes[successor].priority);
+			}
+
+			const double cost = node.cost > 0.0 ? node.cost : node.measured > 0.0 ? node.measured : 1.0;
+			node.priority = cost + longestSuccessor;
+		}
+
+		const auto lessCritical = [this](size_t left, size_t right) { return nodes[left].priority < nodes[right].priority; };
+		for (NodeData& node : nodes)
+		{
+			std::sort(node.successors.begin(), node.successors.end(), lessCritical);
+		}
+		std::sort(roots.begin(), roots.end(), lessCritical);
+	}
+
+	void Spawn(size_t index)
+	{
+		threadPool->Enqueue(ThreadPool::Joined([this, index]() { Execute(index); }));
+	}
+
+	//Runs a node, then keeps running the most critical successor it made ready
+	void Execute(size_t index)
+	{
+		while (true)
+		{
+			NodeData& node = nodes[index];
+			if (tracing)
+			{
+				const Clock::time_point start = Clock::now();
+				node.function();
+				const Clock::time_point end = Clock::now();
+
+				const ThreadPool::WorkerContext& context = ThreadPool::CurrentWorker();
+				NodeTiming& timing = trace[index];
+				timing.thread = context.pool == threadPool ? context.index : threadPool->GetThreadCount();
+				timing.start = std::chrono::duration<double, std::micro>(start - runStart).count();
+				timing.duration = std::chrono::duration<double, std::micro>(end - start).count();
+				node.measured = timing.duration;
+			}
+			else
+			{
+				node.function();
+			}
+
+			//The others are queued least critical first, so the worker's deque hands out the more critical first
+			size_t next = NoNode;
+			for (size_t successor : node.successors)
+			{
+				if (pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					if (next != NoNode)
+					{
+						Spawn(next);
+					}
+					next = successor;
+				}
+			}
+
+			//Once the last node completes the graph may be run again or destroyed, touch nothing after that
+			threadPool->Complete(*runJoin, 1);
+			if (next == NoNode)
+			{
+				return;
+			}
+			index = next;
+		}
+	}
+
+	static constexpr size_t NoNode = ~size_t(0);
+
+	std::vector<NodeData> nodes;
+	std::vector<size_t> order;
+	std::vector<size_t> roots;
+	std::unique_ptr<std::atomic<size_t>[]> pending;
+	bool sorted = false;
+
+	ThreadPool* threadPool = nullptr;
+	ThreadPool::JoinCounter* runJoin = nullptr;
+
+	bool tracing = false;
+	Clock::time_point runStart;
+	std::vector<NodeTiming> trace;
+};
+
+template<class Function>
+TaskGraph::Node TaskGraph::Node::Then(std::string name, Function&& function)
+{
+	Node next = graph->AddNode(std::move(name), std::forward<Function>(function));
+	Precede(next);
+	return next;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <exception>
+#include <mutex>
+#include <utility>
+
+//Tasks added to a pool that are waited for together. Waiting doesn't block the thread, it runs the group's tasks and
+//any others queued on the pool until all of the group's have finished, so a task can start a group of its own and
+//wait for it, as a recursive parallel build does, without tying up a worker or deadlocking a busy pool.
+class TaskGroup
+{
+public:
+	explicit TaskGroup(ThreadPool& threadPool)
+		: threadPool(threadPool), join(0)
+	{
+	}
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	//Waits for tasks that are still running, dropping anything they threw
+	~TaskGroup()
+	{
+		threadPool.HelpUntilDone(join);
+	}
+
+	//Arguments are copied or moved into the task as with ThreadPool::AddTask. If the pool is stopping the task runs
+	//on the thread stopping it instead of being dropped.
+	template<class TaskFunction, class... Arguements>
+	void Run(TaskFunction&& function, Arguements&&... arguements)
+	{
+		join.remaining.fetch_add(1);
+		threadPool.Enqueue(ThreadPool::Joined([this, call = ThreadPool::Bind(std::forward<TaskFunction>(function), std::forward<Arguements>(arguements)...)]() mutable
+			{
+				try
+				{
+					call();
+				}
+				catch (...)
+				{
+					Capture(std::current_exception());
+				}
+
+				//The group may be gone as soon as its last task completes
+				threadPool.Complete(join, 1);
+			}));
+	}
+
+	//Helps until every task run so far has finished, then throws the first exception any of them threw. The group
+	//can be used again afterwards.
+	void Wait()
+	{
+		threadPool.HelpUntilDone(join);
+
+		std::exception_ptr thrown;
+		std::swap(thrown, exception);
+		if (thrown)
+		{
+			std::rethrow_exception(thrown);
+		}
+	}
+
+private:
+	void Capture(std::exception_ptr thrown)
+	{
+		std::lock_guard<std::mutex> lock(exceptionMutex);
+		if (!exception)
+		{
+			exception = thrown;
+		}
+	}
+
+	ThreadPool& threadPool;
+	ThreadPool::JoinCounter join;
+
+	std::mutex exceptionMutex;
+	std::exception_ptr exception;
+};
@@ -1,53 +1,143 @@
 #pragma once
 
-#include "ConcurrentQueue.h"
+#include "CpuTopology.h"
+#include "ObjectPool.h"
+#include "Task.h"
+#include "TaskFuture.h"
+#include "WakeSignal.h"
+#include "WorkStealingDeque.h"
 
-#include <future>
-#include <queue>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+//Each worker owns a work stealing deque. Tasks added from inside a task go to the adding worker's deque, which it
+//works through newest first, and idle workers steal the oldest tasks of a random victim. Tasks added from other
+//threads go through one shared injector queue, which workers drain in batches into their own deque so the lock
+//guarding it is taken once per batch rather than once per task.
+//Tasks are stored in a Task from an ObjectPool and futures share pooled state, so adding a task whose function and
+//arguments fit in a Task allocates nothing once the pools have warmed up.
+//Idle threads spin for a while before sleeping, as the wait policy allows, and are only woken when one is asleep.
+//Every priority has its own deques and injector, and threads take the highest priority task they can find. Tasks
+//added from inside a task get its priority unless given another, so the pieces of a high priority ParallelFor or
+//TaskGroup stay high priority. Some workers can be reserved for high priority tasks, and lower priorities age so a
+//steady stream of high priority tasks can't starve them.
+//Workers can be pinned to cores, in which case they steal from workers on their own NUMA node before others.
 class ThreadPool
 {
 public:
-	ThreadPool(const size_t desiredThreadCount = std::thread::hardware_concurrency())
+	enum class Priority
+	{
+		High,
+		Normal,
+		Low
+	};
+
+	static constexpr size_t PriorityCount = 3;
+
+	//Time tasks of one priority spent queued before starting, over the tasks added while statistics were on
+	struct LaneStatistics
+	{
+		uint64_t tasks = 0;
+		double averageWaitMicroseconds = 0.0;
+		double maxWaitMicroseconds = 0.0;
+	};
+
+	//Sets the priority of tasks, parallel calls, task groups and graphs the calling thread adds to any pool without
+	//giving a priority, until the scope ends
+	class PriorityScope
+	{
+	public:
+		explicit PriorityScope(Priority priority)
+			: previous(CurrentWorker().priority)
+		{
+			CurrentWorker().priority = priority;
+		}
+
+		~PriorityScope()
+		{
+			CurrentWorker().priority = previous;
+		}
+
+		PriorityScope(const PriorityScope&) = delete;
+		PriorityScope& operator=(const PriorityScope&) = delete;
+
+	private:
+		Priority previous;
+	};
+
+	//How threads with nothing to run wait for work
+	enum class WaitPolicy
 	{
+		LowLatency, //spin for the spin time first, so tasks added in quick bursts start without waking a thread
+		PowerSaving //sleep straight away
+	};
+
+	//Pinned workers each stay on one processor of the CpuTopology's PlacementOrder, taking a physical core each
+	//before sharing them and filling one NUMA node before the next. Memory a pinned worker touches first is then
+	//placed on its node and stays near it.
+	ThreadPool(const size_t desiredThreadCount = std::thread::hardware_concurrency(), WaitPolicy waitPolicy = WaitPolicy::LowLatency, bool pinThreads = false)
+	{
+		SetWaitPolicy(waitPolicy);
+
 		threadCount = desiredThreadCount;
 		if (threadCount == 0)
 		{
 			threadCount = 1;
 		}
 
-		threads.reserve(threadCount);
+		workers.reserve(threadCount);
 		for (size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex)
 		{
-			threads.emplace_back([this]()
-				{
-					std::function<void()> Task;
+			workers.emplace_back(new Worker());
+		}
 
-					while (this->workQueue.WaitPop(Task))
-					{
-						Task(); //execute task;
-					}
-				});
+		if (pinThreads)
+		{
+			Place();
+		}
+
+		threads.reserve(threadCount);
+		for (size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+		{
+			threads.emplace_back([this, threadIndex]() { WorkerLoop(threadIndex); });
 		}
 	}
 
-	~ThreadPool() 
+	~ThreadPool()
 	{
 		Stop();
 	}
 
+	//Without wait, workers finish the task they are running and queued tasks are dropped, breaking their futures.
+	//With wait, every task added before the call runs first.
 	void Stop(bool wait = false)
 	{
-		if (!wait)
+		if (wait)
 		{
-			workQueue.Invalidate();
+			closed.store(true);
 		}
 		else
 		{
-			workQueue.CloseQueue();
+			invalid.store(true);
 		}
+		wake.NotifyAll();
 
 		for (std::thread& thread : threads)
 		{
@@ -55,6 +145,26 @@ public:
 		}
 
 		threads.clear();
+
+		//An AddTask racing the close can land after the last worker looked, run what it left
+		QueuedTask* task;
+		for (Injector& injector : injectors)
+		{
+			while ((task = TakeInjected(injector)) != nullptr)
+			{
+				RunOrDrop(task, wait);
+			}
+		}
+		for (std::unique_ptr<Worker>& worker : workers)
+		{
+			for (WorkStealingDeque<QueuedTask*>& deque : worker->deques)
+			{
+				while (deque.Steal(task))
+				{
+					RunOrDrop(task, wait);
+				}
+			}
+		}
 	}
 
 	size_t GetThreadCount() const
@@ -62,27 +172,1212 @@ public:
 		return threadCount;
 	}
 
+	//Empty unless the workers are pinned
+	const CpuTopology& GetTopology() const
+	{
+		return topology;
+	}
+
+	size_t GetNodeCount() const
+	{
+		return nodeWorkers.empty() ? 1 : nodeWorkers.size();
+	}
+
+	size_t GetWorkerNode(size_t index) const
+	{
+		return workers[index]->node;
+	}
+
+	//The NUMA node of the worker calling, for passing to GetTopology().AllocateOnNode. 0 when the workers aren't
+	//pinned and for threads outside the pool.
+	size_t GetCurrentNode() const
+	{
+		const WorkerContext& context = CurrentWorker();
+		return context.pool == this ? workers[context.index]->node : 0;
+	}
+
+	//Can be changed while the pool runs, such as to save power between bursts of work. spinTime is how long a
+	//LowLatency thread looks for work before sleeping, it's spent spinning and then yielding to other threads.
+	void SetWaitPolicy(WaitPolicy policy, std::chrono::microseconds spinTime = DefaultSpinTime())
+	{
+		waitPolicy.store(policy);
+		spinNanoseconds.store(policy == WaitPolicy::LowLatency ? std::chrono::duration_cast<std::chrono::nanoseconds>(spinTime).count() : 0);
+	}
+
+	WaitPolicy GetWaitPolicy() const
+	{
+		return waitPolicy.load();
+	}
+
+	static std::chrono::microseconds DefaultSpinTime()
+	{
+		return std::chrono::microseconds(50);
+	}
+
+	//The first count workers only run high priority tasks, so one is free the moment a high priority task is added
+	//however much other work is queued. At least one worker is always left for every priority.
+	void ReserveWorkers(size_t count)
+	{
+		reservedCount.store(std::min(count, threadCount - 1));
+		wake.NotifyAll(); //workers no longer reserved may have lower priority tasks waiting
+	}
+
+	size_t GetReservedWorkers() const
+	{
+		return reservedCount.load();
+	}
+
+	//Every interval tasks a worker looks at one of the lower priorities first, taking turns between them, so each
+	//still gets a share of the workers while higher priority tasks keep coming. 0 turns aging off.
+	void SetAgingInterval(size_t interval)
+	{
+		agingInterval.store(interval);
+	}
+
+	size_t GetAgingInterval() const
+	{
+		return agingInterval.load();
+	}
+
+	//Measures how long tasks wait in each priority's queues, which costs two clock reads per task while it is on
+	void SetLaneStatistics(bool enabled)
+	{
+		laneStatistics.store(enabled);
+	}
+
+	LaneStatistics GetLaneStatistics(Priority priority) const
+	{
+		uint64_t tasks = laneCounters[Lane(priority)].tasks.load();
+		uint64_t waitNanoseconds = laneCounters[Lane(priority)].waitNanoseconds.load();
+		uint64_t maxWaitNanoseconds = laneCounters[Lane(priority)].maxWaitNanoseconds.load();
+		for (const std::unique_ptr<Worker>& worker : workers)
+		{
+			const LaneCounters& counters = worker->laneCounters[Lane(priority)];
+			tasks += counters.tasks.load();
+			waitNanoseconds += counters.waitNanoseconds.load();
+			maxWaitNanoseconds = std::max(maxWaitNanoseconds, counters.maxWaitNanoseconds.load());
+		}
+
+		LaneStatistics statistics;
+		statistics.tasks = tasks;
+		statistics.averageWaitMicroseconds = tasks > 0 ? waitNanoseconds / 1000.0 / tasks : 0.0;
+		statistics.maxWaitMicroseconds = maxWaitNanoseconds / 1000.0;
+		return statistics;
+	}
+
+	void ResetLaneStatistics()
+	{
+		for (LaneCounters& counters : laneCounters)
+		{
+			counters.Reset();
+		}
+		for (std::unique_ptr<Worker>& worker : workers)
+		{
+			for (LaneCounters& counters : worker->laneCounters)
+			{
+				counters.Reset();
+			}
+		}
+	}
+
+	//Arguments are copied or moved into the task, pass std::ref or std::cref to share them instead
 	template<typename TaskFunction, class... Arguements>
-	auto AddTask(TaskFunction&& function, Arguements&&... arguements) -> std::future<decltype(function(arguements...))>
+	auto AddTask(TaskFunction&& function, Arguements&&... arguements) -> TaskFuture<decltype(function(arguements...))>
+	{
+		return AddTask(CurrentWorker().priority, std::forward<TaskFunction>(function), std::forward<Arguements>(arguements)...);
+	}
+
+	template<typename TaskFunction, class... Arguements>
+	auto AddTask(Priority priority, TaskFunction&& function, Arguements&&... arguements) -> TaskFuture<decltype(function(arguements...))>
 	{
 		using return_type = decltype(function(arguements...));
 
-		auto task = std::make_shared< std::packaged_task<return_type()> >
-			(
-				std::bind(std::forward<TaskFunction>(function), std::forward<Arguements>(arguements)...)
-				);
+		TaskPromise<return_type> promise;
+		TaskFuture<return_type> future = promise.GetFuture();
+		Enqueue([promise = std::move(promise), call = Bind(std::forward<TaskFunction>(function), std::forward<Arguements>(arguements)...)]() mutable
+			{
+				promise.Run(call);
+			}, priority);
+		return future;
+	}
+
+	//Like AddTask without a future, for tasks nobody waits on. The task must not throw.
+	template<typename TaskFunction, class... Arguements>
+	void Submit(TaskFunction&& function, Arguements&&... arguements)
+	{
+		Submit(CurrentWorker().priority, std::forward<TaskFunction>(function), std::forward<Arguements>(arguements)...);
+	}
+
+	template<typename TaskFunction, class... Arguements>
+	void Submit(Priority priority, TaskFunction&& function, Arguements&&... arguements)
+	{
+		Enqueue(Bind(std::forward<TaskFunction>(function), std::forward<Arguements>(arguements)...), priority);
+	}
+
+	//Calls function(index) for every index in [begin, end) and returns once all calls have finished. The range is
+	//split lazily: whoever runs part of it hands half of what is left to the pool whenever nothing is queued for idle
+	//workers to take, so it spreads out while workers are idle and stays in large pieces while they are busy. Pieces
+	//are run grain indices at a time, a grain of 0 picks one from the range and thread count. The calling thread runs
+	//part of the range and helps with other tasks while it waits. The function must not throw. Stopping the pool
+	//doesn't cut a call short, pieces it drops run on the thread stopping it.
+	template<class Function>
+	void ParallelFor(size_t begin, size_t end, size_t grain, Function&& function)
+	{
+		ForEachChunk(begin, end, AutoGrain(begin, end, grain), [&function](size_t chunkBegin, size_t chunkEnd)
+			{
+				for (size_t index = chunkBegin; index < chunkEnd; ++index)
+				{
+					function(index);
+				}
+			});
+	}
+
+	//Folds map(index) for every index in [begin, end) into identity with combine, split as ParallelFor splits. Chunks
+	//are combined in the order they finish, so a combine that isn't associative, such as floating point addition,
+	//can give a different result each run. Deterministic instead folds fixed chunks of grain indices, or a fixed
+	//number of chunks for a grain of 0, and combines them in order, giving the same result for any thread count.
+	template<class Value, class Map, class Combine>
+	Value ParallelReduce(size_t begin, size_t end, size_t grain, Value identity, Map&& map, Combine&& combine, bool deterministic = false)
+	{
+		if (begin >= end)
+		{
+			return identity;
+		}
+
+		if (deterministic)
+		{
+			//Wrapped so a vector of bool partials doesn't pack them into shared words
+			struct Partial
+			{
+				Value value;
+			};
+
+			const size_t chunkSize = grain > 0 ? grain : std::max<size_t>(1, (end - begin) / DeterministicChunkCount);
+			std::vector<Partial> partials((end - begin + chunkSize - 1) / chunkSize, Partial{ identity });
+			ParallelFor(0, partials.size(), 1, [&](size_t chunk)
+				{
+					const size_t chunkBegin = begin + chunk * chunkSize;
+					const size_t chunkEnd = std::min(end, chunkBegin + chunkSize);
+					Value partial = identity;
+					for (size_t index = chunkBegin; index < chunkEnd; ++index)
+					{
+						partial = combine(partial, map(index));
+					}
+					partials[chunk].value = std::move(partial);
+				});
+
+			Value result = identity;
+			for (const Partial& partial : partials)
+			{
+				result = combine(result, partial.value);
+			}
+			return result;
+		}
+
+		std::mutex resultMutex;
+		Value result = identity;
+		ForEachChunk(begin, end, AutoGrain(begin, end, grain), [&](size_t chunkBegin, size_t chunkEnd)
+			{
+				Value partial = identity;
+				for (size_t index = chunkBegin; index < chunkEnd; ++index)
+				{
+					partial = combine(partial, map(index));
+				}
+
+				std::lock_guard<std::mutex> lock(resultMutex);
+				result = combine(result, partial);
+			});
+		return result;
+	}
+
+	//Runs the functions in parallel, the first on the calling thread, and returns once all have finished. The
+	//functions must not throw.
+	template<class... Functions>
+	void ParallelInvoke(Functions&&... functions)
+	{
+		JoinCounter join(sizeof...(Functions));
+		InvokeEach(join, functions...);
+		HelpUntilDone(join);
+	}
 
+	//Waits for a future without blocking the thread: until it is ready the calling thread runs queued and stolen
+	//tasks, so tasks can wait for each other even when every worker is waiting. The thread only sleeps when there is
+	//nothing to run, and is woken by the future itself, wherever it is completed.
+	template<class ValueType>
+	void Wait(const TaskFuture<ValueType>& future)
+	{
+		if (future.Ready())
+		{
+			return;
+		}
 
-		workQueue.Push([task]() { (*task)(); });
+		const FutureWaiter<ValueType> waiter(*this, future);
+		HelpUntil(waiter);
+		waiter.Finish();
+	}
 
-		return task->get_future();
+	//Waits as Wait does, then returns the result or throws what the task threw
+	template<class ValueType>
+	ValueType Get(TaskFuture<ValueType>& future)
+	{
+		Wait(future);
+		return future.Get();
 	}
 
+#if defined(__cpp_impl_coroutine)
+	//co_await pool.Schedule() suspends the coroutine and resumes it as a task of the pool, so what follows runs on a
+	//worker. If the pool is stopping the coroutine resumes on the thread stopping it instead of being dropped.
+	class ScheduleAwaiter
+	{
+	public:
+		ScheduleAwaiter(ThreadPool& threadPool, Priority priority)
+			: threadPool(threadPool), priority(priority)
+		{
+		}
+
+		bool await_ready() const
+		{
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			threadPool.Enqueue(Joined([handle]() { handle.resume(); }), priority);
+		}
+
+		void await_resume() const
+		{
+		}
+
+	private:
+		ThreadPool& threadPool;
+		Priority priority;
+	};
+
+	ScheduleAwaiter Schedule()
+	{
+		return ScheduleAwaiter(*this, CurrentWorker().priority);
+	}
+
+	ScheduleAwaiter Schedule(Priority priority)
+	{
+		return ScheduleAwaiter(*this, priority);
+	}
+#endif
+
 private:
+	//These run their tasks through the pool's joins rather than waiting on futures
+	friend class TaskGraph;
+	friend class TaskGroup;
+
+	//A function and its arguments, called as std::bind would call them
+	template<class Function, class... Arguements>
+	class BoundCall
+	{
+	public:
+		template<class FunctionType, class... ArguementTypes>
+		explicit BoundCall(FunctionType&& function, ArguementTypes&&... arguements)
+			: function(std::forward<FunctionType>(function)), arguements(std::forward<ArguementTypes>(arguements)...)
+		{
+		}
+
+		decltype(auto) operator()()
+		{
+			return Call(std::index_sequence_for<Arguements...>());
+		}
+
+	private:
+		template<size_t... Indices>
+		decltype(auto) Call(std::index_sequence<Indices...>)
+		{
+			return function(Unwrap(std::get<Indices>(arguements))...);
+		}
+
+		template<class Type>
+		static Type& Unwrap(Type& value)
+		{
+			return value;
+		}
+
+		template<class Type>
+		static Type& Unwrap(std::reference_wrapper<Type>& value)
+		{
+			return value.get();
+		}
+
+		Function function;
+		std::tuple<Arguements...> arguements;
+	};
+
+	//Work left in one ParallelFor, ParallelReduce or ParallelInvoke call, which lives on the caller's stack
+	struct JoinCounter
+	{
+		explicit JoinCounter(size_t count)
+			: remaining(count)
+		{
+		}
+
+		std::atomic<size_t> remaining;
+	};
+
+	//Part of a parallel call or task group handed to the pool. Stop(false) drops queued tasks, but the caller is
+	//waiting for this one, so if it is dropped without running it runs then instead.
+	template<class Function>
+	class JoinedCall
+	{
+	public:
+		template<class Callable>
+		explicit JoinedCall(Callable&& function)
+			: function(std::forward<Callable>(function))
+		{
+		}
+
+		JoinedCall(JoinedCall&& other) noexcept(std::is_nothrow_move_constructible<Function>::value)
+			: function(std::move(other.function)), pending(other.pending)
+		{
+			other.pending = false;
+		}
+
+		JoinedCall(const JoinedCall&) = delete;
+		JoinedCall& operator=(const JoinedCall&) = delete;
+
+		~JoinedCall()
+		{
+			if (pending)
+			{
+				function();
+			}
+		}
+
+		void operator()()
+		{
+			pending = false;
+			function();
+		}
+
+	private:
+		Function function;
+		bool pending = true;
+	};
+
+	template<class Function>
+	static JoinedCall<std::decay_t<Function>> Joined(Function&& function)
+	{
+		return JoinedCall<std::decay_t<Function>>(std::forward<Function>(function));
+	}
+
+	//What a thread in Wait waits for. Before it first sleeps it asks the future to notify futureWake when its result
+	//is set, which only threads in Wait sleep on, so a result doesn't wake the pool's parked workers. Waits that end
+	//without sleeping, as most do, never ask.
+	template<class ValueType>
+	class FutureWaiter
+	{
+	public:
+		FutureWaiter(ThreadPool& threadPool, const TaskFuture<ValueType>& future)
+			: threadPool(threadPool), future(future)
+		{
+		}
+
+		bool operator()() const
+		{
+			return registered ? status.load() != Pending : future.Ready();
+		}
+
+		void Register() const
+		{
+			if (!registered)
+			{
+				registered = true;
+				if (!future.Then(&FutureWaiter::Notify, const_cast<FutureWaiter*>(this)))
+				{
+					status.store(Notified);
+				}
+			}
+		}
+
+		//The result is set, but the thread setting it may still be notifying, which has to finish before the waiter goes
+		void Finish() const
+		{
+			while (registered && status.load() != Notified)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+	private:
+		enum Status
+		{
+			Pending,
+			Ready,
+			Notified
+		};
+
+		static void Notify(void* context)
+		{
+			FutureWaiter& waiter = *static_cast<FutureWaiter*>(context);
+			waiter.status.store(Ready);
+			waiter.threadPool.futureWake.NotifyAll();
+
+			//The waiter returns once it sees this, touch nothing after it
+			waiter.status.store(Notified);
+		}
+
+		ThreadPool& threadPool;
+		const TaskFuture<ValueType>& future;
+		mutable bool registered = false;
+		mutable std::atomic<int> status{ Pending };
+	};
+
+	//Whether the thread waits for a future, and so sleeps on futureWake, which this makes sure it will be woken on
+	template<class Done>
+	static bool PrepareFutureSleep(const Done&)
+	{
+		return false;
+	}
+
+	template<class ValueType>
+	static bool PrepareFutureSleep(const FutureWaiter<ValueType>& waiter)
+	{
+		waiter.Register();
+		return true;
+	}
+
+	//Chunks ParallelReduce splits a range into when deterministic and given no grain
+	static constexpr size_t DeterministicChunkCount = 256;
+
+	template<class TaskFunction, class... Arguements>
+	static BoundCall<std::decay_t<TaskFunction>, std::decay_t<Arguements>...> Bind(TaskFunction&& function, Arguements&&... arguements)
+	{
+		return BoundCall<std::decay_t<TaskFunction>, std::decay_t<Arguements>...>(std::forward<TaskFunction>(function), std::forward<Arguements>(arguements)...);
+	}
+
+	//A task with the priority it was added at, and when it was added while lane statistics are on
+	struct QueuedTask
+	{
+		template<class Function>
+		QueuedTask(Function&& function, Priority priority, int64_t queuedAt)
+			: task(std::forward<Function>(function)), queuedAt(queuedAt), priority(priority)
+		{
+		}
+
+		Task task;
+		int64_t queuedAt; //steady clock nanoseconds, 0 when not timed
+		Priority priority;
+	};
+
+	struct LaneCounters
+	{
+		void Add(uint64_t waitNanoseconds)
+		{
+			tasks.fetch_add(1, std::memory_order_relaxed);
+			this->waitNanoseconds.fetch_add(waitNanoseconds, std::memory_order_relaxed);
+			uint64_t longest = maxWaitNanoseconds.load(std::memory_order_relaxed);
+			while (waitNanoseconds > longest && !maxWaitNanoseconds.compare_exchange_weak(longest, waitNanoseconds, std::memory_order_relaxed))
+			{
+			}
+		}
+
+		void Reset()
+		{
+			tasks.store(0);
+			waitNanoseconds.store(0);
+			maxWaitNanoseconds.store(0);
+		}
+
+		std::atomic<uint64_t> tasks{ 0 };
+		std::atomic<uint64_t> waitNanoseconds{ 0 };
+		std::atomic<uint64_t> maxWaitNanoseconds{ 0 };
+	};
+
+	static constexpr size_t NotPinned = ~size_t(0);
+
+	struct Worker
+	{
+		WorkStealingDeque<QueuedTask*> deques[PriorityCount];
+		LaneCounters laneCounters[PriorityCount]; //only written by the worker, so uncontended
+		uint64_t randomState = 0;
+		size_t findsSinceAging = 0;
+		size_t agedLane = 0;
+		size_t processor = NotPinned;
+		size_t node = 0;
+	};
+
+	//Shared by the workers' queues and an injector of each priority
+	struct Injector
+	{
+		std::mutex mutex;
+		std::vector<QueuedTask*> ring;
+		size_t head = 0;
+		std::atomic<size_t> count{ 0 }; //written under mutex, read without it to skip empty checks
+	};
+
+	//Which pool and worker the calling thread belongs to, if any, and the priority of the task it is running
+	struct WorkerContext
+	{
+		const ThreadPool* pool = nullptr;
+		size_t index = 0;
+		Priority priority = Priority::Normal;
+		size_t helpDepth = 0; //waits nested by running tasks while waiting
+	};
+
+	static WorkerContext& CurrentWorker()
+	{
+		static thread_local WorkerContext context;
+		return context;
+	}
+
+	//Pause instructions between looks for work stop doubling here, after which spinning threads yield instead
+	static constexpr size_t MaxSpinPauses = 64;
+
+	//Largest number of tasks a worker moves from an injector to its deque at once
+	static constexpr size_t MaxInjectorBatch = 32;
+
+	//Waits a thread can nest by running tasks that wait themselves, beyond which it waits without running any
+	static constexpr size_t MaxHelpDepth = 64;
+
+	//Tasks a worker finds between looks at a lower priority first, unless changed with SetAgingInterval
+	static constexpr size_t DefaultAgingInterval = 16;
+
+	static size_t Lane(Priority priority)
+	{
+		return static_cast<size_t>(priority);
+	}
+
+	static int64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	//At the priority of the task the calling thread is running, or its PriorityScope
+	template<class Function>
+	void Enqueue(Function&& function)
+	{
+		Enqueue(std::forward<Function>(function), CurrentWorker().priority);
+	}
+
+	template<class Function>
+	void Enqueue(Function&& function, Priority priority)
+	{
+		if (closed.load() || invalid.load())
+		{
+			return; //dropping the function breaks its future, as a closed queue always has
+		}
+
+		QueuedTask* task = ObjectPool<QueuedTask>::Create(std::forward<Function>(function), priority, laneStatistics.load(std::memory_order_relaxed) ? Now() : 0);
+
+		const WorkerContext& context = CurrentWorker();
+		if (context.pool == this)
+		{
+			workers[context.index]->deques[Lane(priority)].Push(task);
+		}
+		else
+		{
+			Injector& injector = injectors[Lane(priority)];
+			std::lock_guard<std::mutex> lock(injector.mutex);
+			PushInjected(injector, task);
+		}
+
+		//Pairs with the fence in Park, either the sleeper sees the task or this sees the sleeper
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const bool anySleeperMayRun = priority == Priority::High || reservedCount.load(std::memory_order_relaxed) == 0;
+		const bool sleeping = sleepingCount.load() > 0;
+		if (sleeping)
+		{
+			//A reserved worker woken for a task it may not run would go back to sleep, so wake them all
+			if (anySleeperMayRun)
+			{
+				wake.NotifyOne();
+			}
+			else
+			{
+				wake.NotifyAll();
+			}
+		}
+
+		//Unless a sleeping worker is sure to be able to run the task, a thread waiting for a future might have to.
+		//The sleepers may all be reserved workers, which can't.
+		if ((!sleeping || !anySleeperMayRun) && futureSleepingCount.load() > 0)
+		{
+			futureWake.NotifyAll();
+		}
+	}
+
+	size_t AutoGrain(size_t begin, size_t end, size_t grain) const
+	{
+		if (grain > 0)
+		{
+			return grain;
+		}
+
+		//Several chunks per thread, lazy splitting decides how many of them are handed out
+		return std::max<size_t>(1, (end - begin) / (8 * (threadCount + 1)));
+	}
+
+	template<class Body>
+	void ForEachChunk(size_t begin, size_t end, size_t grain, const Body& body)
+	{
+		if (begin >= end)
+		{
+			return;
+		}
+
+		JoinCounter join(end - begin);
+		RunChunks(join, begin, end, grain, body);
+		HelpUntilDone(join);
+	}
+
+	template<class Body>
+	void RunChunks(JoinCounter& join, size_t begin, size_t end, size_t grain, const Body& body)
+	{
+		while (begin < end)
+		{
+			while (end - begin > grain && WantsWork())
+			{
+				//If the pool is stopping the half is dropped, which runs it here
+				const size_t middle = begin + (end - begin) / 2;
+				Enqueue(Joined([this, &join, middle, end, grain, &body]() { RunChunks(join, middle, end, grain, body); }));
+				end = middle;
+			}
+
+			const size_t chunkEnd = std::min(end, begin + grain);
+			body(begin, chunkEnd);
+			Complete(join, chunkEnd - begin);
+			begin = chunkEnd;
+		}
+	}
+
+	void InvokeEach(JoinCounter&)
+	{
+	}
+
+	template<class First, class... Rest>
+	void InvokeEach(JoinCounter& join, First& first, Rest&... rest)
+	{
+		const int spawned[] = { 0, (Spawn(join, rest), 0)... };
+		(void)spawned;
+
+		first();
+		Complete(join, 1);
+	}
+
+	template<class Function>
+	void Spawn(JoinCounter& join, Function& function)
+	{
+		Enqueue(Joined([this, &join, &function]() { function(); Complete(join, 1); }));
+	}
+
+	//Whether the calling thread should hand out part of its range, true when idle workers would find nothing to take
+	//from it: its deque of the range's priority is empty if it is one of this pool's workers, otherwise the injector is
+	bool WantsWork() const
+	{
+		const WorkerContext& context = CurrentWorker();
+		if (context.pool == this)
+		{
+			return workers[context.index]->deques[Lane(context.priority)].Empty();
+		}
+
+		return injectors[Lane(context.priority)].count.load(std::memory_order_relaxed) == 0;
+	}
+
+	void Complete(JoinCounter& join, size_t count)
+	{
+		//The join may be gone as soon as it reaches zero, only the pool is touched after that
+		if (join.remaining.fetch_sub(count) == count && joiningCount.load() > 0)
+		{
+			wake.NotifyAll();
+		}
+	}
+
+	void HelpUntilDone(const JoinCounter& join)
+	{
+		HelpUntil([&join]() { return join.remaining.load() == 0; });
+	}
+
+	//Runs queued and stolen tasks until done returns true, sleeping alongside the workers when there are none.
+	//Whatever makes it true has to wake the pool's sleepers, as Complete does. A thread in Wait sleeps on futureWake
+	//instead, and tasks added while it sleeps there only wake it if no sleeping worker is sure to be able to run them.
+	template<class Done>
+	void HelpUntil(const Done& done)
+	{
+		WorkerContext& context = CurrentWorker();
+		if (context.helpDepth >= MaxHelpDepth)
+		{
+			SleepUntil(done);
+			return;
+		}
+
+		++context.helpDepth;
+		const size_t laneCount = CallerLaneCount();
+		while (!done())
+		{
+			QueuedTask* task = FindTaskForCaller();
+			if (task != nullptr)
+			{
+				RunTask(task);
+				continue;
+			}
+
+			if (SpinUntil([this, &done, laneCount]() { return done() || HasWork(laneCount); }))
+			{
+				continue;
+			}
+
+			if (PrepareFutureSleep(done))
+			{
+				const uint32_t token = futureWake.Prepare();
+				futureSleepingCount.fetch_add(1);
+				//Pairs with the fence in Enqueue, either this sees the task or Enqueue sees this sleeping
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (!done() && !HasWork(laneCount))
+				{
+					futureWake.Wait(token);
+				}
+				futureSleepingCount.fetch_sub(1);
+				continue;
+			}
+
+			const uint32_t token = wake.Prepare();
+			joiningCount.fetch_add(1);
+			sleepingCount.fetch_add(1);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!done() && !HasWork(laneCount))
+			{
+				wake.Wait(token);
+			}
+			sleepingCount.fetch_sub(1);
+			joiningCount.fetch_sub(1);
+		}
+		--context.helpDepth;
+	}
+
+	//Waits without running tasks, which a thread outside the pool would otherwise keep doing one inside another while
+	//the task it waits for sits behind them in the injector, until its stack overflows. It isn't counted as asleep,
+	//so adding a task never wakes it in place of a thread that could run the task.
+	template<class Done>
+	void SleepUntil(const Done& done)
+	{
+		while (!done())
+		{
+			if (PrepareFutureSleep(done))
+			{
+				const uint32_t token = futureWake.Prepare();
+				if (!done())
+				{
+					futureWake.Wait(token);
+				}
+				continue;
+			}
+
+			const uint32_t token = wake.Prepare();
+			joiningCount.fetch_add(1);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!done())
+			{
+				wake.Wait(token);
+			}
+			joiningCount.fetch_sub(1);
+		}
+	}
+
+	QueuedTask* FindTaskForCaller()
+	{
+		const WorkerContext& context = CurrentWorker();
+		if (context.pool == this)
+		{
+			return FindTask(context.index);
+		}
+
+		for (size_t lane = 0; lane < PriorityCount; ++lane)
+		{
+			QueuedTask* task = TakeInjected(injectors[lane]);
+			if (task != nullptr)
+			{
+				return task;
+			}
+
+			for (std::unique_ptr<Worker>& worker : workers)
+			{
+				if (!worker->deques[lane].Empty() && worker->deques[lane].Steal(task))
+				{
+					return task;
+				}
+			}
+		}
+
+		return nullptr;
+	}
+
+	//Runs a task at its priority, so tasks it adds inherit it, and records how long it was queued
+	void RunTask(QueuedTask* task)
+	{
+		WorkerContext& context = CurrentWorker();
+		if (task->queuedAt != 0)
+		{
+			const int64_t waited = std::max<int64_t>(0, Now() - task->queuedAt);
+			LaneCounters& counters = context.pool == this ? workers[context.index]->laneCounters[Lane(task->priority)] : laneCounters[Lane(task->priority)];
+			counters.Add(static_cast<uint64_t>(waited));
+		}
+
+		const Priority previous = context.priority;
+		context.priority = task->priority;
+		task->task();
+		context.priority = previous;
+
+		ObjectPool<QueuedTask>::Destroy(task);
+	}
+
+	//How many priorities, from the highest, a worker may run
+	size_t LaneCount(size_t index) const
+	{
+		return index < reservedCount.load(std::memory_order_relaxed) ? 1 : PriorityCount;
+	}
+
+	size_t CallerLaneCount() const
+	{
+		const WorkerContext& context = CurrentWorker();
+		return context.pool == this ? LaneCount(context.index) : PriorityCount;
+	}
+
+	//Picks each worker's processor and groups the workers by node, before any of them start
+	void Place()
+	{
+		topology = CpuTopology::Detect();
+		const std::vector<CpuTopology::Processor> order = topology.PlacementOrder();
+		nodeWorkers.resize(topology.GetNodeCount());
+		for (size_t index = 0; index < threadCount; ++index)
+		{
+			const CpuTopology::Processor& processor = order[index % order.size()];
+			workers[index]->processor = processor.id;
+			workers[index]->node = processor.node;
+			nodeWorkers[processor.node].push_back(index);
+		}
+	}
+
+	void WorkerLoop(size_t index)
+	{
+		//A worker that can't be pinned, such as when the process's affinity changed since the pool was made, runs
+		//wherever the system schedules it
+		if (workers[index]->processor != NotPinned)
+		{
+			CpuTopology::PinCurrentThread(workers[index]->processor);
+		}
+
+		CurrentWorker() = { this, index };
+		workers[index]->randomState = 0x9E3779B97F4A7C15ull * (index + 1);
+
+		while (!invalid.load(std::memory_order_relaxed))
+		{
+			QueuedTask* task = FindTask(index);
+			if (task != nullptr)
+			{
+				RunTask(task);
+			}
+			else if (!SpinUntil([this, index]() { return HasWork(LaneCount(index)); }) && !Park(index))
+			{
+				break;
+			}
+		}
+
+		CurrentWorker() = {};
+	}
+
+	//Takes the highest priority task the worker may run, except that on aging turns a lower priority goes first. The
+	//worker's own deques and the injectors are looked at before stealing, so a busy worker doesn't read every other
+	//worker's deques for higher priority tasks between each of its own, that is left to idle ones.
+	QueuedTask* FindTask(size_t index)
+	{
+		Worker& worker = *workers[index];
+		const size_t laneCount = LaneCount(index);
+
+		QueuedTask* task;
+		const size_t interval = agingInterval.load(std::memory_order_relaxed);
+		if (laneCount > 1 && interval > 0 && ++worker.findsSinceAging >= interval)
+		{
+			worker.findsSinceAging = 0;
+			worker.agedLane = worker.agedLane % (laneCount - 1) + 1;
+			if ((task = TakeQueued(worker, worker.agedLane)) != nullptr || (task = StealTask(index, worker.agedLane)) != nullptr)
+			{
+				return task;
+			}
+		}
+
+		for (size_t lane = 0; lane < laneCount; ++lane)
+		{
+			if ((task = TakeQueued(worker, lane)) != nullptr)
+			{
+				return task;
+			}
+		}
+
+		for (size_t lane = 0; lane < laneCount; ++lane)
+		{
+			if ((task = StealTask(index, lane)) != nullptr)
+			{
+				return task;
+			}
+		}
+
+		return nullptr;
+	}
+
+	QueuedTask* TakeQueued(Worker& worker, size_t lane)
+	{
+		QueuedTask* task;
+		if (!worker.deques[lane].Empty() && worker.deques[lane].Pop(task))
+		{
+			return task;
+		}
+
+		return TakeInjectedBatch(worker, lane);
+	}
+
+	QueuedTask* StealTask(size_t index, size_t lane)
+	{
+		Worker& worker = *workers[index];
+
+		//Tasks from a worker on the same node find their data in memory and caches close by
+		QueuedTask* task;
+		if (nodeWorkers.size() > 1)
+		{
+			const std::vector<size_t>& neighbours = nodeWorkers[worker.node];
+			for (size_t attempt = 0; attempt < 2 * neighbours.size() && neighbours.size() > 1; ++attempt)
+			{
+				const size_t victim = neighbours[static_cast<size_t>(NextRandom(worker) % neighbours.size())];
+				WorkStealingDeque<QueuedTask*>& deque = workers[victim]->deques[lane];
+				if (victim != index && !deque.Empty() && deque.Steal(task))
+				{
+					return task;
+				}
+			}
+		}
+
+		//Random victims spread thieves out instead of all of them hitting the same deque
+		for (size_t attempt = 0; attempt < 2 * threadCount && threadCount > 1; ++attempt)
+		{
+			const size_t victim = static_cast<size_t>(NextRandom(worker) % threadCount);
+			WorkStealingDeque<QueuedTask*>& deque = workers[victim]->deques[lane];
+			if (victim != index && !deque.Empty() && deque.Steal(task))
+			{
+				return task;
+			}
+		}
+
+		return nullptr;
+	}
+
+	//Runs one injected task and queues up to a fair share of the rest on the worker's own deque
+	QueuedTask* TakeInjectedBatch(Worker& worker, size_t lane)
+	{
+		Injector& injector = injectors[lane];
+		if (injector.count.load(std::memory_order_relaxed) == 0)
+		{
+			return nullptr;
+		}
+
+		std::lock_guard<std::mutex> lock(injector.mutex);
+		if (injector.count.load() == 0)
+		{
+			return nullptr;
+		}
+
+		size_t batch = std::max<size_t>(1, injector.count.load() / threadCount);
+		if (batch > MaxInjectorBatch)
+		{
+			batch = MaxInjectorBatch;
+		}
+		QueuedTask* task = PopInjected(injector);
+		for (size_t taken = 1; taken < batch; ++taken)
+		{
+			worker.deques[lane].Push(PopInjected(injector));
+		}
+
+		return task;
+	}
+
+	static QueuedTask* TakeInjected(Injector& injector)
+	{
+		if (injector.count.load(std::memory_order_relaxed) == 0)
+		{
+			return nullptr;
+		}
+
+		std::lock_guard<std::mutex> lock(injector.mutex);
+		if (injector.count.load() == 0)
+		{
+			return nullptr;
+		}
+
+		return PopInjected(injector);
+	}
+
+	//An injector is a ring that doubles when full, so once it has grown to the largest backlog it allocates nothing.
+	//Both are called with the injector's mutex held.
+	static void PushInjected(Injector& injector, QueuedTask* task)
+	{
+		const size_t count = injector.count.load(std::memory_order_relaxed);
+		if (count == injector.ring.size())
+		{
+			std::vector<QueuedTask*> grown(std::max<size_t>(64, 2 * injector.ring.size()));
+			for (size_t index = 0; index < count; ++index)
+			{
+				grown[index] = injector.ring[(injector.head + index) % injector.ring.size()];
+			}
+			injector.ring.swap(grown);
+			injector.head = 0;
+		}
+
+		injector.ring[(injector.head + count) % injector.ring.size()] = task;
+		injector.count.store(count + 1);
+	}
+
+	static QueuedTask* PopInjected(Injector& injector)
+	{
+		QueuedTask* task = injector.ring[injector.head];
+		injector.head = (injector.head + 1) % injector.ring.size();
+		injector.count.store(injector.count.load(std::memory_order_relaxed) - 1);
+		return task;
+	}
+
+	//Whether any of the laneCount highest priorities has a queued task
+	bool HasWork(size_t laneCount) const
+	{
+		for (size_t lane = 0; lane < laneCount; ++lane)
+		{
+			if (injectors[lane].count.load() > 0)
+			{
+				return true;
+			}
+		}
+
+		for (const std::unique_ptr<Worker>& worker : workers)
+		{
+			for (size_t lane = 0; lane < laneCount; ++lane)
+			{
+				if (!worker->deques[lane].Empty())
+				{
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	//Looks for work until ready returns true or the spin time runs out, backing off from a few pause instructions to
+	//yielding the core. Returns false straight away under the PowerSaving policy or once the pool is stopping.
+	template<class Ready>
+	bool SpinUntil(const Ready& ready) const
+	{
+		const int64_t spinTime = spinNanoseconds.load(std::memory_order_relaxed);
+		if (spinTime == 0)
+		{
+			return false;
+		}
+
+		const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(spinTime);
+		size_t pauses = 1;
+		while (!closed.load(std::memory_order_relaxed) && !invalid.load(std::memory_order_relaxed))
+		{
+			if (ready())
+			{
+				return true;
+			}
+
+			if (pauses <= MaxSpinPauses)
+			{
+				for (size_t pause = 0; pause < pauses; ++pause)
+				{
+					CpuRelax();
+				}
+				pauses *= 2;
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+
+			if (std::chrono::steady_clock::now() >= deadline)
+			{
+				return false;
+			}
+		}
+
+		return false;
+	}
+
+	static void CpuRelax()
+	{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+		_mm_pause();
+#else
+		std::this_thread::yield();
+#endif
+	}
+
+	//Sleeps until there may be work the worker can run, returns false once it should exit
+	bool Park(size_t index)
+	{
+		const uint32_t token = wake.Prepare();
+		sleepingCount.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		const bool stopping = invalid.load() || closed.load();
+		bool hasWork = HasWork(LaneCount(index));
+		if (!hasWork && !stopping)
+		{
+			wake.Wait(token);
+			hasWork = HasWork(LaneCount(index));
+		}
+
+		sleepingCount.fetch_sub(1);
+		return !invalid.load() && (hasWork || !stopping);
+	}
+
+	static void RunOrDrop(QueuedTask* task, bool run)
+	{
+		if (run)
+		{
+			task->task();
+		}
+		ObjectPool<QueuedTask>::Destroy(task);
+	}
+
+	static uint64_t NextRandom(Worker& worker)
+	{
+		//xorshift64
+		uint64_t x = worker.randomState;
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		worker.randomState = x;
+		return x;
+	}
+
 	size_t threadCount = 0;
 
+	CpuTopology topology;
+	std::vector<std::vector<size_t>> nodeWorkers; //workers on each node, empty unless pinned
+
+	std::vector<std::unique_ptr<Worker>> workers;
 	std::vector<std::thread> threads;
-	ConcurrentQueue<std::function<void()>> workQueue;
-};
 
+	Injector injectors[PriorityCount];
+
+	WakeSignal wake;
+	std::atomic<size_t> sleepingCount{ 0 }; //parked workers and callers waiting on a parallel call
+	std::atomic<size_t> joiningCount{ 0 }; //of which callers
+
+	WakeSignal futureWake; //notified by futures callers in Wait are waiting for
+	std::atomic<size_t> futureSleepingCount{ 0 };
 
+	std::atomic<bool> closed{ false }; //finish queued tasks then exit
+	std::atomic<bool> invalid{ false }; //exit after the running tasks
+
+	std::atomic<WaitPolicy> waitPolicy{ WaitPolicy::LowLatency };
+	std::atomic<int64_t> spinNanoseconds{ 0 }; //0 under PowerSaving
+
+	std::atomic<size_t> reservedCount{ 0 };
+	std::atomic<size_t> agingInterval{ DefaultAgingInterval };
+	std::atomic<bool> laneStatistics{ false };
+	LaneCounters laneCounters[PriorityCount]; //tasks run by threads outside the pool
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+//Lets threads sleep until another wakes them without the waking thread taking a lock. A sleeper takes a token with
+//Prepare, checks whatever it is waiting for once more, then passes the token to Wait, which returns straight away if
+//the signal was notified after Prepare, so a wake-up can't slip in between the check and the sleep.
+//With C++20 a sleeper waits on the atomic itself, a futex on Linux and WaitOnAddress on Windows, so notifying costs
+//an increment and only makes a system call when a thread is asleep. Timed waits, and every wait before C++20, use a
+//condition variable that notifiers only lock while someone is waiting on it.
+class WakeSignal
+{
+public:
+	uint32_t Prepare() const
+	{
+		return epoch.load();
+	}
+
+	void Wait(uint32_t token)
+	{
+#if defined(__cpp_lib_atomic_wait)
+		epoch.wait(token);
+#else
+		std::unique_lock<std::mutex> lock(mutex);
+		conditionWaiting.fetch_add(1);
+		condition.wait(lock, [this, token]() { return epoch.load() != token; });
+		conditionWaiting.fetch_sub(1);
+#endif
+	}
+
+	//Returns false if the time ran out before a notify
+	template<class Clock, class Duration>
+	bool WaitUntil(uint32_t token, const std::chrono::time_point<Clock, Duration>& time)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		conditionWaiting.fetch_add(1);
+		const bool woken = condition.wait_until(lock, time, [this, token]() { return epoch.load() != token; });
+		conditionWaiting.fetch_sub(1);
+		return woken;
+	}
+
+	void NotifyOne()
+	{
+		epoch.fetch_add(1);
+#if defined(__cpp_lib_atomic_wait)
+		epoch.notify_one();
+#endif
+		NotifyCondition(false);
+	}
+
+	void NotifyAll()
+	{
+		epoch.fetch_add(1);
+#if defined(__cpp_lib_atomic_wait)
+		epoch.notify_all();
+#endif
+		NotifyCondition(true);
+	}
+
+private:
+	void NotifyCondition(bool all)
+	{
+		//The waiter counts itself before checking the epoch and this checks the count after changing it, so one of
+		//them sees the other
+		if (conditionWaiting.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (all)
+			{
+				condition.notify_all();
+			}
+			else
+			{
+				condition.notify_one();
+			}
+		}
+	}
+
+	std::atomic<uint32_t> epoch{ 0 };
+	std::atomic<uint32_t> conditionWaiting{ 0 };
+	std::mutex mutex;
+	std::condition_variable condition;
+};
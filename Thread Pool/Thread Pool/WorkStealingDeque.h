@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+//Chase-Lev work stealing deque with the memory orderings of Le et al. 2013. One owning thread pushes and pops
+//at the bottom, any thread may steal from the top. The ring grows when full, retired rings are kept until the
+//deque is destroyed since a thief may still be reading one.
+template<class DataType>
+class WorkStealingDeque
+{
+	static_assert(std::is_trivially_copyable<DataType>::value, "elements are copied through atomics");
+
+public:
+	explicit WorkStealingDeque(size_t initialCapacity = 256)
+	{
+		size_t capacity = 1;
+		while (capacity < initialCapacity)
+		{
+			capacity <<= 1;
+		}
+
+		rings.emplace_back(new Ring(capacity));
+		ring.store(rings.back().get(), std::memory_order_relaxed);
+	}
+
+	WorkStealingDeque(const WorkStealingDeque&) = delete;
+	WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+	//owner only
+	void Push(DataType value)
+	{
+		const int64_t b = bottom.load(std::memory_order_relaxed);
+		const int64_t t = top.load(std::memory_order_acquire);
+		Ring* current = ring.load(std::memory_order_relaxed);
+
+		if (b - t > static_cast<int64_t>(current->mask))
+		{
+			current = Grow(current, t, b);
+		}
+
+		current->Store(b, value);
+		//a release store rather than Le et al.'s release fence and relaxed store, the same ordering in a form
+		//ThreadSanitizer understands
+		bottom.store(b + 1, std::memory_order_release);
+	}
+
+	//owner only, takes the most recently pushed value
+	bool Pop(DataType& out)
+	{
+		const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		Ring* current = ring.load(std::memory_order_relaxed);
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+
+		if (t > b)
+		{
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		out = current->Load(b);
+		if (t == b)
+		{
+			//last value, race any thief for it
+			const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+
+		return true;
+	}
+
+	//any thread, takes the least recently pushed value. Fails if the deque is empty or another thread won the race.
+	bool Steal(DataType& out)
+	{
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t b = bottom.load(std::memory_order_acquire);
+
+		if (t >= b)
+		{
+			return false;
+		}
+
+		Ring* current = ring.load(std::memory_order_acquire);
+		out = current->Load(t);
+		return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+	//a snapshot that may already be stale
+	size_t Size() const
+	{
+		const int64_t b = bottom.load(std::memory_order_seq_cst);
+		const int64_t t = top.load(std::memory_order_seq_cst);
+		return b > t ? static_cast<size_t>(b - t) : 0;
+	}
+
+	bool Empty() const
+	{
+		return Size() == 0;
+	}
+
+private:
+	struct Ring
+	{
+		explicit Ring(size_t capacity) : mask(capacity - 1), cells(new std::atomic<DataType>[capacity])
+		{
+		}
+
+		DataType Load(int64_t index) const
+		{
+			return cells[static_cast<size_t>(index) & mask].load(std::memory_order_relaxed);
+		}
+
+		void Store(int64_t index, DataType value)
+		{
+			cells[static_cast<size_t>(index) & mask].store(value, std::memory_order_relaxed);
+		}
+
+		size_t mask;
+		std::unique_ptr<std::atomic<DataType>[]> cells;
+	};
+
+	Ring* Grow(Ring* current, int64_t t, int64_t b)
+	{
+		rings.emplace_back(new Ring((current->mask + 1) * 2));
+		Ring* grown = rings.back().get();
+		for (int64_t index = t; index < b; ++index)
+		{
+			grown->Store(index, current->Load(index));
+		}
+
+		ring.store(grown, std::memory_order_release);
+		return grown;
+	}
+
+	//top and bottom on their own cache lines so thieves and the owner don't false share
+	alignas(64) std::atomic<int64_t> top{ 0 };
+	alignas(64) std::atomic<int64_t> bottom{ 0 };
+	alignas(64) std::atomic<Ring*> ring{ nullptr };
+
+	std::vector<std::unique_ptr<Ring>> rings; //owner only
+};